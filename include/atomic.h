@@ -0,0 +1,107 @@
+/*
+ * RISC-V testos 原子操作
+ * 基于 A 扩展的 AMO 与 LR/SC 指令
+ */
+
+#ifndef __ATOMIC_H__
+#define __ATOMIC_H__
+
+#include "types.h"
+
+// 内存屏障
+#define smp_mb()        asm volatile("fence rw, rw" ::: "memory")
+#define smp_rmb()       asm volatile("fence r, r" ::: "memory")
+#define smp_wmb()       asm volatile("fence w, w" ::: "memory")
+#define barrier()       asm volatile("" ::: "memory")
+
+// 单次访问，防止编译器合并或拆分
+#define READ_ONCE(x)        (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val)  (*(volatile __typeof__(x) *)&(x) = (val))
+
+// 获取/释放语义的加载与存储
+#define smp_load_acquire(p) ({                          \
+    __typeof__(*(p)) ___v = READ_ONCE(*(p));            \
+    asm volatile("fence r, rw" ::: "memory");           \
+    ___v;                                               \
+})
+
+#define smp_store_release(p, v) do {                    \
+    asm volatile("fence rw, w" ::: "memory");           \
+    WRITE_ONCE(*(p), (v));                              \
+} while (0)
+
+// ===============================================================================
+// 64 位原子操作（返回旧值）
+// ===============================================================================
+static inline uint64_t atomic_swap(volatile uint64_t *p, uint64_t val)
+{
+    uint64_t old;
+    asm volatile("amoswap.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(val) : "memory");
+    return old;
+}
+
+static inline uint64_t atomic_fetch_add(volatile uint64_t *p, uint64_t val)
+{
+    uint64_t old;
+    asm volatile("amoadd.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(val) : "memory");
+    return old;
+}
+
+static inline uint64_t atomic_fetch_or(volatile uint64_t *p, uint64_t val)
+{
+    uint64_t old;
+    asm volatile("amoor.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(val) : "memory");
+    return old;
+}
+
+static inline uint64_t atomic_fetch_and(volatile uint64_t *p, uint64_t val)
+{
+    uint64_t old;
+    asm volatile("amoand.d.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(val) : "memory");
+    return old;
+}
+
+/**
+ * 比较并交换：*p == expected 时写入 desired
+ * @return 操作前 *p 的值，等于 expected 表示成功
+ */
+static inline uint64_t atomic_cmpxchg(volatile uint64_t *p, uint64_t expected, uint64_t desired)
+{
+    uint64_t old;
+    uint64_t tmp;
+
+    asm volatile("1: lr.d.aqrl %0, %2\n"
+                 "   bne       %0, %3, 2f\n"
+                 "   sc.d.rl   %1, %4, %2\n"
+                 "   bnez      %1, 1b\n"
+                 "2:\n"
+                 : "=&r"(old), "=&r"(tmp), "+A"(*p)
+                 : "r"(expected), "r"(desired)
+                 : "memory");
+    return old;
+}
+
+// ===============================================================================
+// 32 位原子操作
+// ===============================================================================
+static inline uint32_t atomic_swap32(volatile uint32_t *p, uint32_t val)
+{
+    uint32_t old;
+    asm volatile("amoswap.w.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(val) : "memory");
+    return old;
+}
+
+static inline uint32_t atomic_fetch_add32(volatile uint32_t *p, uint32_t val)
+{
+    uint32_t old;
+    asm volatile("amoadd.w.aqrl %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(val) : "memory");
+    return old;
+}
+
+// 自旋等待时的提示（Zihintpause 的 pause 编码，不支持时等同 nop）
+static inline void cpu_relax(void)
+{
+    asm volatile(".word 0x0100000f" ::: "memory");
+}
+
+#endif /* __ATOMIC_H__ */
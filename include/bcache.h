@@ -0,0 +1,86 @@
+/*
+ * RISC-V testos 块缓冲缓存
+ *
+ * 以 (设备, 块号) 为键缓存 4KB 块，哈希表查找。替换策略是 LRU-2 的两队列
+ * 近似：只访问过一次的块进冷队列，再次命中后提升到热队列，淘汰时优先
+ * 从冷队列尾部选，一次性的顺序扫描不会冲掉热数据。
+ * 顺序访问时按自适应窗口异步预读；脏块由定时器按块号排序后批量回写，
+ * 相邻块由驱动合并成一个请求。
+ */
+
+#ifndef __BCACHE_H__
+#define __BCACHE_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "blkdev.h"
+
+#define BCACHE_BLOCK_SIZE       PAGE_SIZE
+#define BCACHE_BLOCK_SECTORS    (BCACHE_BLOCK_SIZE / BLK_SECTOR_SIZE)
+#define BCACHE_DEFAULT_SIZE     (4 * 1024 * 1024)   // 可由启动参数 bcache=<size> 覆盖
+
+// 缓冲块状态
+#define B_VALID         (1U << 0)   // 数据有效
+#define B_BUSY          (1U << 1)   // 读请求在途
+#define B_DIRTY         (1U << 2)   // 已修改，等待回写
+#define B_WRITEBACK     (1U << 3)   // 回写请求在途
+#define B_READAHEAD     (1U << 4)   // 预读进来，尚未被访问
+#define B_HOT           (1U << 5)   // 位于热队列
+
+typedef struct buf {
+    blkdev_t *dev;
+    uint64_t block;             // 块号（BCACHE_BLOCK_SIZE 粒度）
+    uint8_t *data;
+    volatile uint32_t flags;    // B_*
+    uint32_t refcnt;
+    struct buf *hnext;          // 哈希链
+    struct buf *prev;           // 冷/热队列，头部最近使用
+    struct buf *next;
+    blk_request_t req;
+} buf_t;
+
+/**
+ * 初始化缓存
+ * @param size 缓存字节数，按块向下取整
+ */
+void bcache_init(size_t size);
+
+/**
+ * 读取一个块并增加引用，用完后必须 brelse()
+ * @return 缓冲块，I/O 失败或缓存已被占满时返回 NULL
+ */
+buf_t *bread(blkdev_t *dev, uint64_t block);
+
+/**
+ * 释放 bread() 得到的引用
+ */
+void brelse(buf_t *b);
+
+/**
+ * 标记缓冲块已修改，由定时器延迟回写
+ */
+void bdirty(buf_t *b);
+
+/**
+ * 回写所有脏块并等待完成
+ * @return 成功返回 0，有块回写失败返回 -1
+ */
+int bsync(void);
+
+/**
+ * 定时器 tick 回调：有回写工作时挂起块设备软中断，由软中断回收已完成的回写请求、
+ * 按周期发起新一轮回写
+ */
+void bcache_tick(void);
+
+/**
+ * 打印命中率、预读与淘汰统计
+ */
+void bcache_dump_stats(void);
+
+/**
+ * 顺序扫描、热数据保护与回写合并测试
+ */
+void bcache_bench(void);
+
+#endif /* __BCACHE_H__ */
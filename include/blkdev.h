@@ -0,0 +1,99 @@
+/*
+ * RISC-V testos 块设备层
+ *
+ * 驱动通过 blkdev_register() 注册设备，上层用 blk_submit() 批量提交异步请求，
+ * 再用 blk_wait() 轮询等待完成；blk_read()/blk_write() 是单个请求的同步封装。
+ */
+
+#ifndef __BLKDEV_H__
+#define __BLKDEV_H__
+
+#include "types.h"
+
+#define BLK_SECTOR_SIZE     512
+#define BLK_SECTOR_SHIFT    9
+#define BLK_MAX_DEVICES     8
+
+// 请求状态
+#define BLK_REQ_OK          0
+#define BLK_REQ_PENDING     1
+#define BLK_REQ_ERROR       (-1)
+
+typedef struct blk_request {
+    uint64_t sector;        // 起始扇区
+    uint32_t count;         // 扇区数
+    bool write;
+    void *buf;
+    volatile int status;    // BLK_REQ_*
+    struct blk_request *next;   // 驱动内部使用（合并相邻请求）
+} blk_request_t;
+
+typedef struct blkdev blkdev_t;
+
+typedef struct {
+    /**
+     * 提交一批请求，返回实际接受的个数（队列满时可能少于 n）
+     */
+    int (*submit)(blkdev_t *dev, blk_request_t **reqs, int n);
+
+    /**
+     * 回收已完成的请求（优先当前 hart 的队列），返回完成个数
+     */
+    int (*poll)(blkdev_t *dev);
+
+    /**
+     * 打印驱动统计信息
+     */
+    void (*dump)(blkdev_t *dev);
+} blkdev_ops_t;
+
+struct blkdev {
+    const char *name;
+    int id;                 // 注册时分配
+    uint64_t capacity;      // 扇区数
+    bool read_only;
+    const blkdev_ops_t *ops;
+    void *priv;
+};
+
+/**
+ * 注册块设备
+ * @return 设备号，失败返回 -1
+ */
+int blkdev_register(blkdev_t *dev);
+
+/**
+ * 按设备号/名称查找块设备
+ */
+blkdev_t *blkdev_get(int id);
+blkdev_t *blkdev_find(const char *name);
+
+/**
+ * 批量提交请求，队列满时轮询完成后继续提交，直到全部提交
+ */
+int blk_submit(blkdev_t *dev, blk_request_t **reqs, int n);
+
+/**
+ * 轮询等待请求完成
+ * @return 请求的最终状态
+ */
+int blk_wait(blkdev_t *dev, blk_request_t *req);
+
+/**
+ * 同步读写
+ * @return 成功返回 0，失败返回 -1
+ */
+int blk_read(blkdev_t *dev, uint64_t sector, void *buf, uint32_t count);
+int blk_write(blkdev_t *dev, uint64_t sector, const void *buf, uint32_t count);
+
+/**
+ * 打印所有块设备信息
+ */
+void blkdev_dump(void);
+
+/**
+ * 顺序/随机读吞吐测试
+ */
+void blk_bench(void);
+
+#endif /* __BLKDEV_H__ */
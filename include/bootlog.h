@@ -0,0 +1,44 @@
+/*
+ * RISC-V testos 启动计时
+ *
+ * 每个启动阶段结束时用 bootlog_mark() 记下 time CSR，shell 命令 bootlog 打印
+ * 各阶段的时间线。_start 到 kernel_main 之间的时间点由 boot.S 记在 bootlog_early[]，
+ * 从压缩映像启动时还会补上解压存根的起止时间。
+ */
+
+#ifndef __BOOTLOG_H__
+#define __BOOTLOG_H__
+
+#define BOOTLOG_MAX             32      // 最多记录的阶段数
+
+// boot.S 写入 bootlog_early[] 的时间点
+#define BOOTLOG_EARLY_ENTRY     0       // 进入 _start
+#define BOOTLOG_EARLY_BSS       1       // clear_bss 完成
+#define BOOTLOG_EARLY_MEM       2       // mem_init 完成
+#define BOOTLOG_EARLY_COUNT     3
+
+#ifndef __ASSEMBLER__
+
+#include "types.h"
+
+extern uint64_t bootlog_early[BOOTLOG_EARLY_COUNT];
+
+/**
+ * 把 boot.S 和 zboot 存根记下的时间点导入启动日志，须在第一次 bootlog_mark() 之前调用
+ */
+void bootlog_init(void);
+
+/**
+ * 记录一个启动阶段的结束时间，只在启动 hart 上调用
+ * @param phase 阶段名，须为常量字符串
+ */
+void bootlog_mark(const char *phase);
+
+/**
+ * 打印启动时间线：每个阶段距起点的时间和本阶段耗时
+ */
+void bootlog_dump(void);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* __BOOTLOG_H__ */
@@ -19,6 +19,16 @@
     
     #define CLINT_BASE      0x02000000      // QEMU virt CLINT 基地址
     #define TIMER_FREQ_HZ   10000000UL      // 10MHz
+
+    #define MAX_HARTS       4               // QEMU virt 最多启动的 hart 数
+
+    #define VIRTIO_MMIO_BASE    0x10001000  // QEMU virt virtio-mmio 第一个槽位
+    #define VIRTIO_MMIO_STRIDE  0x1000
+    #define VIRTIO_MMIO_NUM     8
+
+    // 页表属性：QEMU 不需要额外的内存类型位
+    #define PTE_ATTR_MEM    0UL
+    #define PTE_ATTR_DEV    0UL
 #elif defined(PLATFORM_SG2002)
     // SG2002 平台配置
     #define UART_BASE       0x4140000       // SG2002 UART0 基地址
@@ -27,17 +37,37 @@
     
     #define CLINT_BASE      0x02000000      // 假设基地址相同或根据实际修改
     #define TIMER_FREQ_HZ   10000000UL
+
+    #define MAX_HARTS       1               // SG2002 上只有一个 C906 大核运行本内核
+
+    // 页表属性：C906 开启 MAEE 后使用 PTE[63:59] 描述内存类型
+    #define PTE_ATTR_MEM    ((1UL << 62) | (1UL << 61) | (1UL << 60))  // C | B | SH
+    #define PTE_ATTR_DEV    ((1UL << 63) | (1UL << 60))                // SO | SH
 #else
     #error "Unknown platform! Please define PLATFORM_QEMU or PLATFORM_SG2002"
 #endif
 
+// 用户程序加载窗口（程序按此地址链接，启动时从堆中保留）
+#define USER_BASE       0x80800000
+#define USER_SIZE       0x800000        // 8MB
+
 // 系统调用入口地址
 #ifndef __SYS_ENTER_ADDR__
 #define __SYS_ENTER_ADDR__ 0x80204000  
 #endif
 
 // 栈大小配置
-#define STACK_SIZE      0x2000          // 8KB 栈空间
+#define STACK_SIZE          0x2000      // 8KB 每个 hart 的内核栈
+#define STACK_GUARD_SIZE    0x1000      // 4KB 栈保护页（不映射，溢出即缺页）
+#define OVERFLOW_STACK_SIZE 0x1000      // 4KB 栈溢出处理专用栈
+#define KSTACK_SLOT_SIZE    (STACK_GUARD_SIZE + STACK_SIZE)
+#define IRQ_STACK_SIZE      0x4000      // 16KB 每个 hart 的中断栈（容纳多层嵌套 trap frame）
+#define IRQ_STACK_SLOT_SIZE (STACK_GUARD_SIZE + IRQ_STACK_SIZE)
+#define KSTACK_PAINT        0x5AC4B0A75AC4B0A7ULL  // 栈水位线填充值
+
+// 页大小
+#define PAGE_SIZE       0x1000          // 4KB
+#define PAGE_SHIFT      12
 
 // UART 通用配置
 #define UART_BAUDRATE   115200          // 波特率
@@ -0,0 +1,164 @@
+/*
+ * RISC-V testos 共享内存通道
+ *
+ * 单生产者单消费者环形队列，放在 mmap(MAP_SHARED) 得到的共享内存里，
+ * fork 之后两个进程各占一端。收发在无竞争时只读写共享内存，不进入内核；
+ * 队列空（满）时先自旋 CHAN_SPIN 次，仍然没有进展才标记等待并用 futex 睡眠，
+ * 对端发布新位置后只在看到等待标记时才调用 FUTEX_WAKE。
+ * head 只由消费者写，tail 只由生产者写，两者各占一个 cache line。
+ * 本头文件只依赖系统调用网关，用户程序也可以直接包含。
+ */
+
+#ifndef __CHAN_H__
+#define __CHAN_H__
+
+#include "types.h"
+#include "atomic.h"
+#include "string.h"
+#include "futex.h"
+#include "sysgate.h"
+
+#define CHAN_CACHE_LINE     64
+#define CHAN_SPIN           256     // 睡眠前的自旋次数
+
+typedef struct {
+    // 消费者写
+    volatile uint32_t head;             // 下一个读取的序号
+    volatile uint32_t recv_waiting;     // 消费者在 tail 上睡眠
+    uint8_t pad0[CHAN_CACHE_LINE - 8];
+    // 生产者写
+    volatile uint32_t tail;             // 下一个写入的序号
+    volatile uint32_t send_waiting;     // 生产者在 head 上睡眠
+    uint8_t pad1[CHAN_CACHE_LINE - 8];
+    // 初始化后只读
+    uint32_t nslots;                    // 2 的幂
+    uint32_t slot_size;
+    uint8_t pad2[CHAN_CACHE_LINE - 8];
+    uint8_t slots[];
+} chan_t;
+
+/**
+ * 通道占用的字节数
+ */
+static inline size_t chan_bytes(uint32_t nslots, uint32_t slot_size)
+{
+    return sizeof(chan_t) + (size_t)nslots * slot_size;
+}
+
+/**
+ * 初始化通道，须在 fork 之前完成
+ * @return 0 成功，-1 nslots 不是 2 的幂
+ */
+static inline int chan_init(chan_t *c, uint32_t nslots, uint32_t slot_size)
+{
+    if (nslots == 0 || (nslots & (nslots - 1)) != 0 || slot_size == 0) {
+        return -1;
+    }
+    c->head         = 0;
+    c->tail         = 0;
+    c->recv_waiting = 0;
+    c->send_waiting = 0;
+    c->nslots       = nslots;
+    c->slot_size    = slot_size;
+    return 0;
+}
+
+// 等待 *pos 离开 seen：先自旋，再设置等待标记后复查，仍未变化则睡眠。
+// 标记与复查之间的全屏障和对端“发布后检查标记”配对，保证不会丢失唤醒
+static inline void chan_wait(volatile uint32_t *pos, uint32_t seen, volatile uint32_t *waiting)
+{
+    for (int i = 0; i < CHAN_SPIN; i++) {
+        if (READ_ONCE(*pos) != seen) {
+            return;
+        }
+        cpu_relax();
+    }
+    for (;;) {
+        WRITE_ONCE(*waiting, 1);
+        smp_mb();
+        if (READ_ONCE(*pos) != seen) {
+            break;
+        }
+        sysgate(SYS_futex, (long)pos, FUTEX_WAIT, seen, 0, 0);
+    }
+    WRITE_ONCE(*waiting, 0);
+}
+
+// 发布新位置，对端在等待时唤醒它
+static inline void chan_publish(volatile uint32_t *pos, uint32_t val, volatile uint32_t *waiting)
+{
+    smp_store_release(pos, val);
+    smp_mb();
+    if (READ_ONCE(*waiting)) {
+        sysgate(SYS_futex, (long)pos, FUTEX_WAKE, 1, 0, 0);
+    }
+}
+
+/**
+ * 生产者：等待空闲槽位，返回槽位地址，填好后调用 chan_commit
+ */
+static inline void *chan_reserve(chan_t *c)
+{
+    uint32_t tail = c->tail;
+    uint32_t head;
+
+    while (tail - (head = smp_load_acquire(&c->head)) == c->nslots) {
+        chan_wait(&c->head, head, &c->send_waiting);
+    }
+    return c->slots + (size_t)(tail & (c->nslots - 1)) * c->slot_size;
+}
+
+/**
+ * 生产者：发布 chan_reserve 得到的槽位
+ */
+static inline void chan_commit(chan_t *c)
+{
+    chan_publish(&c->tail, c->tail + 1, &c->recv_waiting);
+}
+
+/**
+ * 消费者：等待下一条消息，返回槽位地址，用完后调用 chan_release
+ */
+static inline void *chan_peek(chan_t *c)
+{
+    uint32_t head = c->head;
+    uint32_t tail;
+
+    while ((tail = smp_load_acquire(&c->tail)) == head) {
+        chan_wait(&c->tail, tail, &c->recv_waiting);
+    }
+    return c->slots + (size_t)(head & (c->nslots - 1)) * c->slot_size;
+}
+
+/**
+ * 消费者：归还 chan_peek 得到的槽位
+ */
+static inline void chan_release(chan_t *c)
+{
+    chan_publish(&c->head, c->head + 1, &c->send_waiting);
+}
+
+/**
+ * 复制发送一条消息，len 不超过 slot_size
+ */
+static inline void chan_send(chan_t *c, const void *msg, size_t len)
+{
+    memcpy(chan_reserve(c), msg, len);
+    chan_commit(c);
+}
+
+/**
+ * 复制接收一条消息，len 不超过 slot_size
+ */
+static inline void chan_recv(chan_t *c, void *buf, size_t len)
+{
+    memcpy(buf, chan_peek(c), len);
+    chan_release(c);
+}
+
+/**
+ * 内核自带测试：两个进程间的往返延迟和单向吞吐
+ */
+void chan_bench(void);
+
+#endif /* __CHAN_H__ */
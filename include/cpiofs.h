@@ -0,0 +1,48 @@
+/*
+ * RISC-V testos 只读 cpio 文件系统
+ *
+ * 支持 newc 格式（"070701"）的 cpio 归档，可以来自 bootloader 传入的 initrd，
+ * 也可以来自块设备。挂载时只建立文件索引，文件内容直接指向内存中的映像，
+ * 不做拷贝。tools/mkcpio 生成的归档把每个文件的数据按页对齐，
+ * 这样只读段可以直接映射执行。
+ */
+
+#ifndef __CPIOFS_H__
+#define __CPIOFS_H__
+
+#include "types.h"
+
+typedef struct {
+    const char *name;
+    const uint8_t *data;        // 指向映像内部
+    size_t size;
+    uint32_t mode;
+} cpio_file_t;
+
+/**
+ * 从设备树读取 initrd 位置并把它从堆中保留（需在大量堆分配之前调用）
+ */
+void initrd_init(void);
+
+/**
+ * 挂载根文件系统：优先使用 initrd，否则尝试第一个块设备
+ */
+void cpiofs_init(void);
+
+/**
+ * 挂载内存中的 cpio 映像
+ * @return 文件数，格式错误返回 -1
+ */
+int cpiofs_mount(const uint8_t *image, size_t size, const char *source);
+
+/**
+ * 按名称查找文件（名称不带前导 "/" 或 "./"）
+ */
+const cpio_file_t *cpiofs_lookup(const char *name);
+
+/**
+ * 列出所有文件
+ */
+void cpiofs_list(void);
+
+#endif /* __CPIOFS_H__ */
@@ -0,0 +1,68 @@
+/*
+ * RISC-V testos ELF64 定义
+ */
+
+#ifndef __ELF_H__
+#define __ELF_H__
+
+#include "types.h"
+
+#define EI_NIDENT   16
+#define ELFMAG0     0x7f
+#define ELFMAG1     'E'
+#define ELFMAG2     'L'
+#define ELFMAG3     'F'
+#define ELFCLASS64  2
+#define ET_EXEC     2
+#define EM_RISCV    243
+
+// 程序头类型
+#define PT_LOAD     1
+#define PT_DYNAMIC  2
+#define PT_PHDR     6
+#define PT_TLS      7
+
+// 段权限
+#define PF_X        1
+#define PF_W        2
+#define PF_R        4
+
+// 辅助向量 (Auxiliary Vector) 类型定义
+#define AT_NULL     0
+#define AT_PHDR     3
+#define AT_PHENT    4
+#define AT_PHNUM    5
+#define AT_PAGESZ   6
+#define AT_ENTRY    9
+#define AT_RANDOM   25
+
+typedef struct {
+    uint8_t  e_ident[EI_NIDENT];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} Elf64_Ehdr;
+
+// ELF64 程序头结构，用于加载程序与 musl libc 初始化 TLS
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} Elf64_Phdr;
+
+#endif /* __ELF_H__ */
@@ -16,6 +16,7 @@ typedef struct {
     uint64_t mtval;        // 异常值
     uint64_t mstatus;      // 机器状态寄存器
     uint64_t fcsr;         // 浮点控制和状态寄存器
+    uint64_t entry_cycle;  // 进入 trap 时的 cycle 计数
 } trap_frame_t;
 
 // 异常处理函数类型
@@ -33,5 +34,6 @@ void register_syscall_handler(uint64_t syscall_num, syscall_handler_t handler);
 void handle_exception(trap_frame_t *frame);
 void handle_syscall(trap_frame_t *frame);
 void print_hex(uint64_t val);
+void irq_dump_stats(void);
 
 #endif /* __EXCEPTION_H__ */
\ No newline at end of file
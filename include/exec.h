@@ -0,0 +1,77 @@
+/*
+ * RISC-V testos 用户程序加载
+ *
+ * 程序仍在 S 态运行，通过系统调用网关与内核交互，但每个进程有自己的
+ * 用户窗口映射（见 vm.h）。ELF 映像第一次执行时解码成按页排列的映射表并缓存：
+ * 满足页对齐条件的只读页直接指向文件系统映像，其余页预先拼好内容作为模板。
+ * 之后再执行同一个程序只需建立页表，可写页以写时复制方式共享模板。
+ */
+
+#ifndef __EXEC_H__
+#define __EXEC_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "cpiofs.h"
+#include "vm.h"
+#include "elf.h"
+
+#define EXEC_STACK_PAGES    16          // 64KB 用户栈，位于用户窗口顶部
+#define EXEC_STACK_TOP      (USER_BASE + USER_SIZE)
+#define EXEC_STACK_BOTTOM   (EXEC_STACK_TOP - EXEC_STACK_PAGES * PAGE_SIZE)
+#define EXEC_MAX_ARGS       16
+#define EXEC_MAX_ARGLEN     1024        // argv 字符串总长度上限，与向量一起放在栈顶页
+#define EXEC_FLAT_PAGES     (LEVEL_SIZE(1) / PAGE_SIZE)   // 平坦映像连同 bss 占第一个 L1 表项
+
+typedef struct exec_image exec_image_t;
+
+/**
+ * 保留用户程序加载窗口（需在大量堆分配之前调用）
+ */
+void exec_init(void);
+
+/**
+ * 获取文件解码后的映像，首次调用时解码并加入缓存
+ * @return 映像，文件不是可执行的 RISC-V ELF 时返回 NULL
+ */
+exec_image_t *exec_image_get(const cpio_file_t *file);
+
+/**
+ * 在新地址空间中建立映像映射和初始用户栈
+ * @param vm    未初始化的地址空间，成功后由调用者负责销毁
+ * @param argv  参数，在当前地址空间中可读
+ * @param entry 返回程序入口
+ * @param sp    返回初始栈指针（指向 argc）
+ * @return 0 成功，-1 参数过长或内存不足
+ */
+int exec_load(vm_space_t *vm, exec_image_t *img, int argc, const char *const argv[],
+              uintptr_t *entry, uintptr_t *sp);
+
+/**
+ * 在新地址空间中装入链接在 USER_BASE 的平坦二进制（如内嵌的 user_prog），
+ * 入口为 USER_BASE。映像之后到第一个 L1 表项末尾都按需清零，不必知道 bss 大小
+ * @param phdr  程序头表，原样作为 AT_PHDR 传给程序（须在内核映射中）
+ * @return 0 成功，-1 映像过大、参数过长或内存不足
+ */
+int exec_load_flat(vm_space_t *vm, const void *image, size_t size, const Elf64_Phdr *phdr,
+                   int phnum, int argc, const char *const argv[], uintptr_t *sp);
+
+/**
+ * 映射用户栈：栈顶页分配私有页，其余页第一次访问时分配
+ * @return 栈顶页的内核地址，失败返回 NULL（vm 由调用者销毁）
+ */
+void *exec_map_stack(vm_space_t *vm);
+
+/**
+ * 切到用户栈跳转入口，a0 = arg（musl 的 _start 约定为栈指针），
+ * 入口返回时 a0 作为退出码交给 ret
+ */
+void exec_jump(uintptr_t entry, uintptr_t sp, uintptr_t arg, void (*ret)(int))
+    __attribute__((noreturn));
+
+/**
+ * 打印映像缓存
+ */
+void exec_dump_cache(void);
+
+#endif /* __EXEC_H__ */
@@ -0,0 +1,60 @@
+/*
+ * RISC-V testos 设备树（FDT）与启动参数
+ *
+ * 只做只读解析：按路径查找节点属性，并从 /chosen/bootargs 中取出
+ * "key=value" 形式的启动参数。
+ */
+
+#ifndef __FDT_H__
+#define __FDT_H__
+
+#include "types.h"
+
+#define FDT_MAGIC           0xd00dfeed
+
+/**
+ * 记录 SBI 传入的 dtb 地址并检查头部
+ * @return 成功返回 0，地址无效或 magic 不匹配返回 -1
+ */
+int fdt_init(uintptr_t dtb);
+
+/**
+ * 获取设备树占用的字节数（头部的 totalsize），没有设备树时返回 0
+ */
+size_t fdt_totalsize(void);
+
+/**
+ * 获取节点属性
+ * @param path 节点路径（如 "/chosen"），节点名可省略 "@unit" 后缀
+ * @param name 属性名
+ * @param lenp 非空时返回属性长度
+ * @return 属性数据（大端），找不到返回 NULL
+ */
+const void *fdt_getprop(const char *path, const char *name, int *lenp);
+
+/**
+ * 读取 1 或 2 个 cell 的大端整数属性
+ * @return 成功返回 0，找不到返回 -1
+ */
+int fdt_getprop_u64(const char *path, const char *name, uint64_t *val);
+
+/**
+ * 对 path 节点的每个直接子节点调用 fn，name 为完整的节点名（含 "@unit"）
+ * @return 子节点个数，找不到 path 返回 -1
+ */
+int fdt_for_each_child(const char *path, void (*fn)(const char *name, void *arg), void *arg);
+
+/**
+ * 获取启动参数值（/chosen/bootargs 中的 key=value）
+ * @param buf 值的存放缓冲区
+ * @return 找到返回 true
+ */
+bool bootarg_get(const char *key, char *buf, size_t size);
+
+/**
+ * 获取数值型启动参数，支持 K/M/G 后缀
+ * @return 找不到或无法解析时返回 def
+ */
+uint64_t bootarg_get_size(const char *key, uint64_t def);
+
+#endif /* __FDT_H__ */
@@ -0,0 +1,49 @@
+/*
+ * RISC-V testos futex
+ *
+ * 等待队列按物理地址哈希：同一物理页在不同进程中映射的地址可以不同，
+ * 共享内存里的同步变量仍然落到同一个键上。只有竞争时才进入内核，
+ * 无竞争路径完全在用户态完成。
+ */
+
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include "types.h"
+
+#define FUTEX_WAIT              0
+#define FUTEX_WAKE              1
+#define FUTEX_PRIVATE_FLAG      128
+#define FUTEX_CLOCK_REALTIME    256
+
+#define FUTEX_HASH_BITS         6
+
+struct timespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+};
+
+/**
+ * futex 系统调用，支持 FUTEX_WAIT（可带相对超时）和 FUTEX_WAKE
+ * @return WAIT 被唤醒返回 0，值不相等返回 -EAGAIN，超时返回 -ETIMEDOUT；
+ *         WAKE 返回唤醒的进程数
+ */
+int64_t sys_futex(uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout);
+
+/**
+ * 唤醒最多 n 个等在物理地址 key 上的进程（内核内部使用，如线程退出时的 clear_tid）
+ * @return 唤醒的进程数
+ */
+int64_t futex_wake_key(uintptr_t key, uint32_t n);
+
+/**
+ * 打印等待/唤醒统计
+ */
+void futex_dump_stats(void);
+
+/**
+ * 读取累计的 futex 系统调用次数（WAIT + WAKE），供测试计算每条消息的系统调用数
+ */
+uint64_t futex_syscalls(void);
+
+#endif /* __FUTEX_H__ */
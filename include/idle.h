@@ -0,0 +1,40 @@
+/*
+ * RISC-V testos 空闲调控器
+ *
+ * 每次进入空闲时预测本次空闲时长，在满足唤醒延迟目标的前提下选择最深的
+ * 空闲状态。状态 0 是 WFI，更深的状态是 SBI HSM 保持型挂起：优先取设备树
+ * /cpus/idle-states 中的状态（riscv,sbi-suspend-param 与 entry/exit-latency-us、
+ * min-residency-us），没有时用固件默认的保持型挂起。
+ *
+ * 预测 = min(到下一次定时器中断的时间, 最近几次空闲时长的典型值)，典型值
+ * 在去掉离群值后标准差不超过均值 1/6 时才采用。没有定时器的从核只靠历史预测。
+ *
+ * 非保持型挂起与 SBI 系统挂起（SUSP）会丢失上下文、后者还要求其他 hart 全部
+ * 停止，不作为空闲状态使用，只在统计中报告固件是否支持。
+ */
+
+#ifndef __IDLE_H__
+#define __IDLE_H__
+
+#include "types.h"
+
+#define IDLE_MAX_STATES         4
+#define IDLE_HISTORY            8       // 参与预测的最近空闲次数
+#define IDLE_LATENCY_DEFAULT_US 100     // 默认唤醒延迟目标
+
+/**
+ * 读取空闲状态与唤醒延迟目标（启动参数 idle_latency=<us>），需在 smp_init 之前调用
+ */
+void idle_init(void);
+
+/**
+ * 选择并进入一个空闲状态，有中断挂起时返回。调用者关中断，中断在返回后才处理
+ */
+void idle_enter(void);
+
+/**
+ * 打印各空闲状态的参数，以及每个 hart 的使用次数、驻留时间和唤醒延迟
+ */
+void idle_dump_stats(void);
+
+#endif /* __IDLE_H__ */
@@ -0,0 +1,115 @@
+/*
+ * RISC-V testos 初始化调用（initcall）
+ *
+ * 各模块用 INITCALL() 把自己的初始化函数登记在 .initcall.<level> 段中，链接脚本
+ * 按级别排序后放在 __initcall_start/__initcall_end 之间，kernel_main 按级别依次
+ * 调用 initcall_run()。同一级别内的顺序只由声明的依赖（其他 initcall 的名字）决定，
+ * 较低级别在较高级别开始前全部完成，跨级别的依赖不必声明。
+ *
+ * 带 INITCALL_PARALLEL 的 initcall 可以在任意 hart 上运行：空闲的从核在调度循环里
+ * 取走依赖已满足的调用（开中断、非中断上下文），启动 hart 同时执行其余调用。
+ * 被推迟的级别（INIT_DEFERRED，以及快速启动时由 initcall_defer() 指定的级别）
+ * 在 shell 出现后才由 initcall_release() 放行，在后台执行。
+ *
+ * _start 中的 clear_bss、mem_init 以及 percpu_init/fdt_init 在 C 环境和启动参数
+ * 就绪之前运行，不走 initcall。
+ */
+
+#ifndef __INITCALL_H__
+#define __INITCALL_H__
+
+#include "types.h"
+
+// 级别（段名按数字排序，必须是整数字面量）
+#define INIT_EARLY          0       // MMU 开启前：异常、浮点、用户程序窗口与 initrd
+#define INIT_CORE           1       // 内存管理、定时器、从核
+#define INIT_DEVICE         2       // 设备驱动与块缓存
+#define INIT_FS             3       // 根文件系统
+#define INIT_LATE           4       // 系统调用、自检、启动报告
+#define INIT_DEFERRED       5       // shell 出现后在后台执行
+#define INIT_LEVELS         6
+
+// flags
+#define INITCALL_PARALLEL   (1U << 0)   // 可在任意 hart 上与其他 initcall 并行
+
+// 运行状态
+#define INITCALL_PENDING    0
+#define INITCALL_RUNNING    1
+#define INITCALL_DONE       2       // 已返回，ret 为返回值
+#define INITCALL_SKIPPED    3       // 依赖失败、不存在或成环，未调用
+
+typedef struct initcall {
+    const char         *name;
+    int               (*fn)(void);  // 返回负数表示失败，依赖它的 initcall 会被跳过
+    const char *const  *deps;       // 依赖的 initcall 名字
+    uint32_t            ndeps;
+    uint8_t             level;
+    uint8_t             flags;
+    // 以下由 initcall.c 维护
+    volatile uint8_t    state;
+    uint8_t             hart;       // 执行它的 hart
+    int                 ret;
+    uint64_t            start;      // time CSR
+    uint64_t            end;
+} initcall_t;
+
+#define __INITCALL_STR(x)   #x
+#define INITCALL_STR(x)     __INITCALL_STR(x)
+
+/**
+ * 登记一个 initcall
+ * @param id    名字（标识符），也是其他 initcall 声明依赖时用的字符串
+ * @param lvl   INIT_* 级别
+ * @param fl    INITCALL_* 标志
+ * @param func  int func(void)
+ * @param ...   依赖的 initcall 名字（字符串），可省略
+ */
+#define INITCALL(id, lvl, fl, func, ...)                                                     \
+    static initcall_t __initcall_##id                                                        \
+        __attribute__((used, aligned(8), section(".initcall." INITCALL_STR(lvl)))) = {       \
+            .name  = #id,                                                                    \
+            .fn    = func,                                                                   \
+            .deps  = (const char *const[]){ NULL, ##__VA_ARGS__ } + 1,                       \
+            .ndeps = sizeof((const char *const[]){ NULL, ##__VA_ARGS__ }) / sizeof(char *) - 1, \
+            .level = lvl,                                                                    \
+            .flags = fl,                                                                     \
+    }
+
+/**
+ * 运行 level 及更低级别中所有未推迟的 initcall，全部结束后返回（只在启动 hart 上调用）
+ * 每个 initcall 结束时打印耗时和所在的 hart
+ */
+void initcall_run(int level);
+
+/**
+ * 推迟 level 级别，直到 initcall_release()；需在 initcall_run(level) 之前调用
+ */
+void initcall_defer(int level);
+
+/**
+ * 放行被推迟的级别，交给空闲的从核在后台执行；没有从核在线时就地执行
+ */
+void initcall_release(void);
+
+/**
+ * 等待被推迟的 initcall 全部结束，启动 hart 也参与执行（只在启动 hart 上调用）
+ */
+void initcall_sync(void);
+
+/**
+ * 空闲的 hart 调用：执行一个依赖已满足的 INITCALL_PARALLEL 调用
+ * @return 执行了一个调用时返回 true
+ */
+bool initcall_poll(void);
+
+/**
+ * 级别名，用于启动日志
+ */
+const char *initcall_level_name(int level);
+
+/**
+ * 打印每个 initcall 的级别、hart、开始时间和耗时
+ */
+void initcall_dump(void);
+
+#endif /* __INITCALL_H__ */
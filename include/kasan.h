@@ -0,0 +1,109 @@
+/*
+ * RISC-V testos 内核地址检查（KASAN）
+ *
+ * make KASAN=1 时用 -fsanitize=kernel-address 编译内核（定义 CONFIG_KASAN）：
+ * 编译器在每次内存访问前调用 __asan_{load,store}N_noabort，在栈上的数组前后
+ * 插入红区并直接写影子内存。每 8 字节内存对应 1 字节影子：0 表示 8 字节都可访问，
+ * 1~7 表示只有前 k 字节可访问，负值表示整段不可访问，取值标明原因。
+ *
+ * 影子内存固定放在 RAM 顶部 32MB（堆本来就不使用这一段），覆盖
+ * [MEM_START, KASAN_SHADOW_START)，地址 a 的影子在 (a >> 3) + KASAN_SHADOW_OFFSET。
+ * 这个偏移同时写在 Makefile 的 -fasan-shadow-offset 中，两边必须一致。
+ * bootloader 放在这一段的设备树由 kasan_init() 先搬到堆顶再清零影子。
+ *
+ * 分配器在每个对象两侧留红区，free() 后把整个对象标记为已释放；堆不复用，
+ * 释放后使用总能被发现。用户窗口 [USER_BASE, USER_BASE + USER_SIZE) 在每个地址空间中
+ * 映射不同的页，一份影子描述不了，对它的访问不检查。未定义 CONFIG_KASAN 时下面的接口都是空函数。
+ */
+
+#ifndef __KASAN_H__
+#define __KASAN_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+
+#define KASAN_SHADOW_SCALE_SHIFT    3
+#define KASAN_GRANULE               (1UL << KASAN_SHADOW_SCALE_SHIFT)
+#define KASAN_SHADOW_START          (MEM_START + MEM_SIZE - 32 * 1024 * 1024)
+#define KASAN_SHADOW_OFFSET         (KASAN_SHADOW_START - (MEM_START >> KASAN_SHADOW_SCALE_SHIFT))
+
+// 影子取值（与编译器生成的栈红区取值共用一套编号）
+#define KASAN_PAGE_FREE             0xFF    // free_pages 归还的页
+#define KASAN_HEAP_FREE             0xFB    // free() 释放的对象
+#define KASAN_HEAP_REDZONE          0xFC    // 堆对象两侧的红区
+#define KASAN_GLOBAL_REDZONE        0xF9    // 全局变量之后的红区
+#define KASAN_STACK_LEFT            0xF1    // 以下由编译器写入
+#define KASAN_STACK_MID             0xF2
+#define KASAN_STACK_RIGHT           0xF3
+#define KASAN_STACK_USE_AFTER_SCOPE 0xF8
+
+// 每个堆对象右侧至少留的红区（左侧红区取 max(对齐, 此值)）
+#define KASAN_REDZONE_SIZE          16
+
+#ifdef CONFIG_KASAN
+
+// 扫描其他栈等需要故意越过对象边界的函数不做检查
+#define __no_sanitize_address       __attribute__((no_sanitize_address))
+
+/**
+ * 清零影子内存、登记全局变量的红区并开始检查（fdt_init 之后、第一次分配之前调用）
+ * 设备树落在 RAM 顶部 32MB 时先搬到堆顶并重新 fdt_init；initrd 落在影子内存中时不启用
+ */
+void kasan_init(uintptr_t dtb);
+
+/**
+ * 把 [addr, addr + size) 标记为不可访问，addr 与 size 须按 8 字节对齐
+ */
+void kasan_poison(const void *addr, size_t size, uint8_t value);
+
+/**
+ * 把 [addr, addr + size) 标记为可访问，size 不必对齐（末尾的 8 字节记为部分可访问）
+ */
+void kasan_unpoison(const void *addr, size_t size);
+
+/**
+ * 标记新分配的堆对象：[raw, obj) 与 obj + size 之后到 raw + total 为红区
+ */
+void kasan_alloc_object(void *raw, void *obj, size_t size, size_t total);
+
+/**
+ * 标记 free() 释放的对象，发现重复释放或不是对象起点时报告
+ * @param ip 调用 free() 的位置
+ */
+void kasan_free_object(void *ptr, uintptr_t ip);
+
+/**
+ * 检查是否已启用
+ */
+bool kasan_enabled(void);
+
+/**
+ * 获取启动以来检测到的错误数（含只计数未打印的）
+ */
+uint64_t kasan_report_count(void);
+
+/**
+ * 故意制造几类越界和释放后使用，打印检测到的个数（kasan_test.c）
+ */
+void kasan_selftest(void);
+
+#else
+
+#define __no_sanitize_address
+
+static inline void kasan_init(uintptr_t dtb) { (void)dtb; }
+static inline void kasan_poison(const void *addr, size_t size, uint8_t value)
+{
+    (void)addr; (void)size; (void)value;
+}
+static inline void kasan_unpoison(const void *addr, size_t size) { (void)addr; (void)size; }
+static inline void kasan_alloc_object(void *raw, void *obj, size_t size, size_t total)
+{
+    (void)raw; (void)obj; (void)size; (void)total;
+}
+static inline void kasan_free_object(void *ptr, uintptr_t ip) { (void)ptr; (void)ip; }
+static inline bool kasan_enabled(void) { return false; }
+
+#endif /* CONFIG_KASAN */
+
+#endif /* __KASAN_H__ */
@@ -0,0 +1,53 @@
+/*
+ * RISC-V testos 抽样内存错误检测（KFENCE）
+ *
+ * 开销低到可以常开的检测手段：定时器每隔 kfence=<ms> 毫秒置位一次 kfence_armed，
+ * 之后的第一次 malloc 不从堆中分配，而是从一个保护页对象池中取一整页，
+ * 对象紧贴该页的一端放置，两侧的页不映射。越界访问保护页、访问已释放对象
+ * （释放时取消映射）都会产生缺页，由 kfence_handle_fault() 报告后恢复映射继续运行；
+ * 页内对象两端的空隙填充校验字节，释放时检查。
+ *
+ * 没有抽中的分配只多读一次 kfence_armed；池为空时抽样落空，只计数。
+ */
+
+#ifndef __KFENCE_H__
+#define __KFENCE_H__
+
+#include "types.h"
+
+#define KFENCE_NUM_OBJECTS          32      // 对象池大小，占 (2 * 32 + 1) 页
+#define KFENCE_DEFAULT_INTERVAL_MS  100     // 默认抽样间隔，启动参数 kfence=<ms>，0 关闭
+
+// 下一次分配要抽样（由定时器软中断置位，分配时清除）
+extern volatile uint32_t kfence_armed;
+
+/**
+ * 尝试从对象池分配（只在 kfence_armed 置位时由分配器调用）
+ * @param ip 调用分配函数的位置，报告时显示
+ * @return 本次没有抽中、大小超过一页或池已空时返回 NULL，由调用者照常分配
+ */
+void *kfence_alloc(size_t size, size_t align, uintptr_t ip);
+
+/**
+ * 释放对象池中的对象
+ * @return ptr 不属于对象池时返回 false，由调用者照常释放
+ */
+bool kfence_free(void *ptr, uintptr_t ip);
+
+/**
+ * 内核态缺页时调用，地址落在对象池中时报告越界或释放后使用并恢复映射
+ * @return 已处理（可以返回重新执行该指令）时返回 true
+ */
+bool kfence_handle_fault(uintptr_t addr, uintptr_t pc, bool write);
+
+/**
+ * 时钟节拍（定时器软中断中调用），到抽样间隔时置位 kfence_armed
+ */
+void kfence_tick(uint64_t ticks);
+
+/**
+ * 让下一次分配被抽样，不等定时器（测量抽样分配的开销、自检用）
+ */
+void kfence_arm(void);
+
+#endif /* __KFENCE_H__ */
@@ -0,0 +1,76 @@
+/*
+ * RISC-V testos 内核栈管理
+ *
+ * 每个内核栈下方保留一个不映射的保护页，栈溢出会在异常入口被检测到
+ * 并切换到专用的溢出栈报告。栈在分配时填充 KSTACK_PAINT，
+ * 通过扫描残留的填充值得到历史最高水位线。
+ */
+
+#ifndef __KSTACK_H__
+#define __KSTACK_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+
+typedef struct kstack {
+    uintptr_t base;         // 可用栈底（保护页之上）
+    uintptr_t top;          // 栈顶
+    const char *name;       // 栈名称，用于统计输出
+    bool dynamic;           // 是否由 kstack_alloc 分配
+    struct kstack *next;
+} kstack_t;
+
+/**
+ * 注册所有 hart 的启动栈和中断栈并取消映射其保护页（需在 mmu_init 之后调用）
+ */
+void kstack_init(void);
+
+/**
+ * 获取指定 hart 启动栈的栈底/栈顶及溢出栈栈顶
+ */
+uintptr_t kstack_boot_base(uint64_t hart_id);
+uintptr_t kstack_boot_top(uint64_t hart_id);
+uintptr_t kstack_overflow_top(uint64_t hart_id);
+
+/**
+ * 获取指定 hart 中断栈的栈底/栈顶
+ */
+uintptr_t kstack_irq_base(uint64_t hart_id);
+uintptr_t kstack_irq_top(uint64_t hart_id);
+
+/**
+ * 分配带保护页的内核栈
+ * @param size 栈大小（向上取整到页）
+ * @param name 栈名称
+ * @return 栈描述符，失败返回 NULL
+ */
+kstack_t *kstack_alloc(size_t size, const char *name);
+
+/**
+ * 释放 kstack_alloc 分配的栈
+ */
+void kstack_free(kstack_t *ks);
+
+/**
+ * 把已有的静态栈加入水位线统计
+ * @param live_sp 栈当前正在使用时传入 sp，只填充其下方区域；否则传 0
+ */
+void kstack_register(kstack_t *ks, uintptr_t base, uintptr_t top, const char *name,
+                     uintptr_t live_sp);
+
+/**
+ * 获取栈历史最大使用量（字节）
+ */
+size_t kstack_high_watermark(const kstack_t *ks);
+
+/**
+ * 查找包含指定地址（含保护页）的栈
+ */
+kstack_t *kstack_find(uintptr_t addr);
+
+/**
+ * 打印所有已注册栈的使用情况
+ */
+void kstack_dump(void);
+
+#endif /* __KSTACK_H__ */
@@ -11,6 +11,9 @@ extern int logger_info(const char *fmt, ...);
 extern int logger_warn(const char *fmt, ...);
 extern int logger_error(const char *fmt, ...);
 
+// 静默模式下丢弃 debug/info 级别的输出，warn/error 和 logger() 照常输出（快速启动用）
+extern void logger_set_quiet(bool quiet);
+
 // 底层 printf 实现
 extern int my_vprintf(const char *fmt, va_list va);
 extern int my_snprintf(char *buf, int size, const char *fmt, ...);
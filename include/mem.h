@@ -16,6 +16,26 @@ void *calloc(size_t count, size_t size);
 void *aligned_alloc(size_t alignment, size_t size);
 void free(void *ptr);  // 注意：在简单分配器中不实际释放
 
+// 页分配函数（4KB 粒度，单页可回收复用）
+void *alloc_pages(size_t npages);
+void free_pages(void *addr, size_t npages);
+
+// 预清零页池（zpool.c）：空闲时提前清零，pages 为储备页数，可由启动参数 zpool=<size> 指定
+#define ZPOOL_DEFAULT_SIZE  (256 * 1024)
+void zpool_init(size_t pages);
+void zpool_refill(void);        // 空闲的 hart 调用，每次只清零几页
+void zpool_dump_stats(void);
+
+// 取一个清零的页，池已空时现场清零
+void *alloc_zeroed_page(void);
+
+// 清零任意内存，支持 Zicboz 时用 cbo.zero，否则按 8 字节存储
+void mem_zero(void *dst, size_t n);
+
+// 保留一段物理内存，之后的堆分配会跳过它
+// 成功返回 0；区域已被分配或保留表已满返回 -1
+int mem_reserve(uintptr_t start, uintptr_t end);
+
 // 内存信息查询
 size_t mem_get_total_size(void);
 size_t mem_get_allocated_size(void);
@@ -0,0 +1,97 @@
+/*
+ * RISC-V testos Sv39 页表管理
+ *
+ * 内核采用恒等映射：虚拟地址 == 物理地址。设备区使用 1GB 大页，
+ * RAM 使用 2MB 大页，需要细粒度控制（如栈保护页）时按需拆成 4KB 页。
+ */
+
+#ifndef __MMU_H__
+#define __MMU_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+
+typedef uint64_t pte_t;
+
+// PTE 标志位
+#define PTE_V       (1UL << 0)
+#define PTE_R       (1UL << 1)
+#define PTE_W       (1UL << 2)
+#define PTE_X       (1UL << 3)
+#define PTE_U       (1UL << 4)
+#define PTE_G       (1UL << 5)
+#define PTE_A       (1UL << 6)
+#define PTE_D       (1UL << 7)
+
+// RSW 位，硬件忽略，供用户地址空间使用
+#define PTE_COW     (1UL << 8)      // 写时复制：映射为只读，写入时缺页再复制
+#define PTE_SHARED  (1UL << 9)      // 页不属于该地址空间（映像缓存、零页），不计引用
+
+#define PTE_FLAGS_MASK  0x3FFUL
+#define PTE_PPN_SHIFT   10
+#define PTE_ATTR_MASK   (0x1FUL << 59)
+
+// 常用组合（A/D 预置，避免硬件不维护时触发缺页）
+#define PTE_KERNEL_RWX  (PTE_V | PTE_R | PTE_W | PTE_X | PTE_A | PTE_D | PTE_G | PTE_ATTR_MEM)
+#define PTE_KERNEL_RW   (PTE_V | PTE_R | PTE_W | PTE_A | PTE_D | PTE_G | PTE_ATTR_MEM)
+#define PTE_KERNEL_RX   (PTE_V | PTE_R | PTE_X | PTE_A | PTE_G | PTE_ATTR_MEM)
+#define PTE_KERNEL_DEV  (PTE_V | PTE_R | PTE_W | PTE_A | PTE_D | PTE_G | PTE_ATTR_DEV)
+
+#define PTE_TO_PA(pte)  ((((pte) & ~PTE_ATTR_MASK) >> PTE_PPN_SHIFT) << PAGE_SHIFT)
+#define PA_TO_PTE(pa)   (((uint64_t)(pa) >> PAGE_SHIFT) << PTE_PPN_SHIFT)
+#define PTE_IS_LEAF(pte) ((pte) & (PTE_R | PTE_W | PTE_X))
+
+// Sv39 地址拆分
+#define PT_ENTRIES      512
+#define VPN_SHIFT(lvl)  (PAGE_SHIFT + 9 * (lvl))
+#define VPN(va, lvl)    (((uint64_t)(va) >> VPN_SHIFT(lvl)) & 0x1FF)
+#define LEVEL_SIZE(lvl) (1UL << VPN_SHIFT(lvl))
+
+#define SATP_MODE_SV39  (8UL << 60)
+
+// TLB 刷新
+#define SFENCE_VMA_ALL()    asm volatile("sfence.vma zero, zero" ::: "memory")
+#define SFENCE_VMA(va)      asm volatile("sfence.vma %0, zero" :: "r"(va) : "memory")
+
+/**
+ * 建立内核恒等映射页表并在当前 hart 上开启 Sv39
+ */
+void mmu_init(void);
+
+/**
+ * 在当前 hart 上加载内核页表（从核启动时使用）
+ */
+void mmu_enable(void);
+
+/**
+ * 获取内核页表对应的 satp 值
+ */
+uint64_t mmu_kernel_satp(void);
+
+/**
+ * 获取内核根页表（用户地址空间以它为模板）
+ */
+pte_t *mmu_kernel_root(void);
+
+/**
+ * 查找虚拟地址对应的 4KB 级 PTE
+ * @param root  根页表
+ * @param va    虚拟地址
+ * @param alloc 为 true 时按需分配中间页表并把大页拆成 4KB 页
+ * @return PTE 指针，不存在时返回 NULL
+ */
+pte_t *mmu_walk(pte_t *root, uintptr_t va, bool alloc);
+
+/**
+ * 在内核页表中映射/取消映射一个 4KB 页
+ * @return 0 成功，-1 失败
+ */
+int mmu_map_kernel_page(uintptr_t va, uintptr_t pa, uint64_t flags);
+int mmu_unmap_kernel_page(uintptr_t va);
+
+/**
+ * 查询内核页表中某地址是否已映射
+ */
+bool mmu_is_mapped(uintptr_t va);
+
+#endif /* __MMU_H__ */
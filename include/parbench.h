@@ -0,0 +1,16 @@
+/*
+ * RISC-V testos 多线程扩展性测试
+ *
+ * 内核函数进程用 sysgate_clone 创建线程，把矩阵乘法按行分给 1、2、4…个线程，
+ * 报告每种线程数的耗时和相对单线程的加速比。
+ */
+
+#ifndef __PARBENCH_H__
+#define __PARBENCH_H__
+
+/**
+ * 运行测试，线程数上限为在线 hart 数
+ */
+void par_bench(void);
+
+#endif /* __PARBENCH_H__ */
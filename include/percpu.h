@@ -0,0 +1,65 @@
+/*
+ * RISC-V testos 每 hart 私有数据
+ *
+ * sscratch 始终指向当前 hart 的 hart_local_t，异常入口借助它
+ * 拿到临时保存区、栈边界和中断栈，C 代码通过 this_hart() 访问。
+ */
+
+#ifndef __PERCPU_H__
+#define __PERCPU_H__
+
+#include "cfg/cfg.h"
+
+// hart_local_t 字段偏移（供汇编使用，必须与结构体保持一致）
+#define HART_TMP0           0
+#define HART_TMP1           8
+#define HART_STACK_LIMIT    16
+#define HART_OVERFLOW_SP    24
+#define HART_ID             32
+#define HART_TRAP_DEPTH     40
+#define HART_IRQ_STACK_TOP  48
+#define HART_IRQ_STACK_LIMIT 56
+#define HART_LOCAL_SIZE     64
+
+#ifndef __ASSEMBLER__
+
+#include "types.h"
+#include "sysreg.h"
+
+typedef struct hart_local {
+    uint64_t tmp[2];        // 异常入口临时保存 t0/t1
+    uint64_t stack_limit;   // 当前栈的最低可用地址（保护页之上）
+    uint64_t overflow_sp;   // 栈溢出处理专用栈的栈顶
+    uint64_t hart_id;       // 本 hart 的 ID
+    uint64_t trap_depth;    // 当前 trap 嵌套深度，0 表示不在异常处理中
+    uint64_t irq_stack_top; // 中断栈栈顶，首次进入 trap 时切换到这里
+    uint64_t irq_stack_limit; // 中断栈的最低可用地址
+} hart_local_t;
+
+extern hart_local_t hart_locals[MAX_HARTS];
+
+/**
+ * 获取当前 hart 的私有数据
+ */
+static inline hart_local_t *this_hart(void)
+{
+    return (hart_local_t *)CSR_READ(sscratch);
+}
+
+/**
+ * 获取当前 hart 的 ID
+ */
+static inline uint64_t this_hart_id(void)
+{
+    return this_hart()->hart_id;
+}
+
+/**
+ * 初始化当前 hart 的私有数据并写入 sscratch
+ * @param hart_id 当前 hart 的 ID
+ */
+void percpu_init(uint64_t hart_id);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* __PERCPU_H__ */
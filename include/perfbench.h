@@ -0,0 +1,16 @@
+/*
+ * RISC-V testos 性能回归基准
+ *
+ * 对陷入路径、syscall 网关、字符串函数和分配器做微基准，每项输出一行
+ * "PERF <名称> <周期/次>"，由主机上的 tools/perf.py 收集并与基线比较。
+ */
+
+#ifndef __PERFBENCH_H__
+#define __PERFBENCH_H__
+
+/**
+ * 运行全部基准，name 非空时只运行名称以它开头的项
+ */
+void perf_bench(const char *name);
+
+#endif /* __PERFBENCH_H__ */
@@ -0,0 +1,196 @@
+/*
+ * RISC-V testos 进程
+ *
+ * 进程仍在 S 态运行，系统调用通过网关直接调用内核函数，内核代码就运行在
+ * 进程自己的栈上（用户窗口顶部）。调度是协作式的：进程在 wait4、futex、
+ * sched_yield 和 exit 时切回所在 hart 的调度循环，定时器不抢占进程。
+ * 所有 hart 从同一张进程表挑选可运行的进程：发起 proc_run 的 hart 和空闲的从核
+ * 都运行调度循环，进程变为可运行时用 IPI 唤醒一个空闲 hart。
+ * fork 只复制页表（写时复制），execve 从映像缓存建立新地址空间。
+ *
+ * 线程（clone 带 CLONE_VM）也是一个 proc_t，与组长共享组长的地址空间，
+ * pid 即 tid，getpid 返回组长的 pid。每个线程的 tp 在切换时保存恢复，
+ * 陷入时由 trap 帧保存。线程退出后由调度循环回收：清零 clear_tid 并唤醒
+ * 等待者，最后一个线程回收时释放地址空间，组长才能被 wait4 收尸。
+ *
+ * 锁：proc_lock 保护进程表和所有状态转换。切换前后都持有它——进程在
+ * 持锁时切出，由调度循环释放；新进程第一次运行时负责释放调度循环持有的锁。
+ */
+
+#ifndef __PROC_H__
+#define __PROC_H__
+
+#include "types.h"
+#include "setjmp.h"
+#include "spinlock.h"
+#include "vm.h"
+#include "elf.h"
+
+#define NPROC           32
+#define PROC_NAME_LEN   16
+#define PROC_EXIT_FAULT 139     // 访问非法地址被结束的退出码（shell 约定的 128 + SIGSEGV）
+
+typedef enum {
+    PROC_FREE,
+    PROC_NEW,           // 正在创建
+    PROC_RUNNABLE,
+    PROC_RUNNING,
+    PROC_BLOCKED,       // 在 wchan 或 futex 上睡眠
+    PROC_ZOMBIE,        // 已退出；线程等调度循环回收，组长还要等父进程回收
+} proc_state_t;
+
+// 启动延迟的分类
+typedef enum {
+    SPAWN_KERNEL,       // proc_spawn 到第一条用户指令
+    SPAWN_EXEC,         // execve 系统调用到第一条用户指令
+    SPAWN_FORK,         // fork 系统调用在父进程中的耗时
+    SPAWN_FORK_CHILD,   // fork 系统调用到子进程第一次运行
+    SPAWN_THREAD,       // clone 线程到第一次运行
+    SPAWN_KINDS,
+} spawn_kind_t;
+
+typedef struct proc {
+    int pid;                    // 线程的 tid
+    proc_state_t state;
+    struct proc *parent;        // 为 NULL 时退出后由调度循环直接回收；线程总是 NULL
+    struct proc *leader;        // 线程组组长，进程自己就是组长
+    char name[PROC_NAME_LEN];
+    vm_space_t *vm;             // 使用中的地址空间，指向组长的 space
+    vm_space_t space;           // 组长持有的地址空间
+    vm_space_t old_vm;          // execve 换下来的地址空间，切到新栈后释放
+    int nthreads;               // 组长：尚未退出的线程数
+    int nusers;                 // 组长：尚未回收的线程数，降为 0 时释放地址空间
+    bool group_exit;            // 组长：已调用 exit_group，exit_code 不再改变
+    bool killed;                // 被 exit_group 结束，下一次系统调用返回时退出
+    bool run_target;            // proc_run 在等它，没有父进程也不自动释放
+    uint32_t *clear_tid;        // 退出后清零并 FUTEX_WAKE（CLONE_CHILD_CLEARTID）
+    uintptr_t tp;               // 切出时的 tp（线程指针）
+    uintptr_t stack_limit;      // 运行时的栈下界，供 trap 入口做溢出检查
+    uintptr_t unmap_va;         // munmap 了正在使用的栈：线程切离后才解除的映射
+    size_t unmap_pages;
+    jmp_buf ctx;                // 切出时的内核上下文
+    void *wchan;                // 睡眠等待的对象
+    uint64_t deadline;          // 阻塞的超时时刻（time CSR），0 表示不超时
+    uintptr_t futex_key;        // 正在等待的 futex 物理地址
+    struct proc *futex_next;    // futex 哈希桶链
+    bool futex_woken;
+    uintptr_t entry;
+    uintptr_t user_sp;
+    uintptr_t user_arg;         // 进入程序时的 a0
+    int exit_code;
+    bool bench_only;            // 只测量启动延迟，到达入口时直接退出
+    spawn_kind_t spawn_kind;
+    uint64_t spawn_start;       // 进入 spawn/execve/fork 时的 cycle
+    uint64_t faults;            // 缺页次数（按需清零与写时复制），线程回收后计入组长
+    uint64_t fault_cycles;      // 缺页处理的总 cycle 数
+} proc_t;
+
+/**
+ * 从根文件系统创建进程，进程在 proc_run 中才开始运行
+ * @return pid，文件不存在或不是可执行文件返回 -1
+ */
+int proc_spawn(const char *path, int argc, const char *const argv[]);
+
+/**
+ * 创建运行内核函数的进程：地址空间里只有用户栈，fn 通过系统调用网关
+ * 与内核交互，行为与用户程序相同，供内核自带的测试使用。
+ * fn 返回值作为退出码。全局变量不随 fork 复制，进程间只能通过栈和共享内存传递数据
+ * @return pid，失败返回 -1
+ */
+int proc_spawn_fn(const char *name, int (*fn)(void *), void *arg);
+
+/**
+ * 创建运行平坦二进制的进程，映像链接在 USER_BASE，bss 和栈在第一次访问时分配
+ * @param phdr 程序头表，作为 AT_PHDR 传给程序，可为 NULL
+ * @return pid，失败返回 -1
+ */
+int proc_spawn_flat(const char *name, const void *image, size_t size, const Elf64_Phdr *phdr,
+                    int phnum);
+
+/**
+ * 注册进程锁统计（需在 vm_init 之后调用）
+ */
+void proc_init(void);
+
+/**
+ * 在当前 hart 上运行调度循环，直到 pid 对应的进程（含其所有线程）结束
+ * 且当前 hart 上没有可运行的进程
+ * @return 进程的退出码，进程无法结束时返回 -1
+ */
+int proc_run(int pid);
+
+/**
+ * 从核的调度循环，没有可运行的进程时 WFI 等待 IPI，不返回
+ */
+void proc_worker(void) __attribute__((noreturn));
+
+/**
+ * 当前 hart 上正在运行的进程，不在进程上下文中返回 NULL
+ */
+proc_t *proc_current(void);
+
+/**
+ * 结束当前进程的所有线程（exit_group）；不在进程上下文中时原地挂起
+ */
+void proc_exit(int code) __attribute__((noreturn));
+
+/**
+ * 只结束当前线程（exit），最后一个线程退出时 code 成为进程退出码
+ */
+void proc_exit_thread(int code) __attribute__((noreturn));
+
+/**
+ * 当前进程访问了无法处理的地址（缺页处理失败）：结束整个进程，退出码 PROC_EXIT_FAULT
+ * 在 trap 处理函数中调用，直接切回调度循环，被打断的代码不再恢复
+ */
+void proc_kill_fault(uintptr_t va, uintptr_t pc) __attribute__((noreturn));
+
+/**
+ * 系统调用返回前调用：当前线程已被 exit_group 结束时在这里退出
+ */
+void proc_check_killed(void);
+
+/**
+ * 阻塞当前进程并释放 lk，被 proc_unblock 唤醒、到达 deadline 或被 exit_group
+ * 结束后返回。唤醒方须先持有 lk 再调用 proc_unblock，才不会丢失唤醒
+ * @param deadline 超时时刻（time CSR），0 表示不超时
+ */
+void proc_block(spinlock_t *lk, uint64_t deadline);
+
+/**
+ * 唤醒 proc_block 阻塞的进程
+ */
+void proc_unblock(proc_t *p);
+
+/**
+ * 当前进程的缺页，计入进程的缺页次数和耗时
+ * @param access PTE_R、PTE_W 或 PTE_X
+ * @return 已处理返回 true，不在进程上下文中或访问非法返回 false
+ */
+bool proc_page_fault(uintptr_t va, uint64_t access);
+
+// 系统调用，返回值遵循 Linux 约定（失败返回 -errno）
+// sys_clone 的 ret_pc 是网关调用者的返回地址，新线程在新栈上从这里返回 0
+int64_t sys_clone(uint64_t flags, uintptr_t stack, int *ptid, uintptr_t tls, uint32_t *ctid,
+                  uintptr_t ret_pc);
+int64_t sys_execve(const char *path, const char *const argv[], const char *const envp[]);
+int64_t sys_wait4(int64_t pid, int *status, int options);
+int64_t sys_getpid(void);
+int64_t sys_gettid(void);
+int64_t sys_set_tid_address(uint32_t *tidptr);
+int64_t sys_sched_yield(void);
+int64_t sys_mmap(uintptr_t addr, size_t len, int prot, int flags, int fd, uint64_t off);
+int64_t sys_mprotect(uintptr_t addr, size_t len, int prot);
+int64_t sys_munmap(uintptr_t addr, size_t len);
+
+/**
+ * 打印进程表和启动延迟统计
+ */
+void proc_dump(void);
+
+/**
+ * 启动延迟测试：整映像拷贝、缓存映像 spawn 与 fork 的 cycle 数对比
+ */
+void proc_bench(const char *path);
+
+#endif /* __PROC_H__ */
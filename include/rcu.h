@@ -0,0 +1,103 @@
+/*
+ * RISC-V testos RCU（基于静止状态）
+ *
+ * 读者只在本 hart 的计数器上加减，不使用锁和原子操作。写者发布新指针后
+ * 开启一个宽限期，等所有在线 hart 都经过一次静止状态后才回收旧数据。
+ * 静止状态来源：
+ *   - 打断线程上下文（trap 深度为 1）且不在读临界区内的中断返回时，
+ *     定时器 tick 与 IPI 都属于这种情况
+ *   - 上下文切换（rcu_note_context_switch）
+ *   - 空闲循环中的 WFI，空闲 hart 直接视为静止
+ * 读临界区内不能睡眠，也不能调用 synchronize_rcu()。
+ */
+
+#ifndef __RCU_H__
+#define __RCU_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "atomic.h"
+#include "percpu.h"
+
+typedef struct {
+    volatile uint64_t qs_seq;   // 最近一次静止状态时看到的宽限期序号
+    volatile uint64_t idle;     // 非 0 表示处于空闲 WFI 中
+    uint64_t nesting;           // 读临界区嵌套深度
+    uint64_t qs_count;          // 报告静止状态的次数
+} __attribute__((aligned(64))) rcu_data_t;
+
+extern rcu_data_t rcu_data[MAX_HARTS];
+
+typedef struct rcu_head {
+    struct rcu_head *next;
+    void (*func)(struct rcu_head *head);
+    uint64_t gp_seq;            // 需要等待的宽限期
+} rcu_head_t;
+
+typedef void (*rcu_callback_t)(rcu_head_t *head);
+
+// 读取受 RCU 保护的指针（RVWMO 保证地址依赖的顺序）
+#define rcu_dereference(p)          READ_ONCE(p)
+
+// 发布新指针，保证之前对新对象的初始化先于指针可见
+#define rcu_assign_pointer(p, v)    smp_store_release(&(p), (v))
+
+static inline void rcu_read_lock(void)
+{
+    rcu_data[this_hart_id()].nesting++;
+    barrier();
+}
+
+static inline void rcu_read_unlock(void)
+{
+    barrier();
+    rcu_data[this_hart_id()].nesting--;
+}
+
+/**
+ * 等待一个完整的宽限期：返回时所有在调用前开始的读临界区都已结束
+ */
+void synchronize_rcu(void);
+
+/**
+ * 宽限期结束后调用 func(head)，不阻塞调用者
+ */
+void call_rcu(rcu_head_t *head, rcu_callback_t func);
+
+/**
+ * 等待之前提交的所有 call_rcu 回调执行完毕
+ */
+void rcu_barrier(void);
+
+/**
+ * 中断返回路径调用：打断的是线程上下文且不在读临界区内时报告静止状态
+ */
+void rcu_irq_exit(hart_local_t *hl);
+
+/**
+ * 定时器 tick 调用：有待执行的回调时挂起 RCU 软中断，在中断返回前执行宽限期已结束的回调
+ */
+void rcu_tick(void);
+
+/**
+ * 上下文切换时报告静止状态
+ */
+void rcu_note_context_switch(void);
+
+/**
+ * 进入/退出空闲 WFI（调用时必须关中断）
+ */
+void rcu_idle_enter(void);
+void rcu_idle_exit(void);
+
+/**
+ * 打印 RCU 状态
+ */
+void rcu_dump_stats(void);
+
+/**
+ * 读者扩展性测试：1..N 个 hart 并发读取同一份配置，比较 RCU 与自旋锁
+ */
+void rcu_bench(void);
+
+#endif /* __RCU_H__ */
@@ -0,0 +1,121 @@
+/*
+ * RISC-V testos SBI 调用接口
+ * 基于 SBI v0.2+ 的扩展调用约定：a7 = EID，a6 = FID，返回值在 a0(error)/a1(value)
+ */
+
+#ifndef __SBI_H__
+#define __SBI_H__
+
+#include "types.h"
+
+// 扩展 ID
+#define SBI_EXT_BASE        0x10
+#define SBI_EXT_TIME        0x54494D45  // "TIME"
+#define SBI_EXT_IPI         0x735049    // "sPI"
+#define SBI_EXT_HSM         0x48534D    // "HSM"
+#define SBI_EXT_SUSP        0x53555350  // "SUSP"
+
+// Base 功能号
+#define SBI_BASE_PROBE_EXT      3
+
+// HSM 功能号与 hart 状态
+#define SBI_HSM_HART_START      0
+#define SBI_HSM_HART_STOP       1
+#define SBI_HSM_HART_STATUS     2
+#define SBI_HSM_HART_SUSPEND    3
+
+// HSM 挂起类型：最高位为 0 是保持型（返回到调用点，寄存器与 CSR 不丢失），
+// 为 1 是非保持型（从 resume_addr 重新进入）。0 是平台默认的保持型挂起
+#define SBI_HSM_SUSPEND_RET_DEFAULT 0x00000000
+#define SBI_HSM_SUSPEND_NON_RET     0x80000000
+
+#define SBI_HSM_STARTED         0
+#define SBI_HSM_STOPPED         1
+#define SBI_HSM_START_PENDING   2
+#define SBI_HSM_STOP_PENDING    3
+
+// 错误码
+#define SBI_SUCCESS             0
+#define SBI_ERR_FAILED          -1
+#define SBI_ERR_NOT_SUPPORTED   -2
+#define SBI_ERR_INVALID_PARAM   -3
+#define SBI_ERR_ALREADY_AVAILABLE -6
+
+typedef struct {
+    long error;
+    long value;
+} sbiret_t;
+
+static inline sbiret_t sbi_ecall(uint64_t ext, uint64_t fid, uint64_t arg0, uint64_t arg1,
+                                 uint64_t arg2)
+{
+    register uint64_t a0 asm("a0") = arg0;
+    register uint64_t a1 asm("a1") = arg1;
+    register uint64_t a2 asm("a2") = arg2;
+    register uint64_t a6 asm("a6") = fid;
+    register uint64_t a7 asm("a7") = ext;
+
+    asm volatile("ecall"
+                 : "+r"(a0), "+r"(a1)
+                 : "r"(a2), "r"(a6), "r"(a7)
+                 : "memory");
+
+    sbiret_t ret = { (long)a0, (long)a1 };
+    return ret;
+}
+
+/**
+ * 查询固件是否实现某个扩展
+ */
+static inline bool sbi_probe_extension(uint64_t ext)
+{
+    sbiret_t ret = sbi_ecall(SBI_EXT_BASE, SBI_BASE_PROBE_EXT, ext, 0, 0);
+    return ret.error == SBI_SUCCESS && ret.value != 0;
+}
+
+/**
+ * 设置下一次定时器中断的绝对时间
+ */
+static inline void sbi_set_timer(uint64_t stime_value)
+{
+    sbi_ecall(SBI_EXT_TIME, 0, stime_value, 0, 0);
+}
+
+/**
+ * 向一组 hart 发送软件中断（置位目标 hart 的 sip.SSIP）
+ * @param hart_mask 以 hart_mask_base 为起点的位图
+ */
+static inline long sbi_send_ipi(uint64_t hart_mask, uint64_t hart_mask_base)
+{
+    return sbi_ecall(SBI_EXT_IPI, 0, hart_mask, hart_mask_base, 0).error;
+}
+
+/**
+ * 启动处于 STOPPED 状态的 hart，目标 hart 以 S 模式从 start_addr 开始执行，
+ * a0 = hart id，a1 = opaque，satp = 0，sstatus.SIE = 0
+ */
+static inline long sbi_hart_start(uint64_t hart_id, uint64_t start_addr, uint64_t opaque)
+{
+    return sbi_ecall(SBI_EXT_HSM, SBI_HSM_HART_START, hart_id, start_addr, opaque).error;
+}
+
+/**
+ * 查询 hart 状态
+ * @return SBI_HSM_* 状态值，出错时返回负的错误码
+ */
+static inline long sbi_hart_get_status(uint64_t hart_id)
+{
+    sbiret_t ret = sbi_ecall(SBI_EXT_HSM, SBI_HSM_HART_STATUS, hart_id, 0, 0);
+    return ret.error ? ret.error : ret.value;
+}
+
+/**
+ * 挂起当前 hart，直到有已使能（sie）的中断挂起，与 WFI 一样不要求 sstatus.SIE。
+ * 保持型挂起成功时返回 SBI_SUCCESS，resume_addr 和 opaque 只对非保持型有意义
+ */
+static inline long sbi_hart_suspend(uint32_t suspend_type, uint64_t resume_addr, uint64_t opaque)
+{
+    return sbi_ecall(SBI_EXT_HSM, SBI_HSM_HART_SUSPEND, suspend_type, resume_addr, opaque).error;
+}
+
+#endif /* __SBI_H__ */
@@ -0,0 +1,23 @@
+/*
+ * RISC-V testos 非局部跳转
+ */
+
+#ifndef __SETJMP_H__
+#define __SETJMP_H__
+
+#include "types.h"
+
+// ra, sp, s0-s11, fs0-fs11
+typedef uint64_t jmp_buf[26];
+
+/**
+ * 保存当前上下文，直接返回 0，经 longjmp 返回时为 longjmp 的 val
+ */
+int setjmp(jmp_buf env) __attribute__((returns_twice));
+
+/**
+ * 恢复 setjmp 保存的上下文，val 为 0 时按 1 返回
+ */
+void longjmp(jmp_buf env, int val) __attribute__((noreturn));
+
+#endif /* __SETJMP_H__ */
@@ -0,0 +1,85 @@
+/*
+ * RISC-V testos 命令行
+ *
+ * 各模块用 SHELL_CMD() 把命令登记在 .shell_cmd.<name> 段中，链接脚本按段名排序后
+ * 放在 __shell_cmd_start/__shell_cmd_end 之间，命令表本身就是按名字排好序的数组：
+ * 分发用二分查找，Tab 补全按前缀取一段连续的表项，help 按字母顺序列出。
+ * 短名用 SHELL_ALIAS() 登记为指向原命令的独立表项，同样参与查找和补全。
+ *
+ * 命令名同时用作 C 标识符和段名，只能由字母、数字和下划线组成。
+ */
+
+#ifndef __SHELL_H__
+#define __SHELL_H__
+
+#include "types.h"
+
+#define SHELL_MAX_ARGS      16
+#define SHELL_LINE_MAX      128     // 一行命令的最大长度（含结尾的 '\0'）
+#define SHELL_SCRIPT_DEPTH  4       // 脚本嵌套调用的层数上限
+#define SHELL_EXIT          1       // 命令处理函数返回它时退出命令行
+
+typedef struct shell_cmd {
+    const char              *name;
+    const char              *args;      // 参数说明（help 中显示），没有参数时为 NULL
+    const char              *help;
+    int                    (*fn)(int argc, char **argv);   // argv[0] 是命令名
+    const struct shell_cmd  *alias_of;  // 短名表项指向原命令，其余字段不用
+} shell_cmd_t;
+
+/**
+ * 登记一条命令
+ * @param id    命令名（标识符）
+ * @param args  参数说明字符串或 NULL
+ * @param help  一行说明
+ * @param func  int func(int argc, char **argv)，返回负数表示失败
+ */
+#define SHELL_CMD(id, args, help, func)                                                      \
+    static const shell_cmd_t __shell_cmd_##id                                                \
+        __attribute__((used, aligned(8), section(".shell_cmd." #id))) = {                    \
+            #id, args, help, func, NULL,                                                     \
+    }
+
+/**
+ * 给同一文件中用 SHELL_CMD() 登记的命令 id 加一个短名
+ */
+#define SHELL_ALIAS(alias, id)                                                               \
+    static const shell_cmd_t __shell_alias_##alias                                           \
+        __attribute__((used, aligned(8), section(".shell_cmd." #alias))) = {                 \
+            #alias, NULL, NULL, NULL, &__shell_cmd_##id,                                     \
+    }
+
+/**
+ * 按名字查找命令，短名返回原命令
+ * @return 找不到时返回 NULL
+ */
+const shell_cmd_t *shell_find(const char *name);
+
+/**
+ * 把一行命令按空白切分为参数（双引号内的空白不切分），就地修改 line
+ * @return 参数个数，超过 max 的部分被丢弃
+ */
+int shell_parse(char *line, char **argv, int max);
+
+/**
+ * 切分并执行一行命令
+ * @return 命令的返回值；空行返回 0，未知命令返回 -1
+ */
+int shell_exec(char *line);
+
+/**
+ * 逐行执行脚本：空行和 # 开头的行跳过，超过 SHELL_LINE_MAX 的行报告后跳过（记为失败），
+ * 执行到 quit 时停止
+ * 先在根文件系统中查找 name，再查找编译时嵌入的脚本
+ * @return 执行了 quit 返回 SHELL_EXIT；有命令失败或找不到脚本返回 -1；否则返回 0
+ */
+int shell_run_script(const char *name);
+
+/**
+ * 读取一行输入：回显、退格，Tab 补全命令名
+ * @param prompt 列出补全候选后重新显示的提示符
+ * @return 行长度
+ */
+int shell_readline(const char *prompt, char *buf, size_t size);
+
+#endif /* __SHELL_H__ */
@@ -0,0 +1,83 @@
+/*
+ * RISC-V testos 多 hart 支持
+ *
+ * 从核通过 SBI HSM 启动，核间中断（IPI）通过 SBI IPI 置位目标 hart 的
+ * sip.SSIP。每个 hart 有一个无锁的调用队列，发送方把请求挂入目标队列，
+ * 只有队列由空变为非空的那次入队才真正发送 IPI，其余请求合并到同一次
+ * 中断中处理。
+ */
+
+#ifndef __SMP_H__
+#define __SMP_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+
+#define HART_MASK(id)       (1UL << (id))
+#define HART_MASK_ALL       ((MAX_HARTS >= 64) ? ~0UL : (HART_MASK(MAX_HARTS) - 1))
+
+typedef void (*smp_call_func_t)(void *arg);
+
+// 跨 hart 调用请求
+typedef struct call_single_data {
+    struct call_single_data *next;  // 调用队列链表
+    smp_call_func_t func;
+    void *arg;
+    volatile uint64_t flags;        // CSD_FLAG_*
+} csd_t;
+
+#define CSD_FLAG_LOCK       (1UL << 0)  // 已入队，尚未执行完
+#define CSD_FLAG_SYNC       (1UL << 1)  // 发送方等待执行完成
+
+// 已上线 hart 的位图
+extern volatile uint64_t smp_online_mask;
+
+/**
+ * 在启动 hart 上初始化 IPI 并通过 SBI HSM 启动其余 hart
+ * （需在 mmu_init/kstack_init 之后调用）
+ */
+void smp_init(void);
+
+/**
+ * 从核的 C 入口（由 boot.S 的 _secondary_start 调用，不返回）
+ * @param hart_id 当前 hart 的 ID
+ */
+void secondary_main(uint64_t hart_id);
+
+/**
+ * 在 mask 中的每个已上线 hart 上执行 fn(arg)
+ *
+ * 远程 hart 在软件中断上下文中执行 fn（快速入口不保存浮点寄存器，fn 中不能
+ * 使用浮点运算）；mask 包含当前 hart 时在本地关中断执行。
+ * @param mask hart 位图
+ * @param wait 为 true 时等待所有目标执行完毕后返回
+ * @return 成功返回 0，fn 为空返回 -1
+ */
+int smp_call_function(uint64_t mask, smp_call_func_t fn, void *arg, bool wait);
+
+/**
+ * 向 mask 中的 hart 发送 IPI，只唤醒不携带请求（用于调度器等场景）
+ */
+void smp_send_ipi(uint64_t mask);
+
+/**
+ * 刷新所有已上线 hart 上指定虚拟地址的 TLB 项
+ */
+void smp_flush_tlb_page(uintptr_t va);
+
+/**
+ * 空闲等待一次中断（进入时需开中断，返回时中断已处理）
+ */
+void cpu_idle(void);
+
+/**
+ * 获取已上线的 hart 数量
+ */
+int smp_num_online(void);
+
+/**
+ * 打印 hart 状态与 IPI 统计，并测量一次跨 hart 调用的往返延迟
+ */
+void smp_dump_stats(void);
+
+#endif /* __SMP_H__ */
@@ -0,0 +1,71 @@
+/*
+ * RISC-V testos 软中断（中断下半部）
+ *
+ * 硬中断处理函数只做必要的硬件确认，其余工作用 raise_softirq() 置位本 hart 的
+ * 挂起位，在最外层中断返回前（dispatch_interrupt 末尾）统一执行。软中断执行期间
+ * 重新打开 SIE，硬中断可以嵌套进来，嵌套的中断返回时不再执行软中断，只置挂起位，
+ * 由外层循环处理。连续 SOFTIRQ_MAX_RESTART 轮后仍有挂起的留到下一次中断返回。
+ *
+ * 软中断运行在中断栈上、可能来自不保存浮点寄存器的快速入口：处理函数不能睡眠，
+ * 也不能使用浮点运算。需要在线程上下文完成的工作交给工作队列（workqueue.h）。
+ *
+ * tasklet 建立在 SOFTIRQ_TASKLET 之上：同一个 tasklet 在执行前重复调度只执行一次，
+ * 并在调度它的 hart 上执行。
+ */
+
+#ifndef __SOFTIRQ_H__
+#define __SOFTIRQ_H__
+
+#include "types.h"
+#include "percpu.h"
+
+// 软中断号，数字越小越先执行
+enum {
+    SOFTIRQ_TIMER,          // 运行时间统计与心跳
+    SOFTIRQ_BLOCK,          // 块设备完成轮询与块缓存回写
+    SOFTIRQ_TASKLET,
+    SOFTIRQ_RCU,            // RCU 回调
+    SOFTIRQ_NR,
+};
+
+#define SOFTIRQ_MAX_RESTART 4
+
+typedef void (*softirq_handler_t)(void);
+
+typedef struct tasklet {
+    struct tasklet *next;
+    void (*func)(void *data);
+    void *data;
+    volatile uint32_t scheduled;    // 已挂入某个 hart 的队列，尚未开始执行
+} tasklet_t;
+
+#define TASKLET_INIT(fn, arg)   { NULL, (fn), (arg), 0 }
+
+/**
+ * 注册软中断处理函数
+ * @param name 统计输出用的名字
+ */
+void open_softirq(int nr, softirq_handler_t handler, const char *name);
+
+/**
+ * 在当前 hart 上挂起软中断；不在中断处理中调用时发一个 IPI 给自己，
+ * 使其在随后的中断返回时执行
+ */
+void raise_softirq(int nr);
+
+/**
+ * 最外层中断返回前执行本 hart 挂起的软中断，由 dispatch_interrupt 在关中断时调用
+ */
+void softirq_irq_exit(hart_local_t *hl);
+
+/**
+ * 在当前 hart 上调度 tasklet
+ */
+void tasklet_schedule(tasklet_t *t);
+
+/**
+ * 打印每个软中断的执行次数与耗时
+ */
+void softirq_dump_stats(void);
+
+#endif /* __SOFTIRQ_H__ */
@@ -0,0 +1,135 @@
+/*
+ * RISC-V testos 自旋锁
+ *
+ * 提供三种锁：
+ *   spinlock_t - test-and-test-and-set + 指数退避，开销最小，适合低竞争
+ *   ticket_lock_t - 排号锁，按到达顺序获得，保证公平
+ *   mcs_lock_t - MCS 队列锁，每个等待者只在自己的节点上自旋，适合高竞争
+ *
+ * 每个锁可以挂一个 lock_stat_t 记录获取次数、竞争次数和最长持有时间
+ * （cycle），stat 为空时不做统计。统计字段只在持锁期间更新，不需要原子操作。
+ */
+
+#ifndef __SPINLOCK_H__
+#define __SPINLOCK_H__
+
+#include "types.h"
+#include "sysreg.h"
+
+typedef struct lock_stat {
+    const char *name;
+    uint64_t acquired;          // 获取次数
+    uint64_t contended;         // 获取时需要等待的次数
+    uint64_t max_hold;          // 最长持有时间（cycle）
+    uint64_t total_hold;        // 累计持有时间（cycle）
+    uint64_t hold_start;        // 本次获取的时间戳
+    struct lock_stat *next;
+} lock_stat_t;
+
+typedef struct {
+    volatile uint32_t locked;
+    lock_stat_t *stat;
+} spinlock_t;
+
+typedef struct {
+    volatile uint32_t next;     // 下一个发放的号
+    volatile uint32_t owner;    // 当前持有者的号
+    lock_stat_t *stat;
+} ticket_lock_t;
+
+typedef struct mcs_node {
+    volatile uint64_t next;     // 后继等待者（mcs_node_t *）
+    volatile uint64_t locked;   // 非 0 表示仍需等待
+} mcs_node_t;
+
+typedef struct {
+    volatile uint64_t tail;     // 队尾节点（mcs_node_t *），0 表示空闲
+    lock_stat_t *stat;
+} mcs_lock_t;
+
+#define SPINLOCK_INIT       { 0, NULL }
+#define TICKET_LOCK_INIT    { 0, 0, NULL }
+#define MCS_LOCK_INIT       { 0, NULL }
+
+/**
+ * 注册锁统计，注册后可通过 lock_stat_dump() 查看
+ */
+void lock_stat_register(lock_stat_t *stat, const char *name);
+
+/**
+ * 清零统计计数
+ */
+void lock_stat_reset(lock_stat_t *stat);
+
+/**
+ * 打印所有已注册锁的统计信息
+ */
+void lock_stat_dump(void);
+
+// ===============================================================================
+// TTAS 自旋锁
+// ===============================================================================
+void spin_lock_init(spinlock_t *lock, lock_stat_t *stat);
+void spin_lock(spinlock_t *lock);
+bool spin_trylock(spinlock_t *lock);
+void spin_unlock(spinlock_t *lock);
+
+static inline uint64_t spin_lock_irqsave(spinlock_t *lock)
+{
+    uint64_t flags = local_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags)
+{
+    spin_unlock(lock);
+    local_irq_restore(flags);
+}
+
+// ===============================================================================
+// 排号锁
+// ===============================================================================
+void ticket_lock_init(ticket_lock_t *lock, lock_stat_t *stat);
+void ticket_lock(ticket_lock_t *lock);
+void ticket_unlock(ticket_lock_t *lock);
+
+static inline uint64_t ticket_lock_irqsave(ticket_lock_t *lock)
+{
+    uint64_t flags = local_irq_save();
+    ticket_lock(lock);
+    return flags;
+}
+
+static inline void ticket_unlock_irqrestore(ticket_lock_t *lock, uint64_t flags)
+{
+    ticket_unlock(lock);
+    local_irq_restore(flags);
+}
+
+// ===============================================================================
+// MCS 队列锁（node 由调用者提供，通常放在栈上，加锁与解锁须使用同一个 node）
+// ===============================================================================
+void mcs_lock_init(mcs_lock_t *lock, lock_stat_t *stat);
+void mcs_lock(mcs_lock_t *lock, mcs_node_t *node);
+void mcs_unlock(mcs_lock_t *lock, mcs_node_t *node);
+
+static inline uint64_t mcs_lock_irqsave(mcs_lock_t *lock, mcs_node_t *node)
+{
+    uint64_t flags = local_irq_save();
+    mcs_lock(lock, node);
+    return flags;
+}
+
+static inline void mcs_unlock_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint64_t flags)
+{
+    mcs_unlock(lock, node);
+    local_irq_restore(flags);
+}
+
+/**
+ * 多 hart 锁竞争测试：所有在线 hart 同时对同一把锁加解锁，比较三种锁的开销
+ */
+void lock_bench(void);
+
+#endif /* __SPINLOCK_H__ */
@@ -0,0 +1,73 @@
+/*
+ * RISC-V testos 系统调用网关调用约定
+ *
+ * 程序在 S 态运行，不用 ecall，而是直接调用固定地址的网关：
+ * 第 n 号系统调用的入口在 __SYS_ENTER_ADDR__ + n * 8，a0 是调用号，
+ * a1-a5 是参数。本头文件不依赖内核其他部分，用户程序也可以直接包含。
+ */
+
+#ifndef __SYSGATE_H__
+#define __SYSGATE_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+
+// Linux riscv64 系统调用号
+#define SYS_futex           98
+#define SYS_exit            93
+#define SYS_exit_group      94
+#define SYS_set_tid_address 96
+#define SYS_sched_yield     124
+#define SYS_rt_sigprocmask  135
+#define SYS_getpid          172
+#define SYS_gettid          178
+#define SYS_munmap          215
+#define SYS_clone           220
+#define SYS_execve          221
+#define SYS_mmap            222
+#define SYS_mprotect        226
+#define SYS_wait4           260
+
+#define SYSGATE_MAX         256
+
+// mmap
+#define PROT_NONE           0x0
+#define PROT_READ           0x1
+#define PROT_WRITE          0x2
+#define MAP_SHARED          0x01
+#define MAP_PRIVATE         0x02
+#define MAP_FIXED           0x10
+#define MAP_ANONYMOUS       0x20
+
+// clone：低 8 位是子进程退出时发给父进程的信号
+#define CLONE_CSIGNAL       0xff
+#define SIGCHLD             17
+#define CLONE_VM                0x00000100
+#define CLONE_FS                0x00000200
+#define CLONE_FILES             0x00000400
+#define CLONE_SIGHAND           0x00000800
+#define CLONE_THREAD            0x00010000
+#define CLONE_SYSVSEM           0x00040000
+#define CLONE_SETTLS            0x00080000
+#define CLONE_PARENT_SETTID     0x00100000
+#define CLONE_CHILD_CLEARTID    0x00200000
+#define CLONE_DETACHED          0x00400000
+#define CLONE_CHILD_SETTID      0x01000000
+
+typedef long (*sysgate_fn_t)(long nr, long a1, long a2, long a3, long a4, long a5);
+
+static inline long sysgate(long nr, long a1, long a2, long a3, long a4, long a5)
+{
+    return ((sysgate_fn_t)(__SYS_ENTER_ADDR__ + nr * 8))(nr, a1, a2, a3, a4, a5);
+}
+
+/**
+ * 创建线程：在 stack 上调用 fn(arg)，fn 返回后线程以返回值 exit。
+ * 与 musl 的 __clone 相同，新线程从网关返回到调用者之后的指令，
+ * 不能用 sysgate() 直接发起 CLONE_VM，用户程序通过 libc 使用
+ * @return 新线程的 tid，失败返回 -errno
+ */
+long sysgate_clone(int (*fn)(void *), void *stack, unsigned long flags, void *arg, int *ptid,
+                   void *tls, int *ctid);
+
+#endif /* __SYSGATE_H__ */
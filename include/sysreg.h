@@ -68,6 +68,9 @@
 #define SIE_STIE        (1UL << 5)   // Supervisor 定时器中断
 #define SIE_SEIE        (1UL << 9)   // Supervisor 外部中断
 
+// SIP 中断挂起位
+#define SIP_SSIP        (1UL << 1)   // Supervisor 软件中断挂起（IPI）
+
 // 异常原因码
 #define CAUSE_MISALIGNED_FETCH    0
 #define CAUSE_FETCH_ACCESS        1
@@ -80,6 +83,9 @@
 #define CAUSE_USER_ECALL          8
 #define CAUSE_SUPERVISOR_ECALL    9
 #define CAUSE_MACHINE_ECALL       11
+#define CAUSE_FETCH_PAGE_FAULT    12
+#define CAUSE_LOAD_PAGE_FAULT     13
+#define CAUSE_STORE_PAGE_FAULT    15
 
 // 中断原因码 (最高位为1表示中断)
 #define INTERRUPT_BIT             (1UL << 63)
@@ -90,6 +96,25 @@
 #define IRQ_S_EXT                 9
 #define IRQ_M_EXT                 11
 
+// 打开/关闭本地中断
+#define local_irq_enable()  CSR_SET(sstatus, SSTATUS_SIE)
+#define local_irq_disable() CSR_CLEAR(sstatus, SSTATUS_SIE)
+
+// 关闭/恢复本地中断，返回值为关闭前的 sstatus
+static inline uint64_t local_irq_save(void)
+{
+    uint64_t flags;
+    asm volatile("csrrc %0, sstatus, %1" : "=r"(flags) : "r"(SSTATUS_SIE) : "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(uint64_t flags)
+{
+    if (flags & SSTATUS_SIE) {
+        CSR_SET(sstatus, SSTATUS_SIE);
+    }
+}
+
 // WFI 等待中断指令
 #define WFI()   asm volatile ("wfi" ::: "memory")
 
@@ -11,6 +11,7 @@
 
 // RISC-V 定时器相关 CSR
 #define READ_TIME()         CSR_READ(time)
+#define READ_CYCLE()        CSR_READ(cycle)
 #define READ_MCYCLE()       CSR_READ(mcycle)
 #define READ_MINSTRET()     CSR_READ(minstret)
 
@@ -24,6 +25,7 @@ extern volatile uint64_t g_system_ticks;     // 系统tick计数
 extern volatile uint64_t g_timer_frequency;  // 定时器频率
 extern volatile uint64_t g_uptime_seconds;   // 系统运行时间（秒）
 extern volatile uint32_t g_tick_counter;     // tick计数器，用于计算秒
+extern volatile bool     g_timer_heartbeat;  // 为 true 时每秒输出一次运行时间
 
 // 统计信息结构体
 typedef struct {
@@ -88,6 +90,11 @@ uint64_t timer_get_uptime_ms(void);
  */
 uint64_t timer_get_uptime_seconds(void);
 
+/**
+ * 当前 hart 下一次定时器中断的时刻（time CSR），本 hart 没有设置定时器时返回 0
+ */
+uint64_t timer_next_event(void);
+
 /**
  * 获取定时器频率
  * @return 定时器频率（Hz）
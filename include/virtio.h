@@ -0,0 +1,115 @@
+/*
+ * RISC-V testos virtio 定义
+ * virtio-mmio 寄存器（版本 2，modern 接口）与 split virtqueue 结构
+ */
+
+#ifndef __VIRTIO_H__
+#define __VIRTIO_H__
+
+#include "types.h"
+
+// ===============================================================================
+// MMIO 寄存器偏移
+// ===============================================================================
+#define VIRTIO_MMIO_MAGIC_VALUE         0x000   // "virt"
+#define VIRTIO_MMIO_VERSION             0x004
+#define VIRTIO_MMIO_DEVICE_ID           0x008
+#define VIRTIO_MMIO_VENDOR_ID           0x00c
+#define VIRTIO_MMIO_DEVICE_FEATURES     0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL 0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES     0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL 0x024
+#define VIRTIO_MMIO_QUEUE_SEL           0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX       0x034
+#define VIRTIO_MMIO_QUEUE_NUM           0x038
+#define VIRTIO_MMIO_QUEUE_READY         0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY        0x050
+#define VIRTIO_MMIO_INTERRUPT_STATUS    0x060
+#define VIRTIO_MMIO_INTERRUPT_ACK       0x064
+#define VIRTIO_MMIO_STATUS              0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW      0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH     0x084
+#define VIRTIO_MMIO_QUEUE_DRIVER_LOW    0x090
+#define VIRTIO_MMIO_QUEUE_DRIVER_HIGH   0x094
+#define VIRTIO_MMIO_QUEUE_DEVICE_LOW    0x0a0
+#define VIRTIO_MMIO_QUEUE_DEVICE_HIGH   0x0a4
+#define VIRTIO_MMIO_CONFIG_GENERATION   0x0fc
+#define VIRTIO_MMIO_CONFIG              0x100
+
+#define VIRTIO_MMIO_MAGIC               0x74726976
+
+// 设备类型
+#define VIRTIO_DEV_NET                  1
+#define VIRTIO_DEV_BLK                  2
+
+// 设备状态位
+#define VIRTIO_STATUS_ACKNOWLEDGE       1
+#define VIRTIO_STATUS_DRIVER            2
+#define VIRTIO_STATUS_DRIVER_OK         4
+#define VIRTIO_STATUS_FEATURES_OK       8
+#define VIRTIO_STATUS_FAILED            128
+
+// 通用特性位
+#define VIRTIO_RING_F_INDIRECT_DESC     28
+#define VIRTIO_RING_F_EVENT_IDX         29
+#define VIRTIO_F_VERSION_1              32
+
+// ===============================================================================
+// split virtqueue
+// ===============================================================================
+#define VRING_DESC_F_NEXT               1
+#define VRING_DESC_F_WRITE              2   // 设备写入（驱动读取）
+#define VRING_DESC_F_INDIRECT           4
+
+#define VRING_AVAIL_F_NO_INTERRUPT      1
+#define VRING_USED_F_NO_NOTIFY          1
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) vring_desc_t;
+
+// avail 环后紧跟 used_event（EVENT_IDX）
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) vring_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) vring_used_elem_t;
+
+// used 环后紧跟 avail_event（EVENT_IDX）
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx;
+    vring_used_elem_t ring[];
+} __attribute__((packed)) vring_used_t;
+
+#define VRING_USED_EVENT(avail, num)    ((volatile uint16_t *)&(avail)->ring[num])
+#define VRING_AVAIL_EVENT(used, num)    ((volatile uint16_t *)&(used)->ring[num])
+
+/**
+ * EVENT_IDX：对端要求在索引越过 event 时通知，判断 old -> new 之间是否越过
+ */
+static inline bool vring_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx)
+{
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+// MMIO 访问
+static inline uint32_t virtio_read32(uintptr_t base, uint32_t off)
+{
+    return *(volatile uint32_t *)(base + off);
+}
+
+static inline void virtio_write32(uintptr_t base, uint32_t off, uint32_t val)
+{
+    *(volatile uint32_t *)(base + off) = val;
+}
+
+#endif /* __VIRTIO_H__ */
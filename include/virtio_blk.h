@@ -0,0 +1,14 @@
+/*
+ * RISC-V testos virtio-mmio 块设备驱动
+ */
+
+#ifndef __VIRTIO_BLK_H__
+#define __VIRTIO_BLK_H__
+
+/**
+ * 探测 virtio-mmio 槽位上的块设备并注册到块设备层
+ * （需在 smp_init 之后调用，每个 hart 使用自己的 virtqueue）
+ */
+void virtio_blk_init(void);
+
+#endif /* __VIRTIO_BLK_H__ */
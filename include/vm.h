@@ -0,0 +1,147 @@
+/*
+ * RISC-V testos 用户地址空间
+ *
+ * 每个地址空间有私有的根页表和 RAM 区 L1 页表，用户窗口
+ * [USER_BASE, USER_BASE + USER_SIZE) 之外的映射与内核页表共享下级页表，
+ * 因此创建一个地址空间只需复制两页页表。窗口内按 4KB 页映射：
+ * 映像缓存中的页和零页以 PTE_SHARED 共享，进程私有页按物理页计引用，
+ * fork 时双方改为只读并打上 PTE_COW，写入时在缺页处理中复制。
+ * 窗口中间的 2MB 是共享内存区，mmap(MAP_SHARED) 从这里分配，fork 后
+ * 父子进程仍映射同一物理页，futex 按物理地址作键，可以跨进程同步。
+ * 其上是私有匿名映射区（线程栈、malloc）。
+ *
+ * bss、栈和匿名映射按需分配：表项先只记录权限（无效表项 + 软件位），
+ * 第一次访问时在缺页处理中映射一个从预清零页池（mem.h）取出的页，
+ * 缺页时只需取一页、写表项。
+ *
+ * 同一线程组的线程共享地址空间，可能同时在多个 hart 上运行：页表修改在
+ * vm->lock 下进行，权限收紧后向 cpus 中的其他 hart 发 IPI 刷新 TLB。
+ * 刷新时不持有 vm->lock，因为对端可能正关中断在缺页处理中等这把锁。
+ */
+
+#ifndef __VM_H__
+#define __VM_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "mmu.h"
+#include "spinlock.h"
+
+// 共享内存区，占用一个完整的 L1 表项
+#define VM_SHM_BASE     (USER_BASE + USER_SIZE / 2)
+#define VM_SHM_SIZE     LEVEL_SIZE(1)
+
+// 私有匿名映射区，与主线程栈共用最后一个 L1 表项，顶部 128KB 留给栈
+#define VM_MMAP_BASE    (VM_SHM_BASE + VM_SHM_SIZE)
+#define VM_MMAP_SIZE    (LEVEL_SIZE(1) - 32 * PAGE_SIZE)
+
+typedef struct vm_space {
+    pte_t *root;        // 私有根页表
+    pte_t *l1;          // 私有的 RAM 区 L1 页表，窗口内的表项指向私有 L0 页表
+    uint64_t satp;
+    uintptr_t shm_brk;  // 共享内存区下一个未用地址，不回收
+    spinlock_t lock;    // 保护窗口内的页表
+    volatile uint64_t cpus;     // 正在使用此地址空间的 hart 位图
+} vm_space_t;
+
+/**
+ * 初始化物理页引用计数和共享零页（需在 mem_init 之后调用）
+ */
+void vm_init(void);
+
+/**
+ * 创建只含内核映射的地址空间
+ * @return 0 成功，-1 内存不足
+ */
+int vm_create(vm_space_t *vm);
+
+/**
+ * 释放地址空间的页表和私有页，vm 不能是当前 hart 正在使用的地址空间
+ */
+void vm_destroy(vm_space_t *vm);
+
+/**
+ * 在用户窗口内映射一个 4KB 页（建立地址空间时使用，调用者保证没有并发修改）
+ * @param prot PTE_R/W/X，可附加 PTE_COW 和 PTE_SHARED；不带 PTE_SHARED 时增加物理页引用
+ * @return 0 成功，-1 地址越界、已映射或内存不足
+ */
+int vm_map(vm_space_t *vm, uintptr_t va, uintptr_t pa, uint64_t prot);
+
+/**
+ * 按需映射 npages 页：只写入权限，第一次访问时分配清零的页（调用者保证没有并发修改）
+ * @param prot PTE_R/W/X
+ * @return 0 成功，-1 地址越界、已映射或内存不足
+ */
+int vm_map_demand(vm_space_t *vm, uintptr_t va, size_t npages, uint64_t prot);
+
+/**
+ * 分配一个清零的私有页并映射到 va
+ * @return 页的内核（恒等映射）地址，失败返回 NULL
+ */
+void *vm_alloc_page(vm_space_t *vm, uintptr_t va, uint64_t prot);
+
+/**
+ * 在共享内存区分配清零的可写页，fork 时不做写时复制
+ * @return 起始虚拟地址，区域用尽或内存不足返回 0
+ */
+uintptr_t vm_shm_map(vm_space_t *vm, size_t npages);
+
+/**
+ * 在私有匿名映射区找一段空闲地址并映射，首次适配，munmap 后的地址可以复用
+ * 与相邻的映射之间至少隔一个未映射的页
+ * @param prot 0 只保留地址（PROT_NONE），PTE_R 只读，PTE_R | PTE_W 可写；页在第一次访问时分配
+ * @return 起始虚拟地址，没有足够的连续空间返回 0
+ */
+uintptr_t vm_mmap(vm_space_t *vm, size_t npages, uint64_t prot);
+
+/**
+ * 查找私有匿名映射区中 va 所在映射的最低可访问页（其下是保护页）
+ * @return 页地址，va 不在私有映射区、未映射或不可访问时返回 0
+ */
+uintptr_t vm_mmap_bottom(vm_space_t *vm, uintptr_t va);
+
+/**
+ * 修改私有匿名映射区中页的权限，参数同 vm_mmap
+ * @return 0 成功，-1 范围内有未映射的页
+ */
+int vm_mprotect(vm_space_t *vm, uintptr_t va, size_t npages, uint64_t prot);
+
+/**
+ * 解除共享内存区或私有匿名映射区中的映射，最后一个映射者释放物理页
+ * @return 0 成功，-1 地址不在这两个区域内
+ */
+int vm_munmap(vm_space_t *vm, uintptr_t va, size_t npages);
+
+/**
+ * 虚拟地址转物理地址，窗口外的地址按内核恒等映射返回
+ * @param write 为 true 时先打破写时复制，保证返回的物理页之后不再变化
+ * @return 物理地址，未映射返回 0
+ */
+uintptr_t vm_translate(vm_space_t *vm, uintptr_t va, bool write);
+
+/**
+ * 共享的全零物理页，映像缓存用它填充只有 bss 的页
+ */
+uintptr_t vm_zero_page(void);
+
+/**
+ * 复制地址空间：只复制页表，可写页在双方都改为写时复制
+ * src 是当前 hart 正在使用的地址空间时会刷新本地 TLB
+ * @return 0 成功，-1 内存不足
+ */
+int vm_fork(vm_space_t *dst, vm_space_t *src);
+
+/**
+ * 处理缺页：按需清零的页分配，写时复制页复制
+ * @param access 引起缺页的访问，PTE_R（读）、PTE_W（写）或 PTE_X（取指）
+ * @return 已处理返回 true，访问越权或地址未映射返回 false
+ */
+bool vm_fault(vm_space_t *vm, uintptr_t va, uint64_t access);
+
+
+/**
+ * 打印地址空间与写时复制统计
+ */
+void vm_dump_stats(void);
+
+#endif /* __VM_H__ */
@@ -0,0 +1,47 @@
+/*
+ * RISC-V testos 内核工作队列
+ *
+ * 软中断和中断处理函数中不适合做的工作（打印日志、可能等待的操作、浮点运算）
+ * 用 queue_work() 交给线程上下文执行。每个 hart 一个 FIFO 队列，由该 hart 的
+ * 线程上下文循环消费：从核在调度循环空闲时，启动 hart 在 shell 等待输入、两条命令之间
+ * 以及退出 shell 后的空闲循环中。投递到其他 hart 时用 IPI 把它从空闲中唤醒。
+ */
+
+#ifndef __WORKQUEUE_H__
+#define __WORKQUEUE_H__
+
+#include "types.h"
+
+typedef struct work {
+    struct work *next;
+    void (*func)(struct work *work);    // work 可嵌在调用者的结构体中
+    volatile uint32_t pending;          // 已入队，尚未开始执行
+    uint64_t queued;                    // 入队时间（time CSR），统计排队延迟
+} work_t;
+
+#define WORK_INIT(fn)   { NULL, (fn), 0, 0 }
+
+/**
+ * 把 work 投递到指定 hart 的队列，hart 未上线时投递到当前 hart
+ * 可在中断和软中断中调用
+ * @return 已在某个队列中尚未执行时返回 false
+ */
+bool queue_work_on(uint64_t hart, work_t *work);
+
+/**
+ * 把 work 投递到当前 hart 的队列
+ */
+bool queue_work(work_t *work);
+
+/**
+ * 在线程上下文中执行当前 hart 队列中的全部工作
+ * @return 执行了至少一项工作时返回 true
+ */
+bool workqueue_run(void);
+
+/**
+ * 打印每个 hart 的工作数、排队延迟与执行时间
+ */
+void workqueue_dump(void);
+
+#endif /* __WORKQUEUE_H__ */
@@ -0,0 +1,73 @@
+/*
+ * RISC-V testos 压缩内核映像
+ *
+ * zImage 布局（由 tools/mkzimage 生成，整体加载到 __LOAD_ADDR__）：
+ *     [解压存根 zboot/] [zboot_header_t] [LZ4 块数据]
+ * 存根先把整个映像搬到原始内核末尾之后，再从搬走的副本把内核解压回
+ * __LOAD_ADDR__，把耗时写进内核映像中固定位置的 zboot_info，然后跳到 _start。
+ *
+ * 本头文件同时被存根汇编、宿主机工具和内核包含，C 部分只依赖 uint32_t/uint64_t。
+ */
+
+#ifndef __ZBOOT_H__
+#define __ZBOOT_H__
+
+#define ZBOOT_MAGIC             0x345a4c5a      // "ZLZ4"
+#define ZBOOT_INFO_MAGIC        0x4f464e49      // "INFO"
+
+// zboot_info 在原始内核映像中的偏移，与 src/boot/link.lds 中的 .zboot_info 一致
+#define ZBOOT_INFO_OFFSET       0x3fc0
+
+// zboot_header_t 各字段偏移（供存根汇编使用）
+#define ZBOOT_HDR_MAGIC         0
+#define ZBOOT_HDR_RAW_SIZE      4
+#define ZBOOT_HDR_COMP_SIZE     8
+#define ZBOOT_HDR_SIZE          16
+
+// zboot_info_t 各字段偏移
+#define ZBOOT_INFO_MAGIC_OFF    0
+#define ZBOOT_INFO_RAW_OFF      4
+#define ZBOOT_INFO_COMP_OFF     8
+#define ZBOOT_INFO_IMAGE_OFF    12
+#define ZBOOT_INFO_START_OFF    16
+#define ZBOOT_INFO_END_OFF      24
+
+#ifndef __ASSEMBLER__
+
+typedef struct {
+    uint32_t magic;             // ZBOOT_MAGIC
+    uint32_t raw_size;          // 解压后的内核映像字节数
+    uint32_t comp_size;         // 紧随其后的 LZ4 块字节数
+    uint32_t reserved;
+} zboot_header_t;
+
+// 由存根在解压完成后填写；从原始映像启动时保持全零
+typedef struct {
+    uint32_t magic;             // ZBOOT_INFO_MAGIC
+    uint32_t raw_size;
+    uint32_t comp_size;
+    uint32_t image_size;        // 整个 zImage（存根 + 头 + 压缩数据）的字节数
+    uint64_t start_time;        // 存根入口的 time CSR
+    uint64_t end_time;          // 解压完成、跳转内核前的 time CSR
+} zboot_info_t;
+
+/**
+ * 从压缩映像启动时在启动日志中报告解压耗时
+ */
+void zboot_report(void);
+
+/**
+ * 取解压存根的入口和完成时间（time CSR）
+ * @return 成功返回 0，从原始映像启动时返回 -1
+ */
+int zboot_times(uint64_t *start, uint64_t *end);
+
+/**
+ * 比较原始映像与压缩映像的加载+解压时间
+ * @param arg 存储带宽（MB/s），为空时用块设备 0 实测
+ */
+void zboot_dump(const char *arg);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* __ZBOOT_H__ */
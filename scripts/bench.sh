@@ -0,0 +1,8 @@
+# 性能实验示例：shell 中 script bench，或无人值守地 make qemu QEMU_APPEND="batch=bench"
+# 每行一条命令，# 开头的行是注释；最后加一行 quit 时执行完不进入交互
+bootlog
+repeat 5 perfbench
+time ipcbench
+time parbench
+repeat 3 time blkbench
+softirq
@@ -0,0 +1,102 @@
+/*
+ * RISC-V testos 启动计时
+ *
+ * 日志中每条记录是一个阶段的结束时间，第一条是起点：从压缩映像启动时是存根入口，
+ * 否则是 _start。本阶段耗时 = 本条时间 - 上一条时间。
+ * 启动期间只有启动 hart 写日志，shell 里读取时启动已经结束，不需要加锁。
+ */
+
+#include "types.h"
+#include "bootlog.h"
+#include "timer.h"
+#include "string.h"
+#include "zboot.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+typedef struct {
+    const char *phase;
+    uint64_t    time;
+} bootlog_entry_t;
+
+// 在 BSS 中，boot.S 清完 BSS 后才写入
+uint64_t bootlog_early[BOOTLOG_EARLY_COUNT];
+
+static bootlog_entry_t bootlog[BOOTLOG_MAX];
+static int             bootlog_count;
+static int             bootlog_dropped;
+
+static void bootlog_add(const char *phase, uint64_t time)
+{
+    if (bootlog_count >= BOOTLOG_MAX) {
+        bootlog_dropped++;
+        return;
+    }
+    bootlog[bootlog_count].phase = phase;
+    bootlog[bootlog_count].time  = time;
+    bootlog_count++;
+}
+
+void bootlog_init(void)
+{
+    uint64_t zstart, zend;
+
+    bootlog_count   = 0;
+    bootlog_dropped = 0;
+    if (zboot_times(&zstart, &zend) == 0) {
+        bootlog_add("zboot", zstart);
+        bootlog_add("inflate", zend);
+    }
+    bootlog_add("entry", bootlog_early[BOOTLOG_EARLY_ENTRY]);
+    bootlog_add("clear_bss", bootlog_early[BOOTLOG_EARLY_BSS]);
+    bootlog_add("mem_init", bootlog_early[BOOTLOG_EARLY_MEM]);
+}
+
+void bootlog_mark(const char *phase)
+{
+    bootlog_add(phase, READ_TIME());
+}
+
+static uint64_t ticks_to_us(uint64_t ticks)
+{
+    return ticks * 1000000 / timer_get_frequency();
+}
+
+void bootlog_dump(void)
+{
+    if (!bootlog_count) {
+        logger("bootlog: empty\n");
+        return;
+    }
+
+    uint64_t origin = bootlog[0].time;
+
+    logger("=== Boot Timeline ===\n");
+    logger("  before %s (firmware + loader): %llu us\n", bootlog[0].phase, ticks_to_us(origin));
+    logger("  %-16s %10s %10s\n", "phase", "at(us)", "took(us)");
+    for (int i = 0; i < bootlog_count; i++) {
+        uint64_t at = ticks_to_us(bootlog[i].time - origin);
+
+        if (i == 0) {
+            logger("  %-16s %10llu %10s\n", bootlog[i].phase, at, "-");
+        } else {
+            logger("  %-16s %10llu %10llu\n", bootlog[i].phase, at,
+                   ticks_to_us(bootlog[i].time - bootlog[i - 1].time));
+        }
+        if (strcmp(bootlog[i].phase, "shell") == 0) {
+            logger("  time to shell: %llu us since %s, %llu us since reset\n", at,
+                   bootlog[0].phase, ticks_to_us(bootlog[i].time));
+        }
+    }
+    if (bootlog_dropped) {
+        logger("  (%d later phases not recorded, BOOTLOG_MAX = %d)\n", bootlog_dropped, BOOTLOG_MAX);
+    }
+}
+
+static int cmd_bootlog(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    bootlog_dump();
+    return 0;
+}
+SHELL_CMD(bootlog, NULL, "Show boot phase timeline and time to shell", cmd_bootlog);
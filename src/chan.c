@@ -0,0 +1,145 @@
+/*
+ * RISC-V testos 共享内存通道测试
+ *
+ * 测试进程通过系统调用网关 mmap 三个通道后 fork：ping/pong 两个通道测往返延迟，
+ * bulk 通道测单向吞吐。有空闲 hart 时两个进程分别运行，自旋通常就能等到对端；
+ * 只有一个 hart 时对端不会与自旋同时运行，每次等待最终都会走 futex，结果反映的是
+ * “共享内存 + futex 唤醒 + 进程切换”的开销。
+ */
+
+#include "types.h"
+#include "chan.h"
+#include "futex.h"
+#include "proc.h"
+#include "sysgate.h"
+#include "timer.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+#define CHAN_BENCH_ROUNDS       2000
+#define CHAN_PING_SLOTS         4
+#define CHAN_BULK_SLOTS         64
+#define CHAN_BULK_SLOT_SIZE     256
+#define CHAN_BULK_BYTES         (4 << 20)
+#define CHAN_BULK_MSGS          (CHAN_BULK_BYTES / CHAN_BULK_SLOT_SIZE)
+
+static chan_t *chan_bench_map(uint32_t nslots, uint32_t slot_size)
+{
+    long va = sysgate(SYS_mmap, 0, chan_bytes(nslots, slot_size), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1);
+
+    if (va < 0) {
+        return NULL;
+    }
+    chan_init((chan_t *)va, nslots, slot_size);
+    return (chan_t *)va;
+}
+
+// 子进程：回显 ping，然后消费 bulk 流，校验和不对时以非 0 退出
+static int chan_bench_child(chan_t *ping, chan_t *pong, chan_t *bulk)
+{
+    uint64_t v;
+
+    for (int i = 0; i < CHAN_BENCH_ROUNDS; i++) {
+        chan_recv(ping, &v, sizeof(v));
+        chan_send(pong, &v, sizeof(v));
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < CHAN_BULK_MSGS; i++) {
+        const uint64_t *slot = chan_peek(bulk);
+        sum += slot[0] + slot[CHAN_BULK_SLOT_SIZE / sizeof(uint64_t) - 1];
+        chan_release(bulk);
+    }
+    return sum == (uint64_t)CHAN_BULK_MSGS * (CHAN_BULK_MSGS - 1) / 2 ? 0 : 1;
+}
+
+static int chan_bench_main(void *arg)
+{
+    (void)arg;
+
+    chan_t *ping = chan_bench_map(CHAN_PING_SLOTS, sizeof(uint64_t));
+    chan_t *pong = chan_bench_map(CHAN_PING_SLOTS, sizeof(uint64_t));
+    chan_t *bulk = chan_bench_map(CHAN_BULK_SLOTS, CHAN_BULK_SLOT_SIZE);
+    if (!ping || !pong || !bulk) {
+        logger_error("ipcbench: mmap failed\n");
+        return 1;
+    }
+
+    long pid = sysgate(SYS_clone, SIGCHLD, 0, 0, 0, 0);
+    if (pid < 0) {
+        logger_error("ipcbench: fork failed (%ld)\n", pid);
+        return 1;
+    }
+    if (pid == 0) {
+        return chan_bench_child(ping, pong, bulk);
+    }
+
+    uint64_t freq = timer_get_frequency();
+    uint64_t sys  = futex_syscalls();
+    uint64_t t    = READ_CYCLE();
+    uint64_t v;
+
+    for (uint64_t i = 0; i < CHAN_BENCH_ROUNDS; i++) {
+        chan_send(ping, &i, sizeof(i));
+        chan_recv(pong, &v, sizeof(v));
+        if (v != i) {
+            logger_error("ipcbench: ping %llu came back as %llu\n", i, v);
+            break;
+        }
+    }
+    t   = READ_CYCLE() - t;
+    sys = futex_syscalls() - sys;
+    logger("ping-pong: %d round trips, %llu cycles/round trip, %llu.%02llu futex calls/message\n",
+           CHAN_BENCH_ROUNDS, t / CHAN_BENCH_ROUNDS, sys / (2 * CHAN_BENCH_ROUNDS),
+           sys * 100 / (2 * CHAN_BENCH_ROUNDS) % 100);
+
+    sys = futex_syscalls();
+    t   = READ_TIME();
+    for (uint64_t i = 0; i < CHAN_BULK_MSGS; i++) {
+        uint64_t *slot = chan_reserve(bulk);
+        slot[0] = i;
+        for (size_t w = 1; w < CHAN_BULK_SLOT_SIZE / sizeof(uint64_t); w++) {
+            slot[w] = 0;
+        }
+        chan_commit(bulk);
+    }
+
+    int status = 0;
+    sysgate(SYS_wait4, pid, (long)&status, 0, 0, 0);
+    t   = READ_TIME() - t;
+    sys = futex_syscalls() - sys;
+    if (t == 0) {
+        t = 1;
+    }
+    logger("bulk: %d KB in %d-byte slots, %llu KB/s, %llu futex calls for %d messages\n",
+           CHAN_BULK_BYTES / 1024, CHAN_BULK_SLOT_SIZE,
+           (uint64_t)CHAN_BULK_BYTES / 1024 * freq / t, sys, CHAN_BULK_MSGS);
+    if (status != 0) {
+        logger_error("ipcbench: receiver reported a bad checksum\n");
+        return 1;
+    }
+    return 0;
+}
+
+void chan_bench(void)
+{
+    logger("=== Shared-Memory Channel Benchmark ===\n");
+
+    int pid = proc_spawn_fn("ipcbench", chan_bench_main, NULL);
+    if (pid < 0) {
+        return;
+    }
+    int code = proc_run(pid);
+    if (code != 0) {
+        logger_error("ipcbench: exited with %d\n", code);
+    }
+}
+
+static int cmd_ipcbench(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    chan_bench();
+    return 0;
+}
+SHELL_CMD(ipcbench, NULL, "Run shared-memory channel latency/throughput benchmark", cmd_ipcbench);
@@ -0,0 +1,339 @@
+/*
+ * RISC-V testos 块设备层
+ */
+
+#include "types.h"
+#include "blkdev.h"
+#include "string.h"
+#include "spinlock.h"
+#include "atomic.h"
+#include "smp.h"
+#include "percpu.h"
+#include "mem.h"
+#include "timer.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+static blkdev_t  *blkdevs[BLK_MAX_DEVICES];
+static int        blkdev_count;
+static spinlock_t blkdev_lock;
+
+// ===============================================================================
+// 设备注册与查找
+// ===============================================================================
+int blkdev_register(blkdev_t *dev)
+{
+    int id = -1;
+
+    spin_lock(&blkdev_lock);
+    if (blkdev_count < BLK_MAX_DEVICES) {
+        id = blkdev_count++;
+        dev->id     = id;
+        blkdevs[id] = dev;
+    }
+    spin_unlock(&blkdev_lock);
+
+    if (id >= 0) {
+        logger_info("blk%d: %s, %llu sectors (%llu MB)%s\n", id, dev->name, dev->capacity,
+                    dev->capacity >> (20 - BLK_SECTOR_SHIFT), dev->read_only ? ", read-only" : "");
+    }
+    return id;
+}
+
+blkdev_t *blkdev_get(int id)
+{
+    if (id < 0 || id >= blkdev_count) {
+        return NULL;
+    }
+    return blkdevs[id];
+}
+
+blkdev_t *blkdev_find(const char *name)
+{
+    for (int i = 0; i < blkdev_count; i++) {
+        if (strcmp(blkdevs[i]->name, name) == 0) {
+            return blkdevs[i];
+        }
+    }
+    return NULL;
+}
+
+// ===============================================================================
+// 请求提交与等待
+// ===============================================================================
+int blk_submit(blkdev_t *dev, blk_request_t **reqs, int n)
+{
+    int done = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (reqs[i]->sector + reqs[i]->count > dev->capacity ||
+            (reqs[i]->write && dev->read_only)) {
+            reqs[i]->status = BLK_REQ_ERROR;
+            continue;
+        }
+        reqs[i]->status = BLK_REQ_PENDING;
+    }
+
+    while (done < n) {
+        // 跳过参数检查失败的请求
+        if (reqs[done]->status != BLK_REQ_PENDING) {
+            done++;
+            continue;
+        }
+
+        int end = done;
+        while (end < n && reqs[end]->status == BLK_REQ_PENDING) {
+            end++;
+        }
+
+        int accepted = dev->ops->submit(dev, &reqs[done], end - done);
+        if (accepted == 0) {
+            // 队列已满，回收一些完成的请求后重试
+            dev->ops->poll(dev);
+        }
+        done += accepted;
+    }
+
+    return n;
+}
+
+int blk_wait(blkdev_t *dev, blk_request_t *req)
+{
+    while (req->status == BLK_REQ_PENDING) {
+        dev->ops->poll(dev);
+    }
+    return req->status;
+}
+
+static int blk_rw(blkdev_t *dev, uint64_t sector, void *buf, uint32_t count, bool write)
+{
+    blk_request_t  req = { .sector = sector, .count = count, .write = write, .buf = buf };
+    blk_request_t *r   = &req;
+
+    blk_submit(dev, &r, 1);
+    return blk_wait(dev, &req) == BLK_REQ_OK ? 0 : -1;
+}
+
+int blk_read(blkdev_t *dev, uint64_t sector, void *buf, uint32_t count)
+{
+    return blk_rw(dev, sector, buf, count, false);
+}
+
+int blk_write(blkdev_t *dev, uint64_t sector, const void *buf, uint32_t count)
+{
+    return blk_rw(dev, sector, (void *)buf, count, true);
+}
+
+// ===============================================================================
+// 设备信息
+// ===============================================================================
+void blkdev_dump(void)
+{
+    logger("=== Block Devices ===\n");
+    if (blkdev_count == 0) {
+        logger("  (none)\n");
+        return;
+    }
+    for (int i = 0; i < blkdev_count; i++) {
+        blkdev_t *dev = blkdevs[i];
+        logger("  blk%d: %-12s %llu sectors (%llu MB)%s\n", i, dev->name, dev->capacity,
+               dev->capacity >> (20 - BLK_SECTOR_SHIFT), dev->read_only ? " ro" : "");
+        if (dev->ops->dump) {
+            dev->ops->dump(dev);
+        }
+    }
+}
+
+static int cmd_blk(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    blkdev_dump();
+    return 0;
+}
+SHELL_CMD(blk, NULL, "Show block devices and queue statistics", cmd_blk);
+
+// ===============================================================================
+// 吞吐测试
+// ===============================================================================
+#define BLK_BENCH_BS        4096                            // 每个请求的字节数
+#define BLK_BENCH_SECTORS   (BLK_BENCH_BS / BLK_SECTOR_SIZE)
+#define BLK_BENCH_OPS       2048                            // 每个 hart 的请求数
+#define BLK_BENCH_MAX_QD    32
+
+typedef struct {
+    blkdev_t *dev;
+    int qd;
+    bool random;
+    uint64_t harts;
+    volatile uint64_t arrived;
+    volatile uint64_t errors;
+    uint64_t ticks[MAX_HARTS];
+    uint8_t *bufs[MAX_HARTS];
+    blk_request_t reqs[MAX_HARTS][BLK_BENCH_MAX_QD];
+} blk_bench_t;
+
+static blk_bench_t blk_bench_data;
+
+static uint64_t blk_bench_next_sector(blk_bench_t *b, uint64_t *seed, uint64_t n)
+{
+    uint64_t blocks = b->dev->capacity / BLK_BENCH_SECTORS;
+
+    if (b->random) {
+        // xorshift64
+        *seed ^= *seed << 13;
+        *seed ^= *seed >> 7;
+        *seed ^= *seed << 17;
+        return (*seed % blocks) * BLK_BENCH_SECTORS;
+    }
+    return (n % blocks) * BLK_BENCH_SECTORS;
+}
+
+// 在 IPI 上下文中运行，不能使用浮点；每个 hart 走自己的 virtqueue
+static void blk_bench_worker(void *arg)
+{
+    blk_bench_t   *b      = arg;
+    uint64_t       self   = this_hart_id();
+    blk_request_t *reqs   = b->reqs[self];
+    blk_request_t *batch[BLK_BENCH_MAX_QD];
+    uint64_t       seed   = 0x9e3779b97f4a7c15ULL ^ (self << 32);
+    uint64_t       seq    = self * BLK_BENCH_OPS;
+    uint64_t       errors = 0;
+    uint32_t       issued = 0;
+    uint32_t       done   = 0;
+    uint32_t       inflight = 0;   // 在途请求位图
+
+    atomic_fetch_add(&b->arrived, 1);
+    while (READ_ONCE(b->arrived) < b->harts) {
+        cpu_relax();
+    }
+
+    uint64_t start = READ_TIME();
+    while (done < BLK_BENCH_OPS) {
+        int n = 0;
+
+        for (int i = 0; i < b->qd; i++) {
+            if (reqs[i].status == BLK_REQ_PENDING) {
+                continue;
+            }
+            if (inflight & (1U << i)) {
+                inflight &= ~(1U << i);
+                done++;
+                if (reqs[i].status != BLK_REQ_OK) {
+                    errors++;
+                }
+            }
+            if (issued < BLK_BENCH_OPS) {
+                reqs[i].sector = blk_bench_next_sector(b, &seed, seq++);
+                reqs[i].count  = BLK_BENCH_SECTORS;
+                reqs[i].write  = false;
+                reqs[i].buf    = b->bufs[self] + i * BLK_BENCH_BS;
+                batch[n++]     = &reqs[i];
+                inflight |= 1U << i;
+                issued++;
+            }
+        }
+
+        if (n) {
+            blk_submit(b->dev, batch, n);
+        }
+        b->dev->ops->poll(b->dev);
+    }
+    b->ticks[self] = READ_TIME() - start;
+
+    if (errors) {
+        atomic_fetch_add(&b->errors, errors);
+    }
+}
+
+void blk_bench(void)
+{
+    static const struct {
+        const char *name;
+        bool random;
+        int qd;
+        bool all_harts;
+    } modes[] = {
+        { "seq",  false, 1,                false },
+        { "seq",  false, BLK_BENCH_MAX_QD, false },
+        { "rand", true,  1,                false },
+        { "rand", true,  BLK_BENCH_MAX_QD, false },
+        { "rand", true,  BLK_BENCH_MAX_QD, true  },
+    };
+    blk_bench_t *b    = &blk_bench_data;
+    blkdev_t    *dev  = blkdev_get(0);
+    uint64_t     self = this_hart_id();
+    uint64_t     freq = timer_get_frequency();
+
+    if (!dev) {
+        logger_error("blkbench: no block device (try 'make qemu-blk')\n");
+        return;
+    }
+    if (dev->capacity < BLK_BENCH_SECTORS) {
+        logger_error("blkbench: %s is too small\n", dev->name);
+        return;
+    }
+
+    uint64_t online = READ_ONCE(smp_online_mask);
+    for (int h = 0; h < MAX_HARTS; h++) {
+        if ((online & HART_MASK(h)) && !b->bufs[h]) {
+            b->bufs[h] = alloc_pages(BLK_BENCH_MAX_QD * BLK_BENCH_BS / PAGE_SIZE);
+            if (!b->bufs[h]) {
+                logger_error("blkbench: out of memory\n");
+                return;
+            }
+        }
+    }
+
+    logger("=== Block Read Throughput (%s) ===\n", dev->name);
+    logger("  %d x %d KB reads per hart\n", BLK_BENCH_OPS, BLK_BENCH_BS / 1024);
+    logger("  %-6s %4s %6s %10s %8s %8s %s\n", "mode", "qd", "harts", "ticks", "MB/s", "IOPS",
+           "check");
+
+    for (size_t m = 0; m < ARRAY_SIZE(modes); m++) {
+        uint64_t mask = modes[m].all_harts ? online : HART_MASK(self);
+
+        b->dev     = dev;
+        b->qd      = modes[m].qd;
+        b->random  = modes[m].random;
+        b->harts   = 0;
+        b->arrived = 0;
+        b->errors  = 0;
+        for (int h = 0; h < MAX_HARTS; h++) {
+            b->ticks[h] = 0;
+            for (int i = 0; i < BLK_BENCH_MAX_QD; i++) {
+                b->reqs[h][i].status = BLK_REQ_OK;
+            }
+            if (mask & HART_MASK(h)) {
+                b->harts++;
+            }
+        }
+
+        smp_call_function(mask, blk_bench_worker, b, true);
+
+        uint64_t wall = 0;
+        for (int h = 0; h < MAX_HARTS; h++) {
+            if (b->ticks[h] > wall) {
+                wall = b->ticks[h];
+            }
+        }
+        if (wall == 0) {
+            wall = 1;
+        }
+        uint64_t ops   = b->harts * BLK_BENCH_OPS;
+        uint64_t bytes = ops * BLK_BENCH_BS;
+        logger("  %-6s %4d %6llu %10llu %8llu %8llu %s\n", modes[m].name, modes[m].qd, b->harts,
+               wall, bytes * freq / wall >> 20, ops * freq / wall, b->errors ? "FAIL" : "ok");
+    }
+
+    if (dev->ops->dump) {
+        dev->ops->dump(dev);
+    }
+}
+
+static int cmd_blkbench(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    blk_bench();
+    return 0;
+}
+SHELL_CMD(blkbench, NULL, "Run block device read throughput benchmark", cmd_blkbench);
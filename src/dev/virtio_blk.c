@@ -0,0 +1,495 @@
+/*
+ * RISC-V testos virtio-mmio 块设备驱动
+ *
+ * - 每个 hart 一个 virtqueue（设备支持 VIRTIO_BLK_F_MQ 时），提交与回收都在本 hart 队列上进行
+ * - 间接描述符：一个请求只占用环上的一个描述符，队列深度等于环大小
+ * - 批量提交：一批请求只更新一次 avail->idx，相邻扇区的请求合并成一个多段请求
+ * - EVENT_IDX：按设备给出的 avail_event 决定是否写 QueueNotify，减少 MMIO 退出
+ * - 轮询完成，不使用中断
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "virtio.h"
+#include "virtio_blk.h"
+#include "blkdev.h"
+#include "mem.h"
+#include "string.h"
+#include "atomic.h"
+#include "spinlock.h"
+#include "percpu.h"
+#include "sysreg.h"
+#include "initcall.h"
+#include "lib/logger.h"
+
+// virtio-blk 特性位
+#define VIRTIO_BLK_F_RO         5
+#define VIRTIO_BLK_F_MQ         12
+
+// virtio-blk 配置空间偏移
+#define VIRTIO_BLK_CFG_CAPACITY     0x00
+#define VIRTIO_BLK_CFG_NUM_QUEUES   0x22
+
+// 请求类型与状态
+#define VIRTIO_BLK_T_IN         0
+#define VIRTIO_BLK_T_OUT        1
+#define VIRTIO_BLK_S_OK         0
+
+#define VBLK_QUEUE_SIZE         128     // 每个 virtqueue 的描述符数（不超过设备上限）
+#define VBLK_MAX_SEGS           16      // 一个 virtio 请求最多合并的数据段
+#define VBLK_MAX_DEVICES        4
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_req_hdr_t;
+
+// 在途请求，按头描述符编号索引
+typedef struct {
+    vring_desc_t indirect[VBLK_MAX_SEGS + 2];  // 头 + 数据段 + 状态
+    virtio_blk_req_hdr_t hdr;
+    volatile uint8_t status;
+    blk_request_t *reqs;                        // 合并进来的上层请求
+} __attribute__((aligned(16))) vblk_slot_t;
+
+typedef struct {
+    uint16_t index;             // virtqueue 编号
+    uint16_t num;               // 描述符数
+    vring_desc_t  *desc;
+    vring_avail_t *avail;
+    vring_used_t  *used;
+    uint16_t free_head;         // 空闲描述符链表
+    uint16_t num_free;
+    uint16_t avail_idx;         // 下一个要写的 avail 位置
+    uint16_t last_used;         // 已回收到的 used 位置
+    vblk_slot_t *slots;
+    spinlock_t lock;
+
+    // 统计
+    uint64_t requests;          // 上层请求数
+    uint64_t merged;            // 被合并进前一个请求的上层请求数
+    uint64_t batches;           // 提交批次数
+    uint64_t notifies;          // 实际写 QueueNotify 的次数
+    uint64_t suppressed;        // 按 EVENT_IDX/NO_NOTIFY 省掉的通知次数
+    uint64_t completed;         // 完成的 virtio 请求数
+} vblk_queue_t;
+
+typedef struct {
+    blkdev_t dev;
+    char name[16];
+    uintptr_t base;
+    bool indirect;
+    bool event_idx;
+    int nqueues;
+    vblk_queue_t queues[MAX_HARTS];
+} virtio_blk_t;
+
+static virtio_blk_t vblk_devs[VBLK_MAX_DEVICES];
+static int          vblk_count;
+
+// ===============================================================================
+// 描述符分配
+// ===============================================================================
+static int vq_alloc_desc(vblk_queue_t *q, int n)
+{
+    if (q->num_free < n) {
+        return -1;
+    }
+
+    uint16_t head = q->free_head;
+    uint16_t idx  = head;
+    for (int i = 0; i < n - 1; i++) {
+        idx = q->desc[idx].next;
+    }
+    q->free_head = q->desc[idx].next;
+    q->num_free -= n;
+    return head;
+}
+
+static void vq_free_desc(vblk_queue_t *q, uint16_t head)
+{
+    uint16_t idx = head;
+    int      n   = 1;
+
+    while (q->desc[idx].flags & VRING_DESC_F_NEXT) {
+        idx = q->desc[idx].next;
+        n++;
+    }
+    q->desc[idx].next = q->free_head;
+    q->free_head      = head;
+    q->num_free += n;
+}
+
+static void vq_set_desc(vring_desc_t *d, void *addr, uint32_t len, uint16_t flags, uint16_t next)
+{
+    d->addr  = (uintptr_t)addr;
+    d->len   = len;
+    d->flags = flags;
+    d->next  = next;
+}
+
+// ===============================================================================
+// 提交
+// ===============================================================================
+
+// 从 reqs[0] 开始统计可以合并的相邻请求个数
+static int vblk_merge_count(blk_request_t **reqs, int n)
+{
+    int nseg = 1;
+
+    while (nseg < n && nseg < VBLK_MAX_SEGS) {
+        blk_request_t *prev = reqs[nseg - 1];
+        blk_request_t *cur  = reqs[nseg];
+        if (cur->write != prev->write || cur->sector != prev->sector + prev->count) {
+            break;
+        }
+        nseg++;
+    }
+    return nseg;
+}
+
+static int vblk_submit(blkdev_t *dev, blk_request_t **reqs, int n)
+{
+    virtio_blk_t *vb    = dev->priv;
+    vblk_queue_t *q     = &vb->queues[this_hart_id() % vb->nqueues];
+    int           i     = 0;
+    uint16_t      added = 0;
+
+    uint64_t flags = spin_lock_irqsave(&q->lock);
+
+    while (i < n) {
+        int nseg = vblk_merge_count(&reqs[i], n - i);
+        int head = vq_alloc_desc(q, vb->indirect ? 1 : nseg + 2);
+        if (head < 0) {
+            break;
+        }
+
+        vblk_slot_t *slot = &q->slots[head];
+        slot->hdr.type     = reqs[i]->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+        slot->hdr.reserved = 0;
+        slot->hdr.sector   = reqs[i]->sector;
+        slot->status       = 0xff;
+
+        // 上层请求串成链表，完成时逐个标记
+        slot->reqs = reqs[i];
+        for (int s = 0; s < nseg - 1; s++) {
+            reqs[i + s]->next = reqs[i + s + 1];
+        }
+        reqs[i + nseg - 1]->next = NULL;
+
+        uint16_t data_flags = reqs[i]->write ? 0 : VRING_DESC_F_WRITE;
+
+        if (vb->indirect) {
+            vring_desc_t *t = slot->indirect;
+            vq_set_desc(&t[0], &slot->hdr, sizeof(slot->hdr), VRING_DESC_F_NEXT, 1);
+            for (int s = 0; s < nseg; s++) {
+                vq_set_desc(&t[s + 1], reqs[i + s]->buf, reqs[i + s]->count * BLK_SECTOR_SIZE,
+                            data_flags | VRING_DESC_F_NEXT, s + 2);
+            }
+            vq_set_desc(&t[nseg + 1], (void *)&slot->status, 1, VRING_DESC_F_WRITE, 0);
+            vq_set_desc(&q->desc[head], t, (nseg + 2) * sizeof(vring_desc_t),
+                        VRING_DESC_F_INDIRECT, q->desc[head].next);
+        } else {
+            uint16_t idx = head;
+            vq_set_desc(&q->desc[idx], &slot->hdr, sizeof(slot->hdr), VRING_DESC_F_NEXT,
+                        q->desc[idx].next);
+            for (int s = 0; s < nseg; s++) {
+                idx = q->desc[idx].next;
+                vq_set_desc(&q->desc[idx], reqs[i + s]->buf, reqs[i + s]->count * BLK_SECTOR_SIZE,
+                            data_flags | VRING_DESC_F_NEXT, q->desc[idx].next);
+            }
+            idx = q->desc[idx].next;
+            vq_set_desc(&q->desc[idx], (void *)&slot->status, 1, VRING_DESC_F_WRITE, 0);
+        }
+
+        q->avail->ring[q->avail_idx % q->num] = head;
+        q->avail_idx++;
+        added++;
+
+        q->requests += nseg;
+        q->merged += nseg - 1;
+        i += nseg;
+    }
+
+    if (added) {
+        uint16_t old = q->avail->idx;
+
+        // 描述符写入先于 idx，idx 写入先于读取 avail_event / used->flags
+        smp_mb();
+        q->avail->idx = q->avail_idx;
+        smp_mb();
+
+        bool notify;
+        if (vb->event_idx) {
+            notify = vring_need_event(*VRING_AVAIL_EVENT(q->used, q->num), q->avail_idx, old);
+        } else {
+            notify = !(q->used->flags & VRING_USED_F_NO_NOTIFY);
+        }
+
+        if (notify) {
+            virtio_write32(vb->base, VIRTIO_MMIO_QUEUE_NOTIFY, q->index);
+            q->notifies++;
+        } else {
+            q->suppressed++;
+        }
+        q->batches++;
+    }
+
+    spin_unlock_irqrestore(&q->lock, flags);
+    return i;
+}
+
+// ===============================================================================
+// 回收
+// ===============================================================================
+static int vblk_reap_queue(virtio_blk_t *vb, vblk_queue_t *q, uint64_t flags)
+{
+    int done = 0;
+
+    while (q->last_used != q->used->idx) {
+        smp_rmb();
+        uint16_t     id     = q->used->ring[q->last_used % q->num].id;
+        vblk_slot_t *slot   = &q->slots[id];
+        int          status = slot->status == VIRTIO_BLK_S_OK ? BLK_REQ_OK : BLK_REQ_ERROR;
+
+        for (blk_request_t *r = slot->reqs; r;) {
+            blk_request_t *next = r->next;
+            smp_store_release(&r->status, status);
+            r = next;
+        }
+
+        vq_free_desc(q, id);
+        q->last_used++;
+        q->completed++;
+        done++;
+    }
+
+    // 轮询模式不需要完成中断：used_event 始终落后于已回收位置
+    if (vb->event_idx) {
+        *VRING_USED_EVENT(q->avail, q->num) = q->last_used - 1;
+    }
+
+    spin_unlock_irqrestore(&q->lock, flags);
+    return done;
+}
+
+static int vblk_poll(blkdev_t *dev)
+{
+    virtio_blk_t *vb   = dev->priv;
+    int           self = this_hart_id() % vb->nqueues;
+    int           done = 0;
+
+    vblk_queue_t *q = &vb->queues[self];
+    if (q->last_used != q->used->idx) {
+        done += vblk_reap_queue(vb, q, spin_lock_irqsave(&q->lock));
+    }
+
+    // 其他 hart 提交后不再轮询的请求（预读、异步回写）也要有人回收，
+    // 顺带检查其他队列，拿不到锁说明队列主人正在回收，直接跳过
+    for (int i = 0; i < vb->nqueues; i++) {
+        q = &vb->queues[i];
+        if (i == self || q->last_used == q->used->idx) {
+            continue;
+        }
+        uint64_t flags = local_irq_save();
+        if (spin_trylock(&q->lock)) {
+            done += vblk_reap_queue(vb, q, flags);
+        } else {
+            local_irq_restore(flags);
+        }
+    }
+
+    return done;
+}
+
+static void vblk_dump(blkdev_t *dev)
+{
+    virtio_blk_t *vb = dev->priv;
+
+    logger("    virtio-mmio@0x%llx queues=%d indirect=%s event_idx=%s\n", vb->base, vb->nqueues,
+           vb->indirect ? "yes" : "no", vb->event_idx ? "yes" : "no");
+    logger("    %-4s %10s %8s %8s %9s %10s %10s\n", "vq", "requests", "merged", "batches",
+           "notifies", "suppressed", "completed");
+    for (int i = 0; i < vb->nqueues; i++) {
+        vblk_queue_t *q = &vb->queues[i];
+        logger("    %-4d %10llu %8llu %8llu %9llu %10llu %10llu\n", i, q->requests, q->merged,
+               q->batches, q->notifies, q->suppressed, q->completed);
+    }
+}
+
+static const blkdev_ops_t vblk_ops = {
+    .submit = vblk_submit,
+    .poll   = vblk_poll,
+    .dump   = vblk_dump,
+};
+
+// ===============================================================================
+// 设备初始化
+// ===============================================================================
+static int vblk_setup_queue(virtio_blk_t *vb, int index)
+{
+    vblk_queue_t *q    = &vb->queues[index];
+    uintptr_t     base = vb->base;
+
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_SEL, index);
+    if (virtio_read32(base, VIRTIO_MMIO_QUEUE_READY)) {
+        return -1;
+    }
+
+    uint32_t max = virtio_read32(base, VIRTIO_MMIO_QUEUE_NUM_MAX);
+    if (max == 0) {
+        return -1;
+    }
+    q->index = index;
+    q->num   = max < VBLK_QUEUE_SIZE ? max : VBLK_QUEUE_SIZE;
+
+    // 第一页放描述符表和 avail 环，第二页放 used 环
+    uint8_t *mem = alloc_pages(2);
+    q->slots     = aligned_alloc(16, q->num * sizeof(vblk_slot_t));
+    if (!mem || !q->slots) {
+        return -1;
+    }
+    memset(mem, 0, 2 * PAGE_SIZE);
+    memset(q->slots, 0, q->num * sizeof(vblk_slot_t));
+
+    q->desc  = (vring_desc_t *)mem;
+    q->avail = (vring_avail_t *)(mem + q->num * sizeof(vring_desc_t));
+    q->used  = (vring_used_t *)(mem + PAGE_SIZE);
+
+    for (uint16_t i = 0; i < q->num; i++) {
+        q->desc[i].next = (i + 1) % q->num;
+    }
+    q->free_head = 0;
+    q->num_free  = q->num;
+    q->avail_idx = 0;
+    q->last_used = 0;
+    spin_lock_init(&q->lock, NULL);
+
+    if (vb->event_idx) {
+        *VRING_USED_EVENT(q->avail, q->num) = 0xffff;
+    } else {
+        q->avail->flags = VRING_AVAIL_F_NO_INTERRUPT;
+    }
+
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_NUM, q->num);
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_DESC_LOW, (uintptr_t)q->desc);
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_DESC_HIGH, (uintptr_t)q->desc >> 32);
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_DRIVER_LOW, (uintptr_t)q->avail);
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_DRIVER_HIGH, (uintptr_t)q->avail >> 32);
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_DEVICE_LOW, (uintptr_t)q->used);
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_DEVICE_HIGH, (uintptr_t)q->used >> 32);
+    virtio_write32(base, VIRTIO_MMIO_QUEUE_READY, 1);
+    return 0;
+}
+
+static void vblk_probe(uintptr_t base)
+{
+    if (vblk_count >= VBLK_MAX_DEVICES) {
+        return;
+    }
+    virtio_blk_t *vb = &vblk_devs[vblk_count];
+    vb->base = base;
+
+    // 复位后依次置 ACKNOWLEDGE / DRIVER
+    virtio_write32(base, VIRTIO_MMIO_STATUS, 0);
+    virtio_write32(base, VIRTIO_MMIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    virtio_write32(base, VIRTIO_MMIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    // 特性协商
+    virtio_write32(base, VIRTIO_MMIO_DEVICE_FEATURES_SEL, 0);
+    uint64_t features = virtio_read32(base, VIRTIO_MMIO_DEVICE_FEATURES);
+    virtio_write32(base, VIRTIO_MMIO_DEVICE_FEATURES_SEL, 1);
+    features |= (uint64_t)virtio_read32(base, VIRTIO_MMIO_DEVICE_FEATURES) << 32;
+
+    uint64_t wanted = (1ULL << VIRTIO_F_VERSION_1) | (1ULL << VIRTIO_RING_F_INDIRECT_DESC) |
+                      (1ULL << VIRTIO_RING_F_EVENT_IDX) | (1ULL << VIRTIO_BLK_F_MQ) |
+                      (1ULL << VIRTIO_BLK_F_RO);
+    features &= wanted;
+
+    virtio_write32(base, VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0);
+    virtio_write32(base, VIRTIO_MMIO_DRIVER_FEATURES, (uint32_t)features);
+    virtio_write32(base, VIRTIO_MMIO_DRIVER_FEATURES_SEL, 1);
+    virtio_write32(base, VIRTIO_MMIO_DRIVER_FEATURES, (uint32_t)(features >> 32));
+
+    uint32_t status = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_FEATURES_OK;
+    virtio_write32(base, VIRTIO_MMIO_STATUS, status);
+    if (!(virtio_read32(base, VIRTIO_MMIO_STATUS) & VIRTIO_STATUS_FEATURES_OK)) {
+        logger_error("virtio-blk@0x%llx: feature negotiation failed\n", base);
+        virtio_write32(base, VIRTIO_MMIO_STATUS, VIRTIO_STATUS_FAILED);
+        return;
+    }
+
+    vb->indirect  = !!(features & (1ULL << VIRTIO_RING_F_INDIRECT_DESC));
+    vb->event_idx = !!(features & (1ULL << VIRTIO_RING_F_EVENT_IDX));
+
+    // 读取配置空间
+    uint64_t capacity = virtio_read32(base, VIRTIO_MMIO_CONFIG + VIRTIO_BLK_CFG_CAPACITY) |
+                        ((uint64_t)virtio_read32(base, VIRTIO_MMIO_CONFIG + VIRTIO_BLK_CFG_CAPACITY + 4)
+                         << 32);
+    int nqueues = 1;
+    if (features & (1ULL << VIRTIO_BLK_F_MQ)) {
+        nqueues = *(volatile uint16_t *)(base + VIRTIO_MMIO_CONFIG + VIRTIO_BLK_CFG_NUM_QUEUES);
+        if (nqueues > MAX_HARTS) {
+            nqueues = MAX_HARTS;
+        }
+        if (nqueues < 1) {
+            nqueues = 1;
+        }
+    }
+
+    vb->nqueues = 0;
+    for (int i = 0; i < nqueues; i++) {
+        if (vblk_setup_queue(vb, i) < 0) {
+            break;
+        }
+        vb->nqueues++;
+    }
+    if (vb->nqueues == 0) {
+        logger_error("virtio-blk@0x%llx: queue setup failed\n", base);
+        virtio_write32(base, VIRTIO_MMIO_STATUS, VIRTIO_STATUS_FAILED);
+        return;
+    }
+
+    virtio_write32(base, VIRTIO_MMIO_STATUS, status | VIRTIO_STATUS_DRIVER_OK);
+
+    simple_sprintf(vb->name, "virtio-blk%d", vblk_count);
+    vb->dev.name      = vb->name;
+    vb->dev.capacity  = capacity;
+    vb->dev.read_only = !!(features & (1ULL << VIRTIO_BLK_F_RO));
+    vb->dev.ops       = &vblk_ops;
+    vb->dev.priv      = vb;
+
+    if (blkdev_register(&vb->dev) >= 0) {
+        vblk_count++;
+    }
+}
+
+void virtio_blk_init(void)
+{
+#ifdef VIRTIO_MMIO_BASE
+    for (int i = 0; i < VIRTIO_MMIO_NUM; i++) {
+        uintptr_t base = VIRTIO_MMIO_BASE + i * VIRTIO_MMIO_STRIDE;
+
+        if (virtio_read32(base, VIRTIO_MMIO_MAGIC_VALUE) != VIRTIO_MMIO_MAGIC ||
+            virtio_read32(base, VIRTIO_MMIO_DEVICE_ID) != VIRTIO_DEV_BLK) {
+            continue;
+        }
+        if (virtio_read32(base, VIRTIO_MMIO_VERSION) != 2) {
+            logger_warn("virtio-blk@0x%llx: legacy interface not supported "
+                        "(run QEMU with -global virtio-mmio.force-legacy=false)\n",
+                        base);
+            continue;
+        }
+        vblk_probe(base);
+    }
+#endif
+}
+
+// 轮询方式探测，不依赖中断，可以在任意 hart 上进行
+static int virtio_blk_initcall(void)
+{
+    virtio_blk_init();
+    return 0;
+}
+INITCALL(virtio_blk, INIT_DEVICE, INITCALL_PARALLEL, virtio_blk_initcall);
@@ -12,6 +12,20 @@
 #include "exception.h"
 #include "timer.h"
 #include "lib/logger.h"
+#include "percpu.h"
+#include "mmu.h"
+#include "smp.h"
+#include "fdt.h"
+#include "kasan.h"
+#include "elf.h"
+#include "cpiofs.h"
+#include "exec.h"
+#include "vm.h"
+#include "proc.h"
+#include "bootlog.h"
+#include "initcall.h"
+#include "workqueue.h"
+#include "shell.h"
 
 // ===============================================================================
 // 系统调用处理函数示例
@@ -178,215 +192,247 @@ static void test_exception_handling(void)
 // 交互式命令处理
 // ===============================================================================
 
-// ELF64 程序头结构，用于 musl libc 初始化 TLS
-typedef struct {
-    uint32_t p_type;
-    uint32_t p_flags;
-    uint64_t p_offset;
-    uint64_t p_vaddr;
-    uint64_t p_paddr;
-    uint64_t p_filesz;
-    uint64_t p_memsz;
-    uint64_t p_align;
-} Elf64_Phdr;
-
-// 辅助向量 (Auxiliary Vector) 类型定义
-#define AT_NULL   0
-#define AT_PHDR   3
-#define AT_PHENT  4
-#define AT_PHNUM  5
-#define AT_PAGESZ 6
-#define AT_RANDOM 25
-
 extern uint8_t _user_prog_start[];
 extern uint8_t _user_prog_end[];
 
+// 内嵌程序的程序头（从 readelf -l user/user_prog 获取），作为 AT_PHDR 传给 musl
+static const Elf64_Phdr user_phdrs[] = {
+    { 1, 7, 0x1000, 0x80800000, 0x80800000, 0x19b8, 0x2024, 0x1000 }, // PT_LOAD
+    { 2, 6, 0x2798, 0x80801798, 0x80801798, 0x170, 0x170, 0x8 }       // PT_DYNAMIC
+};
+
 /**
- * 准备用户栈空间，填充 argc, argv, envp 和 auxv
- * musl libc 的入口点 _start 期望栈上存在这些信息
+ * 以进程方式运行内嵌的 user_prog：只拷贝映像本身，bss 和栈在第一次访问时
+ * 由缺页处理分配清零的页，不再预先清零固定大小的区域或分配整块栈
  */
-static uint64_t prepare_user_stack(uintptr_t stack_bottom, size_t stack_size)
-{
-    // 为当前用户程序硬编码程序头信息 (从 readelf -l user/user_prog 获取)
-    static Elf64_Phdr user_phdrs[] = {
-        { 1, 7, 0x1000, 0x80800000, 0x80800000, 0x19b8, 0x2024, 0x1000 }, // PT_LOAD
-        { 2, 6, 0x2798, 0x80801798, 0x80801798, 0x170, 0x170, 0x8 }       // PT_DYNAMIC
-    };
-
-    uint64_t *sp = (uint64_t *)(stack_bottom + stack_size);
-    
-    // RISC-V 栈需要 16 字节对齐
-    sp = (uint64_t *)((uintptr_t)sp & ~0xF);
-
-    // AT_RANDOM 所需的 16 字节随机数
-    static uint8_t random_bytes[16] = {
-        0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0,
-        0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88
-    };
-
-    // 1. 压入辅助向量 (Auxiliary Vector)
-    *(--sp) = 0; *(--sp) = AT_NULL;
-    *(--sp) = (uintptr_t)random_bytes; *(--sp) = AT_RANDOM;
-    *(--sp) = 4096; *(--sp) = AT_PAGESZ;
-    *(--sp) = 2; *(--sp) = AT_PHNUM;
-    *(--sp) = sizeof(Elf64_Phdr); *(--sp) = AT_PHENT;
-    *(--sp) = (uintptr_t)user_phdrs; *(--sp) = AT_PHDR;
-    
-    // 2. 压入环境变量 (envp) - 目前为空
-    *(--sp) = 0; // NULL 终止符
-
-    // 3. 压入参数 (argv)
-    *(--sp) = 0; // NULL 终止符
-    *(--sp) = (uintptr_t)"user_prog"; // argv[0]
-
-    // 4. 压入参数个数 (argc)
-    *(--sp) = 1;
-
-    return (uintptr_t)sp;
-}
-
 static void run_user_prog(void)
 {
-    uint64_t start_addr = 0x80800000;
     size_t size = _user_prog_end - _user_prog_start;
-    
-    logger_info("Loading user program to 0x%llx (size: %d bytes)...\n", start_addr, size);
-    
-    // 1. 清除用户程序区域（包括 BSS 段）
-    // 根据 readelf，MemSiz 略大于 FileSiz，清除 16KB 足够覆盖 BSS
-    memset((void *)start_addr, 0, 0x4000);
 
-    // 2. 拷贝用户程序代码和数据
-    memcpy((void *)start_addr, _user_prog_start, size);
-    
-    // 3. 同步指令缓存 (Instruction Cache Barrier)
-    asm volatile("fence.i" ::: "memory");
-    
-    // 4. 分配并准备用户栈
-    // 为用户程序分配 64KB 栈空间
-    void *user_stack = malloc(64 * 1024);
-    if (!user_stack) {
-        logger_error("Failed to allocate user stack!\n");
+    logger_info("Loading user program to 0x%llx (size: %d bytes)...\n", (uint64_t)USER_BASE, size);
+
+    int pid = proc_spawn_flat("user_prog", _user_prog_start, size, user_phdrs,
+                              sizeof(user_phdrs) / sizeof(user_phdrs[0]));
+    if (pid < 0) {
         return;
     }
-    uint64_t sp = prepare_user_stack((uintptr_t)user_stack, 64 * 1024);
-
-    logger_info("Jumping to user program at 0x%llx with sp=0x%llx...\n", start_addr, sp);
-    
-    // // 5. 切换栈并跳转执行
-    // // musl libc 的 _start 约定 a0 指向栈顶
-    // asm volatile (
-    //     "mv a0, %1\n"
-    //     "mv sp, %1\n"
-    //     "jr %0\n"
-    //     :
-    //     : "r"(start_addr), "r"(sp)
-    //     : "a0", "memory"
-    // );
-    void (*user_main)(void) = (void (*)(void))start_addr;
-    user_main();
-    
-    logger_info("User program returned.\n");
+    int code = proc_run(pid);
+    logger_info("User program exited with code %d\n", code);
 }
 
-static int process_command(const char *cmd)
+static void run_file(int argc, char **argv)
 {
-    if (strcmp(cmd, "help") == 0 || strcmp(cmd, "h") == 0) {
-        uart_puts("Available commands:\r\n");
-        uart_puts("  help, h        - Show this help\r\n");
-        uart_puts("  info, i        - Show system information\r\n");
-        uart_puts("  mem, m         - Show memory statistics\r\n");
-        uart_puts("  test, t        - Run basic tests\r\n");
-        uart_puts("  fp, float      - Test floating point unit\r\n");
-        uart_puts("  syscall, s     - Test system calls\r\n");
-        uart_puts("  exception, e   - Test exception handling\r\n");
-        uart_puts("  run, u         - Run embedded user program\r\n");
-        uart_puts("  reboot, r      - Restart system\r\n");
-        uart_puts("  quit, q        - Enter idle loop\r\n");
-    }
-    else if (strcmp(cmd, "info") == 0 || strcmp(cmd, "i") == 0) {
-        uart_puts("=== System Information ===\r\n");
-        uart_puts("System: RISC-V testos\r\n");
-        uart_puts("Version: 1.0\r\n");
-        // uart_puts("Hart ID: ");
-        // uart_print_hex(CSR_READ(mhartid));
-        // uart_puts("\r\n");
-        uart_puts("SSTATUS: ");
-        uart_print_hex(READ_SSTATUS());
-        uart_puts("\r\n");
-        uart_puts("STVEC: ");
-        uart_print_hex(READ_STVEC());
+    if (!cpiofs_lookup(argv[0])) {
+        uart_puts("run: file not found: ");
+        uart_puts(argv[0]);
         uart_puts("\r\n");
+        return;
     }
-    else if (strcmp(cmd, "mem") == 0 || strcmp(cmd, "m") == 0) {
-        mem_print_stats();
-    }
-    else if (strcmp(cmd, "test") == 0 || strcmp(cmd, "t") == 0) {
-        test_basic_functions();
-    }
-    else if (strcmp(cmd, "fp") == 0 || strcmp(cmd, "float") == 0) {
-        test_floating_point();
-    }
-    else if (strcmp(cmd, "syscall") == 0 || strcmp(cmd, "s") == 0) {
-        test_syscalls();
-    }
-    else if (strcmp(cmd, "exception") == 0 || strcmp(cmd, "e") == 0) {
-        test_exception_handling();
+
+    int pid = proc_spawn(argv[0], argc, (const char *const *)argv);
+    if (pid < 0) {
+        return;
     }
-    else if (strcmp(cmd, "run") == 0 || strcmp(cmd, "u") == 0) {
+    int code = proc_run(pid);
+    logger_info("%s exited with code %d\n", argv[0], code);
+}
+
+// 不带参数时运行内嵌程序，否则第一个参数是根文件系统中的程序名
+static int cmd_run(int argc, char **argv)
+{
+    // SHELL_MAX_ARGS 不超过 EXEC_MAX_ARGS，参数个数不必再检查
+    if (argc == 1) {
         run_user_prog();
+    } else {
+        run_file(argc - 1, argv + 1);
     }
-    else if (strcmp(cmd, "reboot") == 0 || strcmp(cmd, "r") == 0) {
-        uart_puts("Rebooting system...\r\n");
-        // 简单的重启：跳转到启动地址
-        void (*reset_func)(void) = (void (*)(void))__LOAD_ADDR__;
-        reset_func();
-    }
-    else if (strcmp(cmd, "quit") == 0 || strcmp(cmd, "q") == 0) {
-        uart_puts("Entering idle loop. System will wait for interrupts.\r\n");
-        return 0;
-    }
-    else if (strlen(cmd) > 0) {
-        uart_puts("Unknown command: ");
-        uart_puts(cmd);
-        uart_puts("\r\nType 'help' for available commands.\r\n");
-    }
+    return 0;
+}
+SHELL_CMD(run, "[prog args...]", "Run a program from the root filesystem (embedded one if none)",
+          cmd_run);
+SHELL_ALIAS(u, run);
+
+static int cmd_info(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    uart_puts("=== System Information ===\r\n");
+    uart_puts("System: RISC-V testos\r\n");
+    uart_puts("Version: 1.0\r\n");
+    // uart_puts("Hart ID: ");
+    // uart_print_hex(CSR_READ(mhartid));
+    // uart_puts("\r\n");
+    uart_puts("SSTATUS: ");
+    uart_print_hex(READ_SSTATUS());
+    uart_puts("\r\n");
+    uart_puts("STVEC: ");
+    uart_print_hex(READ_STVEC());
+    uart_puts("\r\n");
+    return 0;
+}
+SHELL_CMD(info, NULL, "Show system information", cmd_info);
+SHELL_ALIAS(i, info);
+
+// mem.c 也参与主机测试，它的命令登记在这里
+static int cmd_mem(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    mem_print_stats();
+    return 0;
+}
+SHELL_CMD(mem, NULL, "Show memory statistics", cmd_mem);
+SHELL_ALIAS(m, mem);
+
+static int cmd_test(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    test_basic_functions();
+    return 0;
+}
+SHELL_CMD(test, NULL, "Run basic tests", cmd_test);
+SHELL_ALIAS(t, test);
+
+static int cmd_fp(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    test_floating_point();
+    return 0;
+}
+SHELL_CMD(fp, NULL, "Test floating point unit", cmd_fp);
+SHELL_ALIAS(float, fp);
+
+static int cmd_syscall(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    test_syscalls();
+    return 0;
+}
+SHELL_CMD(syscall, NULL, "Test system calls", cmd_syscall);
+SHELL_ALIAS(s, syscall);
+
+static int cmd_exception(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    test_exception_handling();
+    return 0;
+}
+SHELL_CMD(exception, NULL, "Test exception handling", cmd_exception);
+SHELL_ALIAS(e, exception);
+
+static int cmd_reboot(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    uart_puts("Rebooting system...\r\n");
+    // 简单的重启：跳转到启动地址
+    void (*reset_func)(void) = (void (*)(void))__LOAD_ADDR__;
+    reset_func();
+    return 0;
+}
+SHELL_CMD(reboot, NULL, "Restart system", cmd_reboot);
+SHELL_ALIAS(r, reboot);
 
-    return 1;
+static int cmd_quit(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    uart_puts("Entering idle loop. System will wait for interrupts.\r\n");
+    return SHELL_EXIT;
 }
+SHELL_CMD(quit, NULL, "Enter idle loop", cmd_quit);
+SHELL_ALIAS(q, quit);
+
+// ===============================================================================
+// 内核自身的 initcall
+// ===============================================================================
+
+// 快速启动（启动参数 fastboot=1）：跳过自检，设备与文件系统初始化推迟到 shell 出现之后
+static bool fast_boot;
+
+// 设置 sstatus.FS = 11 (Dirty) 来启用浮点扩展（S-mode），从核在 secondary_main 中各自打开
+static int fpu_initcall(void)
+{
+    uint64_t sstatus_val = READ_SSTATUS();
+    sstatus_val |= (0x3ULL << 13);  // FS bits [14:13] = 11
+    WRITE_SSTATUS(sstatus_val);
+    return 0;
+}
+INITCALL(fpu, INIT_EARLY, 0, fpu_initcall);
+
+// 注册系统调用处理函数（exception_init 会把处理函数表重置为默认值）
+static int syscalls_initcall(void)
+{
+    register_syscall_handler(0, sys_putchar);  // SYS_putchar
+    register_syscall_handler(1, sys_puts);     // SYS_puts
+    return 0;
+}
+INITCALL(syscalls, INIT_LATE, 0, syscalls_initcall);
+
+// 内存分配器自检，直接写串口，只在启动 hart 上运行
+static int selftest_initcall(void)
+{
+    if (!fast_boot) {
+        mem_test();
+    }
+    return 0;
+}
+INITCALL(selftest, INIT_LATE, 0, selftest_initcall);
 
 // ===============================================================================
 // 交互式命令行
 // ===============================================================================
 
+#define SHELL_PROMPT    "testos> "
+
 static void interactive_shell(void)
 {
-    char cmd_buffer[128];
+    char cmd_buffer[SHELL_LINE_MAX];
+    char batch[32];
+    bool first_prompt = true;
     
     uart_puts("\r\n");
     uart_puts("========================================\r\n");
     uart_puts("     RISC-V testos Interactive Shell   \r\n");
     uart_puts("========================================\r\n");
     uart_puts("Type 'help' for available commands.\r\n\r\n");
+
+    // 批处理模式（启动参数 batch=<脚本名>）：不等串口输入先执行脚本，脚本以 quit 结束时
+    // 不进入交互，便于无人值守地在开发板上重复性能实验
+    if (bootarg_get("batch", batch, sizeof(batch))) {
+        first_prompt = false;
+        bootlog_mark("shell");
+        initcall_release();
+        initcall_sync();
+        logger_set_quiet(false);
+        if (shell_run_script(batch) == SHELL_EXIT) {
+            return;
+        }
+        uart_puts("\r\n");
+    }
     
     while (1) {
-        uart_puts("testos> ");
+        uart_puts(SHELL_PROMPT);
+
+        if (first_prompt) {
+            first_prompt = false;
+            bootlog_mark("shell");
+            // 被推迟的 initcall 在从核上后台执行，没有从核时在这里就地执行
+            initcall_release();
+        }
         
         // 读取用户输入
-        int len = uart_gets(cmd_buffer, sizeof(cmd_buffer));
+        int len = shell_readline(SHELL_PROMPT, cmd_buffer, sizeof(cmd_buffer));
         
         if (len > 0) {
-            // 去除尾部空格
-            while (len > 0 && (cmd_buffer[len-1] == ' ' || cmd_buffer[len-1] == '\t')) {
-                cmd_buffer[--len] = '\0';
-            }
-            
-            // 处理命令
-            int ret = process_command(cmd_buffer);
-            if (ret == 0) {
+            // 命令可能用到推迟初始化的模块，先等它们完成；后台初始化期间保持静默以免打乱提示符
+            initcall_sync();
+            logger_set_quiet(false);
+
+            // 切分参数并按命令表分发
+            if (shell_exec(cmd_buffer) == SHELL_EXIT) {
                 break;
             }
         }
+
+        // 等待输入时 shell_readline 也会执行工作队列，这里补上命令执行期间投递的
+        workqueue_run();
         
         uart_puts("\r\n");
     }
@@ -396,66 +442,74 @@ static void interactive_shell(void)
 // 内核主函数
 // ===============================================================================
 
-void kernel_main(uint64_t hart_id)
+void kernel_main(uint64_t hart_id, uintptr_t dtb)
 {
+    // 0. 初始化本 hart 私有数据（异常入口的栈溢出检测依赖它）
+    percpu_init(hart_id);
+    bootlog_init();
+
     // 1. 初始化 UART（早期调试输出）
     // uart_init();
-    
+
+    // 记录设备树地址，后续模块从 /chosen 读取启动参数
+    fdt_init(dtb);
+
+    // KASAN 构建：清零影子内存后开始检查，要赶在第一次堆分配之前
+    kasan_init(dtb);
+
+    // 快速启动：串口输出是启动路径上最慢的部分，静默 info 日志、跳过自检，
+    // 设备和文件系统级别的 initcall 推迟到 shell 出现之后
+    fast_boot = bootarg_get_size("fastboot", 0) != 0;
+    logger_set_quiet(fast_boot);
+    bootlog_mark("fdt");
+
     // 2. 输出启动信息
-    logger("\n");
-    logger_info("==========================================\n");
-    logger_info("    RISC-V testos - Simple OS Kernel     \n");
-    logger_info("==========================================\n");
-    logger_info("Compiled: %s %s\n", __DATE__, __TIME__);
-    logger_info("Hart ID: 0x%llx\n", hart_id);
-    logger("\n");
-    
-    // 3. 初始化浮点运算单元
-    logger_info("Enabling floating-point unit...\n");
-    // 设置 sstatus.FS = 11 (Dirty) 来启用浮点扩展（S-mode）
-    uint64_t sstatus_val = READ_SSTATUS();
-    sstatus_val |= (0x3ULL << 13);  // FS bits [14:13] = 11
-    WRITE_SSTATUS(sstatus_val);
-    
-    // 4. 初始化异常处理系统
-    logger_info("Initializing exception handling...\n");
-    exception_init();
-    
-    // 5. 初始化定时器模块
-    logger_info("Initializing timer...\n");
-    timer_init();
-    timer_enable();
-    
-    // 注册系统调用处理函数
-    register_syscall_handler(0, sys_putchar);  // SYS_putchar
-    register_syscall_handler(1, sys_puts);     // SYS_puts
-    
-    // 6. 初始化内存管理
-    logger_info("Initializing memory management...\n");
-    // mem_init(); // 在启动汇编中已调用
-    
-    // 6. 运行内存测试
-    logger_info("Running memory allocator test...\n");
-    mem_test();
+    if (fast_boot) {
+        logger("RISC-V testos (fast boot, 'bootlog' shows the timeline)\n");
+    } else {
+        logger("\n");
+        logger_info("==========================================\n");
+        logger_info("    RISC-V testos - Simple OS Kernel     \n");
+        logger_info("==========================================\n");
+        logger_info("Compiled: %s %s\n", __DATE__, __TIME__);
+        logger_info("Hart ID: 0x%llx\n", hart_id);
+        logger("\n");
+    }
+
+    // 3. 按级别运行各模块登记的 initcall（见 include/initcall.h）
+    if (fast_boot) {
+        initcall_defer(INIT_DEVICE);
+        initcall_defer(INIT_FS);
+    }
+    for (int level = INIT_EARLY; level < INIT_DEFERRED; level++) {
+        initcall_run(level);
+        bootlog_mark(initcall_level_name(level));
+    }
     
-    // 6. 显示系统准备就绪信息
+    // 4. 显示系统准备就绪信息
     logger_info("\nSystem initialization completed!\n");
     logger_info("Supervisor status: 0x%llx\n", READ_SSTATUS());
 
-
-    interactive_shell();
-    
-    // 7. 启用中断
+    // 5. 启用中断
+    // shell 运行期间也要响应其他 hart 的 IPI，因此在进入 shell 前打开中断，
+    // 每秒一次的运行时间输出推迟到退出 shell 后再打开，避免打断命令行
     logger_info("Before enabling interrupts - SIE: 0x%llx\n", READ_SIE());
     CSR_SET(sstatus, SSTATUS_SIE);
     logger_info("Global interrupts enabled.\n");
     logger_info("After enabling interrupts - SSTATUS: 0x%llx, SIE: 0x%llx\n", READ_SSTATUS(), READ_SIE());
-    
+
+    interactive_shell();
+
+    g_timer_heartbeat = true;
     logger_info("Entering WFI loop...\n");
     
-    // 9. 如果从 shell 返回（不应该发生），进入空闲循环
+    // 6. 如果从 shell 返回（不应该发生），进入空闲循环，空闲时补充预清零页
     logger_warn("Kernel main function returned. Entering idle loop.\n");
     while (1) {
-        WFI();
+        if (workqueue_run()) {
+            continue;
+        }
+        zpool_refill();
+        cpu_idle();
     }
 }
\ No newline at end of file
@@ -6,8 +6,18 @@
 #include "sysreg.h"
 #include "cfg/cfg.h"
 #include "timer.h"
+#include "shell.h"
 #include "lib/logger.h"
 #include "uart.h"
+#include "percpu.h"
+#include "kstack.h"
+#include "kfence.h"
+#include "spinlock.h"
+#include "rcu.h"
+#include "softirq.h"
+#include "proc.h"
+#include "futex.h"
+#include "initcall.h"
 
 
 // 异常上下文结构体，与汇编代码中的布局一致
@@ -20,12 +30,15 @@ typedef struct
     uint64_t stval;    // 异常值 (S-mode)
     uint64_t sstatus;  // Supervisor 状态寄存器
     uint64_t fcsr;     // 浮点控制和状态寄存器
+    uint64_t entry_cycle;  // 进入 trap 时的 cycle 计数
 } trap_frame_t;
 
 // 异常处理函数指针类型
 typedef void (*exception_handler_t)(trap_frame_t *frame);
 
 // 异常处理函数数组
+// 三张表在每次 trap 时读取，由 RCU 保护：读者不加锁，注册新处理函数时
+// 持 handler_lock 发布新指针并等待宽限期，返回后旧处理函数不会再被任何 hart 执行
 static exception_handler_t exception_handlers[16];
 static exception_handler_t interrupt_handlers[16];
 
@@ -40,6 +53,8 @@ typedef uint64_t (*syscall_handler_t)(uint64_t arg0,
 // 系统调用处理函数数组
 static syscall_handler_t syscall_handlers[256];
 
+static spinlock_t handler_lock;
+
 // 前向声明
 void
 print_hex(uint64_t val);
@@ -51,6 +66,8 @@ static void
 default_interrupt_handler(trap_frame_t *frame);
 static void
 ebreak_handler(trap_frame_t *frame);
+static void
+page_fault_handler(trap_frame_t *frame);
 static uint64_t
 default_syscall_handler(uint64_t arg0,
                         uint64_t arg1,
@@ -86,13 +103,21 @@ exception_init(void)
     
     // 注册ebreak异常处理函数
     register_exception_handler(CAUSE_BREAKPOINT, ebreak_handler);
+
+    // 进程地址空间中的按需清零页和写时复制页
+    register_exception_handler(CAUSE_FETCH_PAGE_FAULT, page_fault_handler);
+    register_exception_handler(CAUSE_LOAD_PAGE_FAULT, page_fault_handler);
+    register_exception_handler(CAUSE_STORE_PAGE_FAULT, page_fault_handler);
     
-    // 初始化 sscratch 为当前栈指针，用于异常处理时的栈切换
-    // 在 S-mode 运行时，sscratch 保存内核栈指针
-    uint64_t current_sp;
-    asm volatile("mv %0, sp" : "=r"(current_sp));
-    CSR_WRITE(sscratch, current_sp);
+    // sscratch 已由 percpu_init() 指向本 hart 私有数据，异常入口依赖它，这里不再改写
+}
+
+static int exception_initcall(void)
+{
+    exception_init();
+    return 0;
 }
+INITCALL(exception, INIT_EARLY, 0, exception_initcall);
 
 // ===============================================================================
 // 注册异常处理函数
@@ -101,7 +126,10 @@ void
 register_exception_handler(uint64_t cause, exception_handler_t handler)
 {
     if (cause < 16) {
-        exception_handlers[cause] = handler;
+        spin_lock(&handler_lock);
+        rcu_assign_pointer(exception_handlers[cause], handler);
+        spin_unlock(&handler_lock);
+        synchronize_rcu();
     }
 }
 
@@ -112,7 +140,10 @@ void
 register_interrupt_handler(uint64_t cause, exception_handler_t handler)
 {
     if (cause < 16) {
-        interrupt_handlers[cause] = handler;
+        spin_lock(&handler_lock);
+        rcu_assign_pointer(interrupt_handlers[cause], handler);
+        spin_unlock(&handler_lock);
+        synchronize_rcu();
     }
 }
 
@@ -123,43 +154,252 @@ void
 register_syscall_handler(uint64_t syscall_num, syscall_handler_t handler)
 {
     if (syscall_num < 256) {
-        syscall_handlers[syscall_num] = handler;
+        spin_lock(&handler_lock);
+        rcu_assign_pointer(syscall_handlers[syscall_num], handler);
+        spin_unlock(&handler_lock);
+        synchronize_rcu();
     }
 }
 
-// 调试：输出异常信息
+// 调试：异常计数
 static uint64_t trap_count = 0;
 
+// ===============================================================================
+// 中断嵌套
+// 处理慢速中断源或同步异常时重新打开 SIE，只放行优先级更高的中断源，
+// 保证定时器中断的延迟不受长时间运行的 UART/异常处理函数影响
+// ===============================================================================
+
+// 处理各中断源期间允许嵌套进入的中断（优先级：定时器 > 软件 > 外部）
+static const uint64_t irq_preempt_mask[16] = {
+    [IRQ_S_SOFT] = SIE_STIE,
+    [IRQ_S_EXT]  = SIE_STIE | SIE_SSIE,
+};
+
+// 同步异常（断点、系统调用等）处理期间允许所有中断嵌套
+#define EXC_PREEMPT_MASK    (SIE_STIE | SIE_SSIE | SIE_SEIE)
+
+// 嵌套统计，每个 hart 独立维护，最后一项用于同步异常
+#define NEST_STAT_EXC       16
+
+typedef struct {
+    uint64_t count;         // 触发次数
+    uint64_t nested;        // 在其他 trap 处理过程中到达（发生嵌套）的次数
+    uint64_t max_depth;     // 观察到的最大嵌套深度
+} nest_stat_t;
+
+static nest_stat_t nest_stats[MAX_HARTS][NEST_STAT_EXC + 1];
+
+// 入口到处理函数的延迟统计（cycle），按入口路径区分
+enum {
+    ENTRY_SOFT,             // 软件中断快速入口
+    ENTRY_TIMER,            // 定时器中断快速入口
+    ENTRY_EXT,              // 外部中断快速入口
+    ENTRY_FULL,             // 完整上下文保存路径
+    ENTRY_NR,
+};
+
+typedef struct {
+    uint64_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+} entry_lat_t;
+
+static entry_lat_t entry_lat[MAX_HARTS][ENTRY_NR];
+
+static void
+entry_lat_account(hart_local_t *hl, int path, trap_frame_t *frame)
+{
+    uint64_t     cycles = READ_CYCLE() - frame->entry_cycle;
+    entry_lat_t *lat    = &entry_lat[hl->hart_id][path];
+
+    lat->count++;
+    lat->total += cycles;
+    if (lat->min == 0 || cycles < lat->min) {
+        lat->min = cycles;
+    }
+    if (cycles > lat->max) {
+        lat->max = cycles;
+    }
+}
+
+static void
+nest_account(hart_local_t *hl, uint64_t source)
+{
+    nest_stat_t *st = &nest_stats[hl->hart_id][source];
+
+    st->count++;
+    if (hl->trap_depth > 1) {
+        st->nested++;
+    }
+    if (hl->trap_depth > st->max_depth) {
+        st->max_depth = hl->trap_depth;
+    }
+}
+
+// 打开嵌套：屏蔽 mask 以外的中断源后置位 SIE，返回原 sie
+static uint64_t
+nest_enable(uint64_t mask)
+{
+    uint64_t saved_sie = READ_SIE();
+
+    if (mask) {
+        WRITE_SIE(saved_sie & mask);
+        CSR_SET(sstatus, SSTATUS_SIE);
+    }
+    return saved_sie;
+}
+
+// 关闭嵌套：先清 SIE 再恢复 sie，保证返回汇编时不会被打断
+static void
+nest_disable(uint64_t mask, uint64_t saved_sie)
+{
+    if (mask) {
+        CSR_CLEAR(sstatus, SSTATUS_SIE);
+        WRITE_SIE(saved_sie);
+    }
+}
+
+// ===============================================================================
+// 中断分发
+// ===============================================================================
+static void
+dispatch_interrupt(hart_local_t *hl, trap_frame_t *frame, uint64_t interrupt_cause)
+{
+    if (interrupt_cause < 16) {
+        nest_account(hl, interrupt_cause);
+        uint64_t mask      = irq_preempt_mask[interrupt_cause];
+        uint64_t saved_sie = nest_enable(mask);
+        rcu_dereference(interrupt_handlers[interrupt_cause])(frame);
+        nest_disable(mask, saved_sie);
+    } else {
+        default_interrupt_handler(frame);
+    }
+
+    // 打断的是线程上下文时，中断返回是一个 RCU 静止状态
+    rcu_irq_exit(hl);
+
+    // 最外层中断返回前执行下半部，期间重新打开中断
+    softirq_irq_exit(hl);
+}
+
+// ===============================================================================
+// 快速中断处理函数 - 从向量表的快速入口调用
+// frame 中只有 caller-saved 寄存器和 sepc/scause/sstatus 有效
+// ===============================================================================
+void
+handle_irq_fast(trap_frame_t *frame)
+{
+    uint64_t      interrupt_cause = frame->scause & ~INTERRUPT_BIT;
+    hart_local_t *hl              = this_hart();
+
+    trap_count++;
+
+    switch (interrupt_cause) {
+        case IRQ_S_SOFT:
+            entry_lat_account(hl, ENTRY_SOFT, frame);
+            break;
+        case IRQ_S_TIMER:
+            entry_lat_account(hl, ENTRY_TIMER, frame);
+            break;
+        case IRQ_S_EXT:
+            entry_lat_account(hl, ENTRY_EXT, frame);
+            break;
+        default:
+            break;
+    }
+
+    dispatch_interrupt(hl, frame, interrupt_cause);
+}
+
 // ===============================================================================
 // 主异常处理函数 - 从汇编代码调用
 // ===============================================================================
 void
 handle_exception(trap_frame_t *frame)
 {
-    uint64_t cause = frame->scause;
+    uint64_t      cause = frame->scause;
+    hart_local_t *hl    = this_hart();
+    uint64_t      mask;
+    uint64_t      saved_sie;
 
     trap_count++;
-
-    logger_debug("trap count: %d\n", trap_count);
+    entry_lat_account(hl, ENTRY_FULL, frame);
 
     if (cause & INTERRUPT_BIT) {
         // 处理中断
-        uint64_t interrupt_cause = cause & ~INTERRUPT_BIT;
-        if (interrupt_cause < 16) {
-            interrupt_handlers[interrupt_cause](frame);
-        } else {
-            default_interrupt_handler(frame);
-        }
+        dispatch_interrupt(hl, frame, cause & ~INTERRUPT_BIT);
     } else {
-        // 处理异常
+        // 处理异常：只有被打断的上下文原本开着中断时才允许嵌套
+        nest_account(hl, NEST_STAT_EXC);
+        mask      = (frame->sstatus & SSTATUS_SPIE) ? EXC_PREEMPT_MASK : 0;
+        saved_sie = nest_enable(mask);
         if (cause < 16) {
-            exception_handlers[cause](frame);
+            rcu_dereference(exception_handlers[cause])(frame);
         } else {
             default_exception_handler(frame);
         }
+        nest_disable(mask, saved_sie);
+    }
+}
+
+// ===============================================================================
+// 打印中断嵌套统计
+// ===============================================================================
+void
+irq_dump_stats(void)
+{
+    static const char *const names[NEST_STAT_EXC + 1] = {
+        [IRQ_S_SOFT]    = "S-soft",
+        [IRQ_S_TIMER]   = "S-timer",
+        [IRQ_S_EXT]     = "S-ext",
+        [NEST_STAT_EXC] = "exception",
+    };
+
+    logger("=== Trap Nesting Statistics ===\n");
+    logger("Total traps: %llu\n", trap_count);
+
+    for (int hart = 0; hart < MAX_HARTS; hart++) {
+        for (int src = 0; src <= NEST_STAT_EXC; src++) {
+            nest_stat_t *st = &nest_stats[hart][src];
+            if (st->count == 0) {
+                continue;
+            }
+            logger("  hart %d %-10s count=%llu nested=%llu max_depth=%llu\n", hart,
+                   names[src] ? names[src] : "other", st->count, st->nested, st->max_depth);
+        }
+    }
+
+    static const char *const entry_names[ENTRY_NR] = {
+        [ENTRY_SOFT]  = "soft-stub",
+        [ENTRY_TIMER] = "timer-stub",
+        [ENTRY_EXT]   = "ext-stub",
+        [ENTRY_FULL]  = "full-frame",
+    };
+
+    logger("=== Trap Entry-to-Handler Latency (cycles) ===\n");
+    for (int hart = 0; hart < MAX_HARTS; hart++) {
+        for (int path = 0; path < ENTRY_NR; path++) {
+            entry_lat_t *lat = &entry_lat[hart][path];
+            if (lat->count == 0) {
+                continue;
+            }
+            logger("  hart %d %-10s count=%llu min=%llu avg=%llu max=%llu\n", hart,
+                   entry_names[path], lat->count, lat->min, lat->total / lat->count, lat->max);
+        }
     }
 }
 
+static int
+cmd_irq(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    irq_dump_stats();
+    return 0;
+}
+SHELL_CMD(irq, NULL, "Show trap nesting statistics", cmd_irq);
+
 // ===============================================================================
 // 系统调用处理函数 - 从汇编代码调用
 // ===============================================================================
@@ -178,9 +418,13 @@ handle_syscall(trap_frame_t *frame)
     uint64_t arg5 = frame->x[15];  // a5 = x15
 
     // 调用相应的系统调用处理函数
-    uint64_t ret_val;
-    if (syscall_num < 256 && syscall_handlers[syscall_num]) {
-        ret_val = syscall_handlers[syscall_num](arg0, arg1, arg2, arg3, arg4, arg5);
+    uint64_t          ret_val;
+    syscall_handler_t handler = NULL;
+    if (syscall_num < 256) {
+        handler = rcu_dereference(syscall_handlers[syscall_num]);
+    }
+    if (handler) {
+        ret_val = handler(arg0, arg1, arg2, arg3, arg4, arg5);
     } else {
         ret_val = default_syscall_handler(arg0, arg1, arg2, arg3, arg4, arg5);
     }
@@ -224,6 +468,15 @@ default_exception_handler(trap_frame_t *frame)
         case CAUSE_STORE_ACCESS:
             logger_error("Store access fault\n");
             break;
+        case CAUSE_FETCH_PAGE_FAULT:
+            logger_error("Instruction page fault\n");
+            break;
+        case CAUSE_LOAD_PAGE_FAULT:
+            logger_error("Load page fault\n");
+            break;
+        case CAUSE_STORE_PAGE_FAULT:
+            logger_error("Store page fault\n");
+            break;
         default:
             logger_error("Unknown exception\n");
             break;
@@ -236,6 +489,45 @@ default_exception_handler(trap_frame_t *frame)
     }
 }
 
+static inline bool
+in_user_window(uintptr_t addr)
+{
+    return addr >= USER_BASE && addr < USER_BASE + USER_SIZE;
+}
+
+// ===============================================================================
+// 栈溢出处理函数 - 由异常入口在溢出专用栈上调用
+// ===============================================================================
+void
+handle_stack_overflow(trap_frame_t *frame)
+{
+    uint64_t  sp = frame->x[2];
+    kstack_t *ks = kstack_find(sp);
+
+    // 进程（或替它执行系统调用的内核代码）用完了自己的栈：只结束该进程
+    if (proc_current() && in_user_window(sp)) {
+        logger_error("Stack overflow in process, sp 0x%llx below 0x%llx\n", sp,
+                     this_hart()->stack_limit);
+        proc_kill_fault(sp, frame->sepc);
+    }
+
+    logger_error("*** KERNEL STACK OVERFLOW ***\n");
+    logger_error("Hart: %llu\n", this_hart_id());
+    logger_error("SP: 0x%llx, limit: 0x%llx, irq limit: 0x%llx\n", sp, this_hart()->stack_limit,
+                 this_hart()->irq_stack_limit);
+    if (ks) {
+        logger_error("Stack: %s [0x%llx - 0x%llx)\n", ks->name, ks->base, ks->top);
+    }
+    logger_error("Cause: 0x%llx\n", frame->scause);
+    logger_error("PC: 0x%llx, RA: 0x%llx\n", frame->sepc, frame->x[1]);
+    logger_error("Value: 0x%llx\n", frame->stval);
+
+    logger_error("System halted.\n");
+    while (1) {
+        WFI();
+    }
+}
+
 // ===============================================================================
 // 默认中断处理函数
 // ===============================================================================
@@ -269,18 +561,15 @@ default_interrupt_handler(trap_frame_t *frame)
 // ===============================================================================
 // 直接系统调用处理函数 (从 Gateway 跳转而来)
 // ===============================================================================
-uint64_t
-handle_syscall_direct_c(uint64_t syscall_id,
-                        uint64_t arg1,
-                        uint64_t arg2,
-                        uint64_t arg3,
-                        uint64_t arg4,
-                        uint64_t arg5)
+static uint64_t
+syscall_dispatch(uint64_t syscall_id,
+                 uint64_t arg1,
+                 uint64_t arg2,
+                 uint64_t arg3,
+                 uint64_t arg4,
+                 uint64_t arg5,
+                 uint64_t ret_pc)
 {
-    // 打印调试信息
-    logger_info("[GATEWAY] Syscall ID: %lld, args: 0x%llx, 0x%llx, 0x%llx\n", 
-                syscall_id, arg1, arg2, arg3);
-
     // 处理 Linux 标准系统调用号 (musl 使用)
     switch (syscall_id) {
         case 64: // sys_write(fd, buf, count)
@@ -292,16 +581,62 @@ handle_syscall_direct_c(uint64_t syscall_id,
             }
             return count;
         }
-        case 93: // sys_exit(code)
+        case 93: // sys_exit(code)，只结束当前线程
+            proc_exit_thread((int)arg1);
+        case 94: // sys_exit_group(code)
             logger_info("User program exited with code %lld\n", arg1);
-            while(1); // 简单挂起
+            proc_exit((int)arg1);  // 切回调度循环，不在进程中则原地挂起
+        case 96: // sys_set_tid_address(tidptr)
+            return sys_set_tid_address((uint32_t *)arg1);
+        case 98: // sys_futex(uaddr, op, val, timeout, uaddr2, val3)
+            return sys_futex((uint32_t *)arg1, (int)arg2, (uint32_t)arg3,
+                             (const struct timespec *)arg4);
+        case 124: // sys_sched_yield()
+            return sys_sched_yield();
+        case 135: // sys_rt_sigprocmask(how, set, oldset, size)，没有信号，总是成功
             return 0;
+        case 172: // sys_getpid()
+            return sys_getpid();
+        case 178: // sys_gettid()
+            return sys_gettid();
+        case 215: // sys_munmap(addr, len)
+            return sys_munmap(arg1, arg2);
+        case 220: // sys_clone(flags, stack, ptid, tls, ctid)
+            return sys_clone(arg1, arg2, (int *)arg3, arg4, (uint32_t *)arg5, ret_pc);
+        case 221: // sys_execve(path, argv, envp)
+            return sys_execve((const char *)arg1, (const char *const *)arg2,
+                              (const char *const *)arg3);
+        case 222: // sys_mmap(addr, len, prot, flags, fd, off)，网关只传 5 个参数，off 取 0
+            return sys_mmap(arg1, arg2, (int)arg3, (int)arg4, (int)arg5, 0);
+        case 226: // sys_mprotect(addr, len, prot)
+            return sys_mprotect(arg1, arg2, (int)arg3);
+        case 260: // sys_wait4(pid, status, options, rusage)
+            return sys_wait4((int64_t)arg1, (int *)arg2, (int)arg3);
         default:
+            // 热路径上的系统调用不打印，避免日志掩盖 IPC 测试结果
+            logger_debug("[GATEWAY] Syscall ID: %lld, args: 0x%llx, 0x%llx, 0x%llx\n",
+                         syscall_id, arg1, arg2, arg3);
             // 尝试调用原有的处理逻辑
             return default_syscall_handler(syscall_id, arg1, arg2, arg3, arg4, arg5);
     }
 }
 
+uint64_t
+handle_syscall_direct_c(uint64_t syscall_id,
+                        uint64_t arg1,
+                        uint64_t arg2,
+                        uint64_t arg3,
+                        uint64_t arg4,
+                        uint64_t arg5,
+                        uint64_t ret_pc)
+{
+    uint64_t ret = syscall_dispatch(syscall_id, arg1, arg2, arg3, arg4, arg5, ret_pc);
+
+    // 所在线程组已 exit_group 时不再回到程序
+    proc_check_killed();
+    return ret;
+}
+
 // ===============================================================================
 // 默认系统调用处理函数
 // ===============================================================================
@@ -356,4 +691,30 @@ ebreak_handler(trap_frame_t *frame)
     
     // 跳过 ebreak 指令（4 字节）
     frame->sepc += 4;
-}
\ No newline at end of file
+}
+// ===============================================================================
+// 缺页处理函数 - 进程的按需清零页和写时复制页，进程的非法访问结束该进程，其余按致命异常处理
+// 内核访问 KFENCE 保护页或已释放对象时报告后继续执行
+// 访问错误（CAUSE_LOAD_ACCESS/STORE_ACCESS）来自 PMP 检查，与页表无关，仍是致命异常
+// ===============================================================================
+static void
+page_fault_handler(trap_frame_t *frame)
+{
+    uint64_t access = frame->scause == CAUSE_STORE_PAGE_FAULT ? PTE_W :
+                      frame->scause == CAUSE_LOAD_PAGE_FAULT  ? PTE_R : PTE_X;
+
+    if ((frame->sstatus & SSTATUS_SPP) &&
+        kfence_handle_fault(frame->stval, frame->sepc, access == PTE_W)) {
+        return;
+    }
+    if (proc_page_fault(frame->stval, access)) {
+        return;
+    }
+    // 进程代码出错，或系统调用访问了进程窗口中的非法地址：只结束该进程。
+    // 嵌套在中断处理中的缺页是内核自身的问题，仍按致命异常处理
+    if (proc_current() && this_hart()->trap_depth == 1 &&
+        (in_user_window(frame->sepc) || in_user_window(frame->stval))) {
+        proc_kill_fault(frame->stval, frame->sepc);
+    }
+    default_exception_handler(frame);
+}
@@ -0,0 +1,432 @@
+/*
+ * RISC-V testos 用户程序加载
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "exec.h"
+#include "elf.h"
+#include "mem.h"
+#include "mmu.h"
+#include "vm.h"
+#include "string.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "initcall.h"
+#include "lib/logger.h"
+
+_Static_assert(EXEC_STACK_BOTTOM - PAGE_SIZE >= VM_MMAP_BASE + VM_MMAP_SIZE,
+               "main stack and its guard page must lie above the private mapping area");
+
+// 解码后的一页：物理页与映射权限，pa 为 0 表示段之间的空洞
+typedef struct {
+    uintptr_t pa;
+    uint64_t prot;
+} exec_page_t;
+
+struct exec_image {
+    const cpio_file_t *file;
+    uintptr_t entry;
+    uintptr_t phdr;             // AT_PHDR
+    uint16_t phnum;
+    uintptr_t base;             // 第一页的虚拟地址
+    size_t npages;
+    exec_page_t *pages;
+    size_t direct;              // 直接指向文件系统映像的页
+    size_t templates;           // 预先拼好内容的模板页
+    size_t zero;                // 只有 bss 的页，按需清零
+    uint64_t decode_cycles;
+    uint64_t uses;
+    struct exec_image *next;
+};
+
+// 映像缓存：文件系统只读，解码结果和模板页常驻，不做淘汰
+static exec_image_t *exec_cache;
+static spinlock_t exec_lock;
+
+void exec_init(void)
+{
+    if (mem_reserve(USER_BASE, USER_BASE + USER_SIZE) < 0) {
+        logger_warn("exec: user window 0x%llx already in use by the heap\n", USER_BASE);
+    }
+}
+
+// 趁堆还没怎么用，保留用户程序加载窗口
+static int exec_initcall(void)
+{
+    exec_init();
+    return 0;
+}
+INITCALL(exec, INIT_EARLY, 0, exec_initcall);
+
+// ===============================================================================
+// 映像解码
+// ===============================================================================
+static bool exec_check_header(const Elf64_Ehdr *eh, size_t size)
+{
+    return size >= sizeof(Elf64_Ehdr) && eh->e_ident[0] == ELFMAG0 && eh->e_ident[1] == ELFMAG1 &&
+           eh->e_ident[2] == ELFMAG2 && eh->e_ident[3] == ELFMAG3 &&
+           eh->e_ident[4] == ELFCLASS64 && eh->e_machine == EM_RISCV && eh->e_type == ET_EXEC &&
+           eh->e_phentsize == sizeof(Elf64_Phdr) &&
+           eh->e_phoff + (uint64_t)eh->e_phnum * sizeof(Elf64_Phdr) <= size;
+}
+
+static uint64_t exec_prot(uint32_t p_flags)
+{
+    // RISC-V 不允许只写映射，可写页总是可读
+    uint64_t prot = PTE_R;
+
+    if (p_flags & PF_W) {
+        prot |= PTE_W;
+    }
+    if (p_flags & PF_X) {
+        prot |= PTE_X;
+    }
+    return prot;
+}
+
+static int exec_decode_page(exec_image_t *img, const Elf64_Phdr *phdrs, int phnum, uintptr_t va,
+                            exec_page_t *pg)
+{
+    const uint8_t    *image      = img->file->data;
+    const Elf64_Phdr *only       = NULL;
+    uint64_t          prot       = 0;
+    int               nseg       = 0;
+    bool              file_bytes = false;
+
+    for (int i = 0; i < phnum; i++) {
+        const Elf64_Phdr *ph = &phdrs[i];
+        if (ph->p_type != PT_LOAD || ALIGN_DOWN(ph->p_vaddr, PAGE_SIZE) >= va + PAGE_SIZE ||
+            ALIGN_UP(ph->p_vaddr + ph->p_memsz, PAGE_SIZE) <= va) {
+            continue;
+        }
+        only = ph;
+        prot |= exec_prot(ph->p_flags);
+        nseg++;
+        if (ph->p_vaddr < va + PAGE_SIZE && ph->p_vaddr + ph->p_filesz > va) {
+            file_bytes = true;
+        }
+    }
+    if (nseg == 0) {
+        return 0;
+    }
+
+    if (nseg == 1 && !(prot & PTE_W) && only->p_filesz == only->p_memsz &&
+        ((uintptr_t)image & (PAGE_SIZE - 1)) == 0 &&
+        (only->p_vaddr & (PAGE_SIZE - 1)) == (only->p_offset & (PAGE_SIZE - 1))) {
+        // 只读、无 bss、与映像页对齐且不和其他段共享页：直接映射映像
+        pg->pa = (uintptr_t)image + ALIGN_DOWN(only->p_offset, PAGE_SIZE) +
+                 (va - ALIGN_DOWN(only->p_vaddr, PAGE_SIZE));
+        img->direct++;
+    } else if (!file_bytes) {
+        pg->pa = vm_zero_page();
+        img->zero++;
+    } else {
+        // 把所有落在这一页里的文件内容拼到模板页，其余部分为零
+        uint8_t *page = alloc_pages(1);
+        if (!page) {
+            return -1;
+        }
+        memset(page, 0, PAGE_SIZE);
+        for (int i = 0; i < phnum; i++) {
+            const Elf64_Phdr *ph = &phdrs[i];
+            if (ph->p_type != PT_LOAD) {
+                continue;
+            }
+            uintptr_t s = ph->p_vaddr > va ? ph->p_vaddr : va;
+            uintptr_t e = ph->p_vaddr + ph->p_filesz;
+            if (e > va + PAGE_SIZE) {
+                e = va + PAGE_SIZE;
+            }
+            if (s < e) {
+                memcpy(page + (s - va), image + ph->p_offset + (s - ph->p_vaddr), e - s);
+            }
+        }
+        pg->pa = (uintptr_t)page;
+        img->templates++;
+    }
+
+    // 缓存中的页被所有进程共享，可写页改为写时复制
+    if (prot & PTE_W) {
+        prot = (prot & ~PTE_W) | PTE_COW;
+    }
+    pg->prot = prot | PTE_SHARED;
+    return 0;
+}
+
+static exec_image_t *exec_decode(const cpio_file_t *file)
+{
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *)file->data;
+
+    if (!exec_check_header(eh, file->size)) {
+        logger_error("exec: %s is not a RISC-V ELF executable\n", file->name);
+        return NULL;
+    }
+
+    uint64_t          start = READ_CYCLE();
+    const Elf64_Phdr *phdrs = (const Elf64_Phdr *)(file->data + eh->e_phoff);
+    uintptr_t         phdr  = (uintptr_t)phdrs;
+    uintptr_t         lo    = ~0ULL;
+    uintptr_t         hi    = 0;
+
+    for (int i = 0; i < eh->e_phnum; i++) {
+        const Elf64_Phdr *ph = &phdrs[i];
+        if (ph->p_type == PT_PHDR) {
+            // 有 PT_PHDR 时 musl 用 AT_PHDR - p_vaddr 计算加载基址
+            phdr = ph->p_vaddr;
+        }
+        if (ph->p_type != PT_LOAD) {
+            continue;
+        }
+        if (ph->p_offset + ph->p_filesz > file->size || ph->p_filesz > ph->p_memsz) {
+            logger_error("exec: %s: truncated segment %d\n", file->name, i);
+            return NULL;
+        }
+        if (ALIGN_DOWN(ph->p_vaddr, PAGE_SIZE) < lo) {
+            lo = ALIGN_DOWN(ph->p_vaddr, PAGE_SIZE);
+        }
+        if (ALIGN_UP(ph->p_vaddr + ph->p_memsz, PAGE_SIZE) > hi) {
+            hi = ALIGN_UP(ph->p_vaddr + ph->p_memsz, PAGE_SIZE);
+        }
+    }
+
+    // 映像只能占用共享内存区以下的部分
+    if (hi <= lo || lo < USER_BASE || hi > VM_SHM_BASE) {
+        logger_error("exec: %s: segments 0x%llx-0x%llx outside user window\n", file->name, lo, hi);
+        return NULL;
+    }
+
+    exec_image_t *img = calloc(1, sizeof(exec_image_t));
+    if (!img) {
+        return NULL;
+    }
+    img->file   = file;
+    img->entry  = eh->e_entry;
+    img->phdr   = phdr;
+    img->phnum  = eh->e_phnum;
+    img->base   = lo;
+    img->npages = (hi - lo) / PAGE_SIZE;
+    img->pages  = calloc(img->npages, sizeof(exec_page_t));
+    if (!img->pages) {
+        return NULL;
+    }
+
+    for (size_t n = 0; n < img->npages; n++) {
+        if (exec_decode_page(img, phdrs, eh->e_phnum, lo + n * PAGE_SIZE, &img->pages[n]) < 0) {
+            logger_error("exec: %s: out of memory while decoding\n", file->name);
+            for (size_t k = 0; k < n; k++) {
+                uintptr_t pa = img->pages[k].pa;
+                if (pa && pa != vm_zero_page() && (pa < (uintptr_t)file->data ||
+                                                   pa >= (uintptr_t)file->data + file->size)) {
+                    free_pages((void *)pa, 1);
+                }
+            }
+            return NULL;
+        }
+    }
+
+    // 模板页可能含代码，同步指令缓存
+    asm volatile("fence.i" ::: "memory");
+    img->decode_cycles = READ_CYCLE() - start;
+    return img;
+}
+
+exec_image_t *exec_image_get(const cpio_file_t *file)
+{
+    exec_image_t *img;
+
+    spin_lock(&exec_lock);
+    for (img = exec_cache; img; img = img->next) {
+        if (img->file == file) {
+            break;
+        }
+    }
+    if (!img) {
+        img = exec_decode(file);
+        if (img) {
+            img->next  = exec_cache;
+            exec_cache = img;
+            logger_info("exec: cached %s: %llu pages (%llu direct, %llu template, %llu zero), "
+                        "%llu cycles\n", file->name, img->npages, img->direct, img->templates,
+                        img->zero, img->decode_cycles);
+        }
+    }
+    spin_unlock(&exec_lock);
+    return img;
+}
+
+// ===============================================================================
+// 用户栈
+// ===============================================================================
+
+/**
+ * 在栈顶页中填充 argv 字符串、argc, argv, envp 和 auxv
+ * musl libc 的入口点 _start 期望栈上存在这些信息
+ * top 是栈顶页的内核地址，返回值和栈上的指针都是用户窗口内的地址
+ */
+static int exec_setup_stack(uintptr_t entry, uintptr_t phdr, int phnum, uint8_t *top, int argc,
+                            const char *const argv[], uintptr_t *user_sp)
+{
+    uint8_t  *end = top + PAGE_SIZE;
+    uint8_t  *p   = end;
+    uintptr_t uargv[EXEC_MAX_ARGS];
+    size_t    total = 0;
+
+#define USER_VA(kp) (EXEC_STACK_TOP - (uintptr_t)(end - (uint8_t *)(kp)))
+
+    for (int i = argc - 1; i >= 0; i--) {
+        size_t len = strlen(argv[i]) + 1;
+        total += len;
+        if (total > EXEC_MAX_ARGLEN) {
+            return -1;
+        }
+        p -= len;
+        memcpy(p, argv[i], len);
+        uargv[i] = USER_VA(p);
+    }
+
+    uint64_t *sp = (uint64_t *)ALIGN_DOWN((uintptr_t)p, 16);
+
+    // AT_RANDOM 所需的 16 字节随机数
+    sp -= 2;
+    sp[0] = READ_TIME() * 0x9e3779b97f4a7c15ULL;
+    sp[1] = READ_CYCLE() ^ (uintptr_t)sp;
+    uintptr_t random = USER_VA(sp);
+
+    // 下面共压入 argc + 17 项（auxv 7 对、envp 1、argv 结束 1、argc 1），
+    // 项数为奇数时先补一项，保证 argc 处 16 字节对齐
+    if ((argc + 17) & 1) {
+        *(--sp) = 0;
+    }
+    *(--sp) = 0;                    *(--sp) = AT_NULL;
+    *(--sp) = random;               *(--sp) = AT_RANDOM;
+    *(--sp) = entry;                *(--sp) = AT_ENTRY;
+    *(--sp) = PAGE_SIZE;            *(--sp) = AT_PAGESZ;
+    *(--sp) = phnum;                *(--sp) = AT_PHNUM;
+    *(--sp) = sizeof(Elf64_Phdr);   *(--sp) = AT_PHENT;
+    *(--sp) = phdr;                 *(--sp) = AT_PHDR;
+
+    *(--sp) = 0;                    // envp 结束
+    *(--sp) = 0;                    // argv 结束
+    for (int i = argc - 1; i >= 0; i--) {
+        *(--sp) = uargv[i];
+    }
+    *(--sp) = argc;
+
+    *user_sp = USER_VA(sp);
+#undef USER_VA
+    return 0;
+}
+
+// ===============================================================================
+// 建立地址空间
+// ===============================================================================
+void *exec_map_stack(vm_space_t *vm)
+{
+    // 栈顶页放参数，其余栈页第一次访问时才分配
+    uint8_t *top = vm_alloc_page(vm, EXEC_STACK_TOP - PAGE_SIZE, PTE_R | PTE_W);
+    if (!top || vm_map_demand(vm, EXEC_STACK_BOTTOM, EXEC_STACK_PAGES - 1, PTE_R | PTE_W) < 0) {
+        return NULL;
+    }
+    return top;
+}
+
+int exec_load(vm_space_t *vm, exec_image_t *img, int argc, const char *const argv[],
+              uintptr_t *entry, uintptr_t *sp)
+{
+    if (argc < 0 || argc > EXEC_MAX_ARGS || vm_create(vm) < 0) {
+        return -1;
+    }
+
+    // 映像页全部来自缓存，这里只写页表；只有 bss 的页不共享零页，第一次访问时分配
+    for (size_t n = 0; n < img->npages; n++) {
+        exec_page_t *pg  = &img->pages[n];
+        uintptr_t    va  = img->base + n * PAGE_SIZE;
+        int          ret = 0;
+
+        if (pg->pa == vm_zero_page()) {
+            ret = vm_map_demand(vm, va, 1, pg->prot);
+        } else if (pg->pa) {
+            ret = vm_map(vm, va, pg->pa, pg->prot);
+        }
+        if (ret < 0) {
+            goto fail;
+        }
+    }
+
+    uint8_t *top = exec_map_stack(vm);
+    if (!top || exec_setup_stack(img->entry, img->phdr, img->phnum, top, argc, argv, sp) < 0) {
+        goto fail;
+    }
+
+    *entry = img->entry;
+    img->uses++;
+    return 0;
+
+fail:
+    vm_destroy(vm);
+    return -1;
+}
+
+int exec_load_flat(vm_space_t *vm, const void *image, size_t size, const Elf64_Phdr *phdr,
+                   int phnum, int argc, const char *const argv[], uintptr_t *sp)
+{
+    size_t npages = ALIGN_UP(size, PAGE_SIZE) / PAGE_SIZE;
+
+    if (argc < 0 || argc > EXEC_MAX_ARGS || npages == 0 || npages > EXEC_FLAT_PAGES ||
+        vm_create(vm) < 0) {
+        return -1;
+    }
+
+    // 没有段信息，整个映像私有可写可执行；其后直到 L1 表项末尾都作为 bss 按需清零
+    for (size_t n = 0; n < npages; n++) {
+        size_t   off  = n * PAGE_SIZE;
+        uint8_t *page = vm_alloc_page(vm, USER_BASE + off, PTE_R | PTE_W | PTE_X);
+        if (!page) {
+            goto fail;
+        }
+        memcpy(page, (const uint8_t *)image + off, size - off < PAGE_SIZE ? size - off : PAGE_SIZE);
+    }
+    if (vm_map_demand(vm, USER_BASE + npages * PAGE_SIZE, EXEC_FLAT_PAGES - npages,
+                      PTE_R | PTE_W | PTE_X) < 0) {
+        goto fail;
+    }
+    asm volatile("fence.i" ::: "memory");
+
+    uint8_t *top = exec_map_stack(vm);
+    if (!top || exec_setup_stack(USER_BASE, (uintptr_t)phdr, phnum, top, argc, argv, sp) < 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    vm_destroy(vm);
+    return -1;
+}
+
+void exec_jump(uintptr_t entry, uintptr_t sp, uintptr_t arg, void (*ret)(int))
+{
+    asm volatile("mv sp, %1\n"
+                 "mv a0, %2\n"
+                 "mv ra, %3\n"
+                 "jr %0\n"
+                 :
+                 : "r"(entry), "r"(sp), "r"(arg), "r"(ret)
+                 : "memory");
+    __builtin_unreachable();
+}
+
+void exec_dump_cache(void)
+{
+    logger("=== Program Image Cache ===\n");
+    if (!exec_cache) {
+        logger("(empty)\n");
+        return;
+    }
+    logger("%-16s %6s %6s %8s %6s %10s %6s\n", "name", "pages", "direct", "template", "zero",
+           "decode", "uses");
+    for (exec_image_t *img = exec_cache; img; img = img->next) {
+        logger("%-16s %6llu %6llu %8llu %6llu %10llu %6llu\n", img->file->name, img->npages,
+               img->direct, img->templates, img->zero, img->decode_cycles, img->uses);
+    }
+}
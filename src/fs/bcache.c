@@ -0,0 +1,704 @@
+/*
+ * RISC-V testos 块缓冲缓存
+ */
+
+#include "types.h"
+#include "bcache.h"
+#include "blkdev.h"
+#include "mem.h"
+#include "string.h"
+#include "atomic.h"
+#include "softirq.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "fdt.h"
+#include "initcall.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+#define BCACHE_MIN_BLOCKS       64
+#define BCACHE_COLD_PCT         25                  // 冷队列目标占比，超过时优先淘汰冷块
+#define BCACHE_RA_MIN           4                   // 初始预读窗口（块）
+#define BCACHE_RA_MAX           32                  // 最大预读窗口（块）
+#define BCACHE_WB_BATCH         64                  // 每轮最多回写的块数
+#define BCACHE_WB_INTERVAL      TIMER_FREQUENCY_HZ  // 回写周期（tick），即 1 秒
+
+typedef struct {
+    buf_t *head;
+    buf_t *tail;
+    size_t len;
+} buf_list_t;
+
+// 每个设备的顺序预读状态
+typedef struct {
+    uint64_t last;          // 上一次访问的块
+    uint64_t next;          // 下一个尚未预读的块
+    uint32_t window;        // 当前窗口，0 表示未识别为顺序访问
+} ra_state_t;
+
+typedef struct {
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t ra_blocks;     // 预读发起的块数
+    uint64_t ra_hits;       // 预读块被访问
+    uint64_t ra_wasted;     // 预读块未被访问就被淘汰
+    uint64_t promotions;    // 冷 -> 热
+    uint64_t evict_cold;
+    uint64_t evict_hot;
+    uint64_t nobuf;         // 没有可淘汰的块
+    uint64_t wb_rounds;
+    uint64_t wb_blocks;
+    uint64_t wb_extents;    // 排序后连续块段数，即合并后的请求数
+    uint64_t wb_errors;
+} bcache_stats_t;
+
+static struct {
+    buf_t *bufs;
+    size_t nbufs;
+    buf_t **hash;
+    uint32_t hash_bits;
+    buf_list_t cold;
+    buf_list_t hot;
+    size_t cold_target;
+    volatile size_t ndirty;
+    buf_t *wb[BCACHE_WB_BATCH];     // 在途回写
+    volatile int wb_count;
+    uint32_t wb_ticks;
+    ra_state_t ra[BLK_MAX_DEVICES];
+    bcache_stats_t stats;
+} bc;
+
+// 定时器中断中也会访问，使用 irqsave
+static spinlock_t  bcache_lock;
+static lock_stat_t bcache_lock_stat;
+
+// ===============================================================================
+// 队列与哈希表
+// ===============================================================================
+static void list_del(buf_list_t *l, buf_t *b)
+{
+    if (b->prev) {
+        b->prev->next = b->next;
+    } else {
+        l->head = b->next;
+    }
+    if (b->next) {
+        b->next->prev = b->prev;
+    } else {
+        l->tail = b->prev;
+    }
+    b->prev = b->next = NULL;
+    l->len--;
+}
+
+static void list_push_head(buf_list_t *l, buf_t *b)
+{
+    b->prev = NULL;
+    b->next = l->head;
+    if (l->head) {
+        l->head->prev = b;
+    } else {
+        l->tail = b;
+    }
+    l->head = b;
+    l->len++;
+}
+
+static inline buf_list_t *bc_list_of(buf_t *b)
+{
+    return (b->flags & B_HOT) ? &bc.hot : &bc.cold;
+}
+
+static inline uint32_t bc_hash(blkdev_t *dev, uint64_t block)
+{
+    return (uint32_t)(((block << 3) ^ dev->id) * 0x9e3779b97f4a7c15ULL >> (64 - bc.hash_bits));
+}
+
+static buf_t *bc_lookup(blkdev_t *dev, uint64_t block)
+{
+    for (buf_t *b = bc.hash[bc_hash(dev, block)]; b; b = b->hnext) {
+        if (b->dev == dev && b->block == block) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+static void bc_hash_remove(buf_t *b)
+{
+    buf_t **pp = &bc.hash[bc_hash(b->dev, b->block)];
+
+    while (*pp != b) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = b->hnext;
+    b->hnext = NULL;
+}
+
+// ===============================================================================
+// 替换策略
+// ===============================================================================
+
+// 读请求完成后更新状态（需持有锁）
+static void bc_settle(buf_t *b)
+{
+    if ((b->flags & B_BUSY) && b->req.status != BLK_REQ_PENDING) {
+        b->flags &= ~B_BUSY;
+        if (b->req.status == BLK_REQ_OK) {
+            b->flags |= B_VALID;
+        }
+    }
+}
+
+static inline bool bc_evictable(buf_t *b)
+{
+    bc_settle(b);
+    return b->refcnt == 0 && !(b->flags & (B_BUSY | B_DIRTY | B_WRITEBACK));
+}
+
+// 冷队列超过目标长度时先淘汰冷块，否则先淘汰热块
+static buf_t *bc_pick_victim(void)
+{
+    bool cold_first = bc.cold.len > bc.cold_target || bc.hot.len == 0;
+
+    for (int pass = 0; pass < 2; pass++) {
+        buf_list_t *l = (cold_first == (pass == 0)) ? &bc.cold : &bc.hot;
+        for (buf_t *b = l->tail; b; b = b->prev) {
+            if (bc_evictable(b)) {
+                return b;
+            }
+        }
+    }
+    return NULL;
+}
+
+// 把淘汰出来的块重新用于 (dev, block)，放到冷队列头部，发起读请求前调用
+static void bc_reuse(buf_t *b, blkdev_t *dev, uint64_t block)
+{
+    if (b->dev) {
+        if (b->flags & B_HOT) {
+            bc.stats.evict_hot++;
+        } else {
+            bc.stats.evict_cold++;
+        }
+        if (b->flags & B_READAHEAD) {
+            bc.stats.ra_wasted++;
+        }
+        bc_hash_remove(b);
+    }
+    list_del(bc_list_of(b), b);
+
+    b->dev   = dev;
+    b->block = block;
+    b->flags = B_BUSY;
+
+    uint32_t h  = bc_hash(dev, block);
+    b->hnext    = bc.hash[h];
+    bc.hash[h]  = b;
+    list_push_head(&bc.cold, b);
+
+    b->req.sector = block * BCACHE_BLOCK_SECTORS;
+    b->req.count  = BCACHE_BLOCK_SECTORS;
+    b->req.write  = false;
+    b->req.buf    = b->data;
+    b->req.status = BLK_REQ_PENDING;
+}
+
+// 命中时调整队列位置：第二次访问提升到热队列
+static void bc_touch(buf_t *b)
+{
+    if (b->flags & B_READAHEAD) {
+        // 预读块的第一次真正访问
+        b->flags &= ~B_READAHEAD;
+        bc.stats.ra_hits++;
+        list_del(&bc.cold, b);
+        list_push_head(&bc.cold, b);
+    } else if (b->flags & B_HOT) {
+        list_del(&bc.hot, b);
+        list_push_head(&bc.hot, b);
+    } else {
+        list_del(&bc.cold, b);
+        b->flags |= B_HOT;
+        list_push_head(&bc.hot, b);
+        bc.stats.promotions++;
+    }
+}
+
+// ===============================================================================
+// 预读
+// ===============================================================================
+
+// 连续访问时窗口从 BCACHE_RA_MIN 开始翻倍，已预读部分消耗过半时再补齐一个窗口，
+// 读请求与预读请求一起提交，驱动会把相邻块合并成一个请求
+static int bc_readahead(blkdev_t *dev, uint64_t block, blk_request_t **reqs)
+{
+    ra_state_t *ra      = &bc.ra[dev->id];
+    uint64_t    nblocks = dev->capacity / BCACHE_BLOCK_SECTORS;
+    int         n       = 0;
+
+    if (block == ra->last + 1) {
+        ra->window = ra->window ? ra->window * 2 : BCACHE_RA_MIN;
+        if (ra->window > BCACHE_RA_MAX) {
+            ra->window = BCACHE_RA_MAX;
+        }
+    } else if (block != ra->last) {
+        ra->window = 0;
+        ra->next   = block + 1;
+    }
+    ra->last = block;
+
+    if (ra->window == 0) {
+        return 0;
+    }
+    if (ra->next <= block) {
+        ra->next = block + 1;
+    }
+    if (ra->next > block + ra->window / 2) {
+        return 0;
+    }
+
+    uint64_t end = block + 1 + ra->window;
+    if (end > nblocks) {
+        end = nblocks;
+    }
+    while (ra->next < end && n < BCACHE_RA_MAX) {
+        if (!bc_lookup(dev, ra->next)) {
+            buf_t *b = bc_pick_victim();
+            if (!b) {
+                break;
+            }
+            bc_reuse(b, dev, ra->next);
+            b->flags |= B_READAHEAD;
+            reqs[n++] = &b->req;
+            bc.stats.ra_blocks++;
+        }
+        ra->next++;
+    }
+    return n;
+}
+
+// ===============================================================================
+// 读取与释放
+// ===============================================================================
+buf_t *bread(blkdev_t *dev, uint64_t block)
+{
+    blk_request_t *reqs[1 + BCACHE_RA_MAX];
+    int            n = 0;
+
+    if (bc.nbufs == 0 || block >= dev->capacity / BCACHE_BLOCK_SECTORS) {
+        return NULL;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+
+    bc.stats.lookups++;
+    buf_t *b = bc_lookup(dev, block);
+    if (b) {
+        bc.stats.hits++;
+        b->refcnt++;
+        bc_touch(b);
+        bc_settle(b);
+        if (!(b->flags & (B_VALID | B_BUSY))) {
+            // 之前的读请求失败，重新读
+            b->flags |= B_BUSY;
+            b->req.status = BLK_REQ_PENDING;
+            reqs[n++]     = &b->req;
+        }
+    } else {
+        bc.stats.misses++;
+        b = bc_pick_victim();
+        if (!b) {
+            bc.stats.nobuf++;
+            spin_unlock_irqrestore(&bcache_lock, flags);
+            return NULL;
+        }
+        bc_reuse(b, dev, block);
+        b->refcnt = 1;
+        reqs[n++] = &b->req;
+    }
+    n += bc_readahead(dev, block, &reqs[n]);
+
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    if (n) {
+        blk_submit(dev, reqs, n);
+    }
+
+    if (b->flags & B_BUSY) {
+        blk_wait(dev, &b->req);
+        flags = spin_lock_irqsave(&bcache_lock);
+        bc_settle(b);
+        spin_unlock_irqrestore(&bcache_lock, flags);
+    }
+
+    if (!(b->flags & B_VALID)) {
+        brelse(b);
+        return NULL;
+    }
+    return b;
+}
+
+void brelse(buf_t *b)
+{
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+    b->refcnt--;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+void bdirty(buf_t *b)
+{
+    if (b->dev->read_only) {
+        logger_warn("bcache: %s is read-only, block %llu not written\n", b->dev->name, b->block);
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+    if (!(b->flags & B_DIRTY)) {
+        b->flags |= B_DIRTY;
+        bc.ndirty++;
+    }
+    spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+// ===============================================================================
+// 回写
+// ===============================================================================
+
+// 回收在途回写（需持有锁），全部完成返回 true
+static bool bc_reap_writeback(void)
+{
+    for (int i = 0; i < bc.wb_count; i++) {
+        if (bc.wb[i]->req.status == BLK_REQ_PENDING) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < bc.wb_count; i++) {
+        buf_t *b = bc.wb[i];
+        b->flags &= ~B_WRITEBACK;
+        b->refcnt--;
+        if (b->req.status != BLK_REQ_OK) {
+            // 写失败的块不再重试，避免 bsync 永远等不到结束
+            logger_error("bcache: write-back of %s block %llu failed\n", b->dev->name, b->block);
+            bc.stats.wb_errors++;
+        }
+    }
+    bc.wb_count = 0;
+    return true;
+}
+
+static inline bool bc_before(buf_t *a, buf_t *b)
+{
+    return a->dev->id < b->dev->id || (a->dev == b->dev && a->block < b->block);
+}
+
+// 收集一批脏块按 (设备, 块号) 排序后提交（需持有锁）
+static void bc_start_writeback(void)
+{
+    blk_request_t *reqs[BCACHE_WB_BATCH];
+    int            n = 0;
+
+    for (size_t i = 0; i < bc.nbufs && n < BCACHE_WB_BATCH; i++) {
+        buf_t *b = &bc.bufs[i];
+        if ((b->flags & (B_DIRTY | B_WRITEBACK)) != B_DIRTY) {
+            continue;
+        }
+        b->flags = (b->flags & ~B_DIRTY) | B_WRITEBACK;
+        b->refcnt++;
+        bc.ndirty--;
+
+        b->req.sector = b->block * BCACHE_BLOCK_SECTORS;
+        b->req.count  = BCACHE_BLOCK_SECTORS;
+        b->req.write  = true;
+        b->req.buf    = b->data;
+
+        int j = n++;
+        while (j > 0 && bc_before(b, bc.wb[j - 1])) {
+            bc.wb[j] = bc.wb[j - 1];
+            j--;
+        }
+        bc.wb[j] = b;
+    }
+    bc.wb_count = n;
+    if (n == 0) {
+        return;
+    }
+
+    bc.stats.wb_rounds++;
+    bc.stats.wb_blocks += n;
+
+    // 按设备分组提交
+    for (int i = 0; i < n;) {
+        blkdev_t *dev = bc.wb[i]->dev;
+        int       cnt = 0;
+
+        for (; i < n && bc.wb[i]->dev == dev; i++) {
+            if (cnt == 0 || bc.wb[i]->block != bc.wb[i - 1]->block + 1) {
+                bc.stats.wb_extents++;
+            }
+            reqs[cnt++] = &bc.wb[i]->req;
+        }
+        blk_submit(dev, reqs, cnt);
+    }
+}
+
+static void bc_poll_devices(void)
+{
+    blkdev_t *dev;
+
+    for (int i = 0; (dev = blkdev_get(i)) != NULL; i++) {
+        dev->ops->poll(dev);
+    }
+}
+
+void bcache_tick(void)
+{
+    if (bc.wb_count || bc.ndirty) {
+        raise_softirq(SOFTIRQ_BLOCK);
+    }
+}
+
+// 轮询设备完成队列、回收回写，每个 tick 挂起一次
+static void bcache_softirq(void)
+{
+    if (bc.wb_count) {
+        bc_poll_devices();
+    }
+
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+    if (bc_reap_writeback() && bc.ndirty && ++bc.wb_ticks >= BCACHE_WB_INTERVAL) {
+        bc.wb_ticks = 0;
+        bc_start_writeback();
+    }
+    spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+int bsync(void)
+{
+    uint64_t errors = bc.stats.wb_errors;
+
+    for (;;) {
+        bc_poll_devices();
+
+        uint64_t flags = spin_lock_irqsave(&bcache_lock);
+        bool     done  = false;
+        if (bc_reap_writeback()) {
+            if (bc.ndirty == 0) {
+                done = true;
+            } else {
+                bc_start_writeback();
+            }
+        }
+        spin_unlock_irqrestore(&bcache_lock, flags);
+
+        if (done) {
+            break;
+        }
+        cpu_relax();
+    }
+
+    return bc.stats.wb_errors == errors ? 0 : -1;
+}
+
+static int cmd_sync(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    if (bsync() < 0) {
+        logger("sync: some blocks failed to write back\n");
+        return -1;
+    }
+    return 0;
+}
+SHELL_CMD(sync, NULL, "Write back dirty cached blocks", cmd_sync);
+
+// ===============================================================================
+// 初始化
+// ===============================================================================
+void bcache_init(size_t size)
+{
+    size_t nbufs = size / BCACHE_BLOCK_SIZE;
+
+    if (nbufs < BCACHE_MIN_BLOCKS) {
+        nbufs = BCACHE_MIN_BLOCKS;
+    }
+
+    bc.hash_bits = 1;
+    while ((1UL << bc.hash_bits) < nbufs) {
+        bc.hash_bits++;
+    }
+
+    uint8_t *data = alloc_pages(nbufs);
+    bc.bufs       = calloc(nbufs, sizeof(buf_t));
+    bc.hash       = calloc(1UL << bc.hash_bits, sizeof(buf_t *));
+    if (!data || !bc.bufs || !bc.hash) {
+        logger_error("bcache: out of memory for %llu blocks\n", nbufs);
+        return;
+    }
+
+    spin_lock_init(&bcache_lock, &bcache_lock_stat);
+    lock_stat_register(&bcache_lock_stat, "bcache");
+
+    // 空闲块没有设备，挂在冷队列上最先被选中
+    for (size_t i = 0; i < nbufs; i++) {
+        bc.bufs[i].data = data + i * BCACHE_BLOCK_SIZE;
+        list_push_head(&bc.cold, &bc.bufs[i]);
+    }
+    bc.cold_target = nbufs * BCACHE_COLD_PCT / 100;
+    bc.nbufs       = nbufs;
+
+    logger_info("bcache: %llu blocks (%llu KB), %u hash buckets\n", nbufs,
+                nbufs * BCACHE_BLOCK_SIZE / 1024, 1U << bc.hash_bits);
+}
+
+// 大小可由启动参数 bcache=<size> 指定
+static int bcache_initcall(void)
+{
+    bcache_init(bootarg_get_size("bcache", BCACHE_DEFAULT_SIZE));
+    open_softirq(SOFTIRQ_BLOCK, bcache_softirq, "block");
+    return 0;
+}
+INITCALL(bcache, INIT_DEVICE, INITCALL_PARALLEL, bcache_initcall);
+
+// ===============================================================================
+// 统计与测试
+// ===============================================================================
+static uint64_t pct(uint64_t part, uint64_t total)
+{
+    return total ? part * 100 / total : 0;
+}
+
+void bcache_dump_stats(void)
+{
+    bcache_stats_t *s = &bc.stats;
+
+    logger("=== Buffer Cache ===\n");
+    if (bc.nbufs == 0) {
+        logger("  (not initialized)\n");
+        return;
+    }
+    logger("  Blocks: %llu x %d KB, cold %llu (target %llu), hot %llu, dirty %llu\n", bc.nbufs,
+           BCACHE_BLOCK_SIZE / 1024, bc.cold.len, bc.cold_target, bc.hot.len, bc.ndirty);
+    logger("  Lookups: %llu, hits %llu (%llu%%), misses %llu, promotions %llu\n", s->lookups,
+           s->hits, pct(s->hits, s->lookups), s->misses, s->promotions);
+    logger("  Read-ahead: %llu blocks, used %llu (%llu%%), wasted %llu\n", s->ra_blocks, s->ra_hits,
+           pct(s->ra_hits, s->ra_blocks), s->ra_wasted);
+    logger("  Evictions: cold %llu, hot %llu, no buffer %llu\n", s->evict_cold, s->evict_hot,
+           s->nobuf);
+    logger("  Write-back: %llu rounds, %llu blocks in %llu extents, %llu errors\n", s->wb_rounds,
+           s->wb_blocks, s->wb_extents, s->wb_errors);
+}
+
+static int cmd_bcache(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    bcache_dump_stats();
+    return 0;
+}
+SHELL_CMD(bcache, NULL, "Show buffer cache statistics", cmd_bcache);
+
+// 顺序读取 [start, start + count) 中的块，返回读取失败的块数
+static uint64_t bench_read(blkdev_t *dev, uint64_t start, uint64_t count, bool dirty)
+{
+    uint64_t failed = 0;
+
+    for (uint64_t blk = start; blk < start + count; blk++) {
+        buf_t *b = bread(dev, blk);
+        if (!b) {
+            failed++;
+            continue;
+        }
+        if (dirty) {
+            b->data[0]++;
+            bdirty(b);
+        }
+        brelse(b);
+    }
+    return failed;
+}
+
+static void bench_report(const char *name, bcache_stats_t *before, uint64_t ticks, uint64_t failed)
+{
+    bcache_stats_t *s       = &bc.stats;
+    uint64_t        lookups = s->lookups - before->lookups;
+    uint64_t        hits    = s->hits - before->hits;
+    uint64_t        ra      = s->ra_blocks - before->ra_blocks;
+    uint64_t        ra_hits = s->ra_hits - before->ra_hits;
+
+    logger("  %-12s %8llu %8llu %6llu%% %8llu %8llu %10llu %s\n", name, lookups, hits,
+           pct(hits, lookups), ra, ra_hits, ticks * 1000000 / timer_get_frequency(),
+           failed ? "FAIL" : "ok");
+    *before = *s;
+}
+
+void bcache_bench(void)
+{
+    blkdev_t      *dev = blkdev_get(0);
+    bcache_stats_t before;
+    uint64_t       start;
+    uint64_t       failed;
+
+    if (bc.nbufs == 0 || !dev) {
+        logger_error("bcbench: no buffer cache or block device\n");
+        return;
+    }
+
+    // 布局：顺序区 | 热数据区 | 扫描区
+    uint64_t nblocks = dev->capacity / BCACHE_BLOCK_SECTORS;
+    uint64_t seq     = bc.nbufs / 2;
+    uint64_t hot     = bc.nbufs / 4;
+    uint64_t scan    = bc.nbufs * 2;
+    if (seq + hot + scan > nblocks) {
+        logger_error("bcbench: %s is too small (%llu blocks needed)\n", dev->name,
+                     seq + hot + scan);
+        return;
+    }
+
+    // 先清掉之前的脏块，避免回写干扰计时
+    bsync();
+
+    logger("=== Buffer Cache Benchmark (%s) ===\n", dev->name);
+    logger("  %-12s %8s %8s %7s %8s %8s %10s %s\n", "phase", "lookups", "hits", "hit", "ra",
+           "ra used", "us", "check");
+    before = bc.stats;
+
+    start  = READ_TIME();
+    failed = bench_read(dev, 0, seq, false);
+    bench_report("seq cold", &before, READ_TIME() - start, failed);
+
+    start  = READ_TIME();
+    failed = bench_read(dev, 0, seq, false);
+    bench_report("seq warm", &before, READ_TIME() - start, failed);
+
+    // 热数据访问两次进入热队列，再做一次两倍缓存大小的扫描
+    failed = bench_read(dev, seq, hot, false) + bench_read(dev, seq, hot, false);
+    bench_report("hot load", &before, 0, failed);
+
+    start  = READ_TIME();
+    failed = bench_read(dev, seq + hot, scan, false);
+    bench_report("scan", &before, READ_TIME() - start, failed);
+
+    start  = READ_TIME();
+    failed = bench_read(dev, seq, hot, false);
+    bench_report("hot reread", &before, READ_TIME() - start, failed);
+
+    if (!dev->read_only) {
+        uint64_t extents = bc.stats.wb_extents;
+        uint64_t blocks  = bc.stats.wb_blocks;
+
+        failed = bench_read(dev, seq, hot, true);
+        start  = READ_TIME();
+        failed += bsync() ? 1 : 0;
+        bench_report("write+sync", &before, READ_TIME() - start, failed);
+        logger("  write-back: %llu blocks in %llu extents\n", bc.stats.wb_blocks - blocks,
+               bc.stats.wb_extents - extents);
+    }
+}
+
+static int cmd_bcbench(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    bcache_bench();
+    return 0;
+}
+SHELL_CMD(bcbench, NULL, "Run buffer cache benchmark", cmd_bcbench);
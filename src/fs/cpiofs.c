@@ -0,0 +1,342 @@
+/*
+ * RISC-V testos 只读 cpio 文件系统
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "cpiofs.h"
+#include "blkdev.h"
+#include "bcache.h"
+#include "fdt.h"
+#include "mem.h"
+#include "string.h"
+#include "initcall.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+#define CPIO_MAGIC          "070701"
+#define CPIO_HDR_SIZE       110
+#define CPIO_TRAILER        "TRAILER!!!"
+#define CPIO_LOAD_BATCH     64      // 从块设备加载映像时每批提交的页数
+
+#define S_IFMT              0170000
+#define S_IFREG             0100000
+
+// newc 头部：魔数后是 13 个 8 位十六进制 ASCII 字段
+typedef struct {
+    char magic[6];
+    char ino[8];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char nlink[8];
+    char mtime[8];
+    char filesize[8];
+    char devmajor[8];
+    char devminor[8];
+    char rdevmajor[8];
+    char rdevminor[8];
+    char namesize[8];
+    char check[8];
+} cpio_newc_hdr_t;
+
+static struct {
+    const uint8_t *image;
+    size_t size;
+    const char *source;
+    cpio_file_t *files;
+    int nfiles;
+} cpiofs;
+
+static uint64_t initrd_start;
+static uint64_t initrd_end;
+
+// ===============================================================================
+// 头部解析
+// ===============================================================================
+static bool cpio_hex(const char *s, uint32_t *val)
+{
+    uint32_t v = 0;
+
+    for (int i = 0; i < 8; i++) {
+        char c = s[i];
+        if (c >= '0' && c <= '9') {
+            v = (v << 4) | (c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            v = (v << 4) | (c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            v = (v << 4) | (c - 'A' + 10);
+        } else {
+            return false;
+        }
+    }
+    *val = v;
+    return true;
+}
+
+static bool cpio_parse_hdr(const cpio_newc_hdr_t *h, uint32_t *mode, uint32_t *filesize,
+                           uint32_t *namesize)
+{
+    return memcmp(h->magic, CPIO_MAGIC, 6) == 0 && cpio_hex(h->mode, mode) &&
+           cpio_hex(h->filesize, filesize) && cpio_hex(h->namesize, namesize) && *namesize > 0;
+}
+
+// 下一个头部的偏移：名称和数据各自按 4 字节对齐
+static inline uint64_t cpio_next(uint64_t off, uint32_t namesize, uint32_t filesize)
+{
+    return ALIGN_UP(ALIGN_UP(off + CPIO_HDR_SIZE + namesize, 4) + filesize, 4);
+}
+
+// ===============================================================================
+// 挂载
+// ===============================================================================
+int cpiofs_mount(const uint8_t *image, size_t size, const char *source)
+{
+    int count = 0;
+
+    // 两遍扫描：先数文件，再建立索引
+    for (int pass = 0; pass < 2; pass++) {
+        uint64_t off = 0;
+        int      n   = 0;
+
+        for (;;) {
+            const cpio_newc_hdr_t *h = (const cpio_newc_hdr_t *)(image + off);
+            uint32_t               mode, filesize, namesize;
+
+            if (off + CPIO_HDR_SIZE > size || !cpio_parse_hdr(h, &mode, &filesize, &namesize) ||
+                off + CPIO_HDR_SIZE + namesize > size) {
+                logger_error("cpiofs: bad header at offset 0x%llx in %s\n", off, source);
+                return -1;
+            }
+
+            const char *name = (const char *)h + CPIO_HDR_SIZE;
+            uint64_t    data = ALIGN_UP(off + CPIO_HDR_SIZE + namesize, 4);
+            if (name[namesize - 1] != '\0' || data + filesize > size) {
+                logger_error("cpiofs: truncated entry at offset 0x%llx in %s\n", off, source);
+                return -1;
+            }
+            if (strcmp(name, CPIO_TRAILER) == 0) {
+                break;
+            }
+
+            if ((mode & S_IFMT) == S_IFREG) {
+                if (pass == 1) {
+                    // 去掉前导的 "./" 和 "/"
+                    while (name[0] == '.' && name[1] == '/') {
+                        name += 2;
+                    }
+                    while (name[0] == '/') {
+                        name++;
+                    }
+                    cpiofs.files[n].name = name;
+                    cpiofs.files[n].data = image + data;
+                    cpiofs.files[n].size = filesize;
+                    cpiofs.files[n].mode = mode;
+                }
+                n++;
+            }
+            off = cpio_next(off, namesize, filesize);
+        }
+
+        if (pass == 0) {
+            count = n;
+            cpiofs.files = count ? malloc(count * sizeof(cpio_file_t)) : NULL;
+            if (count && !cpiofs.files) {
+                return -1;
+            }
+        }
+    }
+
+    cpiofs.image  = image;
+    cpiofs.size   = size;
+    cpiofs.source = source;
+    cpiofs.nfiles = count;
+
+    logger_info("cpiofs: mounted %s at 0x%llx (%llu KB, %d files)\n", source, (uintptr_t)image,
+                size / 1024, count);
+    return count;
+}
+
+// 通过块缓存从设备读取任意字节范围
+static int cpio_blk_copy(blkdev_t *dev, uint64_t off, void *dst, size_t len)
+{
+    uint8_t *p = dst;
+
+    while (len) {
+        uint64_t block = off / BCACHE_BLOCK_SIZE;
+        size_t   in    = off % BCACHE_BLOCK_SIZE;
+        size_t   n     = BCACHE_BLOCK_SIZE - in;
+        if (n > len) {
+            n = len;
+        }
+
+        buf_t *b = bread(dev, block);
+        if (!b) {
+            return -1;
+        }
+        memcpy(p, b->data + in, n);
+        brelse(b);
+
+        p += n;
+        off += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 沿头部链找到归档末尾，再把整个归档一次性读入连续内存
+static int cpiofs_load_blk(blkdev_t *dev, const uint8_t **image, size_t *size)
+{
+    uint64_t capacity = dev->capacity * BLK_SECTOR_SIZE;
+    uint64_t off      = 0;
+
+    for (;;) {
+        cpio_newc_hdr_t h;
+        char            name[sizeof(CPIO_TRAILER)];
+        uint32_t        mode, filesize, namesize;
+
+        if (off + CPIO_HDR_SIZE > capacity || cpio_blk_copy(dev, off, &h, CPIO_HDR_SIZE) < 0 ||
+            !cpio_parse_hdr(&h, &mode, &filesize, &namesize)) {
+            return -1;
+        }
+
+        size_t n = namesize < sizeof(name) ? namesize : sizeof(name);
+        if (cpio_blk_copy(dev, off + CPIO_HDR_SIZE, name, n) < 0) {
+            return -1;
+        }
+        name[n - 1] = '\0';
+
+        off = cpio_next(off, namesize, filesize);
+        if (off > capacity) {
+            return -1;
+        }
+        if (namesize == sizeof(CPIO_TRAILER) && strcmp(name, CPIO_TRAILER) == 0) {
+            break;
+        }
+    }
+
+    size_t   npages = ALIGN_UP(off, PAGE_SIZE) / PAGE_SIZE;
+    uint8_t *buf    = alloc_pages(npages);
+    if (!buf) {
+        logger_error("cpiofs: no memory for %llu KB image\n", off / 1024);
+        return -1;
+    }
+
+    // 按批提交整页读请求，驱动会把相邻页合并
+    static blk_request_t  reqs[CPIO_LOAD_BATCH];
+    static blk_request_t *batch[CPIO_LOAD_BATCH];
+    for (size_t page = 0; page < npages;) {
+        int n = 0;
+
+        for (; n < CPIO_LOAD_BATCH && page < npages; n++, page++) {
+            uint64_t sector = page * (PAGE_SIZE / BLK_SECTOR_SIZE);
+            reqs[n].sector  = sector;
+            reqs[n].count   = PAGE_SIZE / BLK_SECTOR_SIZE;
+            if (sector + reqs[n].count > dev->capacity) {
+                reqs[n].count = dev->capacity - sector;
+            }
+            reqs[n].write = false;
+            reqs[n].buf   = buf + page * PAGE_SIZE;
+            batch[n]      = &reqs[n];
+        }
+
+        blk_submit(dev, batch, n);
+        for (int i = 0; i < n; i++) {
+            if (blk_wait(dev, &reqs[i]) != BLK_REQ_OK) {
+                free_pages(buf, npages);
+                return -1;
+            }
+        }
+    }
+
+    *image = buf;
+    *size  = off;
+    return 0;
+}
+
+void initrd_init(void)
+{
+    if (fdt_getprop_u64("/chosen", "linux,initrd-start", &initrd_start) < 0 ||
+        fdt_getprop_u64("/chosen", "linux,initrd-end", &initrd_end) < 0 ||
+        initrd_end <= initrd_start) {
+        initrd_start = initrd_end = 0;
+        return;
+    }
+
+    logger_info("initrd: 0x%llx-0x%llx (%llu KB)\n", initrd_start, initrd_end,
+                (initrd_end - initrd_start) / 1024);
+    if (mem_reserve(initrd_start, initrd_end) < 0) {
+        logger_warn("initrd: overlaps memory already allocated, ignored\n");
+        initrd_start = initrd_end = 0;
+    }
+}
+
+static int initrd_initcall(void)
+{
+    initrd_init();
+    return 0;
+}
+INITCALL(initrd, INIT_EARLY, 0, initrd_initcall);
+
+void cpiofs_init(void)
+{
+    if (initrd_start) {
+        cpiofs_mount((const uint8_t *)initrd_start, initrd_end - initrd_start, "initrd");
+        return;
+    }
+
+    blkdev_t      *dev = blkdev_get(0);
+    const uint8_t *image;
+    size_t         size;
+    if (dev && cpiofs_load_blk(dev, &image, &size) == 0) {
+        cpiofs_mount(image, size, dev->name);
+        return;
+    }
+
+    logger_info("cpiofs: no initrd or cpio image on disk, nothing mounted\n");
+}
+
+// 挂载 initrd 或磁盘上的 cpio 根文件系统
+static int cpiofs_initcall(void)
+{
+    cpiofs_init();
+    return 0;
+}
+INITCALL(cpiofs, INIT_FS, INITCALL_PARALLEL, cpiofs_initcall, "initrd", "virtio_blk", "bcache");
+
+// ===============================================================================
+// 查找与列表
+// ===============================================================================
+const cpio_file_t *cpiofs_lookup(const char *name)
+{
+    while (name[0] == '/') {
+        name++;
+    }
+    for (int i = 0; i < cpiofs.nfiles; i++) {
+        if (strcmp(cpiofs.files[i].name, name) == 0) {
+            return &cpiofs.files[i];
+        }
+    }
+    return NULL;
+}
+
+void cpiofs_list(void)
+{
+    if (!cpiofs.image) {
+        logger("(no filesystem mounted)\n");
+        return;
+    }
+    logger("%s: %d files\n", cpiofs.source, cpiofs.nfiles);
+    for (int i = 0; i < cpiofs.nfiles; i++) {
+        const cpio_file_t *f = &cpiofs.files[i];
+        logger("  %10llu  %s\n", f->size, f->name);
+    }
+}
+
+static int cmd_ls(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    cpiofs_list();
+    return 0;
+}
+SHELL_CMD(ls, NULL, "List files in the root filesystem", cmd_ls);
@@ -0,0 +1,157 @@
+/*
+ * RISC-V testos futex
+ */
+
+#include "types.h"
+#include "futex.h"
+#include "proc.h"
+#include "vm.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "lib/logger.h"
+
+// Linux errno
+#define EAGAIN      11
+#define EFAULT      14
+#define EINVAL      22
+#define ENOSYS      38
+#define ETIMEDOUT   110
+
+#define FUTEX_HASH_SIZE     (1 << FUTEX_HASH_BITS)
+
+// 每个桶一把锁，等待者按到达顺序挂在链上（节点嵌在 proc_t 中）
+typedef struct {
+    spinlock_t lock;
+    proc_t *head;
+} futex_bucket_t;
+
+static futex_bucket_t futex_table[FUTEX_HASH_SIZE];
+
+static struct {
+    uint64_t waits;         // 进入睡眠的 WAIT
+    uint64_t eagain;        // 值已改变，未睡眠
+    uint64_t timeouts;
+    uint64_t wakes;         // WAKE 调用次数
+    uint64_t woken;         // 实际唤醒的进程数
+} futex_stats;
+
+static futex_bucket_t *futex_bucket(uintptr_t key)
+{
+    return &futex_table[((key >> 2) * 0x9e3779b97f4a7c15ULL) >> (64 - FUTEX_HASH_BITS)];
+}
+
+// 从桶链上摘下 p，调用者持有桶锁
+static void futex_unlink(futex_bucket_t *b, proc_t *p)
+{
+    for (proc_t **pp = &b->head; *pp; pp = &(*pp)->futex_next) {
+        if (*pp == p) {
+            *pp           = p->futex_next;
+            p->futex_next = NULL;
+            return;
+        }
+    }
+}
+
+static int64_t futex_wait(proc_t *p, uintptr_t key, uint32_t val, const struct timespec *timeout)
+{
+    futex_bucket_t *b        = futex_bucket(key);
+    uint64_t        deadline = 0;
+
+    if (timeout) {
+        if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000) {
+            return -EINVAL;
+        }
+        uint64_t freq = timer_get_frequency();
+        deadline = READ_TIME() + (uint64_t)timeout->tv_sec * freq +
+                   (uint64_t)timeout->tv_nsec * freq / 1000000000ULL;
+    }
+
+    // 值比较和入队在同一把锁下，WAKE 必须先拿到这把锁，不会丢失唤醒
+    spin_lock(&b->lock);
+    if (*(volatile uint32_t *)key != val) {
+        futex_stats.eagain++;
+        spin_unlock(&b->lock);
+        return -EAGAIN;
+    }
+
+    proc_t **tail = &b->head;
+    while (*tail) {
+        tail = &(*tail)->futex_next;
+    }
+    *tail          = p;
+    p->futex_next  = NULL;
+    p->futex_key   = key;
+    p->futex_woken = false;
+    futex_stats.waits++;
+    proc_block(&b->lock, deadline);
+
+    spin_lock(&b->lock);
+    bool woken = p->futex_woken;
+    if (!woken) {
+        futex_unlink(b, p);
+        futex_stats.timeouts++;
+    }
+    p->futex_key = 0;
+    spin_unlock(&b->lock);
+    return woken ? 0 : -ETIMEDOUT;
+}
+
+int64_t futex_wake_key(uintptr_t key, uint32_t n)
+{
+    futex_bucket_t *b     = futex_bucket(key);
+    int64_t         count = 0;
+
+    spin_lock(&b->lock);
+    futex_stats.wakes++;
+    for (proc_t **pp = &b->head; *pp && (uint32_t)count < n;) {
+        proc_t *w = *pp;
+        if (w->futex_key != key) {
+            pp = &w->futex_next;
+            continue;
+        }
+        *pp            = w->futex_next;
+        w->futex_next  = NULL;
+        w->futex_woken = true;
+        proc_unblock(w);
+        count++;
+    }
+    futex_stats.woken += count;
+    spin_unlock(&b->lock);
+    return count;
+}
+
+int64_t sys_futex(uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout)
+{
+    proc_t *p = proc_current();
+
+    if (!p) {
+        return -ENOSYS;
+    }
+    if ((uintptr_t)uaddr & 3) {
+        return -EINVAL;
+    }
+    // 私有 futex 也按物理地址作键，时钟选择对相对超时没有影响
+    op &= ~(FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME);
+    if (op != FUTEX_WAIT && op != FUTEX_WAKE) {
+        return -ENOSYS;
+    }
+
+    // 先打破写时复制：fork 后第一次等待时键就固定在自己的物理页上
+    uintptr_t key = vm_translate(p->vm, (uintptr_t)uaddr, true);
+    if (!key) {
+        return -EFAULT;
+    }
+    return op == FUTEX_WAIT ? futex_wait(p, key, val, timeout) : futex_wake_key(key, val);
+}
+
+uint64_t futex_syscalls(void)
+{
+    return futex_stats.waits + futex_stats.eagain + futex_stats.wakes;
+}
+
+void futex_dump_stats(void)
+{
+    logger("=== Futex ===\n");
+    logger("waits %llu, eagain %llu, timeouts %llu, wakes %llu, woken %llu\n", futex_stats.waits,
+           futex_stats.eagain, futex_stats.timeouts, futex_stats.wakes, futex_stats.woken);
+}
@@ -0,0 +1,312 @@
+/*
+ * RISC-V testos 空闲调控器
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "idle.h"
+#include "sbi.h"
+#include "fdt.h"
+#include "timer.h"
+#include "percpu.h"
+#include "smp.h"
+#include "string.h"
+#include "initcall.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+#define IDLE_NAME_LEN       16
+
+// 设备树没有描述空闲状态时，固件默认保持型挂起使用的保守参数
+#define IDLE_RET_EXIT_US        10
+#define IDLE_RET_RESIDENCY_US   50
+
+typedef struct {
+    char name[IDLE_NAME_LEN];
+    uint32_t param;             // HSM 挂起类型，WFI 不使用
+    uint32_t exit_us;           // 进入加退出的延迟
+    uint32_t residency_us;      // 至少要停留这么久才比浅一级的状态划算
+    uint64_t exit_latency;      // 以上两项换算成 time CSR 计数
+    uint64_t target_residency;
+    volatile bool disabled;     // 固件拒绝该挂起类型
+} idle_state_t;
+
+// 每个状态在一个 hart 上的统计
+typedef struct {
+    uint64_t usage;
+    uint64_t time;              // 总驻留时间（time CSR 计数）
+    uint64_t above;             // 驻留不足 target_residency，选得太深
+    uint64_t below;             // 驻留足够更深的状态，选得太浅
+    uint64_t timer_wakes;       // 由定时器唤醒的次数
+    uint64_t wake_latency;      // 定时器到期到 hart 恢复执行的总延迟
+    uint64_t wake_latency_max;
+} idle_usage_t;
+
+typedef struct {
+    uint64_t intervals[IDLE_HISTORY];   // 最近几次空闲的实测时长，0 表示无样本
+    int next;
+    idle_usage_t usage[IDLE_MAX_STATES];
+} __attribute__((aligned(64))) idle_hart_t;
+
+static idle_state_t idle_states[IDLE_MAX_STATES];
+static int          idle_nstates = 1;
+static idle_hart_t  idle_harts[MAX_HARTS];
+
+static uint64_t idle_latency_limit;     // 唤醒延迟目标（time CSR 计数）
+static uint32_t idle_latency_us;
+static uint64_t idle_interval_max;      // 记录的空闲时长上限，防止方差计算溢出
+static bool     idle_has_susp;
+
+static uint64_t us_to_time(uint64_t us)
+{
+    return us * timer_get_frequency() / 1000000;
+}
+
+static uint64_t time_to_us(uint64_t t)
+{
+    return t * 1000000 / timer_get_frequency();
+}
+
+// ===============================================================================
+// 空闲状态表
+// ===============================================================================
+static void idle_add_state(const char *name, uint32_t param, uint32_t exit_us, uint32_t residency_us)
+{
+    if (idle_nstates >= IDLE_MAX_STATES) {
+        return;
+    }
+
+    // 按 min-residency 从浅到深插入
+    int i = idle_nstates++;
+    while (i > 1 && idle_states[i - 1].residency_us > residency_us) {
+        idle_states[i] = idle_states[i - 1];
+        i--;
+    }
+
+    idle_state_t *s = &idle_states[i];
+    memset(s, 0, sizeof(*s));
+    strncpy(s->name, name, IDLE_NAME_LEN - 1);
+    s->param            = param;
+    s->exit_us          = exit_us;
+    s->residency_us     = residency_us;
+    s->exit_latency     = us_to_time(exit_us);
+    s->target_residency = us_to_time(residency_us);
+}
+
+static void idle_parse_state(const char *name, void *arg)
+{
+    char     path[64] = "/cpus/idle-states/";
+    uint64_t param, entry = 0, exit = 0, residency = 0;
+
+    (void)arg;
+    if (strlen(path) + strlen(name) >= sizeof(path)) {
+        return;
+    }
+    strcat(path, name);
+
+    if (fdt_getprop_u64(path, "riscv,sbi-suspend-param", &param) < 0) {
+        return;
+    }
+    if (param & SBI_HSM_SUSPEND_NON_RET) {
+        logger_info("idle: skipping non-retentive state %s\n", name);
+        return;
+    }
+    fdt_getprop_u64(path, "entry-latency-us", &entry);
+    fdt_getprop_u64(path, "exit-latency-us", &exit);
+    fdt_getprop_u64(path, "min-residency-us", &residency);
+    idle_add_state(name, (uint32_t)param, (uint32_t)(entry + exit), (uint32_t)residency);
+}
+
+void idle_init(void)
+{
+    idle_state_t *wfi = &idle_states[0];
+
+    strcpy(wfi->name, "wfi");
+    idle_nstates = 1;
+
+    idle_latency_us    = (uint32_t)bootarg_get_size("idle_latency", IDLE_LATENCY_DEFAULT_US);
+    idle_latency_limit = us_to_time(idle_latency_us);
+    idle_interval_max  = timer_get_frequency();
+
+    if (fdt_for_each_child("/cpus/idle-states", idle_parse_state, NULL) <= 0 || idle_nstates == 1) {
+        idle_add_state("ret-default", SBI_HSM_SUSPEND_RET_DEFAULT, IDLE_RET_EXIT_US,
+                       IDLE_RET_RESIDENCY_US);
+    }
+    idle_has_susp = sbi_probe_extension(SBI_EXT_SUSP);
+
+    logger_info("idle: %d state(s), wakeup latency target %u us\n", idle_nstates, idle_latency_us);
+}
+
+static int idle_initcall(void)
+{
+    idle_init();
+    return 0;
+}
+INITCALL(idle, INIT_CORE, 0, idle_initcall);
+
+// ===============================================================================
+// 预测与选择
+// ===============================================================================
+
+// 最近几次空闲时长的典型值：反复去掉最大的离群值，直到剩下的样本足够集中
+static uint64_t idle_typical_interval(const idle_hart_t *h)
+{
+    uint64_t thresh = UINT64_MAX;
+
+    for (int pass = 0; pass < 3; pass++) {
+        uint64_t sum = 0, max = 0;
+        int      n   = 0;
+
+        for (int i = 0; i < IDLE_HISTORY; i++) {
+            uint64_t v = h->intervals[i];
+            if (v && v <= thresh) {
+                sum += v;
+                max = v > max ? v : max;
+                n++;
+            }
+        }
+        if (n < IDLE_HISTORY / 2) {
+            return 0;
+        }
+
+        uint64_t avg = sum / n;
+        uint64_t var = 0;
+        for (int i = 0; i < IDLE_HISTORY; i++) {
+            uint64_t v = h->intervals[i];
+            if (v && v <= thresh) {
+                int64_t d = (int64_t)(v - avg);
+                var += (uint64_t)(d * d);
+            }
+        }
+        var /= n;
+
+        // 标准差不超过均值的 1/6
+        if (var * 36 <= avg * avg) {
+            return avg;
+        }
+        thresh = max - 1;
+    }
+    return 0;
+}
+
+static int idle_select(const idle_hart_t *h, uint64_t now, uint64_t next)
+{
+    uint64_t sleep     = !next ? UINT64_MAX : next > now ? next - now : 0;
+    uint64_t typical   = idle_typical_interval(h);
+    uint64_t predicted = typical && typical < sleep ? typical : sleep;
+    int      sel       = 0;
+
+    for (int i = 1; i < idle_nstates; i++) {
+        const idle_state_t *s = &idle_states[i];
+        if (s->target_residency > predicted) {
+            break;
+        }
+        if (!s->disabled && s->exit_latency <= idle_latency_limit) {
+            sel = i;
+        }
+    }
+    return sel;
+}
+
+// 根据实测驻留时间判断这次选得太深还是太浅
+static void idle_reflect(idle_hart_t *h, int sel, uint64_t now, uint64_t end, uint64_t next)
+{
+    idle_usage_t *u        = &h->usage[sel];
+    uint64_t      measured = end - now;
+
+    u->usage++;
+    u->time += measured;
+    if (sel > 0 && measured < idle_states[sel].target_residency) {
+        u->above++;
+    } else {
+        for (int i = sel + 1; i < idle_nstates; i++) {
+            const idle_state_t *s = &idle_states[i];
+            if (!s->disabled && s->exit_latency <= idle_latency_limit &&
+                measured >= s->target_residency) {
+                u->below++;
+                break;
+            }
+        }
+    }
+
+    // 定时器在空闲期间到期：恢复执行时刻与到期时刻之差就是唤醒延迟
+    if (next && next > now && end >= next) {
+        uint64_t lat = end - next;
+        u->timer_wakes++;
+        u->wake_latency += lat;
+        u->wake_latency_max = lat > u->wake_latency_max ? lat : u->wake_latency_max;
+    }
+
+    h->intervals[h->next] = measured < idle_interval_max ? (measured ? measured : 1)
+                                                          : idle_interval_max;
+    h->next = (h->next + 1) % IDLE_HISTORY;
+}
+
+void idle_enter(void)
+{
+    idle_hart_t *h    = &idle_harts[this_hart_id()];
+    uint64_t     now  = READ_TIME();
+    uint64_t     next = timer_next_event();
+    int          sel  = idle_select(h, now, next);
+
+    if (sel > 0) {
+        idle_state_t *s   = &idle_states[sel];
+        long          err = sbi_hart_suspend(s->param, 0, 0);
+        if (err != SBI_SUCCESS) {
+            if (!s->disabled) {
+                logger_warn("idle: %s rejected by firmware (err %d), disabled\n", s->name, (int)err);
+            }
+            s->disabled = true;
+            sel         = 0;
+        }
+    }
+    if (sel == 0) {
+        WFI();
+    }
+
+    idle_reflect(h, sel, now, READ_TIME(), next);
+}
+
+// ===============================================================================
+// 统计输出
+// ===============================================================================
+void idle_dump_stats(void)
+{
+    logger("=== CPU Idle ===\n");
+    logger("wakeup latency target %u us, SBI system suspend %s\n", idle_latency_us,
+           idle_has_susp ? "available (not used)" : "not supported");
+    logger("  %-3s %-16s %-10s %8s %10s %s\n", "idx", "state", "param", "exit us", "resid us",
+           "");
+    for (int i = 0; i < idle_nstates; i++) {
+        const idle_state_t *s = &idle_states[i];
+        logger("  %-3d %-16s 0x%08x %8u %10u %s\n", i, s->name, i ? s->param : 0, s->exit_us,
+               s->residency_us,
+               s->disabled ? "disabled" : s->exit_latency > idle_latency_limit ? "over target" : "");
+    }
+
+    logger("  %-4s %-3s %10s %10s %8s %8s %10s %10s\n", "hart", "idx", "usage", "time ms",
+           "above", "below", "wake avg", "wake max");
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        if (!(smp_online_mask & HART_MASK(hart))) {
+            continue;
+        }
+        for (int i = 0; i < idle_nstates; i++) {
+            const idle_usage_t *u = &idle_harts[hart].usage[i];
+            if (!u->usage) {
+                continue;
+            }
+            logger("  %-4llu %-3d %10llu %10llu %8llu %8llu %8llu us %7llu us\n", hart, i,
+                   u->usage, time_to_us(u->time) / 1000, u->above, u->below,
+                   u->timer_wakes ? time_to_us(u->wake_latency / u->timer_wakes) : 0,
+                   time_to_us(u->wake_latency_max));
+        }
+    }
+}
+
+static int cmd_idle(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    idle_dump_stats();
+    return 0;
+}
+SHELL_CMD(idle, NULL, "Show idle state residency and wakeup latency", cmd_idle);
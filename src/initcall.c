@@ -0,0 +1,339 @@
+/*
+ * RISC-V testos 初始化调用（initcall）
+ *
+ * 调用表就是 .initcall.* 段本身（链接脚本按级别排序），运行状态直接写在表项里。
+ * initcall_lock 保护所有表项的状态转换；调用本身在锁外执行。
+ * 启动 hart 在 initcall_run() 中执行任何已就绪的调用，没有可执行的调用时自旋等待
+ * 从核上的调用结束；从核只在调度循环空闲时通过 initcall_poll() 执行可并行的调用。
+ * 一个调用结束时用 IPI 唤醒其他 hart，依赖它的调用可能已经就绪。
+ */
+
+#include "types.h"
+#include "initcall.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "string.h"
+#include "timer.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+// 检查依赖是否停在被推迟的级别上时的最大递归深度（成环时也能结束）
+#define INITCALL_MAX_DEPTH  16
+
+extern initcall_t __initcall_start[];
+extern initcall_t __initcall_end[];
+
+static const char *const level_names[INIT_LEVELS] = {
+    [INIT_EARLY]    = "early",
+    [INIT_CORE]     = "core",
+    [INIT_DEVICE]   = "device",
+    [INIT_FS]       = "fs",
+    [INIT_LATE]     = "late",
+    [INIT_DEFERRED] = "deferred",
+};
+
+static spinlock_t    initcall_lock;
+static int           initcall_level = -1;                   // initcall_run 已到达的级别
+static uint32_t      initcall_deferred = 1U << INIT_DEFERRED;
+static bool          initcall_released;
+static volatile bool initcall_finished;                     // 放行后全部结束，空闲路径不再加锁
+
+#define for_each_initcall(c) for (initcall_t *c = __initcall_start; c < __initcall_end; c++)
+
+const char *initcall_level_name(int level)
+{
+    return level >= 0 && level < INIT_LEVELS ? level_names[level] : "?";
+}
+
+static uint64_t ticks_to_us(uint64_t ticks)
+{
+    return ticks * 1000000 / timer_get_frequency();
+}
+
+static initcall_t *initcall_find(const char *name)
+{
+    for_each_initcall(c) {
+        if (strcmp(c->name, name) == 0) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// 以下函数都在持有 initcall_lock 时调用
+
+static bool initcall_open(const initcall_t *c)
+{
+    return c->level <= initcall_level &&
+           (initcall_released || !(initcall_deferred & (1U << c->level)));
+}
+
+static bool initcall_active(const initcall_t *c)
+{
+    return c->state == INITCALL_PENDING || c->state == INITCALL_RUNNING;
+}
+
+// 1：依赖全部成功结束；0：还要等（或依赖不存在）；-1：有依赖失败或被跳过
+static int initcall_ready(const initcall_t *c)
+{
+    for (uint32_t i = 0; i < c->ndeps; i++) {
+        const initcall_t *d = initcall_find(c->deps[i]);
+
+        if (!d || initcall_active(d)) {
+            return 0;
+        }
+        if (d->state == INITCALL_SKIPPED || d->ret < 0) {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+// 依赖（直接或间接）落在尚未放行的级别上：等放行后再执行，不算卡住
+static bool initcall_waits_deferred(const initcall_t *c, int depth)
+{
+    for (uint32_t i = 0; i < c->ndeps && depth < INITCALL_MAX_DEPTH; i++) {
+        const initcall_t *d = initcall_find(c->deps[i]);
+
+        if (d && initcall_active(d) &&
+            (!initcall_open(d) || initcall_waits_deferred(d, depth + 1))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void initcall_skip(initcall_t *c, const char *why)
+{
+    c->state = INITCALL_SKIPPED;
+    logger_warn("initcall %s: skipped, %s\n", c->name, why);
+}
+
+// 取一个可以开始的调用并标记为运行中
+static initcall_t *initcall_claim(bool parallel_only)
+{
+    for_each_initcall(c) {
+        if (c->state != INITCALL_PENDING || !initcall_open(c) ||
+            (parallel_only && !(c->flags & INITCALL_PARALLEL))) {
+            continue;
+        }
+
+        int ready = initcall_ready(c);
+        if (ready < 0) {
+            initcall_skip(c, "a dependency failed");
+        } else if (ready > 0) {
+            c->state = INITCALL_RUNNING;
+            c->hart  = (uint8_t)this_hart_id();
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// 已放行的调用中还有没结束的（不算等待推迟级别的）
+static bool initcall_outstanding(bool *running)
+{
+    bool pending = false;
+
+    *running = false;
+    for_each_initcall(c) {
+        if (!initcall_open(c)) {
+            continue;
+        }
+        if (c->state == INITCALL_RUNNING) {
+            *running = true;
+        } else if (c->state == INITCALL_PENDING && !initcall_waits_deferred(c, 0)) {
+            pending = true;
+        }
+    }
+    return pending || *running;
+}
+
+// ===============================================================================
+// 执行
+// ===============================================================================
+
+// 唤醒其他 hart 来取新就绪的调用
+static void initcall_kick(void)
+{
+    smp_send_ipi(READ_ONCE(smp_online_mask) & ~HART_MASK(this_hart_id()));
+}
+
+static void initcall_exec(initcall_t *c)
+{
+    bool running;
+
+    c->start     = READ_TIME();
+    int      ret = c->fn();
+    uint64_t end = READ_TIME();
+
+    spin_lock(&initcall_lock);
+    c->ret   = ret;
+    c->end   = end;
+    c->state = INITCALL_DONE;
+    if (initcall_released && !initcall_outstanding(&running)) {
+        initcall_finished = true;
+    }
+    spin_unlock(&initcall_lock);
+
+    if (ret < 0) {
+        logger_warn("initcall %s failed (%d) after %llu us on hart %d\n", c->name, ret,
+                    ticks_to_us(end - c->start), c->hart);
+    } else {
+        logger_info("initcall %-12s %8llu us  hart %d\n", c->name, ticks_to_us(end - c->start),
+                    c->hart);
+    }
+    initcall_kick();
+}
+
+// 启动 hart 执行所有已放行的调用，直到全部结束
+static void initcall_drain(void)
+{
+    for (;;) {
+        bool running;
+
+        spin_lock(&initcall_lock);
+        initcall_t *c = initcall_claim(false);
+        if (c) {
+            spin_unlock(&initcall_lock);
+            initcall_exec(c);
+            continue;
+        }
+
+        if (!initcall_outstanding(&running)) {
+            if (initcall_released) {
+                initcall_finished = true;
+            }
+            spin_unlock(&initcall_lock);
+            return;
+        }
+
+        // 没有可执行的、也没有正在执行的：剩下的依赖不存在或成环
+        if (!running) {
+            for_each_initcall(p) {
+                if (p->state == INITCALL_PENDING && initcall_open(p) &&
+                    !initcall_waits_deferred(p, 0)) {
+                    initcall_skip(p, "dependency missing or cyclic");
+                }
+            }
+        }
+        spin_unlock(&initcall_lock);
+        cpu_relax();
+    }
+}
+
+void initcall_run(int level)
+{
+    spin_lock(&initcall_lock);
+    if (level > initcall_level) {
+        initcall_level = level;
+    }
+    spin_unlock(&initcall_lock);
+
+    initcall_kick();
+    initcall_drain();
+}
+
+void initcall_defer(int level)
+{
+    spin_lock(&initcall_lock);
+    initcall_deferred |= 1U << level;
+    spin_unlock(&initcall_lock);
+}
+
+void initcall_release(void)
+{
+    spin_lock(&initcall_lock);
+    initcall_released = true;
+    initcall_level    = INIT_LEVELS - 1;
+    spin_unlock(&initcall_lock);
+
+    if (smp_num_online() > 1) {
+        initcall_kick();
+    } else {
+        initcall_drain();
+    }
+}
+
+void initcall_sync(void)
+{
+    if (!READ_ONCE(initcall_finished)) {
+        initcall_drain();
+    }
+}
+
+bool initcall_poll(void)
+{
+    if (READ_ONCE(initcall_finished)) {
+        return false;
+    }
+
+    spin_lock(&initcall_lock);
+    initcall_t *c = initcall_claim(true);
+    spin_unlock(&initcall_lock);
+
+    if (!c) {
+        return false;
+    }
+    initcall_exec(c);
+    return true;
+}
+
+// ===============================================================================
+// 统计
+// ===============================================================================
+
+void initcall_dump(void)
+{
+    uint64_t origin = 0;
+    uint64_t total  = 0;
+
+    for_each_initcall(c) {
+        if (c->state == INITCALL_DONE && (!origin || c->start < origin)) {
+            origin = c->start;
+        }
+    }
+
+    logger("=== Initcalls ===\n");
+    logger("  %-12s %-8s %4s %10s %10s  %s\n", "name", "level", "hart", "at(us)", "took(us)",
+           "result");
+    for_each_initcall(c) {
+        const char *level = initcall_level_name(c->level);
+
+        switch (c->state) {
+            case INITCALL_DONE:
+                total += c->end - c->start;
+                logger("  %-12s %-8s %4d %10llu %10llu  ", c->name, level, c->hart,
+                       ticks_to_us(c->start - origin), ticks_to_us(c->end - c->start));
+                if (c->ret < 0) {
+                    logger("failed (%d)\n", c->ret);
+                } else {
+                    logger("ok\n");
+                }
+                break;
+            case INITCALL_RUNNING:
+                logger("  %-12s %-8s %4d %10llu %10s  running\n", c->name, level, c->hart,
+                       ticks_to_us(c->start - origin), "-");
+                break;
+            case INITCALL_SKIPPED:
+                logger("  %-12s %-8s %4s %10s %10s  skipped\n", c->name, level, "-", "-", "-");
+                break;
+            default:
+                logger("  %-12s %-8s %4s %10s %10s  %s\n", c->name, level, "-", "-", "-",
+                       initcall_open(c) ? "pending" : "deferred");
+                break;
+        }
+    }
+    logger("  %d initcalls, %llu us of init work\n", (int)(__initcall_end - __initcall_start),
+           ticks_to_us(total));
+}
+
+static int cmd_initcall(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    initcall_dump();
+    return 0;
+}
+SHELL_CMD(initcall, NULL, "Show per-initcall hart and duration", cmd_initcall);
@@ -0,0 +1,274 @@
+/*
+ * RISC-V testos 设备树（FDT）解析
+ */
+
+#include "types.h"
+#include "fdt.h"
+#include "string.h"
+#include "lib/logger.h"
+
+// 结构块 token
+#define FDT_BEGIN_NODE      0x1
+#define FDT_END_NODE        0x2
+#define FDT_PROP            0x3
+#define FDT_NOP             0x4
+#define FDT_END             0x9
+
+#define FDT_MAX_DEPTH       8
+
+typedef struct {
+    uint32_t magic;
+    uint32_t totalsize;
+    uint32_t off_dt_struct;
+    uint32_t off_dt_strings;
+    uint32_t off_mem_rsvmap;
+    uint32_t version;
+    uint32_t last_comp_version;
+    uint32_t boot_cpuid_phys;
+    uint32_t size_dt_strings;
+    uint32_t size_dt_struct;
+} fdt_header_t;
+
+static const uint8_t *fdt_base;
+
+static inline uint32_t be32(const void *p)
+{
+    const uint8_t *b = p;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+int fdt_init(uintptr_t dtb)
+{
+    if (dtb == 0 || (dtb & 3) || be32((const void *)dtb) != FDT_MAGIC) {
+        logger_warn("No valid device tree at 0x%llx\n", dtb);
+        return -1;
+    }
+    fdt_base = (const uint8_t *)dtb;
+    return 0;
+}
+
+size_t fdt_totalsize(void)
+{
+    if (!fdt_base) {
+        return 0;
+    }
+    return be32(&((const fdt_header_t *)fdt_base)->totalsize);
+}
+
+// 比较节点名，path 中的组件不带 "@unit" 时忽略节点名的 unit 部分
+static bool fdt_name_match(const char *node, const char *comp, size_t len)
+{
+    if (strncmp(node, comp, len) != 0) {
+        return false;
+    }
+    return node[len] == '\0' || node[len] == '@';
+}
+
+// 把 path 拆成组件，返回组件个数
+static int fdt_split_path(const char *path, const char *comp[], size_t comp_len[])
+{
+    int ncomp = 0;
+
+    for (const char *s = path + 1; *s && ncomp < FDT_MAX_DEPTH;) {
+        const char *e = strchr(s, '/');
+        size_t      n = e ? (size_t)(e - s) : strlen(s);
+        if (n) {
+            comp[ncomp]       = s;
+            comp_len[ncomp++] = n;
+        }
+        s += n + (e ? 1 : 0);
+    }
+    return ncomp;
+}
+
+const void *fdt_getprop(const char *path, const char *name, int *lenp)
+{
+    if (!fdt_base || path[0] != '/') {
+        return NULL;
+    }
+
+    const fdt_header_t *hdr     = (const fdt_header_t *)fdt_base;
+    const uint8_t      *p       = fdt_base + be32(&hdr->off_dt_struct);
+    const char         *strings = (const char *)fdt_base + be32(&hdr->off_dt_strings);
+
+    // matched: 已匹配的路径层数；depth: 当前所在节点深度（根节点为 1）
+    int         depth   = 0;
+    int         matched = 0;
+    const char *comp[FDT_MAX_DEPTH];
+    size_t      comp_len[FDT_MAX_DEPTH];
+    int         ncomp = fdt_split_path(path, comp, comp_len);
+
+    for (;;) {
+        uint32_t token = be32(p);
+        p += 4;
+
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                const char *node = (const char *)p;
+                p += ALIGN_UP(strlen(node) + 1, 4);
+                depth++;
+                // 根节点名为空，depth - 2 是该节点在 path 中对应的组件下标
+                if (depth >= 2 && matched == depth - 2 && matched < ncomp &&
+                    fdt_name_match(node, comp[matched], comp_len[matched])) {
+                    matched++;
+                }
+                break;
+            }
+            case FDT_END_NODE:
+                if (matched == depth - 1 && matched > 0) {
+                    // 目标节点结束仍未找到属性
+                    if (matched == ncomp) {
+                        return NULL;
+                    }
+                    matched--;
+                }
+                depth--;
+                break;
+            case FDT_PROP: {
+                uint32_t len  = be32(p);
+                uint32_t noff = be32(p + 4);
+                const uint8_t *data = p + 8;
+                p += 8 + ALIGN_UP(len, 4);
+                if (matched == ncomp && depth == ncomp + 1 && strcmp(strings + noff, name) == 0) {
+                    if (lenp) {
+                        *lenp = len;
+                    }
+                    return data;
+                }
+                break;
+            }
+            case FDT_NOP:
+                break;
+            default:
+                return NULL;
+        }
+    }
+}
+
+int fdt_for_each_child(const char *path, void (*fn)(const char *name, void *arg), void *arg)
+{
+    if (!fdt_base || path[0] != '/') {
+        return -1;
+    }
+
+    const fdt_header_t *hdr = (const fdt_header_t *)fdt_base;
+    const uint8_t      *p   = fdt_base + be32(&hdr->off_dt_struct);
+
+    // 与 fdt_getprop 相同的匹配方式，目标节点内深度为 ncomp + 2 的节点即子节点
+    int         depth   = 0;
+    int         matched = 0;
+    int         count   = 0;
+    const char *comp[FDT_MAX_DEPTH];
+    size_t      comp_len[FDT_MAX_DEPTH];
+    int         ncomp = fdt_split_path(path, comp, comp_len);
+
+    for (;;) {
+        uint32_t token = be32(p);
+        p += 4;
+
+        switch (token) {
+            case FDT_BEGIN_NODE: {
+                const char *node = (const char *)p;
+                p += ALIGN_UP(strlen(node) + 1, 4);
+                depth++;
+                if (depth >= 2 && matched == depth - 2 && matched < ncomp &&
+                    fdt_name_match(node, comp[matched], comp_len[matched])) {
+                    matched++;
+                } else if (matched == ncomp && depth == ncomp + 2) {
+                    fn(node, arg);
+                    count++;
+                }
+                break;
+            }
+            case FDT_END_NODE:
+                if (matched == depth - 1 && matched > 0) {
+                    if (matched == ncomp) {
+                        return count;
+                    }
+                    matched--;
+                }
+                depth--;
+                break;
+            case FDT_PROP:
+                p += 8 + ALIGN_UP(be32(p), 4);
+                break;
+            case FDT_NOP:
+                break;
+            default:
+                return ncomp == 0 ? count : -1;
+        }
+    }
+}
+
+int fdt_getprop_u64(const char *path, const char *name, uint64_t *val)
+{
+    int            len;
+    const uint8_t *p = fdt_getprop(path, name, &len);
+
+    if (!p) {
+        return -1;
+    }
+    if (len == 4) {
+        *val = be32(p);
+    } else if (len == 8) {
+        *val = ((uint64_t)be32(p) << 32) | be32(p + 4);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// ===============================================================================
+// 启动参数
+// ===============================================================================
+bool bootarg_get(const char *key, char *buf, size_t size)
+{
+    const char *args = fdt_getprop("/chosen", "bootargs", NULL);
+    size_t      klen = strlen(key);
+
+    if (!args || size == 0) {
+        return false;
+    }
+
+    for (const char *s = args; *s;) {
+        while (*s == ' ') {
+            s++;
+        }
+        const char *e = s;
+        while (*e && *e != ' ') {
+            e++;
+        }
+        if ((size_t)(e - s) > klen && strncmp(s, key, klen) == 0 && s[klen] == '=') {
+            size_t n = e - s - klen - 1;
+            if (n >= size) {
+                n = size - 1;
+            }
+            memcpy(buf, s + klen + 1, n);
+            buf[n] = '\0';
+            return true;
+        }
+        s = e;
+    }
+    return false;
+}
+
+uint64_t bootarg_get_size(const char *key, uint64_t def)
+{
+    char     buf[32];
+    uint64_t val = 0;
+    char    *s   = buf;
+
+    if (!bootarg_get(key, buf, sizeof(buf)) || *s < '0' || *s > '9') {
+        return def;
+    }
+    while (*s >= '0' && *s <= '9') {
+        val = val * 10 + (*s++ - '0');
+    }
+    switch (*s) {
+        case 'G': case 'g': val <<= 30; break;
+        case 'M': case 'm': val <<= 20; break;
+        case 'K': case 'k': val <<= 10; break;
+        default: break;
+    }
+    return val;
+}
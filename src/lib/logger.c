@@ -52,6 +52,7 @@ typedef struct strprops {
     char pad;
     int npad;
     bool alternate;
+    bool left;          // '-'：左对齐，忽略 '0'
 } strprops_t;
 
 static char digits[16] = "0123456789abcdef";
@@ -68,7 +69,7 @@ static void addchar(pstream_t *p, char c)
 static void print_str(pstream_t *p, const char *s, strprops_t props)
 {
     const char *s_orig = s;
-    int npad = props.npad;
+    int npad = props.left ? -props.npad : props.npad;
 
     if (npad > 0) {
         npad -= strlen(s_orig);
@@ -94,20 +95,28 @@ static void print_str(pstream_t *p, const char *s, strprops_t props)
 static void print_int(pstream_t *ps, long long n, int base, strprops_t props)
 {
     char buf[sizeof(long) * 3 + 2], *p = buf;
+    unsigned long long u = n;
     int s = 0, i;
 
+    // 按无符号取绝对值，LLONG_MIN 取反不会溢出
     if (n < 0) {
-        n = -n;
+        u = -u;
         s = 1;
     }
 
-    while (n) {
-        *p++ = digits[n % base];
-        n /= base;
+    while (u) {
+        *p++ = digits[u % base];
+        u /= base;
     }
 
-    if (s)
+    // 补 0 时符号在最前面：-0042
+    if (s && props.pad == '0' && !props.left) {
+        addchar(ps, '-');
+        if (props.npad > 0)
+            --props.npad;
+    } else if (s) {
         *p++ = '-';
+    }
 
     if (p == buf)
         *p++ = '0';
@@ -136,7 +145,7 @@ static void print_unsigned(pstream_t *ps, unsigned long long n, int base, strpro
     if (p == buf)
         *p++ = '0';
     else if (props.alternate && base == 16) {
-        if (props.pad == '0') {
+        if (props.pad == '0' && !props.left) {
             addchar(ps, '0');
             addchar(ps, 'x');
             if (props.npad > 0)
@@ -163,17 +172,11 @@ static int fmtnum(const char **fmt)
     const char *f = *fmt;
     int len = 0, num = 0;
 
-    if (*f == '-')
-        ++f, ++len;
-
     while (*f >= '0' && *f <= '9') {
         num = num * 10 + (*f - '0');
         ++f, ++len;
     }
 
-    if (**fmt == '-')
-        num = -num;
-
     *fmt += len;
     return num;
 }
@@ -182,8 +185,9 @@ int my_vsnprintf(char *buf, int size, const char *fmt, va_list va)
 {
     pstream_t s;
 
+    // size 为 0 时只计算长度，不写缓冲区
     s.buffer = buf;
-    s.remain = size - 1;
+    s.remain = size > 0 ? size - 1 : 0;
     s.added = 0;
 
     while (*fmt) {
@@ -215,10 +219,11 @@ int my_vsnprintf(char *buf, int size, const char *fmt, va_list va)
                 goto morefmt;
             case '0':
                 props.pad = '0';
-                ++fmt;
-                /* fall through */
-            case '1' ... '9':
+                goto morefmt;
             case '-':
+                props.left = true;
+                goto morefmt;
+            case '1' ... '9':
                 --fmt;
                 props.npad = fmtnum(&fmt);
                 goto morefmt;
@@ -276,7 +281,8 @@ int my_vsnprintf(char *buf, int size, const char *fmt, va_list va)
                 break;
         }
     }
-    *s.buffer = 0;
+    if (size > 0)
+        *s.buffer = 0;
     return s.added;
 }
 
@@ -301,9 +307,21 @@ int my_vprintf(const char *fmt, va_list va)
     return r;
 }
 
+static bool logger_quiet;
+
+void logger_set_quiet(bool quiet)
+{
+    logger_quiet = quiet;
+}
+
 // 通用日志输出函数
 static int logger_output(log_level_t level, const char *fmt, va_list args)
 {
+    // 串口输出是启动路径上最慢的部分，静默时连格式化也省掉
+    if (logger_quiet && (level == LOG_LEVEL_DEBUG || level == LOG_LEVEL_INFO)) {
+        return 0;
+    }
+
     char buf[BUFSZ];
     int r = my_vsnprintf(buf, sizeof(buf), fmt, args);
 
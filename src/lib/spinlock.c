@@ -0,0 +1,366 @@
+/*
+ * RISC-V testos 自旋锁实现
+ * 基于 A 扩展的 amoswap/amoadd 与 lr/sc
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "atomic.h"
+#include "spinlock.h"
+#include "percpu.h"
+#include "smp.h"
+#include "timer.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+// 退避上限（cpu_relax 次数）
+#define BACKOFF_MIN     4
+#define BACKOFF_MAX     1024
+
+static lock_stat_t *lock_stat_list;
+static spinlock_t   lock_stat_list_lock;
+
+// ===============================================================================
+// 统计
+// ===============================================================================
+
+// 获取成功后调用（已持锁）
+static inline void lock_stat_acquired(lock_stat_t *stat, bool contended)
+{
+    if (stat) {
+        stat->acquired++;
+        if (contended) {
+            stat->contended++;
+        }
+        stat->hold_start = READ_CYCLE();
+    }
+}
+
+// 释放前调用（仍持锁）
+static inline void lock_stat_release(lock_stat_t *stat)
+{
+    if (stat) {
+        uint64_t hold = READ_CYCLE() - stat->hold_start;
+        stat->total_hold += hold;
+        if (hold > stat->max_hold) {
+            stat->max_hold = hold;
+        }
+    }
+}
+
+void lock_stat_register(lock_stat_t *stat, const char *name)
+{
+    lock_stat_reset(stat);
+    stat->name = name;
+
+    spin_lock(&lock_stat_list_lock);
+    stat->next     = lock_stat_list;
+    lock_stat_list = stat;
+    spin_unlock(&lock_stat_list_lock);
+}
+
+void lock_stat_reset(lock_stat_t *stat)
+{
+    stat->acquired   = 0;
+    stat->contended  = 0;
+    stat->max_hold   = 0;
+    stat->total_hold = 0;
+}
+
+void lock_stat_dump(void)
+{
+    logger("=== Lock Statistics ===\n");
+    logger("  %-12s %10s %10s %6s %10s %10s\n", "name", "acquired", "contended", "cont%",
+           "avg hold", "max hold");
+
+    for (lock_stat_t *st = lock_stat_list; st; st = st->next) {
+        uint64_t pct = st->acquired ? st->contended * 100 / st->acquired : 0;
+        uint64_t avg = st->acquired ? st->total_hold / st->acquired : 0;
+        logger("  %-12s %10llu %10llu %5llu%% %10llu %10llu\n", st->name, st->acquired,
+               st->contended, pct, avg, st->max_hold);
+    }
+}
+
+static int cmd_lockstat(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    lock_stat_dump();
+    return 0;
+}
+SHELL_CMD(lockstat, NULL, "Show lock contention statistics", cmd_lockstat);
+
+// ===============================================================================
+// TTAS 自旋锁
+// 先用普通读自旋等锁释放，只有看到空闲时才执行 amoswap，减少缓存行争抢
+// ===============================================================================
+void spin_lock_init(spinlock_t *lock, lock_stat_t *stat)
+{
+    lock->locked = 0;
+    lock->stat   = stat;
+}
+
+void spin_lock(spinlock_t *lock)
+{
+    bool     contended = false;
+    uint32_t backoff   = BACKOFF_MIN;
+
+    while (atomic_swap32(&lock->locked, 1)) {
+        contended = true;
+        do {
+            for (uint32_t i = 0; i < backoff; i++) {
+                cpu_relax();
+            }
+            if (backoff < BACKOFF_MAX) {
+                backoff <<= 1;
+            }
+        } while (READ_ONCE(lock->locked));
+    }
+
+    lock_stat_acquired(lock->stat, contended);
+}
+
+bool spin_trylock(spinlock_t *lock)
+{
+    if (READ_ONCE(lock->locked) || atomic_swap32(&lock->locked, 1)) {
+        return false;
+    }
+    lock_stat_acquired(lock->stat, false);
+    return true;
+}
+
+void spin_unlock(spinlock_t *lock)
+{
+    lock_stat_release(lock->stat);
+    smp_store_release(&lock->locked, 0);
+}
+
+// ===============================================================================
+// 排号锁
+// 等待时间按前面排队的人数退避，减少对 owner 所在缓存行的读取
+// ===============================================================================
+void ticket_lock_init(ticket_lock_t *lock, lock_stat_t *stat)
+{
+    lock->next  = 0;
+    lock->owner = 0;
+    lock->stat  = stat;
+}
+
+void ticket_lock(ticket_lock_t *lock)
+{
+    uint32_t ticket    = atomic_fetch_add32(&lock->next, 1);
+    bool     contended = false;
+
+    for (;;) {
+        uint32_t owner = smp_load_acquire(&lock->owner);
+        if (owner == ticket) {
+            break;
+        }
+        contended = true;
+        for (uint32_t i = 0; i < (ticket - owner) * BACKOFF_MIN; i++) {
+            cpu_relax();
+        }
+    }
+
+    lock_stat_acquired(lock->stat, contended);
+}
+
+void ticket_unlock(ticket_lock_t *lock)
+{
+    lock_stat_release(lock->stat);
+    smp_store_release(&lock->owner, lock->owner + 1);
+}
+
+// ===============================================================================
+// MCS 队列锁
+// 等待者把自己的节点挂到队尾，只在自己的 locked 字段上自旋，
+// 释放时由持有者直接把锁交给后继
+// ===============================================================================
+void mcs_lock_init(mcs_lock_t *lock, lock_stat_t *stat)
+{
+    lock->tail = 0;
+    lock->stat = stat;
+}
+
+void mcs_lock(mcs_lock_t *lock, mcs_node_t *node)
+{
+    node->next   = 0;
+    node->locked = 1;
+
+    mcs_node_t *prev = (mcs_node_t *)atomic_swap(&lock->tail, (uint64_t)node);
+    bool contended   = (prev != NULL);
+
+    if (prev) {
+        WRITE_ONCE(prev->next, (uint64_t)node);
+        while (smp_load_acquire(&node->locked)) {
+            cpu_relax();
+        }
+    }
+
+    lock_stat_acquired(lock->stat, contended);
+}
+
+void mcs_unlock(mcs_lock_t *lock, mcs_node_t *node)
+{
+    mcs_node_t *next = (mcs_node_t *)READ_ONCE(node->next);
+
+    lock_stat_release(lock->stat);
+
+    if (!next) {
+        // 没有后继：队尾仍是自己时直接清空
+        if (atomic_cmpxchg(&lock->tail, (uint64_t)node, 0) == (uint64_t)node) {
+            return;
+        }
+        // 有新的等待者正在挂入，等它写好 next
+        while (!(next = (mcs_node_t *)READ_ONCE(node->next))) {
+            cpu_relax();
+        }
+    }
+
+    smp_store_release(&next->locked, 0);
+}
+
+// ===============================================================================
+// 多 hart 锁竞争测试
+// ===============================================================================
+#define LOCK_BENCH_ITERS    20000
+#define LOCK_BENCH_HOLD     16          // 临界区内的空转次数
+#define LOCK_BENCH_GAP      32          // 两次加锁之间的空转次数
+
+enum {
+    LOCK_BENCH_SPIN,
+    LOCK_BENCH_TICKET,
+    LOCK_BENCH_MCS,
+    LOCK_BENCH_NR,
+};
+
+static const char *lock_bench_names[LOCK_BENCH_NR] = {
+    "spinlock", "ticket", "mcs",
+};
+
+typedef struct {
+    int kind;
+    uint64_t harts;
+    volatile uint64_t arrived;
+    uint64_t cycles[MAX_HARTS];
+} lock_bench_t;
+
+static spinlock_t    bench_spin;
+static ticket_lock_t bench_ticket;
+static mcs_lock_t    bench_mcs;
+static lock_stat_t   bench_stats[LOCK_BENCH_NR];
+static volatile uint64_t bench_counter;
+
+static inline void bench_spin_wait(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        cpu_relax();
+    }
+}
+
+// 在 IPI 上下文中运行，不能使用浮点
+static void lock_bench_worker(void *arg)
+{
+    lock_bench_t *b = arg;
+    mcs_node_t    node;
+
+    // 所有 hart 到齐后同时开始
+    atomic_fetch_add(&b->arrived, 1);
+    while (READ_ONCE(b->arrived) < b->harts) {
+        cpu_relax();
+    }
+
+    uint64_t start = READ_CYCLE();
+    for (int i = 0; i < LOCK_BENCH_ITERS; i++) {
+        switch (b->kind) {
+            case LOCK_BENCH_SPIN:
+                spin_lock(&bench_spin);
+                bench_counter++;
+                bench_spin_wait(LOCK_BENCH_HOLD);
+                spin_unlock(&bench_spin);
+                break;
+            case LOCK_BENCH_TICKET:
+                ticket_lock(&bench_ticket);
+                bench_counter++;
+                bench_spin_wait(LOCK_BENCH_HOLD);
+                ticket_unlock(&bench_ticket);
+                break;
+            case LOCK_BENCH_MCS:
+                mcs_lock(&bench_mcs, &node);
+                bench_counter++;
+                bench_spin_wait(LOCK_BENCH_HOLD);
+                mcs_unlock(&bench_mcs, &node);
+                break;
+            default:
+                break;
+        }
+        bench_spin_wait(LOCK_BENCH_GAP);
+    }
+    b->cycles[this_hart_id()] = READ_CYCLE() - start;
+}
+
+void lock_bench(void)
+{
+    static bool  inited;
+    uint64_t     mask  = READ_ONCE(smp_online_mask);
+    uint64_t     harts = smp_num_online();
+    lock_bench_t b;
+
+    if (!inited) {
+        spin_lock_init(&bench_spin, &bench_stats[LOCK_BENCH_SPIN]);
+        ticket_lock_init(&bench_ticket, &bench_stats[LOCK_BENCH_TICKET]);
+        mcs_lock_init(&bench_mcs, &bench_stats[LOCK_BENCH_MCS]);
+        for (int k = 0; k < LOCK_BENCH_NR; k++) {
+            lock_stat_register(&bench_stats[k], lock_bench_names[k]);
+        }
+        inited = true;
+    }
+
+    logger("=== Lock Contention Benchmark ===\n");
+    logger("  %llu hart(s), %d iterations each, hold %d / gap %d relax\n", harts,
+           LOCK_BENCH_ITERS, LOCK_BENCH_HOLD, LOCK_BENCH_GAP);
+    logger("  %-10s %12s %10s %6s %10s %10s %s\n", "lock", "wall cyc", "cyc/op", "cont%",
+           "max hold", "spread", "check");
+
+    for (int k = 0; k < LOCK_BENCH_NR; k++) {
+        lock_stat_reset(&bench_stats[k]);
+        bench_counter = 0;
+
+        b.kind    = k;
+        b.harts   = harts;
+        b.arrived = 0;
+        for (int h = 0; h < MAX_HARTS; h++) {
+            b.cycles[h] = 0;
+        }
+
+        smp_call_function(mask, lock_bench_worker, &b, true);
+
+        // 最慢的 hart 决定总耗时，最快与最慢的差反映公平性
+        uint64_t max = 0;
+        uint64_t min = ~0UL;
+        for (int h = 0; h < MAX_HARTS; h++) {
+            if (!(mask & HART_MASK(h))) {
+                continue;
+            }
+            if (b.cycles[h] > max) {
+                max = b.cycles[h];
+            }
+            if (b.cycles[h] < min) {
+                min = b.cycles[h];
+            }
+        }
+
+        lock_stat_t *st  = &bench_stats[k];
+        uint64_t     ops = harts * LOCK_BENCH_ITERS;
+        logger("  %-10s %12llu %10llu %5llu%% %10llu %10llu %s\n", lock_bench_names[k], max,
+               max / ops, st->contended * 100 / st->acquired, st->max_hold, max - min,
+               bench_counter == ops ? "ok" : "FAIL");
+    }
+}
+
+static int cmd_lockbench(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    lock_bench();
+    return 0;
+}
+SHELL_CMD(lockbench, NULL, "Run multi-hart lock contention benchmark", cmd_lockbench);
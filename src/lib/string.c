@@ -59,14 +59,25 @@ char *strcat(char *dst, const char *src)
     return dst;
 }
 
+// c 按 char 比较（与 C 标准一致），否则 char 有符号时查不到 0x80 以上的字节
 char *strchr(const char *s, int c)
 {
     while (*s) {
-        if (*s == c)
+        if (*s == (char)c)
             return (char *)s;
         s++;
     }
-    return (c == '\0') ? (char *)s : NULL;
+    return ((char)c == '\0') ? (char *)s : NULL;
+}
+
+char *strrchr(const char *s, int c)
+{
+    const char *last = NULL;
+    do {
+        if (*s == (char)c)
+            last = s;
+    } while (*s++);
+    return (char *)last;
 }
 
 char *strstr(const char *haystack, const char *needle)
@@ -0,0 +1,433 @@
+/*
+ * RISC-V testos 内核地址检查（KASAN）运行时
+ *
+ * 只在 make KASAN=1 时编译进内核。本文件自身不插桩（见 Makefile），
+ * 编译器生成的检查调用都汇集到 kasan_check()：先确认地址落在影子覆盖的 RAM 内，
+ * 设备寄存器、影子内存本身、RAM 之外以及各进程共用 VA 的用户窗口一律放行。
+ * 故意制造错误的自检在插桩编译的 kasan_test.c 中。
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "kasan.h"
+
+#ifdef CONFIG_KASAN
+
+#include "atomic.h"
+#include "fdt.h"
+#include "kstack.h"
+#include "mem.h"
+#include "percpu.h"
+#include "shell.h"
+#include "string.h"
+#include "lib/logger.h"
+
+_Static_assert(KASAN_SHADOW_OFFSET == CONFIG_KASAN_SHADOW_OFFSET,
+               "Makefile KASAN_SHADOW_OFFSET does not match include/kasan.h");
+
+#define KASAN_SHADOW_END    (KASAN_SHADOW_START + ((KASAN_SHADOW_START - MEM_START) >> KASAN_SHADOW_SCALE_SHIFT))
+#define KASAN_REPORT_MAX    16      // 详细打印的报告数，之后只计数
+
+static bool              kasan_ready;
+static volatile uint64_t kasan_reports;
+static bool              kasan_in_report[MAX_HARTS];
+
+static inline int8_t *kasan_mem_to_shadow(uintptr_t addr)
+{
+    return (int8_t *)((addr >> KASAN_SHADOW_SCALE_SHIFT) + KASAN_SHADOW_OFFSET);
+}
+
+bool kasan_enabled(void)
+{
+    return READ_ONCE(kasan_ready);
+}
+
+uint64_t kasan_report_count(void)
+{
+    return READ_ONCE(kasan_reports);
+}
+
+// ===============================================================================
+// 影子标记
+// ===============================================================================
+
+static void kasan_fill_shadow(uintptr_t addr, size_t size, int8_t value)
+{
+    int8_t *s   = kasan_mem_to_shadow(addr);
+    int8_t *end = kasan_mem_to_shadow(addr + size);
+
+    while (s < end) {
+        *s++ = value;
+    }
+}
+
+void kasan_poison(const void *addr, size_t size, uint8_t value)
+{
+    if (!kasan_ready || !size) {
+        return;
+    }
+    kasan_fill_shadow((uintptr_t)addr, size, (int8_t)value);
+}
+
+void kasan_unpoison(const void *addr, size_t size)
+{
+    uintptr_t a = (uintptr_t)addr;
+
+    if (!kasan_ready || !size) {
+        return;
+    }
+    kasan_fill_shadow(a, ALIGN_DOWN(size, KASAN_GRANULE), 0);
+    if (size & (KASAN_GRANULE - 1)) {
+        *kasan_mem_to_shadow(a + size) = size & (KASAN_GRANULE - 1);
+    }
+}
+
+void kasan_alloc_object(void *raw, void *obj, size_t size, size_t total)
+{
+    uintptr_t start = (uintptr_t)raw;
+    uintptr_t tail  = (uintptr_t)obj + ALIGN_UP(size, KASAN_GRANULE);
+
+    kasan_poison(raw, (uintptr_t)obj - start, KASAN_HEAP_REDZONE);
+    kasan_unpoison(obj, size);
+    kasan_poison((void *)tail, start + total - tail, KASAN_HEAP_REDZONE);
+}
+
+// ===============================================================================
+// 报告
+// ===============================================================================
+
+static const char *kasan_bug_type(int8_t shadow)
+{
+    switch ((uint8_t)shadow) {
+        case KASAN_HEAP_REDZONE:          return "heap-out-of-bounds";
+        case KASAN_HEAP_FREE:             return "use-after-free";
+        case KASAN_PAGE_FREE:             return "use-after-free-page";
+        case KASAN_GLOBAL_REDZONE:        return "global-out-of-bounds";
+        case KASAN_STACK_LEFT:
+        case KASAN_STACK_MID:
+        case KASAN_STACK_RIGHT:           return "stack-out-of-bounds";
+        case KASAN_STACK_USE_AFTER_SCOPE: return "stack-use-after-scope";
+        default:                          return "wild-access";
+    }
+}
+
+// 打印出错地址前后的影子，出错的那个字节用 [] 标出
+static void kasan_dump_shadow(uintptr_t addr)
+{
+    int8_t   *bad  = kasan_mem_to_shadow(addr);
+    uintptr_t line = ALIGN_DOWN(addr, 16 * KASAN_GRANULE) - 16 * KASAN_GRANULE;
+
+    logger_error("  shadow around 0x%llx:\n", addr);
+    for (int row = 0; row < 3; row++, line += 16 * KASAN_GRANULE) {
+        char  buf[80];
+        char *p = buf;
+
+        if (line < MEM_START || line >= KASAN_SHADOW_START) {
+            continue;
+        }
+        for (int i = 0; i < 16; i++) {
+            int8_t *s = kasan_mem_to_shadow(line) + i;
+            uint8_t v = (uint8_t)*s;
+
+            *p++ = s == bad ? '[' : ' ';
+            *p++ = "0123456789abcdef"[v >> 4];
+            *p++ = "0123456789abcdef"[v & 0xf];
+            *p++ = s == bad ? ']' : ' ';
+        }
+        *p = '\0';
+        logger_error("    0x%llx:%s\n", line, buf);
+    }
+}
+
+static void kasan_report(uintptr_t addr, size_t size, bool write, uintptr_t ip, int8_t *bad,
+                         const char *type)
+{
+    uint64_t hart = this_hart_id();
+    uint64_t n    = atomic_fetch_add(&kasan_reports, 1);
+
+    if (n >= KASAN_REPORT_MAX || kasan_in_report[hart]) {
+        return;
+    }
+    kasan_in_report[hart] = true;
+
+    // 部分可访问的字节看它后面一个字节才知道越界到了哪里
+    int8_t shadow = *bad;
+    if (shadow > 0 && shadow < (int8_t)KASAN_GRANULE) {
+        shadow = bad[1];
+    }
+    if (!type) {
+        type = kasan_bug_type(shadow);
+    }
+    uintptr_t bad_addr = ((uintptr_t)bad - KASAN_SHADOW_OFFSET) << KASAN_SHADOW_SCALE_SHIFT;
+    if (bad_addr < addr) {
+        bad_addr = addr;
+    }
+
+    logger_error("==================================================================\n");
+    logger_error("KASAN: %s on address 0x%llx\n", type, addr);
+    if (size) {
+        logger_error("%s of size %llu by ip 0x%llx on hart %llu\n", write ? "Write" : "Read",
+                     (uint64_t)size, ip, hart);
+    } else {
+        logger_error("free() by ip 0x%llx on hart %llu\n", ip, hart);
+    }
+    kasan_dump_shadow(bad_addr);
+    if (n + 1 == KASAN_REPORT_MAX) {
+        logger_error("KASAN: further reports are only counted ('kasan' shows the total)\n");
+    }
+    logger_error("==================================================================\n");
+
+    kasan_in_report[hart] = false;
+}
+
+// ===============================================================================
+// 访问检查
+// ===============================================================================
+
+// 返回第一个不可访问字节的影子，全部可访问时返回 NULL
+static inline int8_t *kasan_bad_shadow(uintptr_t addr, size_t size)
+{
+    int8_t *s    = kasan_mem_to_shadow(addr);
+    int8_t *last = kasan_mem_to_shadow(addr + size - 1);
+
+    // 除最后一个以外的 8 字节组都必须整组可访问
+    for (; s < last; s++) {
+        if (*s) {
+            return s;
+        }
+    }
+    if (*last && (int8_t)((addr + size - 1) & (KASAN_GRANULE - 1)) >= *last) {
+        return last;
+    }
+    return NULL;
+}
+
+static inline void kasan_check(uintptr_t addr, size_t size, bool write, uintptr_t ip)
+{
+    if (!READ_ONCE(kasan_ready) || !size) {
+        return;
+    }
+    // 设备寄存器、影子内存和 RAM 之外的地址不检查
+    if (addr < MEM_START || addr + size > KASAN_SHADOW_START || addr + size < addr) {
+        return;
+    }
+    // 用户窗口也不检查：影子按虚拟地址索引，同一个 VA（如 EXEC_STACK_TOP 下的栈）
+    // 在每个地址空间中是不同的页，没有正常返回的系统调用栈帧留下的红区会被下一个进程继承
+    if (addr < USER_BASE + USER_SIZE && addr + size > USER_BASE) {
+        return;
+    }
+
+    int8_t *bad = kasan_bad_shadow(addr, size);
+    if (bad) {
+        kasan_report(addr, size, write, ip, bad, NULL);
+    }
+}
+
+#define _RET_IP_    ((uintptr_t)__builtin_return_address(0))
+
+#define DEFINE_ASAN_LOAD_STORE(size)                                                         \
+    void __asan_load##size##_noabort(uintptr_t addr);                                        \
+    void __asan_load##size##_noabort(uintptr_t addr)                                         \
+    {                                                                                        \
+        kasan_check(addr, size, false, _RET_IP_);                                            \
+    }                                                                                        \
+    void __asan_store##size##_noabort(uintptr_t addr);                                       \
+    void __asan_store##size##_noabort(uintptr_t addr)                                        \
+    {                                                                                        \
+        kasan_check(addr, size, true, _RET_IP_);                                             \
+    }
+
+DEFINE_ASAN_LOAD_STORE(1)
+DEFINE_ASAN_LOAD_STORE(2)
+DEFINE_ASAN_LOAD_STORE(4)
+DEFINE_ASAN_LOAD_STORE(8)
+DEFINE_ASAN_LOAD_STORE(16)
+
+void __asan_loadN_noabort(uintptr_t addr, size_t size);
+void __asan_loadN_noabort(uintptr_t addr, size_t size)
+{
+    kasan_check(addr, size, false, _RET_IP_);
+}
+
+void __asan_storeN_noabort(uintptr_t addr, size_t size);
+void __asan_storeN_noabort(uintptr_t addr, size_t size)
+{
+    kasan_check(addr, size, true, _RET_IP_);
+}
+
+// longjmp、proc_exit 等不返回的调用跳过了沿途函数清除栈红区的尾声，
+// 把当前栈 sp 以下的部分整体标记为可访问
+void __asan_handle_no_return(void);
+void __asan_handle_no_return(void)
+{
+    uintptr_t sp;
+    asm volatile("mv %0, sp" : "=r"(sp));
+
+    kstack_t *ks = kstack_find(sp);
+    if (ks && sp > ks->base) {
+        kasan_unpoison((void *)ks->base, ALIGN_DOWN(sp, KASAN_GRANULE) - ks->base);
+    }
+}
+
+// ===============================================================================
+// 全局变量红区
+// 编译器在每个全局变量后补齐红区，并生成一个构造函数登记它们；
+// 内核没有 C 运行时，由 kasan_init 遍历 .init_array 调用这些构造函数
+// ===============================================================================
+
+// 与 GCC 生成的描述符布局一致（ASan ABI 版本 5）
+struct kasan_global {
+    const void    *beg;
+    size_t         size;
+    size_t         size_with_redzone;
+    const char    *name;
+    const char    *module_name;
+    unsigned long  has_dynamic_init;
+    void          *location;
+    char          *odr_indicator;
+};
+
+void __asan_register_globals(struct kasan_global *globals, size_t n);
+void __asan_register_globals(struct kasan_global *globals, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uintptr_t beg     = (uintptr_t)globals[i].beg;
+        size_t    aligned = ALIGN_UP(globals[i].size, KASAN_GRANULE);
+
+        kasan_unpoison((void *)beg, globals[i].size);
+        kasan_poison((void *)(beg + aligned), globals[i].size_with_redzone - aligned,
+                     KASAN_GLOBAL_REDZONE);
+    }
+}
+
+void __asan_unregister_globals(struct kasan_global *globals, size_t n);
+void __asan_unregister_globals(struct kasan_global *globals, size_t n)
+{
+    (void)globals; (void)n;
+}
+
+typedef void (*kasan_ctor_t)(void);
+extern kasan_ctor_t __init_array_start[];
+extern kasan_ctor_t __init_array_end[];
+
+// ===============================================================================
+// 堆对象释放
+// ===============================================================================
+
+void kasan_free_object(void *ptr, uintptr_t ip)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+
+    if (!kasan_ready || addr < MEM_START + KASAN_GRANULE || addr >= KASAN_SHADOW_START) {
+        return;
+    }
+
+    int8_t *s    = kasan_mem_to_shadow(addr);
+    int8_t  left = *kasan_mem_to_shadow(addr - KASAN_GRANULE);
+
+    if ((uint8_t)*s == KASAN_HEAP_FREE) {
+        kasan_report(addr, 0, true, ip, s, "double-free");
+        return;
+    }
+    if (left == 0 && *s == 0) {
+        // 启用检查之前分配的对象没有红区，无从判断
+        return;
+    }
+    if ((addr & (KASAN_GRANULE - 1)) || (uint8_t)left != KASAN_HEAP_REDZONE) {
+        kasan_report(addr, 0, true, ip, s, "invalid-free");
+        return;
+    }
+
+    // 对象长度从影子恢复：连续的 0 加上末尾一个部分可访问的字节
+    int8_t *end = s;
+    while (*end == 0) {
+        end++;
+    }
+    if (*end > 0 && *end < (int8_t)KASAN_GRANULE) {
+        end++;
+    }
+    kasan_fill_shadow(addr, (size_t)(end - s) << KASAN_SHADOW_SCALE_SHIFT,
+                      (int8_t)KASAN_HEAP_FREE);
+}
+
+// ===============================================================================
+// 初始化
+// ===============================================================================
+
+static bool kasan_overlaps_shadow(uintptr_t start, uintptr_t end)
+{
+    return start < KASAN_SHADOW_END && end > KASAN_SHADOW_START;
+}
+
+// bootloader 常把设备树放在 RAM 顶部（QEMU virt -m 256M 时在 0x8FE00000），
+// 落在为影子预留的 32MB 中时搬到堆顶并保留，之后的 fdt_* 都读副本
+static int kasan_relocate_fdt(uintptr_t dtb)
+{
+    size_t    size = fdt_totalsize();
+    uintptr_t dst  = ALIGN_DOWN(KASAN_SHADOW_START - size, PAGE_SIZE);
+
+    if (dtb + size <= KASAN_SHADOW_START || dtb >= MEM_START + MEM_SIZE) {
+        return 0;
+    }
+    if (mem_reserve(dst, KASAN_SHADOW_START) < 0) {
+        return -1;
+    }
+    memmove((void *)dst, (const void *)dtb, size);
+    fdt_init(dst);
+    logger_info("KASAN: device tree moved from 0x%llx to 0x%llx (%llu bytes)\n", dtb,
+                (uint64_t)dst, (uint64_t)size);
+    return 0;
+}
+
+void kasan_init(uintptr_t dtb)
+{
+    uint64_t initrd_start = 0, initrd_end = 0;
+
+    // 影子内存要清零，不能覆盖 bootloader 放在 RAM 顶部的设备树和 initrd
+    if (dtb && fdt_totalsize() && kasan_relocate_fdt(dtb) < 0) {
+        logger_warn("KASAN: cannot move device tree at 0x%llx out of the shadow, disabled\n", dtb);
+        return;
+    }
+    if (fdt_getprop_u64("/chosen", "linux,initrd-start", &initrd_start) == 0 &&
+        fdt_getprop_u64("/chosen", "linux,initrd-end", &initrd_end) == 0 &&
+        kasan_overlaps_shadow(initrd_start, initrd_end)) {
+        logger_warn("KASAN: initrd at 0x%llx overlaps the shadow, disabled\n", initrd_start);
+        return;
+    }
+
+    for (uint64_t *p = (uint64_t *)KASAN_SHADOW_START; (uintptr_t)p < KASAN_SHADOW_END; p++) {
+        *p = 0;
+    }
+    kasan_ready = true;
+
+    for (kasan_ctor_t *ctor = __init_array_start; ctor < __init_array_end; ctor++) {
+        (*ctor)();
+    }
+
+    logger_info("KASAN: shadow 0x%llx-0x%llx covers 0x%llx-0x%llx\n",
+                (uint64_t)KASAN_SHADOW_START, (uint64_t)KASAN_SHADOW_END, (uint64_t)MEM_START,
+                (uint64_t)KASAN_SHADOW_START);
+}
+
+// ===============================================================================
+// shell 命令
+// ===============================================================================
+
+static int cmd_kasan(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "test") == 0) {
+        if (!kasan_ready) {
+            logger_error("kasan: not enabled\n");
+            return -1;
+        }
+        kasan_selftest();
+        return 0;
+    }
+
+    logger("KASAN: %s, shadow 0x%llx-0x%llx, %llu reports\n", kasan_ready ? "enabled" : "disabled",
+           (uint64_t)KASAN_SHADOW_START, (uint64_t)KASAN_SHADOW_END, kasan_reports);
+    return 0;
+}
+SHELL_CMD(kasan, "[test]", "Show KASAN state, or trigger deliberate bugs with 'test'", cmd_kasan);
+
+#endif /* CONFIG_KASAN */
@@ -0,0 +1,60 @@
+/*
+ * RISC-V testos KASAN 自检
+ *
+ * 与 kasan.c 不同，本文件按普通内核代码插桩编译，下面故意制造的错误访问
+ * 由编译器插入的检查发现。用 volatile 下标防止编译器在编译期就看出越界。
+ */
+
+#include "types.h"
+#include "kasan.h"
+
+#ifdef CONFIG_KASAN
+
+#include "mem.h"
+#include "lib/logger.h"
+
+static volatile int kasan_test_idx;
+static char         kasan_test_global[13];
+
+static void kasan_test_stack(void)
+{
+    char buf[24];
+
+    buf[0] = 0;
+    kasan_test_idx = sizeof(buf);
+    logger("kasan test: stack out-of-bounds read\n");
+    (void)((volatile char *)buf)[kasan_test_idx];
+}
+
+void kasan_selftest(void)
+{
+    uint64_t before = kasan_report_count();
+    char    *p      = malloc(13);
+
+    if (!p) {
+        logger_error("kasan test: allocation failed\n");
+        return;
+    }
+
+    kasan_test_idx = 13;
+    logger("kasan test: heap out-of-bounds read\n");
+    (void)((volatile char *)p)[kasan_test_idx];
+
+    free(p);
+    kasan_test_idx = 0;
+    logger("kasan test: use-after-free write\n");
+    ((volatile char *)p)[kasan_test_idx] = 1;
+
+    logger("kasan test: double free\n");
+    free(p);
+
+    kasan_test_stack();
+
+    kasan_test_idx = sizeof(kasan_test_global);
+    logger("kasan test: global out-of-bounds read\n");
+    (void)((volatile char *)kasan_test_global)[kasan_test_idx];
+
+    logger("kasan test: %llu of 5 bugs detected\n", kasan_report_count() - before);
+}
+
+#endif /* CONFIG_KASAN */
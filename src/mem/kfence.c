@@ -0,0 +1,445 @@
+/*
+ * RISC-V testos 抽样内存错误检测（KFENCE）
+ *
+ * 对象池是一段连续的页：[保护页][对象页][保护页][对象页]...[保护页]，
+ * 偶数页是保护页，奇数页 2k+1 属于第 k 个对象。空闲和已释放对象的页都不映射，
+ * 分配时映射、释放时取消映射；已释放的对象排到空闲队列末尾，尽量晚被重用，
+ * 释放后使用被发现的时间窗口因此最长。
+ *
+ * 映射和取消映射只刷新本 hart 的 TLB：在中断里分配或释放时不能同步等待其他 hart。
+ * 其他 hart 残留的旧映射最多让那里的释放后使用漏报一段时间；残留的无效表项
+ * 造成的缺页在 kfence_handle_fault() 中识别为虚假缺页，刷新后重试。
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "kfence.h"
+#include "atomic.h"
+#include "fdt.h"
+#include "initcall.h"
+#include "mem.h"
+#include "mmu.h"
+#include "percpu.h"
+#include "shell.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "string.h"
+#include "timer.h"
+#include "lib/logger.h"
+
+#define KFENCE_POOL_PAGES   (2 * KFENCE_NUM_OBJECTS + 1)
+#define KFENCE_CANARY(addr) ((uint8_t)(0xaa ^ ((addr) & 0x7)))
+
+enum {
+    KFENCE_UNUSED,
+    KFENCE_ALLOCATED,
+    KFENCE_FREED,
+};
+
+typedef struct kfence_obj {
+    uintptr_t          page;
+    uintptr_t          addr;        // 交给调用者的地址（对象贴着页的一端）
+    size_t             size;
+    uint8_t            state;
+    uint8_t            alloc_hart;
+    uint8_t            free_hart;
+    uintptr_t          alloc_ip;
+    uintptr_t          free_ip;
+    uint64_t           alloc_tick;
+    pte_t             *pte;
+    struct kfence_obj *next;        // 空闲队列
+} kfence_obj_t;
+
+volatile uint32_t kfence_armed;
+
+static uintptr_t     kfence_pool;
+static kfence_obj_t  kfence_objs[KFENCE_NUM_OBJECTS];
+static pte_t        *kfence_guard_pte[KFENCE_NUM_OBJECTS + 1];
+static kfence_obj_t *kfence_free_head;
+static kfence_obj_t *kfence_free_tail;
+static spinlock_t    kfence_lock;
+static lock_stat_t   kfence_lock_stat;
+
+static uint64_t kfence_interval;    // 抽样间隔（时钟节拍），0 表示不抽样
+static uint64_t kfence_next_tick;
+
+static struct {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t missed;                // 抽中时池已空
+    uint64_t reports;
+    uint64_t spurious;              // 其他 hart 的旧 TLB 表项造成的缺页
+} kfence_stats;
+
+static inline bool kfence_in_pool(uintptr_t addr)
+{
+    uintptr_t pool = READ_ONCE(kfence_pool);
+
+    return pool && addr - pool < KFENCE_POOL_PAGES * PAGE_SIZE;
+}
+
+static inline void kfence_set_pte(pte_t *pte, uintptr_t page, bool present)
+{
+    WRITE_ONCE(*pte, present ? PA_TO_PTE(page) | PTE_KERNEL_RW : 0);
+    SFENCE_VMA(page);
+}
+
+// 需持有 kfence_lock
+static void kfence_queue_free(kfence_obj_t *obj)
+{
+    obj->next = NULL;
+    if (kfence_free_tail) {
+        kfence_free_tail->next = obj;
+    } else {
+        kfence_free_head = obj;
+    }
+    kfence_free_tail = obj;
+}
+
+// ===============================================================================
+// 报告
+// ===============================================================================
+
+static void kfence_report_obj(const kfence_obj_t *obj)
+{
+    logger_error("  object 0x%llx, size %llu, allocated by ip 0x%llx on hart %d at tick %llu\n",
+                 obj->addr, (uint64_t)obj->size, obj->alloc_ip, obj->alloc_hart, obj->alloc_tick);
+    if (obj->state == KFENCE_FREED) {
+        logger_error("  freed by ip 0x%llx on hart %d\n", obj->free_ip, obj->free_hart);
+    }
+}
+
+static void kfence_report(const char *type, uintptr_t addr, uintptr_t ip, const kfence_obj_t *obj)
+{
+    kfence_stats.reports++;
+    logger_error("==================================================================\n");
+    logger_error("KFENCE: %s at 0x%llx by ip 0x%llx on hart %llu\n", type, addr, ip,
+                 this_hart_id());
+    if (obj && obj->state != KFENCE_UNUSED) {
+        kfence_report_obj(obj);
+    }
+    logger_error("==================================================================\n");
+}
+
+// ===============================================================================
+// 分配与释放
+// ===============================================================================
+
+void *kfence_alloc(size_t size, size_t align, uintptr_t ip)
+{
+    if (!kfence_pool || size > PAGE_SIZE || align > PAGE_SIZE ||
+        !atomic_swap32(&kfence_armed, 0)) {
+        return NULL;
+    }
+
+    uint64_t      flags = spin_lock_irqsave(&kfence_lock);
+    kfence_obj_t *obj   = kfence_free_head;
+
+    if (!obj) {
+        kfence_stats.missed++;
+        spin_unlock_irqrestore(&kfence_lock, flags);
+        return NULL;
+    }
+    kfence_free_head = obj->next;
+    if (!kfence_free_head) {
+        kfence_free_tail = NULL;
+    }
+
+    // 交替贴着页尾和页首放置，分别抓向后和向前的越界
+    uintptr_t addr = obj->page;
+    if (kfence_stats.allocs++ & 1) {
+        addr = ALIGN_DOWN(obj->page + PAGE_SIZE - size, align);
+    }
+
+    kfence_set_pte(obj->pte, obj->page, true);
+    for (uintptr_t p = obj->page; p < addr; p++) {
+        *(uint8_t *)p = KFENCE_CANARY(p);
+    }
+    for (uintptr_t p = addr + size; p < obj->page + PAGE_SIZE; p++) {
+        *(uint8_t *)p = KFENCE_CANARY(p);
+    }
+
+    obj->addr       = addr;
+    obj->size       = size;
+    obj->state      = KFENCE_ALLOCATED;
+    obj->alloc_hart = this_hart_id();
+    obj->alloc_ip   = ip;
+    obj->alloc_tick = timer_get_system_ticks();
+    spin_unlock_irqrestore(&kfence_lock, flags);
+
+    return (void *)addr;
+}
+
+// 检查对象两侧的校验字节，返回第一个被改写的地址
+static uintptr_t kfence_check_canary(const kfence_obj_t *obj)
+{
+    for (uintptr_t p = obj->page; p < obj->addr; p++) {
+        if (*(uint8_t *)p != KFENCE_CANARY(p)) {
+            return p;
+        }
+    }
+    for (uintptr_t p = obj->addr + obj->size; p < obj->page + PAGE_SIZE; p++) {
+        if (*(uint8_t *)p != KFENCE_CANARY(p)) {
+            return p;
+        }
+    }
+    return 0;
+}
+
+bool kfence_free(void *ptr, uintptr_t ip)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+
+    if (!kfence_in_pool(addr)) {
+        return false;
+    }
+
+    size_t        page  = (addr - kfence_pool) / PAGE_SIZE;
+    kfence_obj_t *obj   = (page & 1) ? &kfence_objs[page / 2] : NULL;
+    uint64_t      flags = spin_lock_irqsave(&kfence_lock);
+
+    if (!obj || obj->state == KFENCE_UNUSED || (obj->state == KFENCE_ALLOCATED && addr != obj->addr)) {
+        kfence_report("invalid free", addr, ip, obj);
+    } else if (obj->state == KFENCE_FREED) {
+        kfence_report("double free", addr, ip, obj);
+    } else {
+        uintptr_t bad = kfence_check_canary(obj);
+        if (bad) {
+            kfence_report("memory corruption next to object", bad, ip, obj);
+        }
+
+        obj->state     = KFENCE_FREED;
+        obj->free_hart = this_hart_id();
+        obj->free_ip   = ip;
+        kfence_stats.frees++;
+
+        // 越界访问时打开过的两侧保护页也一并恢复
+        kfence_set_pte(obj->pte, obj->page, false);
+        kfence_set_pte(kfence_guard_pte[page / 2], obj->page - PAGE_SIZE, false);
+        kfence_set_pte(kfence_guard_pte[page / 2 + 1], obj->page + PAGE_SIZE, false);
+        kfence_queue_free(obj);
+    }
+
+    spin_unlock_irqrestore(&kfence_lock, flags);
+    return true;
+}
+
+// ===============================================================================
+// 缺页处理
+// ===============================================================================
+
+bool kfence_handle_fault(uintptr_t addr, uintptr_t pc, bool write)
+{
+    if (!kfence_in_pool(addr)) {
+        return false;
+    }
+
+    size_t    page      = (addr - kfence_pool) / PAGE_SIZE;
+    uintptr_t page_addr = kfence_pool + page * PAGE_SIZE;
+    pte_t    *pte       = (page & 1) ? kfence_objs[page / 2].pte : kfence_guard_pte[page / 2];
+    uint64_t  flags     = spin_lock_irqsave(&kfence_lock);
+
+    if (READ_ONCE(*pte) & PTE_V) {
+        // 页已经映射：本 hart 的 TLB 里还是旧的无效表项
+        kfence_stats.spurious++;
+        SFENCE_VMA(page_addr);
+        spin_unlock_irqrestore(&kfence_lock, flags);
+        return true;
+    }
+
+    if (page & 1) {
+        kfence_obj_t *obj = &kfence_objs[page / 2];
+        kfence_report(write ? "use-after-free write" : "use-after-free read", addr, pc, obj);
+    } else {
+        // 保护页：归到离访问地址较近的那个在用对象
+        kfence_obj_t *left  = page > 0 ? &kfence_objs[page / 2 - 1] : NULL;
+        kfence_obj_t *right = page / 2 < KFENCE_NUM_OBJECTS ? &kfence_objs[page / 2] : NULL;
+        kfence_obj_t *obj   = NULL;
+
+        if (left && left->state != KFENCE_ALLOCATED) {
+            left = NULL;
+        }
+        if (right && right->state != KFENCE_ALLOCATED) {
+            right = NULL;
+        }
+        if (left && right) {
+            obj = addr - (left->addr + left->size) < right->addr - addr ? left : right;
+        } else {
+            obj = left ? left : right;
+        }
+        kfence_report(write ? "out-of-bounds write" : "out-of-bounds read", addr, pc, obj);
+    }
+
+    // 报告一次即可：恢复映射让内核继续运行，释放对象时再取消映射
+    kfence_set_pte(pte, page_addr, true);
+    spin_unlock_irqrestore(&kfence_lock, flags);
+    return true;
+}
+
+// ===============================================================================
+// 抽样
+// ===============================================================================
+
+void kfence_tick(uint64_t ticks)
+{
+    uint64_t interval = READ_ONCE(kfence_interval);
+
+    if (!interval || ticks < kfence_next_tick) {
+        return;
+    }
+    kfence_next_tick = ticks + interval;
+    WRITE_ONCE(kfence_armed, 1);
+}
+
+void kfence_arm(void)
+{
+    if (kfence_pool) {
+        WRITE_ONCE(kfence_armed, 1);
+    }
+}
+
+static void kfence_set_interval(uint64_t ms)
+{
+    uint64_t ticks = ms ? (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS : 0;
+
+    kfence_next_tick = 0;
+    WRITE_ONCE(kfence_interval, ticks);
+}
+
+// ===============================================================================
+// 初始化
+// ===============================================================================
+
+static int kfence_initcall(void)
+{
+    uint64_t ms = bootarg_get_size("kfence", KFENCE_DEFAULT_INTERVAL_MS);
+
+    if (!ms) {
+        logger_info("KFENCE: disabled\n");
+        return 0;
+    }
+
+    uintptr_t pool = (uintptr_t)alloc_pages(KFENCE_POOL_PAGES);
+    if (!pool) {
+        logger_warn("KFENCE: no memory for the object pool\n");
+        return -1;
+    }
+
+    // 先把大页拆开取得每一页的 PTE，之后映射和取消映射只改 PTE
+    for (int i = 0; i < KFENCE_POOL_PAGES; i++) {
+        uintptr_t page = pool + i * PAGE_SIZE;
+        pte_t    *pte  = mmu_walk(mmu_kernel_root(), page, true);
+
+        if (!pte) {
+            logger_warn("KFENCE: cannot split the mapping of 0x%llx\n", page);
+            return -1;
+        }
+        if (i & 1) {
+            kfence_objs[i / 2].page = page;
+            kfence_objs[i / 2].pte  = pte;
+            kfence_queue_free(&kfence_objs[i / 2]);
+        } else {
+            kfence_guard_pte[i / 2] = pte;
+        }
+        *pte = 0;
+        // 已上线的从核可能缓存着原来的大页映射
+        smp_flush_tlb_page(page);
+    }
+
+    spin_lock_init(&kfence_lock, &kfence_lock_stat);
+    lock_stat_register(&kfence_lock_stat, "kfence");
+
+    kfence_pool = pool;
+    kfence_set_interval(ms);
+    logger_info("KFENCE: %d objects at 0x%llx, sampling every %llu ms\n", KFENCE_NUM_OBJECTS,
+                (uint64_t)pool, ms);
+    return 0;
+}
+INITCALL(kfence, INIT_CORE, 0, kfence_initcall, "mmu");
+
+// ===============================================================================
+// shell 命令
+// ===============================================================================
+
+static void kfence_dump(void)
+{
+    uint64_t ticks = timer_get_system_ticks();
+    int      used  = 0;
+
+    logger("=== KFENCE ===\n");
+    if (!kfence_pool) {
+        logger("  disabled (boot with kfence=<ms>)\n");
+        return;
+    }
+    logger("  pool 0x%llx, %d objects, sampling %s", (uint64_t)kfence_pool, KFENCE_NUM_OBJECTS,
+           kfence_interval ? "every " : "off\n");
+    if (kfence_interval) {
+        logger("%llu ms\n", kfence_interval * TIMER_TICK_MS);
+    }
+    logger("  allocs %llu, frees %llu, missed (pool empty) %llu, reports %llu, spurious faults %llu\n",
+           kfence_stats.allocs, kfence_stats.frees, kfence_stats.missed, kfence_stats.reports,
+           kfence_stats.spurious);
+
+    for (int i = 0; i < KFENCE_NUM_OBJECTS; i++) {
+        const kfence_obj_t *obj = &kfence_objs[i];
+
+        if (obj->state != KFENCE_ALLOCATED) {
+            continue;
+        }
+        if (!used++) {
+            logger("  %-18s %6s %-18s %4s %10s\n", "object", "size", "alloc ip", "hart", "age (ms)");
+        }
+        logger("  0x%-16llx %6llu 0x%-16llx %4d %10llu\n", obj->addr, (uint64_t)obj->size,
+               obj->alloc_ip, obj->alloc_hart, (ticks - obj->alloc_tick) * TIMER_TICK_MS);
+    }
+    logger("  %d of %d objects in use\n", used, KFENCE_NUM_OBJECTS);
+}
+
+// 故意越过被抽样对象的边界并在释放后访问，确认两种错误都被报告
+static void kfence_selftest(void)
+{
+    uint64_t before = kfence_stats.reports;
+    volatile int idx;
+
+    kfence_arm();
+    char *p = malloc(24);
+    if (!p || !kfence_in_pool((uintptr_t)p)) {
+        logger_error("kfence test: allocation was not sampled\n");
+        return;
+    }
+
+    // 贴着页首放置时越过前一页，贴着页尾时越过后一页
+    idx = ((uintptr_t)p & (PAGE_SIZE - 1)) ? 24 : -1;
+    logger("kfence test: out-of-bounds read at offset %d\n", idx);
+    (void)((volatile char *)p)[idx];
+
+    free(p);
+    idx = 0;
+    logger("kfence test: use-after-free read\n");
+    (void)((volatile char *)p)[idx];
+
+    logger("kfence test: %llu of 2 bugs detected\n", kfence_stats.reports - before);
+}
+
+static int cmd_kfence(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "test") == 0) {
+        if (!kfence_pool) {
+            logger_error("kfence: disabled\n");
+            return -1;
+        }
+        kfence_selftest();
+        return 0;
+    }
+    if (argc > 1) {
+        if (!kfence_pool) {
+            logger_error("kfence: disabled\n");
+            return -1;
+        }
+        kfence_set_interval(atol(argv[1]));
+    }
+    kfence_dump();
+    return 0;
+}
+SHELL_CMD(kfence, "[ms|test]", "Show KFENCE objects, set the sampling interval, or self-test",
+          cmd_kfence);
@@ -0,0 +1,214 @@
+/*
+ * RISC-V testos 内核栈管理
+ * 保护页 + 填充值水位线统计
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "kstack.h"
+#include "mmu.h"
+#include "mem.h"
+#include "kasan.h"
+#include "initcall.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+// boot.S 中分配的栈区域
+// _kstack_region: 每个 hart 一个 [保护页 | 内核栈] 槽位
+// _irq_stack_region: 每个 hart 一个 [保护页 | 中断栈] 槽位
+// _overflow_stack_region: 每个 hart 一个溢出处理专用栈
+extern char _kstack_region[];
+extern char _irq_stack_region[];
+extern char _overflow_stack_region[];
+
+static kstack_t boot_stacks[MAX_HARTS];
+static kstack_t irq_stacks[MAX_HARTS];
+static kstack_t *kstack_list;
+
+// 填充时与活动栈顶保持的距离，避免覆盖 kstack_paint 自身的栈帧
+#define LIVE_SP_MARGIN  512
+
+// ===============================================================================
+// 启动栈地址计算
+// ===============================================================================
+uintptr_t kstack_boot_base(uint64_t hart_id)
+{
+    return (uintptr_t)_kstack_region + hart_id * KSTACK_SLOT_SIZE + STACK_GUARD_SIZE;
+}
+
+uintptr_t kstack_boot_top(uint64_t hart_id)
+{
+    return kstack_boot_base(hart_id) + STACK_SIZE;
+}
+
+uintptr_t kstack_irq_base(uint64_t hart_id)
+{
+    return (uintptr_t)_irq_stack_region + hart_id * IRQ_STACK_SLOT_SIZE + STACK_GUARD_SIZE;
+}
+
+uintptr_t kstack_irq_top(uint64_t hart_id)
+{
+    return kstack_irq_base(hart_id) + IRQ_STACK_SIZE;
+}
+
+uintptr_t kstack_overflow_top(uint64_t hart_id)
+{
+    return (uintptr_t)_overflow_stack_region + (hart_id + 1) * OVERFLOW_STACK_SIZE;
+}
+
+// ===============================================================================
+// 栈填充与水位线
+// ===============================================================================
+static void kstack_paint(uintptr_t from, uintptr_t to)
+{
+    for (uint64_t *p = (uint64_t *)from; (uintptr_t)p < to; p++) {
+        *p = KSTACK_PAINT;
+    }
+}
+
+// 扫描的是其他执行流的栈，KASAN 构建中会碰到活动栈帧的红区，不做检查
+__no_sanitize_address size_t kstack_high_watermark(const kstack_t *ks)
+{
+    const uint64_t *p = (const uint64_t *)ks->base;
+
+    while ((uintptr_t)p < ks->top && *p == KSTACK_PAINT) {
+        p++;
+    }
+    return ks->top - (uintptr_t)p;
+}
+
+void kstack_register(kstack_t *ks, uintptr_t base, uintptr_t top, const char *name,
+                     uintptr_t live_sp)
+{
+    ks->base = base;
+    ks->top  = top;
+    ks->name = name;
+
+    if (live_sp) {
+        if (live_sp - LIVE_SP_MARGIN > base) {
+            kstack_paint(base, live_sp - LIVE_SP_MARGIN);
+        }
+    } else {
+        kstack_paint(base, top);
+    }
+
+    ks->next    = kstack_list;
+    kstack_list = ks;
+}
+
+// ===============================================================================
+// 启动栈初始化
+// ===============================================================================
+void kstack_init(void)
+{
+    uintptr_t sp;
+    asm volatile("mv %0, sp" : "=r"(sp));
+
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        uintptr_t base = kstack_boot_base(hart);
+        uintptr_t top  = kstack_boot_top(hart);
+
+        // 保护页取消映射后，任何越界访问都会产生缺页
+        mmu_unmap_kernel_page(base - STACK_GUARD_SIZE);
+
+        bool live = (sp > base && sp <= top);
+        kstack_register(&boot_stacks[hart], base, top, "boot", live ? sp : 0);
+
+        // 中断栈：此时尚未开中断，整段都可以填充
+        base = kstack_irq_base(hart);
+        mmu_unmap_kernel_page(base - STACK_GUARD_SIZE);
+        kstack_register(&irq_stacks[hart], base, kstack_irq_top(hart), "irq", 0);
+    }
+
+    logger_info("Kernel stacks: %d x %d KB, irq stacks: %d x %d KB, guard %d KB\n", MAX_HARTS,
+                STACK_SIZE / 1024, MAX_HARTS, IRQ_STACK_SIZE / 1024, STACK_GUARD_SIZE / 1024);
+}
+
+// 保护页要从已经建好的内核页表中取消映射
+static int kstack_initcall(void)
+{
+    kstack_init();
+    return 0;
+}
+INITCALL(kstack, INIT_CORE, 0, kstack_initcall, "mmu");
+
+// ===============================================================================
+// 动态栈分配
+// ===============================================================================
+kstack_t *kstack_alloc(size_t size, const char *name)
+{
+    size_t npages = ALIGN_UP(size, PAGE_SIZE) / PAGE_SIZE;
+
+    kstack_t *ks = malloc(sizeof(kstack_t));
+    if (!ks) {
+        return NULL;
+    }
+
+    uintptr_t guard = (uintptr_t)alloc_pages(npages + 1);
+    if (!guard) {
+        free(ks);
+        return NULL;
+    }
+    mmu_unmap_kernel_page(guard);
+
+    uintptr_t base = guard + PAGE_SIZE;
+    kstack_register(ks, base, base + npages * PAGE_SIZE, name, 0);
+    ks->dynamic = true;
+    return ks;
+}
+
+void kstack_free(kstack_t *ks)
+{
+    if (!ks || !ks->dynamic) {
+        return;
+    }
+
+    // 从统计链表中摘除
+    for (kstack_t **pp = &kstack_list; *pp; pp = &(*pp)->next) {
+        if (*pp == ks) {
+            *pp = ks->next;
+            break;
+        }
+    }
+
+    // 恢复保护页映射后整体归还
+    uintptr_t guard = ks->base - PAGE_SIZE;
+    mmu_map_kernel_page(guard, guard, PTE_KERNEL_RW);
+    free_pages((void *)guard, (ks->top - guard) / PAGE_SIZE);
+    free(ks);
+}
+
+kstack_t *kstack_find(uintptr_t addr)
+{
+    for (kstack_t *ks = kstack_list; ks; ks = ks->next) {
+        if (addr >= ks->base - STACK_GUARD_SIZE && addr < ks->top) {
+            return ks;
+        }
+    }
+    return NULL;
+}
+
+// ===============================================================================
+// 打印栈使用情况
+// ===============================================================================
+void kstack_dump(void)
+{
+    logger("=== Kernel Stack Watermarks ===\n");
+    logger("  %-10s %-18s %8s %8s %5s\n", "name", "base", "size", "peak", "use%");
+
+    for (kstack_t *ks = kstack_list; ks; ks = ks->next) {
+        size_t size = ks->top - ks->base;
+        size_t peak = kstack_high_watermark(ks);
+        logger("  %-10s 0x%-16llx %8llu %8llu %4llu%%\n", ks->name, ks->base, size, peak,
+               peak * 100 / size);
+    }
+}
+
+static int cmd_stack(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    kstack_dump();
+    return 0;
+}
+SHELL_CMD(stack, NULL, "Show kernel stack watermarks", cmd_stack);
+SHELL_ALIAS(k, stack);
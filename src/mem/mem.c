@@ -6,6 +6,11 @@
 #include "types.h"
 #include "cfg/cfg.h"
 #include "uart.h"
+#include "spinlock.h"
+#include "atomic.h"
+#include "kasan.h"
+#include "kfence.h"
+#include "mem.h"
 
 // ===============================================================================
 // 内存管理器状态
@@ -23,6 +28,29 @@ typedef struct {
 
 static heap_info_t heap;
 
+// 堆内不能分配的区域（如 bootloader 放在内存中的 initrd），分配时跳过
+#define MEM_MAX_RESERVED    4
+
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+} mem_region_t;
+
+static mem_region_t reserved[MEM_MAX_RESERVED];
+static int reserved_count;
+
+// 空闲页链表：释放的页按单页挂入，供 alloc_pages(1) 复用
+typedef struct free_page {
+    struct free_page *next;
+} free_page_t;
+
+static free_page_t *free_page_list;
+static size_t free_page_count;
+
+// 保护 heap 与空闲页链表，可能在中断上下文中分配，因此使用 irqsave
+static spinlock_t heap_lock;
+static lock_stat_t heap_lock_stat;
+
 // 外部符号（由链接器提供）
 extern char _heap_start[];
 
@@ -38,7 +66,7 @@ void mem_init(void)
     // 设置堆结束地址（使用可用内存的一部分）
     // 假设我们有 128MB 物理内存，内核占用前面的空间
     // 为堆分配 64MB 空间
-    heap.end = MEM_START + MEM_SIZE - (32 * 1024 * 1024);  // 预留 32MB
+    heap.end = MEM_START + MEM_SIZE - (32 * 1024 * 1024);  // 预留 32MB（KASAN 构建的影子内存在这里）
     
     // 确保堆起始地址有效
     if (heap.start < MEM_START + (4 * 1024 * 1024)) {  // 内核至少占用 4MB
@@ -53,6 +81,9 @@ void mem_init(void)
     heap.total_size = heap.end - heap.start;
     heap.allocated = 0;
     heap.align = 8;  // 默认 8 字节对齐
+
+    spin_lock_init(&heap_lock, &heap_lock_stat);
+    lock_stat_register(&heap_lock_stat, "heap");
     
     // 输出初始化信息
     uart_puts("Memory heap initialized:\r\n");
@@ -66,36 +97,107 @@ void mem_init(void)
 }
 
 // ===============================================================================
-// 内存分配函数
+// 保留区域
 // ===============================================================================
 
-void *malloc(size_t size)
+int mem_reserve(uintptr_t start, uintptr_t end)
 {
-    if (size == 0) {
-        return NULL;
+    start = ALIGN_DOWN(start, PAGE_SIZE);
+    end   = ALIGN_UP(end, PAGE_SIZE);
+
+    // 不在堆范围内的区域本来就不会被分配
+    if (end <= heap.start || start >= heap.end) {
+        return 0;
     }
-    
-    // 对齐大小到指定边界
-    size = ALIGN_UP(size, heap.align);
-    
+
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    if (reserved_count >= MEM_MAX_RESERVED || start < heap.current) {
+        // 已经分配出去的内存无法再保留
+        spin_unlock_irqrestore(&heap_lock, flags);
+        return -1;
+    }
+    reserved[reserved_count].start = start;
+    reserved[reserved_count].end   = end;
+    reserved_count++;
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return 0;
+}
+
+// 返回不与保留区域重叠的分配起点（需持有 heap_lock）
+static uintptr_t heap_skip_reserved(uintptr_t start, size_t size, size_t align)
+{
+    for (int i = 0; i < reserved_count; i++) {
+        if (start < reserved[i].end && start + size > reserved[i].start) {
+            start = ALIGN_UP(reserved[i].end, align);
+            i = -1;  // 跳过后重新检查所有区域
+        }
+    }
+    return start;
+}
+
+// ===============================================================================
+// 内存分配函数
+// ===============================================================================
+
+// 从堆顶按 align 对齐切出 size 字节，对齐和跳过保留区域产生的空洞计入已分配
+static void *heap_alloc(size_t size, size_t align)
+{
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    uintptr_t start = heap_skip_reserved(ALIGN_UP(heap.current, align), size, align);
+
     // 检查是否有足够的空间
-    if (heap.current + size > heap.end) {
+    if (start + size > heap.end) {
+        size_t available = heap.end - heap.current;
+        spin_unlock_irqrestore(&heap_lock, flags);
+
         uart_puts("ERROR: Out of memory!\r\n");
         uart_puts("  Requested: ");
         uart_print_dec(size);
         uart_puts(" bytes\r\n");
         uart_puts("  Available: ");
-        uart_print_dec(heap.end - heap.current);
+        uart_print_dec(available);
         uart_puts(" bytes\r\n");
         return NULL;
     }
-    
-    // 分配内存
-    void *ptr = (void *)heap.current;
-    heap.current += size;
-    heap.allocated += size;
-    
-    return ptr;
+
+    heap.allocated += (start - heap.current) + size;
+    heap.current = start + size;
+
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return (void *)start;
+}
+
+// 分配一个对象；KASAN 构建在两侧各留红区，左侧红区同时满足对齐
+static void *heap_alloc_object(size_t size, size_t align, uintptr_t ip)
+{
+    // 被抽样的分配由 KFENCE 的保护页对象承担，其余只多读这一次标志
+    if (READ_ONCE(kfence_armed)) {
+        void *ptr = kfence_alloc(size, align, ip);
+        if (ptr) {
+            return ptr;
+        }
+    }
+
+#ifdef CONFIG_KASAN
+    size_t left  = align > KASAN_REDZONE_SIZE ? align : KASAN_REDZONE_SIZE;
+    size_t total = left + ALIGN_UP(size, heap.align) + KASAN_REDZONE_SIZE;
+    uint8_t *raw = heap_alloc(total, align);
+    if (!raw) {
+        return NULL;
+    }
+    kasan_alloc_object(raw, raw + left, size, total);
+    return raw + left;
+#else
+    return heap_alloc(ALIGN_UP(size, heap.align), align);
+#endif
+}
+
+void *malloc(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+    return heap_alloc_object(size, heap.align, (uintptr_t)__builtin_return_address(0));
 }
 
 // ===============================================================================
@@ -109,15 +211,22 @@ void *calloc(size_t count, size_t size)
         // 整数溢出检查
         return NULL;
     }
-    
-    void *ptr = malloc(total_size);
-    if (ptr) {
-        // 清零内存
-        uint8_t *bytes = (uint8_t *)ptr;
-        for (size_t i = 0; i < total_size; i++) {
-            bytes[i] = 0;
+
+#ifndef CONFIG_KASAN
+    // 超过半页的请求直接用预清零的页，浪费不超过一半（KASAN 构建需要红区，不走这条路）
+    if (total_size > PAGE_SIZE / 2 && total_size <= PAGE_SIZE) {
+        void *page = alloc_zeroed_page();
+        if (page) {
+            return page;
         }
     }
+#endif
+
+    void *ptr = total_size ? heap_alloc_object(total_size, heap.align,
+                                               (uintptr_t)__builtin_return_address(0)) : NULL;
+    if (ptr) {
+        mem_zero(ptr, total_size);
+    }
     
     return ptr;
 }
@@ -132,19 +241,76 @@ void *aligned_alloc(size_t alignment, size_t size)
         // alignment 必须是 2 的幂
         return NULL;
     }
-    
-    // 分配额外的空间以确保对齐
-    size_t aligned_size = size + alignment - 1;
-    void *raw_ptr = malloc(aligned_size);
-    if (!raw_ptr) {
+    if (size == 0) {
         return NULL;
     }
-    
-    // 计算对齐后的地址
-    uintptr_t aligned_addr = ALIGN_UP((uintptr_t)raw_ptr, alignment);
-    
-    // 注意：这种实现会浪费一些内存，因为我们不能释放前面的部分
-    return (void *)aligned_addr;
+
+    // 直接按对齐要求切出，空洞只有对齐所需的部分
+    if (alignment < heap.align) {
+        alignment = heap.align;
+    }
+    return heap_alloc_object(size, alignment, (uintptr_t)__builtin_return_address(0));
+}
+
+// ===============================================================================
+// 页分配
+// ===============================================================================
+
+void *alloc_pages(size_t npages)
+{
+    if (npages == 0) {
+        return NULL;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+
+    // 单页优先从空闲链表取
+    if (npages == 1 && free_page_list) {
+        free_page_t *page = free_page_list;
+        free_page_list = page->next;
+        free_page_count--;
+        heap.allocated += PAGE_SIZE;
+        spin_unlock_irqrestore(&heap_lock, flags);
+        kasan_unpoison(page, PAGE_SIZE);
+        return page;
+    }
+
+    // 从堆顶按页对齐切出，对齐产生的空洞计入已分配
+    size_t size = npages * PAGE_SIZE;
+    uintptr_t start = heap_skip_reserved(ALIGN_UP(heap.current, PAGE_SIZE), size, PAGE_SIZE);
+    if (start + size > heap.end) {
+        spin_unlock_irqrestore(&heap_lock, flags);
+        uart_puts("ERROR: Out of pages!\r\n");
+        return NULL;
+    }
+
+    heap.allocated += (start - heap.current) + size;
+    heap.current = start + size;
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return (void *)start;
+}
+
+void free_pages(void *addr, size_t npages)
+{
+    uintptr_t page = (uintptr_t)addr;
+
+    if (!addr || (page & (PAGE_SIZE - 1))) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+
+    // 多页块拆成单页挂回链表；KASAN 构建把页标记为已释放，链表指针由本文件读写，不经检查
+    kasan_poison(addr, npages * PAGE_SIZE, KASAN_PAGE_FREE);
+    for (size_t i = 0; i < npages; i++, page += PAGE_SIZE) {
+        free_page_t *fp = (free_page_t *)page;
+        fp->next = free_page_list;
+        free_page_list = fp;
+        free_page_count++;
+        heap.allocated -= PAGE_SIZE;
+    }
+
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 // ===============================================================================
@@ -195,9 +361,15 @@ void mem_print_stats(void)
     uart_print_dec((heap.allocated * 100) / heap.total_size);
     uart_puts("%\r\n");
     
+    uart_puts("Free pages:      ");
+    uart_print_dec(free_page_count);
+    uart_puts("\r\n");
+
     uart_puts("Current pointer: 0x");
     uart_print_hex(heap.current);
     uart_puts("\r\n");
+
+    zpool_dump_stats();
 }
 
 // ===============================================================================
@@ -206,9 +378,17 @@ void mem_print_stats(void)
 
 void free(void *ptr)
 {
+    uintptr_t ip = (uintptr_t)__builtin_return_address(0);
+
+    // KFENCE 对象取消映射放回对象池
+    if (kfence_free(ptr, ip)) {
+        return;
+    }
+
     // 在这个简单的分配器中，我们不实际释放内存
-    // 只是忽略 free 调用，内存会在系统重启时自动回收
-    (void)ptr;  // 避免编译器警告
+    // 只是忽略 free 调用，内存会在系统重启时自动回收；
+    // KASAN 构建把对象标记为已释放，之后的访问都会被报告
+    kasan_free_object(ptr, ip);
     
     // 在调试模式下可以输出警告
     #ifdef DEBUG_MEM
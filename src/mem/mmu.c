@@ -0,0 +1,179 @@
+/*
+ * RISC-V testos Sv39 页表管理
+ * 内核恒等映射，按需把大页拆成 4KB 页以支持保护页
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "sysreg.h"
+#include "mmu.h"
+#include "mem.h"
+#include "smp.h"
+#include "string.h"
+#include "initcall.h"
+#include "lib/logger.h"
+
+// 根页表（L2）与 RAM 所在 1GB 区域的 L1 页表
+static pte_t kernel_root[PT_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static pte_t kernel_ram_l1[PT_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+
+static uint64_t kernel_satp;
+
+// ===============================================================================
+// 分配一页清零的页表
+// ===============================================================================
+static pte_t *alloc_page_table(void)
+{
+    return alloc_zeroed_page();
+}
+
+// ===============================================================================
+// 把 lvl 级的大页拆成下一级页表，保持原有映射与属性不变
+// ===============================================================================
+static pte_t *split_superpage(pte_t *pte, int lvl)
+{
+    pte_t *table = alloc_page_table();
+    if (!table) {
+        return NULL;
+    }
+
+    uintptr_t base  = PTE_TO_PA(*pte);
+    uint64_t  attrs = *pte & (PTE_FLAGS_MASK | PTE_ATTR_MASK);
+
+    for (int i = 0; i < PT_ENTRIES; i++) {
+        table[i] = PA_TO_PTE(base + i * LEVEL_SIZE(lvl - 1)) | attrs;
+    }
+
+    *pte = PA_TO_PTE(table) | PTE_V;
+    SFENCE_VMA_ALL();
+    return table;
+}
+
+// ===============================================================================
+// 页表遍历
+// ===============================================================================
+pte_t *mmu_walk(pte_t *root, uintptr_t va, bool alloc)
+{
+    pte_t *table = root;
+
+    for (int lvl = 2; lvl > 0; lvl--) {
+        pte_t *pte = &table[VPN(va, lvl)];
+
+        if (!(*pte & PTE_V)) {
+            if (!alloc) {
+                return NULL;
+            }
+            pte_t *next = alloc_page_table();
+            if (!next) {
+                return NULL;
+            }
+            *pte = PA_TO_PTE(next) | PTE_V;
+            table = next;
+        } else if (PTE_IS_LEAF(*pte)) {
+            if (!alloc) {
+                return NULL;
+            }
+            table = split_superpage(pte, lvl);
+            if (!table) {
+                return NULL;
+            }
+        } else {
+            table = (pte_t *)PTE_TO_PA(*pte);
+        }
+    }
+
+    return &table[VPN(va, 0)];
+}
+
+// ===============================================================================
+// 内核页表初始化
+// ===============================================================================
+void mmu_init(void)
+{
+    memset(kernel_root, 0, sizeof(kernel_root));
+    memset(kernel_ram_l1, 0, sizeof(kernel_ram_l1));
+
+    // 0-2GB 的设备区（UART/CLINT/PLIC/virtio 等）使用 1GB 大页
+    kernel_root[0] = PA_TO_PTE(0x00000000UL) | PTE_KERNEL_DEV;
+    kernel_root[1] = PA_TO_PTE(0x40000000UL) | PTE_KERNEL_DEV;
+
+    // RAM 使用 2MB 大页
+    uintptr_t ram_gb = ALIGN_DOWN(MEM_START, LEVEL_SIZE(2));
+    for (uintptr_t pa = MEM_START; pa < MEM_START + MEM_SIZE; pa += LEVEL_SIZE(1)) {
+        kernel_ram_l1[VPN(pa, 1)] = PA_TO_PTE(pa) | PTE_KERNEL_RWX;
+    }
+    kernel_root[VPN(ram_gb, 2)] = PA_TO_PTE(kernel_ram_l1) | PTE_V;
+
+    kernel_satp = SATP_MODE_SV39 | ((uintptr_t)kernel_root >> PAGE_SHIFT);
+    mmu_enable();
+
+    logger_info("Sv39 enabled, satp=0x%llx\n", kernel_satp);
+}
+
+static int mmu_initcall(void)
+{
+    mmu_init();
+    return 0;
+}
+INITCALL(mmu, INIT_CORE, 0, mmu_initcall);
+
+void mmu_enable(void)
+{
+    CSR_WRITE(satp, kernel_satp);
+    SFENCE_VMA_ALL();
+}
+
+uint64_t mmu_kernel_satp(void)
+{
+    return kernel_satp;
+}
+
+pte_t *mmu_kernel_root(void)
+{
+    return kernel_root;
+}
+
+// ===============================================================================
+// 内核页映射操作
+// ===============================================================================
+int mmu_map_kernel_page(uintptr_t va, uintptr_t pa, uint64_t flags)
+{
+    pte_t *pte = mmu_walk(kernel_root, va, true);
+    if (!pte) {
+        return -1;
+    }
+
+    *pte = PA_TO_PTE(pa) | flags;
+    smp_flush_tlb_page(va);
+    return 0;
+}
+
+int mmu_unmap_kernel_page(uintptr_t va)
+{
+    pte_t *pte = mmu_walk(kernel_root, va, true);
+    if (!pte) {
+        return -1;
+    }
+
+    *pte = 0;
+    smp_flush_tlb_page(va);
+    return 0;
+}
+
+bool mmu_is_mapped(uintptr_t va)
+{
+    pte_t *table = kernel_root;
+
+    for (int lvl = 2; lvl >= 0; lvl--) {
+        pte_t pte = table[VPN(va, lvl)];
+        if (!(pte & PTE_V)) {
+            return false;
+        }
+        if (PTE_IS_LEAF(pte)) {
+            return true;
+        }
+        table = (pte_t *)PTE_TO_PA(pte);
+    }
+
+    return false;
+}
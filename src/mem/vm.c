@@ -0,0 +1,621 @@
+/*
+ * RISC-V testos 用户地址空间与写时复制
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "sysreg.h"
+#include "vm.h"
+#include "mmu.h"
+#include "mem.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "smp.h"
+#include "string.h"
+#include "initcall.h"
+#include "lib/logger.h"
+
+#define USER_END            (USER_BASE + USER_SIZE)
+#define USER_L1_FIRST       ((int)VPN(USER_BASE, 1))
+#define USER_L1_LAST        ((int)VPN(USER_END - 1, 1))
+
+#define PTE_USER_ATTRS      (PTE_V | PTE_A | PTE_ATTR_MEM)
+#define PTE_PROT_MASK       (PTE_R | PTE_W | PTE_X | PTE_COW | PTE_SHARED)
+
+// 无效表项中的软件位：私有映射区里已保留但不可访问的页（PROT_NONE）
+#define PTE_RESERVED        PTE_COW
+// 无效表项中的软件位：按需清零的页，R/W/X 位记录将来的权限，第一次访问时分配
+#define PTE_DEMAND          PTE_SHARED
+
+
+_Static_assert((USER_BASE & (LEVEL_SIZE(1) - 1)) == 0 && (USER_SIZE & (LEVEL_SIZE(1) - 1)) == 0,
+               "user window must be 2MB aligned");
+_Static_assert((VM_SHM_BASE & (LEVEL_SIZE(1) - 1)) == 0 && VM_SHM_SIZE == LEVEL_SIZE(1),
+               "shared memory area must be one L1 entry");
+_Static_assert(VPN(VM_MMAP_BASE, 1) == VPN(VM_MMAP_BASE + VM_MMAP_SIZE - 1, 1),
+               "private mapping area must lie in one L1 entry");
+_Static_assert(VPN(USER_BASE, 2) == VPN(MEM_START, 2) && VPN(USER_END - 1, 2) == VPN(MEM_START, 2),
+               "user window must lie in the RAM gigabyte");
+
+// 每个 RAM 物理页的引用计数，只统计进程私有页
+static volatile uint32_t *page_refs;
+static uint8_t *zero_page;
+
+static struct {
+    uint64_t spaces;        // 当前存在的地址空间
+    uint64_t tables;        // 当前占用的页表页
+    uint64_t forks;
+    uint64_t cow_faults;
+    uint64_t cow_copies;    // 复制了物理页
+    uint64_t cow_reuse;     // 只剩一个引用，直接改回可写
+    uint64_t shootdowns;    // 需要向其他 hart 发 IPI 的 TLB 刷新
+    uint64_t demand_faults; // 按需清零的页第一次被访问
+} vm_stats;
+
+static inline volatile uint32_t *page_ref(uintptr_t pa)
+{
+    return &page_refs[(pa - MEM_START) >> PAGE_SHIFT];
+}
+
+static inline void page_get(uintptr_t pa)
+{
+    atomic_fetch_add32(page_ref(pa), 1);
+}
+
+static inline void page_put(uintptr_t pa)
+{
+    if (atomic_fetch_add32(page_ref(pa), (uint32_t)-1) == 1) {
+        free_pages((void *)pa, 1);
+    }
+}
+
+static pte_t *vm_alloc_table(void)
+{
+    pte_t *table = alloc_zeroed_page();
+    if (table) {
+        vm_stats.tables++;
+    }
+    return table;
+}
+
+static void vm_free_table(pte_t *table)
+{
+    free_pages(table, 1);
+    vm_stats.tables--;
+}
+
+// 取一个清零的私有页，引用计数置 1
+static void *vm_zeroed_page(void)
+{
+    void *page = alloc_zeroed_page();
+    if (page) {
+        *page_ref((uintptr_t)page) = 1;
+    }
+    return page;
+}
+
+void vm_init(void)
+{
+    page_refs = calloc(MEM_SIZE / PAGE_SIZE, sizeof(uint32_t));
+    zero_page = alloc_pages(1);
+    if (!page_refs || !zero_page) {
+        logger_error("vm: failed to allocate page reference table\n");
+        return;
+    }
+    memset(zero_page, 0, PAGE_SIZE);
+}
+
+// 进程页表复制内核页表，栈保护页需在此之前取消映射
+static int vm_initcall(void)
+{
+    vm_init();
+    return page_refs && zero_page ? 0 : -1;
+}
+INITCALL(vm, INIT_CORE, 0, vm_initcall, "mmu", "kstack");
+
+uintptr_t vm_zero_page(void)
+{
+    return (uintptr_t)zero_page;
+}
+
+static inline bool vm_in_shm(uintptr_t va)
+{
+    return va >= VM_SHM_BASE && va < VM_SHM_BASE + VM_SHM_SIZE;
+}
+
+static inline bool vm_in_mmap(uintptr_t va)
+{
+    return va >= VM_MMAP_BASE && va < VM_MMAP_BASE + VM_MMAP_SIZE;
+}
+
+// ===============================================================================
+// TLB 刷新
+// 本 hart 直接 sfence，其他正在使用此地址空间的 hart 通过 IPI 刷新。
+// 调用者必须已释放 vm->lock：对端可能关中断在缺页处理中等这把锁
+// ===============================================================================
+static void vm_flush_remote(void *arg)
+{
+    uintptr_t va = (uintptr_t)arg;
+
+    if (va) {
+        SFENCE_VMA(va);
+    } else {
+        SFENCE_VMA_ALL();
+    }
+}
+
+// va 为 0 时刷新整个地址空间
+static void vm_flush_tlb(vm_space_t *vm, uintptr_t va)
+{
+    uint64_t self = HART_MASK(this_hart_id());
+
+    // 与切换地址空间时“先置位再写 satp”配对：没看到的 hart 切入时会整体刷新
+    smp_mb();
+    uint64_t others = READ_ONCE(vm->cpus) & ~self;
+
+    if (CSR_READ(satp) == vm->satp) {
+        vm_flush_remote((void *)va);
+    }
+    if (others) {
+        smp_call_function(others, vm_flush_remote, (void *)va, true);
+        vm_stats.shootdowns++;
+    }
+}
+
+// ===============================================================================
+// 页表操作
+// ===============================================================================
+
+// 用户窗口内 va 对应的 L0 表项，窗口外返回 NULL
+static pte_t *vm_pte(vm_space_t *vm, uintptr_t va, bool alloc)
+{
+    if (va < USER_BASE || va >= USER_END) {
+        return NULL;
+    }
+
+    pte_t *l1e = &vm->l1[VPN(va, 1)];
+    if (!(*l1e & PTE_V)) {
+        if (!alloc) {
+            return NULL;
+        }
+        pte_t *table = vm_alloc_table();
+        if (!table) {
+            return NULL;
+        }
+        *l1e = PA_TO_PTE(table) | PTE_V;
+    }
+    return &((pte_t *)PTE_TO_PA(*l1e))[VPN(va, 0)];
+}
+
+int vm_create(vm_space_t *vm)
+{
+    pte_t *kroot = mmu_kernel_root();
+
+    vm->root = vm_alloc_table();
+    vm->l1   = vm_alloc_table();
+    if (!vm->root || !vm->l1) {
+        if (vm->root) {
+            vm_free_table(vm->root);
+        }
+        if (vm->l1) {
+            vm_free_table(vm->l1);
+        }
+        return -1;
+    }
+
+    // 复制内核的根页表和 RAM 区 L1 页表，窗口内的恒等映射清空，按需建立私有 L0 页表。
+    // 之后内核再拆分 RAM 区的大页不会同步到已有的地址空间，内核映射应在启动阶段建好
+    memcpy(vm->root, kroot, PAGE_SIZE);
+    memcpy(vm->l1, (void *)PTE_TO_PA(kroot[VPN(USER_BASE, 2)]), PAGE_SIZE);
+    for (int i = USER_L1_FIRST; i <= USER_L1_LAST; i++) {
+        vm->l1[i] = 0;
+    }
+    vm->root[VPN(USER_BASE, 2)] = PA_TO_PTE(vm->l1) | PTE_V;
+    vm->satp    = SATP_MODE_SV39 | ((uintptr_t)vm->root >> PAGE_SHIFT);
+    vm->shm_brk = VM_SHM_BASE;
+    vm->cpus    = 0;
+    spin_lock_init(&vm->lock, NULL);
+
+    vm_stats.spaces++;
+    return 0;
+}
+
+void vm_destroy(vm_space_t *vm)
+{
+    if (!vm->root) {
+        return;
+    }
+
+    for (int i = USER_L1_FIRST; i <= USER_L1_LAST; i++) {
+        if (!(vm->l1[i] & PTE_V)) {
+            continue;
+        }
+        pte_t *l0 = (pte_t *)PTE_TO_PA(vm->l1[i]);
+        for (int j = 0; j < PT_ENTRIES; j++) {
+            if ((l0[j] & PTE_V) && !(l0[j] & PTE_SHARED)) {
+                page_put(PTE_TO_PA(l0[j]));
+            }
+        }
+        vm_free_table(l0);
+    }
+    vm_free_table(vm->l1);
+    vm_free_table(vm->root);
+
+    vm->root = NULL;
+    vm->l1   = NULL;
+    vm->satp = 0;
+    vm_stats.spaces--;
+}
+
+int vm_map(vm_space_t *vm, uintptr_t va, uintptr_t pa, uint64_t prot)
+{
+    pte_t *pte = vm_pte(vm, va, true);
+    if (!pte || (*pte & PTE_V)) {
+        return -1;
+    }
+
+    if (!(prot & PTE_SHARED)) {
+        page_get(pa);
+    }
+    // 可写页预置 D 位，写时复制页在复制后才变为可写
+    *pte = PA_TO_PTE(pa) | (prot & PTE_PROT_MASK) | PTE_USER_ATTRS | ((prot & PTE_W) ? PTE_D : 0);
+    return 0;
+}
+
+int vm_map_demand(vm_space_t *vm, uintptr_t va, size_t npages, uint64_t prot)
+{
+    for (size_t n = 0; n < npages; n++, va += PAGE_SIZE) {
+        pte_t *pte = vm_pte(vm, va, true);
+        if (!pte || *pte) {
+            return -1;
+        }
+        *pte = PTE_DEMAND | (prot & (PTE_R | PTE_W | PTE_X));
+    }
+    return 0;
+}
+
+void *vm_alloc_page(vm_space_t *vm, uintptr_t va, uint64_t prot)
+{
+    uint8_t *page = vm_zeroed_page();
+    if (!page) {
+        return NULL;
+    }
+    *page_ref((uintptr_t)page) = 0;
+
+    if (vm_map(vm, va, (uintptr_t)page, prot & ~PTE_SHARED) < 0) {
+        free_pages(page, 1);
+        return NULL;
+    }
+    return page;
+}
+
+// ===============================================================================
+// fork 与写时复制
+// ===============================================================================
+int vm_fork(vm_space_t *dst, vm_space_t *src)
+{
+    if (vm_create(dst) < 0) {
+        return -1;
+    }
+
+    spin_lock(&src->lock);
+    for (int i = USER_L1_FIRST; i <= USER_L1_LAST; i++) {
+        if (!(src->l1[i] & PTE_V)) {
+            continue;
+        }
+        pte_t *sl0 = (pte_t *)PTE_TO_PA(src->l1[i]);
+        pte_t *dl0 = vm_alloc_table();
+        if (!dl0) {
+            spin_unlock(&src->lock);
+            vm_destroy(dst);
+            return -1;
+        }
+        dst->l1[i] = PA_TO_PTE(dl0) | PTE_V;
+
+        // 共享内存区的页保持可写，父子进程看到同一物理页
+        bool shm = (i == (int)VPN(VM_SHM_BASE, 1));
+        for (int j = 0; j < PT_ENTRIES; j++) {
+            pte_t pte = sl0[j];
+            if (!(pte & PTE_V)) {
+                dl0[j] = pte;       // 保留的地址照样保留
+                continue;
+            }
+            if ((pte & PTE_W) && !shm) {
+                pte = (pte & ~(PTE_W | PTE_D)) | PTE_COW;
+                sl0[j] = pte;
+            }
+            if (!(pte & PTE_SHARED)) {
+                page_get(PTE_TO_PA(pte));
+            }
+            dl0[j] = pte;
+        }
+    }
+    dst->shm_brk = src->shm_brk;
+    spin_unlock(&src->lock);
+
+    // 父进程的可写页刚改为只读，丢弃所有使用它的 hart 上的旧 TLB 项
+    vm_flush_tlb(src, 0);
+    vm_stats.forks++;
+    return 0;
+}
+
+// 第一次访问按需清零的页，调用者持有 vm->lock
+static bool vm_fault_demand(pte_t *pte, uintptr_t va, uint64_t access)
+{
+    uint64_t prot = *pte & (PTE_R | PTE_W | PTE_X);
+
+    if (!(prot & access)) {
+        return false;
+    }
+    uint8_t *page = vm_zeroed_page();
+    if (!page) {
+        return false;
+    }
+    *pte = PA_TO_PTE(page) | prot | PTE_USER_ATTRS | ((prot & PTE_W) ? PTE_D : 0);
+    vm_stats.demand_faults++;
+
+    // 无效表项不会进入 TLB，只需丢弃可能缓存的“无效”结果
+    SFENCE_VMA(va);
+    return true;
+}
+
+bool vm_fault(vm_space_t *vm, uintptr_t va, uint64_t access)
+{
+    spin_lock(&vm->lock);
+
+    pte_t *pte = vm_pte(vm, va, false);
+    if (pte && !(*pte & PTE_V) && (*pte & PTE_DEMAND)) {
+        bool ok = vm_fault_demand(pte, va, access);
+        spin_unlock(&vm->lock);
+        return ok;
+    }
+    if (!pte || !(*pte & PTE_V)) {
+        spin_unlock(&vm->lock);
+        return false;
+    }
+    if (access != PTE_W || !(*pte & PTE_COW)) {
+        // 同组的另一个线程已经处理了同一页，本 hart 上是旧 TLB 项
+        bool handled = (*pte & access) != 0;
+        spin_unlock(&vm->lock);
+        if (handled) {
+            SFENCE_VMA(va);
+        }
+        return handled;
+    }
+
+    uintptr_t pa    = PTE_TO_PA(*pte);
+    uint64_t  flags = (*pte & (PTE_FLAGS_MASK | PTE_ATTR_MASK) & ~(PTE_COW | PTE_SHARED)) |
+                      PTE_W | PTE_D;
+
+    vm_stats.cow_faults++;
+    if (!(*pte & PTE_SHARED) && READ_ONCE(*page_ref(pa)) == 1) {
+        // 其他共享者都已退出或复制，直接改回可写
+        *pte = PA_TO_PTE(pa) | flags;
+        vm_stats.cow_reuse++;
+    } else {
+        uint8_t *page = (pa == (uintptr_t)zero_page) ? vm_zeroed_page() : alloc_pages(1);
+        if (!page) {
+            spin_unlock(&vm->lock);
+            return false;
+        }
+        if (pa != (uintptr_t)zero_page) {
+            memcpy(page, (void *)pa, PAGE_SIZE);
+        }
+        *page_ref((uintptr_t)page) = 1;
+        if (!(*pte & PTE_SHARED)) {
+            page_put(pa);
+        }
+        *pte = PA_TO_PTE(page) | flags;
+        vm_stats.cow_copies++;
+        if (flags & PTE_X) {
+            asm volatile("fence.i" ::: "memory");
+        }
+    }
+    spin_unlock(&vm->lock);
+
+    // 其他线程可能还缓存着旧页的只读映射，写入前必须让它们看到新页
+    vm_flush_tlb(vm, va);
+    return true;
+}
+
+// ===============================================================================
+// 共享内存区与私有匿名映射区
+// ===============================================================================
+
+// 释放一个表项指向的页并写入 val，调用者持有 vm->lock
+static void vm_clear_pte(pte_t *pte, pte_t val)
+{
+    if ((*pte & PTE_V) && !(*pte & PTE_SHARED)) {
+        page_put(PTE_TO_PA(*pte));
+    }
+    *pte = val;
+}
+
+// 私有映射区的一页：只保留地址，或第一次访问时按需清零，调用者持有 vm->lock
+static void vm_mmap_page(pte_t *pte, uint64_t prot)
+{
+    *pte = (prot & PTE_R) ? (PTE_DEMAND | (prot & (PTE_R | PTE_W))) : PTE_RESERVED;
+}
+
+uintptr_t vm_shm_map(vm_space_t *vm, size_t npages)
+{
+    spin_lock(&vm->lock);
+
+    uintptr_t start = vm->shm_brk;
+    if (npages == 0 || npages > (VM_SHM_BASE + VM_SHM_SIZE - start) / PAGE_SIZE) {
+        spin_unlock(&vm->lock);
+        return 0;
+    }
+    for (size_t n = 0; n < npages; n++) {
+        if (!vm_alloc_page(vm, start + n * PAGE_SIZE, PTE_R | PTE_W)) {
+            for (size_t k = 0; k < n; k++) {
+                vm_clear_pte(vm_pte(vm, start + k * PAGE_SIZE, false), 0);
+            }
+            spin_unlock(&vm->lock);
+            return 0;
+        }
+    }
+    vm->shm_brk = start + npages * PAGE_SIZE;
+    spin_unlock(&vm->lock);
+    return start;
+}
+
+uintptr_t vm_mmap(vm_space_t *vm, size_t npages, uint64_t prot)
+{
+    if (npages == 0 || npages + 2 > VM_MMAP_SIZE / PAGE_SIZE) {
+        return 0;
+    }
+
+    spin_lock(&vm->lock);
+    pte_t *l0 = vm_pte(vm, VM_MMAP_BASE, true);
+    if (!l0) {
+        spin_unlock(&vm->lock);
+        return 0;
+    }
+
+    // 首次适配：空闲页的表项为 0，PROT_NONE 保留的页带 PTE_RESERVED。
+    // 只用空闲段内部的页，两段映射之间至少隔一个空闲页：线程栈溢出时在保护页上缺页，
+    // 而不是写进下面的映射，vm_mmap_bottom() 也靠它找到映射的下界
+    size_t run = 0;
+    for (size_t i = 0; i < VM_MMAP_SIZE / PAGE_SIZE; i++) {
+        run = l0[i] ? 0 : run + 1;
+        if (run < npages + 2) {
+            continue;
+        }
+        size_t    first = i - npages;
+        uintptr_t start = VM_MMAP_BASE + first * PAGE_SIZE;
+        for (size_t n = 0; n < npages; n++) {
+            vm_mmap_page(&l0[first + n], prot);
+        }
+        spin_unlock(&vm->lock);
+        return start;
+    }
+    spin_unlock(&vm->lock);
+    return 0;
+}
+
+uintptr_t vm_mmap_bottom(vm_space_t *vm, uintptr_t va)
+{
+    va = ALIGN_DOWN(va, PAGE_SIZE);
+    if (!vm_in_mmap(va)) {
+        return 0;
+    }
+
+    spin_lock(&vm->lock);
+    pte_t *pte = vm_pte(vm, va, false);
+    if (!pte || !*pte || *pte == PTE_RESERVED) {
+        spin_unlock(&vm->lock);
+        return 0;
+    }
+    // 向下找到空闲页或 PROT_NONE 页为止，映射之间总有一个空闲页
+    while (va > VM_MMAP_BASE && pte[-1] && pte[-1] != PTE_RESERVED) {
+        va -= PAGE_SIZE;
+        pte--;
+    }
+    spin_unlock(&vm->lock);
+    return va;
+}
+
+int vm_mprotect(vm_space_t *vm, uintptr_t va, size_t npages, uint64_t prot)
+{
+    if ((va & (PAGE_SIZE - 1)) || !vm_in_mmap(va) ||
+        npages > (VM_MMAP_BASE + VM_MMAP_SIZE - va) / PAGE_SIZE) {
+        return -1;
+    }
+
+    spin_lock(&vm->lock);
+    for (size_t n = 0; n < npages; n++) {
+        pte_t *pte = vm_pte(vm, va + n * PAGE_SIZE, false);
+        if (!pte || !*pte) {
+            spin_unlock(&vm->lock);
+            return -1;
+        }
+    }
+    for (size_t n = 0; n < npages; n++) {
+        uintptr_t addr = va + n * PAGE_SIZE;
+        pte_t    *pte  = vm_pte(vm, addr, false);
+
+        if (!(prot & PTE_R)) {
+            vm_clear_pte(pte, PTE_RESERVED);
+        } else if (!(*pte & PTE_V)) {
+            vm_mmap_page(pte, prot);
+        } else if (!(prot & PTE_W)) {
+            *pte &= ~(PTE_W | PTE_D | PTE_COW);
+        } else if (!(*pte & PTE_W)) {
+            // 放宽为可写：统一走写时复制，只剩一个引用时缺页直接改回可写
+            *pte |= PTE_COW;
+        }
+    }
+    spin_unlock(&vm->lock);
+
+    vm_flush_tlb(vm, 0);
+    return 0;
+}
+
+int vm_munmap(vm_space_t *vm, uintptr_t va, size_t npages)
+{
+    uintptr_t end;
+
+    if (va & (PAGE_SIZE - 1)) {
+        return -1;
+    }
+    if (vm_in_shm(va)) {
+        end = VM_SHM_BASE + VM_SHM_SIZE;
+    } else if (vm_in_mmap(va)) {
+        end = VM_MMAP_BASE + VM_MMAP_SIZE;
+    } else {
+        return -1;
+    }
+    if (npages > (end - va) / PAGE_SIZE) {
+        return -1;
+    }
+
+    spin_lock(&vm->lock);
+    for (size_t n = 0; n < npages; n++) {
+        pte_t *pte = vm_pte(vm, va + n * PAGE_SIZE, false);
+        if (pte) {
+            vm_clear_pte(pte, 0);
+        }
+    }
+    spin_unlock(&vm->lock);
+
+    vm_flush_tlb(vm, npages == 1 ? va : 0);
+    return 0;
+}
+
+uintptr_t vm_translate(vm_space_t *vm, uintptr_t va, bool write)
+{
+    if (va < USER_BASE || va >= USER_END) {
+        return va;
+    }
+
+    for (;;) {
+        spin_lock(&vm->lock);
+        pte_t *pte = vm_pte(vm, va, false);
+        if (!pte || !(*pte & (PTE_V | PTE_DEMAND))) {
+            spin_unlock(&vm->lock);
+            return 0;
+        }
+        if ((*pte & PTE_V) && (!write || !(*pte & PTE_COW))) {
+            uintptr_t pa = PTE_TO_PA(*pte) | (va & (PAGE_SIZE - 1));
+            spin_unlock(&vm->lock);
+            return pa;
+        }
+        // 按需清零的页先分配，写时复制页先复制
+        spin_unlock(&vm->lock);
+        if (!vm_fault(vm, va, write ? PTE_W : PTE_R)) {
+            return 0;
+        }
+    }
+}
+
+void vm_dump_stats(void)
+{
+    logger("=== Address Space Statistics ===\n");
+    logger("spaces:     %llu live, %llu page-table pages\n", vm_stats.spaces, vm_stats.tables);
+    logger("forks:      %llu\n", vm_stats.forks);
+    logger("cow faults: %llu (%llu copied, %llu reused last reference)\n", vm_stats.cow_faults,
+           vm_stats.cow_copies, vm_stats.cow_reuse);
+    logger("shootdowns: %llu\n", vm_stats.shootdowns);
+    logger("demand:     %llu faults\n", vm_stats.demand_faults);
+}
@@ -0,0 +1,203 @@
+/*
+ * RISC-V testos 预清零页池
+ *
+ * 空闲的 hart 提前把页清零放进池里，calloc、页表分配和按需清零的缺页
+ * 只需从池里取一页。池中的页用第一个字串成链表，取出时把这个字清零即可。
+ * 平台支持 Zicboz 时用 cbo.zero 按缓存块清零，否则用 8 字节宽的存储。
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "mem.h"
+#include "fdt.h"
+#include "atomic.h"
+#include "spinlock.h"
+#include "string.h"
+#include "initcall.h"
+#include "lib/logger.h"
+
+#define ZPOOL_BATCH     8       // 每次空闲时最多清零的页数，不拖慢对 IPI 的响应
+
+typedef struct zpool_page {
+    struct zpool_page *next;
+} zpool_page_t;
+
+static struct {
+    spinlock_t lock;            // 可能在中断上下文中分配，使用 irqsave
+    zpool_page_t *head;
+    volatile size_t count;
+    size_t target;              // 储备页数，0 表示不预清零
+    uint64_t hits;              // 取到现成的零页
+    uint64_t misses;            // 池已空，调用者现场清零
+    uint64_t refills;           // 空闲时清零放入的页
+} zpool;
+
+static lock_stat_t zpool_stat;
+
+// cbo.zero 的块大小，0 表示不支持 Zicboz
+static size_t cboz_block;
+
+// ===============================================================================
+// 清零
+// ===============================================================================
+
+// 设备树 riscv,isa 中是否有 _zicboz 扩展
+static bool zpool_has_zicboz(void)
+{
+    int         len;
+    const char *isa = fdt_getprop("/cpus/cpu", "riscv,isa", &len);
+
+    if (!isa || len <= 0) {
+        return false;
+    }
+    for (const char *p = isa; p + 7 <= isa + len && *p; p++) {
+        if (strncmp(p, "_zicboz", 7) == 0 && (p[7] == '_' || p[7] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void cbo_zero(void *block)
+{
+    // cbo.zero 0(rs1)，用 .insn 编码，不依赖汇编器对 Zicboz 的支持
+    asm volatile(".insn i 0x0f, 2, x0, %0, 4" :: "r"(block) : "memory");
+}
+
+void mem_zero(void *dst, size_t n)
+{
+    uint8_t *p = dst;
+
+    while (n && ((uintptr_t)p & 7)) {
+        *p++ = 0;
+        n--;
+    }
+
+    if (cboz_block && n >= 2 * cboz_block) {
+        while ((uintptr_t)p & (cboz_block - 1)) {
+            *(uint64_t *)p = 0;
+            p += 8;
+            n -= 8;
+        }
+        for (; n >= cboz_block; p += cboz_block, n -= cboz_block) {
+            cbo_zero(p);
+        }
+    }
+
+    uint64_t *w = (uint64_t *)p;
+    for (; n >= 64; n -= 64, w += 8) {
+        w[0] = 0; w[1] = 0; w[2] = 0; w[3] = 0;
+        w[4] = 0; w[5] = 0; w[6] = 0; w[7] = 0;
+    }
+    for (; n >= 8; n -= 8) {
+        *w++ = 0;
+    }
+
+    p = (uint8_t *)w;
+    while (n--) {
+        *p++ = 0;
+    }
+}
+
+// ===============================================================================
+// 页池
+// ===============================================================================
+void zpool_init(size_t pages)
+{
+    uint64_t block = 0;
+
+    spin_lock_init(&zpool.lock, &zpool_stat);
+    lock_stat_register(&zpool_stat, "zpool");
+
+    // cbo.zero 还需要 M 态固件打开 menvcfg.CBZE，OpenSBI 在扩展存在时会打开
+    if (zpool_has_zicboz() && fdt_getprop_u64("/cpus/cpu", "riscv,cboz-block-size", &block) == 0 &&
+        block >= 8 && (block & (block - 1)) == 0 && block <= PAGE_SIZE) {
+        cboz_block = block;
+    }
+
+    zpool.target = pages;
+    logger_info("zpool: target %llu pre-zeroed pages, zeroing with %s\n", (uint64_t)zpool.target,
+                cboz_block ? "cbo.zero" : "64-bit stores");
+}
+
+static int zpool_initcall(void)
+{
+    zpool_init(bootarg_get_size("zpool", ZPOOL_DEFAULT_SIZE) / PAGE_SIZE);
+    return 0;
+}
+INITCALL(zpool, INIT_CORE, 0, zpool_initcall);
+
+// 储备的填充不在启动路径上：shell 出现后由空闲的 hart 一次填满
+static int zpool_fill_initcall(void)
+{
+    while (zpool.count < zpool.target) {
+        size_t before = zpool.count;
+        zpool_refill();
+        if (zpool.count == before) {
+            break;
+        }
+    }
+    logger_info("zpool: %llu pre-zeroed pages\n", (uint64_t)zpool.count);
+    return 0;
+}
+INITCALL(zpool_fill, INIT_DEFERRED, INITCALL_PARALLEL, zpool_fill_initcall, "zpool");
+
+void *alloc_zeroed_page(void)
+{
+    uint64_t      flags = spin_lock_irqsave(&zpool.lock);
+    zpool_page_t *page  = zpool.head;
+
+    if (page) {
+        zpool.head = page->next;
+        zpool.count--;
+        zpool.hits++;
+    } else {
+        zpool.misses++;
+    }
+    spin_unlock_irqrestore(&zpool.lock, flags);
+
+    if (page) {
+        page->next = NULL;      // 链表指针是页里唯一的非零内容
+        return page;
+    }
+
+    void *fresh = alloc_pages(1);
+    if (fresh) {
+        mem_zero(fresh, PAGE_SIZE);
+    }
+    return fresh;
+}
+
+void zpool_refill(void)
+{
+    for (int n = 0; n < ZPOOL_BATCH; n++) {
+        // 不持锁检查，多补或少补一页都无妨
+        if (READ_ONCE(zpool.count) >= zpool.target) {
+            return;
+        }
+        zpool_page_t *page = alloc_pages(1);
+        if (!page) {
+            return;
+        }
+        mem_zero(page, PAGE_SIZE);
+
+        uint64_t flags = spin_lock_irqsave(&zpool.lock);
+        page->next = zpool.head;
+        zpool.head = page;
+        zpool.count++;
+        zpool.refills++;
+        spin_unlock_irqrestore(&zpool.lock, flags);
+    }
+}
+
+void zpool_dump_stats(void)
+{
+    logger("=== Pre-zeroed Page Pool ===\n");
+    logger("reserve:    %llu/%llu pages, zeroing with %s",
+           (uint64_t)zpool.count, (uint64_t)zpool.target, cboz_block ? "cbo.zero" : "64-bit stores");
+    if (cboz_block) {
+        logger(" (%llu-byte blocks)", (uint64_t)cboz_block);
+    }
+    logger("\n");
+    logger("hits %llu, misses %llu, refilled %llu\n", zpool.hits, zpool.misses, zpool.refills);
+}
@@ -0,0 +1,180 @@
+/*
+ * RISC-V testos 多线程扩展性测试
+ *
+ * 线程的创建、退出和等待都走与 musl pthread 相同的路径：CLONE_SETTLS 之外的
+ * pthread_create 标志，线程栈来自 mmap，pthread_join 等价于在 CLONE_CHILD_CLEARTID
+ * 的 tid 上做 FUTEX_WAIT。主线程自己也计算一份，其余份额由空闲 hart 上的线程完成。
+ */
+
+#include "types.h"
+#include "parbench.h"
+#include "atomic.h"
+#include "futex.h"
+#include "proc.h"
+#include "smp.h"
+#include "string.h"
+#include "sysgate.h"
+#include "timer.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+#define PAR_N               128                     // 方阵阶数
+#define PAR_MATRIX_BYTES    (PAR_N * PAR_N * sizeof(uint32_t))
+#define PAR_STACK_SIZE      (64 * 1024)
+#define PAR_MAX_THREADS     MAX_HARTS
+
+#define PAR_CLONE_FLAGS     (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD |   \
+                             CLONE_SYSVSEM | CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID)
+
+typedef struct {
+    const uint32_t *a;
+    const uint32_t *b;
+    uint32_t *c;
+    int row_lo;
+    int row_hi;
+    volatile int tid;           // 线程退出时由内核清零并唤醒
+    void *stack;
+} par_work_t;
+
+static int par_worker(void *arg)
+{
+    par_work_t *w = arg;
+
+    for (int i = w->row_lo; i < w->row_hi; i++) {
+        for (int j = 0; j < PAR_N; j++) {
+            uint32_t sum = 0;
+            for (int k = 0; k < PAR_N; k++) {
+                sum += w->a[i * PAR_N + k] * w->b[k * PAR_N + j];
+            }
+            w->c[i * PAR_N + j] = sum;
+        }
+    }
+    return 0;
+}
+
+static void *par_map(size_t len)
+{
+    long va = sysgate(SYS_mmap, 0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1);
+    return va < 0 ? NULL : (void *)va;
+}
+
+// 用 nthreads 个线程（含调用者）计算 c = a * b
+// @return 耗时（time CSR 计数），失败返回 0
+static uint64_t par_run(par_work_t *work, int nthreads, const uint32_t *a, const uint32_t *b,
+                        uint32_t *c)
+{
+    memset(c, 0, PAR_MATRIX_BYTES);
+    for (int i = 0; i < nthreads; i++) {
+        work[i].a      = a;
+        work[i].b      = b;
+        work[i].c      = c;
+        work[i].row_lo = PAR_N * i / nthreads;
+        work[i].row_hi = PAR_N * (i + 1) / nthreads;
+        work[i].tid    = 0;
+        work[i].stack  = NULL;
+    }
+
+    uint64_t t = READ_TIME();
+    int      started;
+    for (started = 1; started < nthreads; started++) {
+        par_work_t *w = &work[started];
+        if (!(w->stack = par_map(PAR_STACK_SIZE))) {
+            break;
+        }
+        long tid = sysgate_clone(par_worker, (uint8_t *)w->stack + PAR_STACK_SIZE, PAR_CLONE_FLAGS,
+                                 w, (int *)&w->tid, NULL, (int *)&w->tid);
+        if (tid < 0) {
+            logger_error("parbench: clone failed (%ld)\n", tid);
+            break;
+        }
+    }
+    par_worker(&work[0]);
+
+    // pthread_join：等内核在线程退出后清零 tid
+    for (int i = 1; i < started; i++) {
+        int tid;
+        while ((tid = READ_ONCE(work[i].tid)) != 0) {
+            sysgate(SYS_futex, (long)&work[i].tid, FUTEX_WAIT, tid, 0, 0);
+        }
+    }
+    t = READ_TIME() - t;
+
+    for (int i = 1; i < nthreads; i++) {
+        if (work[i].stack) {
+            sysgate(SYS_munmap, (long)work[i].stack, PAR_STACK_SIZE, 0, 0, 0);
+        }
+    }
+    if (started < nthreads) {
+        return 0;
+    }
+    return t ? t : 1;
+}
+
+static int par_bench_main(void *arg)
+{
+    (void)arg;
+
+    uint32_t *a = par_map(PAR_MATRIX_BYTES);
+    uint32_t *b = par_map(PAR_MATRIX_BYTES);
+    uint32_t *c = par_map(PAR_MATRIX_BYTES);
+    if (!a || !b || !c) {
+        logger_error("parbench: mmap failed\n");
+        return 1;
+    }
+    for (int i = 0; i < PAR_N * PAR_N; i++) {
+        a[i] = i % 7 + 1;
+        b[i] = i % 5 + 1;
+    }
+
+    par_work_t work[PAR_MAX_THREADS];
+    uint64_t   freq = timer_get_frequency();
+    uint64_t   base = 0;
+    uint32_t   expect = 0;
+
+    logger("%8s %10s %8s %10s\n", "threads", "time(us)", "speedup", "checksum");
+    for (int n = 1; n <= smp_num_online() && n <= PAR_MAX_THREADS; n *= 2) {
+        uint64_t t = par_run(work, n, a, b, c);
+        if (t == 0) {
+            return 1;
+        }
+
+        uint32_t sum = 0;
+        for (int i = 0; i < PAR_N * PAR_N; i++) {
+            sum = sum * 31 + c[i];
+        }
+        if (n == 1) {
+            base   = t;
+            expect = sum;
+        } else if (sum != expect) {
+            logger_error("parbench: %d threads produced checksum %x, expected %x\n", n, sum,
+                         expect);
+            return 1;
+        }
+        logger("%8d %10llu %5llu.%02llu %10x\n", n, t * 1000000 / freq, base / t,
+               base * 100 / t % 100, sum);
+    }
+    return 0;
+}
+
+void par_bench(void)
+{
+    logger("=== Parallel Matrix Multiply (%dx%d, %d harts online) ===\n", PAR_N, PAR_N,
+           smp_num_online());
+
+    int pid = proc_spawn_fn("parbench", par_bench_main, NULL);
+    if (pid < 0) {
+        return;
+    }
+    int code = proc_run(pid);
+    if (code != 0) {
+        logger_error("parbench: exited with %d\n", code);
+    }
+}
+
+static int cmd_parbench(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    par_bench();
+    return 0;
+}
+SHELL_CMD(parbench, NULL, "Run multi-threaded matrix multiply scaling benchmark", cmd_parbench);
@@ -0,0 +1,37 @@
+/*
+ * RISC-V testos 每 hart 私有数据
+ */
+
+#include "percpu.h"
+#include "kstack.h"
+
+hart_local_t hart_locals[MAX_HARTS] __attribute__((aligned(64)));
+
+_Static_assert(sizeof(hart_local_t) == HART_LOCAL_SIZE, "HART_LOCAL_SIZE mismatch");
+_Static_assert(offsetof(hart_local_t, stack_limit) == HART_STACK_LIMIT, "HART_STACK_LIMIT mismatch");
+_Static_assert(offsetof(hart_local_t, overflow_sp) == HART_OVERFLOW_SP, "HART_OVERFLOW_SP mismatch");
+_Static_assert(offsetof(hart_local_t, hart_id) == HART_ID, "HART_ID mismatch");
+_Static_assert(offsetof(hart_local_t, trap_depth) == HART_TRAP_DEPTH, "HART_TRAP_DEPTH mismatch");
+_Static_assert(offsetof(hart_local_t, irq_stack_top) == HART_IRQ_STACK_TOP,
+               "HART_IRQ_STACK_TOP mismatch");
+_Static_assert(offsetof(hart_local_t, irq_stack_limit) == HART_IRQ_STACK_LIMIT,
+               "HART_IRQ_STACK_LIMIT mismatch");
+
+// ===============================================================================
+// 初始化当前 hart 的私有数据
+// ===============================================================================
+void percpu_init(uint64_t hart_id)
+{
+    hart_local_t *hl = &hart_locals[hart_id];
+
+    hl->hart_id     = hart_id;
+    hl->stack_limit = kstack_boot_base(hart_id);
+    hl->overflow_sp = kstack_overflow_top(hart_id);
+
+    hl->trap_depth      = 0;
+    hl->irq_stack_limit = kstack_irq_base(hart_id);
+    hl->irq_stack_top   = kstack_irq_top(hart_id);
+
+    // boot.S 已经写过 sscratch，这里再写一次保证与结构体一致
+    CSR_WRITE(sscratch, (uint64_t)hl);
+}
@@ -0,0 +1,249 @@
+/*
+ * RISC-V testos 性能回归基准
+ *
+ * 每项跑 PERF_ROUNDS 轮，每轮连续调用 iters 次，取各轮周期数的中位数再除以次数，
+ * 偶尔落在某一轮里的定时器中断不会影响结果。在 QEMU icount 模式下 cycle CSR
+ * 按执行的指令数推进，同一内核两次运行的结果完全一致，可以直接与基线比较。
+ *
+ * 输出格式（tools/perf.py 解析，改动时两边一起改）：
+ *     PERF <名称> <周期/次>
+ */
+
+#include "types.h"
+#include "perfbench.h"
+#include "sysreg.h"
+#include "sysgate.h"
+#include "timer.h"
+#include "mem.h"
+#include "kfence.h"
+#include "string.h"
+#include "shell.h"
+#include "lib/logger.h"
+#include "uart.h"
+
+#define PERF_ROUNDS     7
+#define PERF_BUF_SIZE   4096
+
+typedef struct {
+    const char *name;
+    void (*fn)(int iters);
+    int iters;                  // 每轮调用次数
+} perf_item_t;
+
+// 防止编译器把被测调用优化掉
+static volatile uintptr_t perf_sink;
+
+static uint8_t perf_src[PERF_BUF_SIZE] __attribute__((aligned(64)));
+static uint8_t perf_dst[PERF_BUF_SIZE + 8] __attribute__((aligned(64)));
+static char    perf_str[257];
+
+// ===============================================================================
+// 陷入路径
+// ===============================================================================
+
+// 给自己挂一个软件中断：经 exception.S 保存现场、分发到 IPI 处理函数再返回
+static void perf_trap_ssip(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        CSR_SET(sip, SIP_SSIP);
+        // 中断在下一条指令之前就会被响应，这里只是让两次之间有个明确的边界
+        asm volatile("nop" ::: "memory");
+    }
+}
+
+static void perf_syscall_gate(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)sysgate(SYS_getpid, 0, 0, 0, 0, 0);
+    }
+}
+
+// ===============================================================================
+// 字符串函数
+// ===============================================================================
+static void perf_memcpy_64(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)memcpy(perf_dst, perf_src, 64);
+    }
+}
+
+static void perf_memcpy_4k(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)memcpy(perf_dst, perf_src, PERF_BUF_SIZE);
+    }
+}
+
+static void perf_memmove_4k(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)memmove(perf_dst + 8, perf_dst, PERF_BUF_SIZE);
+    }
+}
+
+static void perf_memset_4k(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)memset(perf_dst, i, PERF_BUF_SIZE);
+    }
+}
+
+static void perf_memcmp_4k(int iters)
+{
+    memcpy(perf_dst, perf_src, PERF_BUF_SIZE);
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)memcmp(perf_dst, perf_src, PERF_BUF_SIZE);
+    }
+}
+
+static void perf_strlen_256(int iters)
+{
+    memset(perf_str, 'a', sizeof(perf_str) - 1);
+    perf_str[sizeof(perf_str) - 1] = '\0';
+    for (int i = 0; i < iters; i++) {
+        perf_sink = strlen(perf_str);
+    }
+}
+
+static void perf_snprintf(int iters)
+{
+    char buf[128];
+
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)my_snprintf(buf, sizeof(buf), "pid %d: %s at 0x%llx, %08lu\n", i,
+                                           "fault", (unsigned long long)i * 4096, (unsigned long)i);
+    }
+}
+
+// ===============================================================================
+// 分配器
+// ===============================================================================
+
+// 堆只分配不释放：malloc/calloc 每次完整运行用掉 PERF_ROUNDS * iters 个小块
+static void perf_malloc_32(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)malloc(32);
+    }
+}
+
+static void perf_calloc_64(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        perf_sink = (uintptr_t)calloc(1, 64);
+    }
+}
+
+static void perf_page_cycle(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        void *p = alloc_pages(1);
+        perf_sink = (uintptr_t)p;
+        free_pages(p, 1);
+    }
+}
+
+// 每次都强制抽样：一次 KFENCE 分配加释放（映射、填校验字节、检查、取消映射）的代价，
+// 乘以每秒的抽样次数就是常开时的开销；启动参数 kfence=0 时退化为普通 malloc
+static void perf_kfence_32(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        kfence_arm();
+        void *p = malloc(32);
+        perf_sink = (uintptr_t)p;
+        free(p);
+    }
+}
+
+static void perf_mem_zero_4k(int iters)
+{
+    for (int i = 0; i < iters; i++) {
+        mem_zero(perf_dst, PERF_BUF_SIZE);
+    }
+}
+
+// 名称是基线文件的键，改名等于新增一项
+static const perf_item_t perf_items[] = {
+    { "trap.ssip",       perf_trap_ssip,    256 },
+    { "syscall.getpid",  perf_syscall_gate, 256 },
+    { "string.memcpy64", perf_memcpy_64,    256 },
+    { "string.memcpy4k", perf_memcpy_4k,    16 },
+    { "string.memmove4k", perf_memmove_4k,  16 },
+    { "string.memset4k", perf_memset_4k,    16 },
+    { "string.memcmp4k", perf_memcmp_4k,    16 },
+    { "string.strlen256", perf_strlen_256,  64 },
+    { "string.snprintf", perf_snprintf,     64 },
+    { "alloc.malloc32",  perf_malloc_32,    128 },
+    { "alloc.calloc64",  perf_calloc_64,    128 },
+    { "alloc.page",      perf_page_cycle,   128 },
+    { "alloc.kfence32",  perf_kfence_32,    16 },
+    { "alloc.memzero4k", perf_mem_zero_4k,  16 },
+};
+
+// ===============================================================================
+// 运行
+// ===============================================================================
+static uint64_t perf_measure(const perf_item_t *item)
+{
+    uint64_t samples[PERF_ROUNDS];
+
+    // 先跑一轮热身，让缓存和 TLB 进入稳定状态
+    item->fn(item->iters);
+
+    for (int r = 0; r < PERF_ROUNDS; r++) {
+        uint64_t start = READ_CYCLE();
+        item->fn(item->iters);
+        samples[r] = READ_CYCLE() - start;
+    }
+
+    // 插入排序取中位数
+    for (int i = 1; i < PERF_ROUNDS; i++) {
+        uint64_t v = samples[i];
+        int j = i - 1;
+        while (j >= 0 && samples[j] > v) {
+            samples[j + 1] = samples[j];
+            j--;
+        }
+        samples[j + 1] = v;
+    }
+    return samples[PERF_ROUNDS / 2] / item->iters;
+}
+
+void perf_bench(const char *name)
+{
+    size_t prefix = name ? strlen(name) : 0;
+    int    ran    = 0;
+
+    // 自陷测试需要软件中断已使能，否则挂起位会一直留到以后才触发
+    bool irq_ready = (READ_SSTATUS() & SSTATUS_SIE) && (READ_SIE() & SIE_SSIE);
+
+    for (size_t i = 0; i < sizeof(perf_items) / sizeof(perf_items[0]); i++) {
+        const perf_item_t *item = &perf_items[i];
+        char line[64];
+
+        if (prefix && strncmp(item->name, name, prefix) != 0) {
+            continue;
+        }
+        if (item->fn == perf_trap_ssip && !irq_ready) {
+            logger_warn("perfbench: software interrupts disabled, skipping %s\n", item->name);
+            continue;
+        }
+        my_snprintf(line, sizeof(line), "PERF %s %llu\r\n", item->name,
+                    (unsigned long long)perf_measure(item));
+        uart_puts(line);
+        ran++;
+    }
+
+    if (!ran) {
+        logger_warn("perfbench: no benchmark matches '%s'\n", name);
+    }
+}
+
+static int cmd_perfbench(int argc, char **argv)
+{
+    perf_bench(argc > 1 ? argv[1] : NULL);
+    return 0;
+}
+SHELL_CMD(perfbench, "[prefix]", "Run cycle micro-benchmarks (names starting with prefix)",
+          cmd_perfbench);
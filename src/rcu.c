@@ -0,0 +1,408 @@
+/*
+ * RISC-V testos RCU 实现
+ * 宽限期序号 + 每 hart 静止状态记录，回调在 RCU 软中断中执行
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "atomic.h"
+#include "rcu.h"
+#include "smp.h"
+#include "softirq.h"
+#include "spinlock.h"
+#include "mem.h"
+#include "timer.h"
+#include "initcall.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+rcu_data_t rcu_data[MAX_HARTS];
+
+// 当前宽限期序号，每次开启新宽限期加 1
+static volatile uint64_t rcu_gp_seq;
+
+// 已完成的宽限期数（统计用）
+static volatile uint64_t rcu_gp_completed;
+
+// 待执行回调，按提交顺序排列（宽限期序号单调不减）
+static rcu_head_t  *rcu_cb_head;
+static rcu_head_t **rcu_cb_tail = &rcu_cb_head;
+static spinlock_t   rcu_cb_lock;
+static uint64_t     rcu_cb_pending;
+static uint64_t     rcu_cb_invoked;
+
+// ===============================================================================
+// 静止状态
+// ===============================================================================
+static void rcu_qs(rcu_data_t *rd)
+{
+    // 之前的读操作全部完成后再记录序号
+    smp_mb();
+    WRITE_ONCE(rd->qs_seq, READ_ONCE(rcu_gp_seq));
+    rd->qs_count++;
+}
+
+void rcu_irq_exit(hart_local_t *hl)
+{
+    rcu_data_t *rd = &rcu_data[hl->hart_id];
+
+    if (hl->trap_depth == 1 && rd->nesting == 0) {
+        rcu_qs(rd);
+    }
+}
+
+void rcu_note_context_switch(void)
+{
+    rcu_qs(&rcu_data[this_hart_id()]);
+}
+
+void rcu_idle_enter(void)
+{
+    rcu_data_t *rd = &rcu_data[this_hart_id()];
+
+    rcu_qs(rd);
+    WRITE_ONCE(rd->idle, 1);
+    smp_mb();
+}
+
+void rcu_idle_exit(void)
+{
+    rcu_data_t *rd = &rcu_data[this_hart_id()];
+
+    // 与写者的 smp_mb 配对：要么写者看到 idle == 0 并等待，要么这里之后的读者看到新指针
+    WRITE_ONCE(rd->idle, 0);
+    smp_mb();
+}
+
+// ===============================================================================
+// 宽限期
+// ===============================================================================
+
+// 开启新宽限期，返回需要等待的序号
+static uint64_t rcu_gp_start(void)
+{
+    // 发布新指针的写操作先于序号增加
+    smp_mb();
+    return atomic_fetch_add(&rcu_gp_seq, 1) + 1;
+}
+
+// 返回尚未经过 gp 宽限期静止状态的 hart 位图（不含当前 hart）
+static uint64_t rcu_gp_pending(uint64_t gp)
+{
+    uint64_t self    = this_hart_id();
+    uint64_t online  = READ_ONCE(smp_online_mask);
+    uint64_t pending = 0;
+
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        if (hart == self || !(online & HART_MASK(hart))) {
+            continue;
+        }
+        rcu_data_t *rd = &rcu_data[hart];
+        if (READ_ONCE(rd->idle) || READ_ONCE(rd->qs_seq) >= gp) {
+            continue;
+        }
+        pending |= HART_MASK(hart);
+    }
+
+    smp_mb();
+    return pending;
+}
+
+void synchronize_rcu(void)
+{
+    uint64_t gp      = rcu_gp_start();
+    uint64_t pending = rcu_gp_pending(gp);
+
+    if (pending) {
+        // 加速：向还没有报告的 hart 发一次空 IPI，中断返回时即可报告静止状态
+        smp_send_ipi(pending);
+        while (rcu_gp_pending(gp)) {
+            cpu_relax();
+        }
+    }
+
+    atomic_fetch_add(&rcu_gp_completed, 1);
+}
+
+// ===============================================================================
+// 异步回调
+// ===============================================================================
+void call_rcu(rcu_head_t *head, rcu_callback_t func)
+{
+    head->func   = func;
+    head->next   = NULL;
+    head->gp_seq = rcu_gp_start();
+
+    uint64_t flags = spin_lock_irqsave(&rcu_cb_lock);
+    *rcu_cb_tail = head;
+    rcu_cb_tail  = &head->next;
+    rcu_cb_pending++;
+    spin_unlock_irqrestore(&rcu_cb_lock, flags);
+}
+
+// 取出宽限期已结束的回调并执行，只能在静止状态下调用
+static void rcu_process_callbacks(void)
+{
+    rcu_head_t *done = NULL;
+    rcu_head_t **done_tail = &done;
+
+    if (!READ_ONCE(rcu_cb_head)) {
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&rcu_cb_lock);
+    while (rcu_cb_head && !rcu_gp_pending(rcu_cb_head->gp_seq)) {
+        rcu_head_t *head = rcu_cb_head;
+        rcu_cb_head = head->next;
+        *done_tail  = head;
+        done_tail   = &head->next;
+        rcu_cb_pending--;
+    }
+    if (!rcu_cb_head) {
+        rcu_cb_tail = &rcu_cb_head;
+    }
+    *done_tail = NULL;
+    spin_unlock_irqrestore(&rcu_cb_lock, flags);
+
+    while (done) {
+        rcu_head_t *next = done->next;
+        done->func(done);
+        rcu_cb_invoked++;
+        done = next;
+    }
+}
+
+void rcu_tick(void)
+{
+    if (READ_ONCE(rcu_cb_head)) {
+        raise_softirq(SOFTIRQ_RCU);
+    }
+}
+
+// 软中断只在最外层中断返回前执行，被打断的线程不在读临界区内时才是静止状态
+static void rcu_softirq(void)
+{
+    if (rcu_data[this_hart_id()].nesting == 0) {
+        rcu_process_callbacks();
+    }
+}
+
+static int rcu_initcall(void)
+{
+    open_softirq(SOFTIRQ_RCU, rcu_softirq, "rcu");
+    return 0;
+}
+INITCALL(rcu, INIT_CORE, 0, rcu_initcall);
+
+void rcu_barrier(void)
+{
+    while (READ_ONCE(rcu_cb_head)) {
+        synchronize_rcu();
+        rcu_process_callbacks();
+    }
+}
+
+// ===============================================================================
+// 统计输出
+// ===============================================================================
+void rcu_dump_stats(void)
+{
+    logger("=== RCU ===\n");
+    logger("  gp_seq=%llu completed=%llu callbacks pending=%llu invoked=%llu\n", rcu_gp_seq,
+           rcu_gp_completed, rcu_cb_pending, rcu_cb_invoked);
+    logger("  %-6s %10s %10s %6s\n", "hart", "qs_seq", "qs_count", "idle");
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        if (!(smp_online_mask & HART_MASK(hart))) {
+            continue;
+        }
+        rcu_data_t *rd = &rcu_data[hart];
+        logger("  %-6llu %10llu %10llu %6llu\n", hart, rd->qs_seq, rd->qs_count, rd->idle);
+    }
+}
+
+static int cmd_rcu(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    rcu_dump_stats();
+    return 0;
+}
+SHELL_CMD(rcu, NULL, "Show RCU grace period state", cmd_rcu);
+
+// ===============================================================================
+// 读者扩展性测试
+// 共享配置满足 a + b == RCU_BENCH_SUM，读者每次检查这个不变式，
+// 发起测试的 hart 同时周期性地替换配置
+// ===============================================================================
+#define RCU_BENCH_ITERS     100000
+#define RCU_BENCH_WRITE_GAP 5000        // 写者每隔多少次读更新一次
+#define RCU_BENCH_SUM       1000000
+
+typedef struct {
+    rcu_head_t rcu;
+    uint64_t a;
+    uint64_t b;
+} bench_cfg_t;
+
+enum {
+    RCU_BENCH_RCU,
+    RCU_BENCH_SPIN,
+    RCU_BENCH_NR,
+};
+
+typedef struct {
+    int mode;
+    uint64_t harts;
+    uint64_t writer;
+    volatile uint64_t arrived;
+    volatile uint64_t errors;
+    uint64_t cycles[MAX_HARTS];
+} rcu_bench_t;
+
+static bench_cfg_t *bench_cfg;          // RCU 保护
+static bench_cfg_t  bench_locked_cfg;   // 自旋锁保护
+static spinlock_t   bench_lock;
+
+static void bench_cfg_free(rcu_head_t *head)
+{
+    free_pages(head, 1);
+}
+
+static void bench_update(int mode, uint64_t a)
+{
+    if (mode == RCU_BENCH_RCU) {
+        bench_cfg_t *cfg = alloc_pages(1);
+        if (!cfg) {
+            return;
+        }
+        cfg->a = a;
+        cfg->b = RCU_BENCH_SUM - a;
+
+        bench_cfg_t *old = bench_cfg;
+        rcu_assign_pointer(bench_cfg, cfg);
+        call_rcu(&old->rcu, bench_cfg_free);
+    } else {
+        spin_lock(&bench_lock);
+        bench_locked_cfg.a = a;
+        bench_locked_cfg.b = RCU_BENCH_SUM - a;
+        spin_unlock(&bench_lock);
+    }
+}
+
+// 在 IPI 上下文中运行，不能使用浮点
+static void rcu_bench_worker(void *arg)
+{
+    rcu_bench_t *b      = arg;
+    uint64_t     self   = this_hart_id();
+    uint64_t     errors = 0;
+    uint64_t     sum;
+
+    atomic_fetch_add(&b->arrived, 1);
+    while (READ_ONCE(b->arrived) < b->harts) {
+        cpu_relax();
+    }
+
+    uint64_t start = READ_CYCLE();
+    for (uint64_t i = 0; i < RCU_BENCH_ITERS; i++) {
+        if (b->mode == RCU_BENCH_RCU) {
+            rcu_read_lock();
+            bench_cfg_t *cfg = rcu_dereference(bench_cfg);
+            sum = cfg->a + cfg->b;
+            rcu_read_unlock();
+        } else {
+            spin_lock(&bench_lock);
+            sum = bench_locked_cfg.a + bench_locked_cfg.b;
+            spin_unlock(&bench_lock);
+        }
+        if (sum != RCU_BENCH_SUM) {
+            errors++;
+        }
+        if (self == b->writer && i % RCU_BENCH_WRITE_GAP == 0) {
+            bench_update(b->mode, i);
+        }
+    }
+    b->cycles[self] = READ_CYCLE() - start;
+
+    if (errors) {
+        atomic_fetch_add(&b->errors, errors);
+    }
+}
+
+void rcu_bench(void)
+{
+    static const char *const mode_names[RCU_BENCH_NR] = { "rcu", "spinlock" };
+    uint64_t    self   = this_hart_id();
+    uint64_t    online = READ_ONCE(smp_online_mask);
+    rcu_bench_t b;
+
+    if (!bench_cfg) {
+        bench_cfg_t *cfg = alloc_pages(1);
+        if (!cfg) {
+            logger_error("rcubench: out of memory\n");
+            return;
+        }
+        cfg->a = 0;
+        cfg->b = RCU_BENCH_SUM;
+        rcu_assign_pointer(bench_cfg, cfg);
+        bench_locked_cfg.a = 0;
+        bench_locked_cfg.b = RCU_BENCH_SUM;
+        spin_lock_init(&bench_lock, NULL);
+    }
+
+    logger("=== RCU Reader Scalability ===\n");
+    logger("  %d reads per hart, writer hart %llu updates every %d reads\n", RCU_BENCH_ITERS,
+           self, RCU_BENCH_WRITE_GAP);
+    logger("  %-10s %6s %12s %10s %14s %s\n", "mode", "harts", "wall cyc", "cyc/read",
+           "reads/kcyc", "check");
+
+    for (int mode = 0; mode < RCU_BENCH_NR; mode++) {
+        // 当前 hart 总是参与，逐个加入其他在线 hart
+        uint64_t mask  = HART_MASK(self);
+        uint64_t harts = 1;
+        uint64_t next  = 0;
+
+        for (;;) {
+            b.mode    = mode;
+            b.harts   = harts;
+            b.writer  = self;
+            b.arrived = 0;
+            b.errors  = 0;
+            for (int h = 0; h < MAX_HARTS; h++) {
+                b.cycles[h] = 0;
+            }
+
+            smp_call_function(mask, rcu_bench_worker, &b, true);
+
+            uint64_t wall  = 0;
+            uint64_t total = 0;
+            for (int h = 0; h < MAX_HARTS; h++) {
+                if (b.cycles[h] > wall) {
+                    wall = b.cycles[h];
+                }
+                total += b.cycles[h];
+            }
+            uint64_t reads = harts * RCU_BENCH_ITERS;
+            logger("  %-10s %6llu %12llu %10llu %14llu %s\n", mode_names[mode], harts, wall,
+                   total / reads, wall ? reads * 1000 / wall : 0, b.errors ? "FAIL" : "ok");
+
+            while (next < MAX_HARTS && (next == self || !(online & HART_MASK(next)))) {
+                next++;
+            }
+            if (next >= MAX_HARTS) {
+                break;
+            }
+            mask |= HART_MASK(next++);
+            harts++;
+        }
+    }
+
+    // 回收测试过程中替换下来的配置
+    rcu_barrier();
+}
+
+static int cmd_rcubench(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    rcu_bench();
+    return 0;
+}
+SHELL_CMD(rcubench, NULL, "Run RCU reader scalability benchmark", cmd_rcubench);
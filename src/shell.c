@@ -0,0 +1,499 @@
+/*
+ * RISC-V testos 命令行：命令表、参数切分与行编辑
+ *
+ * 命令表由链接脚本按名字排序（见 include/shell.h），启动时检查一遍顺序；
+ * 出现重名或乱序时退回线性查找，只影响速度不影响结果。
+ * time/repeat/script 通过 shell_exec 递归执行其他命令，可以任意组合，
+ * 如 repeat 10 time perfbench。
+ */
+
+#include "types.h"
+#include "shell.h"
+#include "initcall.h"
+#include "string.h"
+#include "uart.h"
+#include "timer.h"
+#include "atomic.h"
+#include "workqueue.h"
+#include "cpiofs.h"
+#include "lib/logger.h"
+
+extern const shell_cmd_t __shell_cmd_start[];
+extern const shell_cmd_t __shell_cmd_end[];
+
+// 编译时嵌入的脚本，由 Makefile 生成的 shell_scripts.S 登记
+typedef struct {
+    const char *name;
+    const char *text;
+    uint64_t    size;
+} shell_script_t;
+
+extern const shell_script_t __shell_script_start[];
+extern const shell_script_t __shell_script_end[];
+
+static bool shell_sorted;
+
+#define for_each_shell_cmd(c) \
+    for (const shell_cmd_t *c = __shell_cmd_start; c < __shell_cmd_end; c++)
+
+static int shell_initcall(void)
+{
+    shell_sorted = true;
+    for (const shell_cmd_t *c = __shell_cmd_start + 1; c < __shell_cmd_end; c++) {
+        int order = strcmp(c[-1].name, c->name);
+
+        if (order >= 0) {
+            logger_warn("shell: command '%s' %s, using linear lookup\n", c->name,
+                        order == 0 ? "registered twice" : "out of order");
+            shell_sorted = false;
+        }
+    }
+    return 0;
+}
+INITCALL(shell, INIT_EARLY, 0, shell_initcall);
+
+// ===============================================================================
+// 查找
+// ===============================================================================
+
+// 第一个前 len 个字符不小于 key 的表项；未排序时从头开始
+static const shell_cmd_t *shell_lower_bound(const char *key, size_t len)
+{
+    const shell_cmd_t *lo = __shell_cmd_start;
+    const shell_cmd_t *hi = __shell_cmd_end;
+
+    if (!shell_sorted) {
+        return lo;
+    }
+    while (lo < hi) {
+        const shell_cmd_t *mid = lo + (hi - lo) / 2;
+
+        if (strncmp(mid->name, key, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// 从 c 开始的下一个名字以 prefix 开头的表项，没有时返回 NULL
+static const shell_cmd_t *shell_next_match(const shell_cmd_t *c, const char *prefix, size_t len)
+{
+    for (; c < __shell_cmd_end; c++) {
+        if (strncmp(c->name, prefix, len) == 0) {
+            return c;
+        }
+        if (shell_sorted) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+const shell_cmd_t *shell_find(const char *name)
+{
+    size_t             len = strlen(name) + 1;      // 连同结尾的 '\0' 比较，即精确匹配
+    const shell_cmd_t *c   = shell_next_match(shell_lower_bound(name, len), name, len);
+
+    if (c && c->alias_of) {
+        c = c->alias_of;
+    }
+    return c;
+}
+
+// ===============================================================================
+// 执行
+// ===============================================================================
+
+int shell_parse(char *line, char **argv, int max)
+{
+    int argc = 0;
+
+    while (argc < max) {
+        while (*line == ' ' || *line == '\t') {
+            line++;
+        }
+        if (!*line) {
+            break;
+        }
+
+        // 去掉引号后就地前移，out 不会超过 line
+        char *out    = line;
+        bool  quoted = false;
+
+        argv[argc++] = out;
+        while (*line && (quoted || (*line != ' ' && *line != '\t'))) {
+            if (*line == '"') {
+                quoted = !quoted;
+                line++;
+                continue;
+            }
+            *out++ = *line++;
+        }
+
+        char sep = *line;
+        *out = '\0';
+        if (sep) {
+            line++;
+        }
+    }
+    return argc;
+}
+
+static int shell_exec_argv(int argc, char **argv)
+{
+    const shell_cmd_t *c = shell_find(argv[0]);
+
+    if (!c) {
+        logger("Unknown command: %s\nType 'help' for available commands.\n", argv[0]);
+        return -1;
+    }
+    return c->fn(argc, argv);
+}
+
+int shell_exec(char *line)
+{
+    char *argv[SHELL_MAX_ARGS];
+    int   argc = shell_parse(line, argv, SHELL_MAX_ARGS);
+
+    if (argc == 0) {
+        return 0;
+    }
+    return shell_exec_argv(argc, argv);
+}
+
+// ===============================================================================
+// 计时
+// ===============================================================================
+
+static uint64_t ticks_to_us(uint64_t ticks)
+{
+    return ticks * 1000000 / timer_get_frequency();
+}
+
+static int shell_cmd_time(int argc, char **argv)
+{
+    if (argc < 2) {
+        logger("usage: time <command> [args...]\n");
+        return -1;
+    }
+
+    uint64_t start  = READ_TIME();
+    uint64_t cycles = READ_CYCLE();
+    int      ret    = shell_exec_argv(argc - 1, argv + 1);
+
+    cycles = READ_CYCLE() - cycles;
+    logger("time: %llu us, %llu cycles\n", ticks_to_us(READ_TIME() - start), cycles);
+    return ret;
+}
+SHELL_CMD(time, "<command> [args...]", "Run a command and show its wall time and cycles",
+          shell_cmd_time);
+
+// 每次执行都重新传入同一组参数，处理函数不能修改参数字符串
+static int shell_cmd_repeat(int argc, char **argv)
+{
+    int n = argc > 2 ? atoi(argv[1]) : 0;
+
+    if (n <= 0) {
+        logger("usage: repeat <n> <command> [args...]\n");
+        return -1;
+    }
+
+    uint64_t min = ~0ULL, max = 0, total = 0, cycles = 0;
+    int      runs = 0;
+    int      ret  = 0;
+
+    while (runs < n) {
+        uint64_t start = READ_TIME();
+        uint64_t c0    = READ_CYCLE();
+
+        ret = shell_exec_argv(argc - 2, argv + 2);
+
+        uint64_t ticks = READ_TIME() - start;
+        cycles += READ_CYCLE() - c0;
+        total  += ticks;
+        if (ticks < min) {
+            min = ticks;
+        }
+        if (ticks > max) {
+            max = ticks;
+        }
+        runs++;
+
+        // 失败或要求退出时停止，已完成的次数照常统计
+        if (ret < 0 || ret == SHELL_EXIT) {
+            break;
+        }
+    }
+
+    logger("repeat: %d/%d runs, min %llu us, avg %llu us, max %llu us, avg %llu cycles\n", runs, n,
+           ticks_to_us(min), ticks_to_us(total / runs), ticks_to_us(max), cycles / runs);
+    return ret;
+}
+SHELL_CMD(repeat, "<n> <command> [args...]", "Run a command n times, show min/avg/max time",
+          shell_cmd_repeat);
+
+// ===============================================================================
+// 脚本
+// ===============================================================================
+
+// 先在根文件系统中找，再找编译时嵌入内核的脚本（Makefile 的 SHELL_SCRIPTS）
+static bool shell_script_find(const char *name, const char **text, size_t *size)
+{
+    const cpio_file_t *f = cpiofs_lookup(name);
+
+    if (f) {
+        *text = (const char *)f->data;
+        *size = f->size;
+        return true;
+    }
+    for (const shell_script_t *sc = __shell_script_start; sc < __shell_script_end; sc++) {
+        if (strcmp(sc->name, name) == 0) {
+            *text = sc->text;
+            *size = sc->size;
+            return true;
+        }
+    }
+    return false;
+}
+
+int shell_run_script(const char *name)
+{
+    static int depth;
+    const char *text;
+    size_t      size;
+
+    if (!shell_script_find(name, &text, &size)) {
+        logger("script: %s not found\n", name);
+        return -1;
+    }
+    if (depth >= SHELL_SCRIPT_DEPTH) {
+        logger("script: %s nested too deeply\n", name);
+        return -1;
+    }
+
+    char     line[SHELL_LINE_MAX];
+    int      ncmds  = 0;
+    int      failed = 0;
+    int      ret    = 0;
+    int      lineno = 0;
+    uint64_t start  = READ_TIME();
+
+    depth++;
+    for (size_t pos = 0; pos < size && ret != SHELL_EXIT;) {
+        size_t len      = 0;
+        bool   too_long = false;
+
+        while (pos < size && text[pos] != '\n') {
+            char c = text[pos++];
+            if (c == '\r') {
+                continue;
+            }
+            if (len + 1 < sizeof(line)) {
+                line[len++] = c;
+            } else {
+                too_long = true;
+            }
+        }
+        pos++;
+        lineno++;
+        line[len] = '\0';
+
+        const char *cmd = line;
+        while (*cmd == ' ' || *cmd == '\t') {
+            cmd++;
+        }
+        if (*cmd == '\0' || *cmd == '#') {
+            continue;
+        }
+        // 截断后的命令可能是另一条命令，不执行，记为失败
+        if (too_long) {
+            logger("%s:%d: line longer than %d characters, skipped\n", name, lineno,
+                   SHELL_LINE_MAX - 1);
+            ncmds++;
+            failed++;
+            continue;
+        }
+
+        // 回显命令，输出日志中能看出每段结果属于哪条命令
+        logger("%s> %s\n", name, cmd);
+        ret = shell_exec(line);
+        ncmds++;
+        if (ret < 0) {
+            failed++;
+        }
+    }
+    depth--;
+
+    logger("script %s: %d commands, %d failed, %llu us\n", name, ncmds, failed,
+           ticks_to_us(READ_TIME() - start));
+    return ret == SHELL_EXIT ? SHELL_EXIT : (failed ? -1 : 0);
+}
+
+static int shell_cmd_script(int argc, char **argv)
+{
+    if (argc < 2) {
+        logger("Embedded scripts:");
+        for (const shell_script_t *sc = __shell_script_start; sc < __shell_script_end; sc++) {
+            logger(" %s", sc->name);
+        }
+        logger("\nusage: script <name> (root filesystem first, then embedded)\n");
+        return 0;
+    }
+    return shell_run_script(argv[1]);
+}
+SHELL_CMD(script, "[name]", "Run commands from a script, list embedded scripts",
+          shell_cmd_script);
+
+// ===============================================================================
+// help
+// ===============================================================================
+
+static void shell_help_line(const shell_cmd_t *cmd)
+{
+    char usage[48];
+
+    strcpy(usage, cmd->name);
+    for_each_shell_cmd(c) {
+        if (c->alias_of == cmd && strlen(usage) + strlen(c->name) + 2 < sizeof(usage)) {
+            strcat(usage, ", ");
+            strcat(usage, c->name);
+        }
+    }
+    if (cmd->args && strlen(usage) + strlen(cmd->args) + 1 < sizeof(usage)) {
+        strcat(usage, " ");
+        strcat(usage, cmd->args);
+    }
+    logger("  %-22s - %s\n", usage, cmd->help);
+}
+
+static int shell_cmd_help(int argc, char **argv)
+{
+    if (argc > 1) {
+        const shell_cmd_t *c = shell_find(argv[1]);
+        if (!c) {
+            logger("help: no such command: %s\n", argv[1]);
+            return -1;
+        }
+        shell_help_line(c);
+        return 0;
+    }
+
+    logger("Available commands:\n");
+    for_each_shell_cmd(c) {
+        if (!c->alias_of) {
+            shell_help_line(c);
+        }
+    }
+    return 0;
+}
+SHELL_CMD(help, "[command]", "Show this help", shell_cmd_help);
+SHELL_ALIAS(h, help);
+
+// ===============================================================================
+// 行编辑
+// ===============================================================================
+
+// 补全第一个词：唯一匹配时补全并加空格，多个匹配时补到公共前缀，无法再补时列出候选
+static size_t shell_complete(const char *prompt, char *buf, size_t len, size_t size)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] == ' ' || buf[i] == '\t') {
+            return len;
+        }
+    }
+
+    const shell_cmd_t *first  = shell_next_match(shell_lower_bound(buf, len), buf, len);
+    size_t             common = first ? strlen(first->name) : 0;
+    int                n      = 0;
+
+    for (const shell_cmd_t *c = first; c; c = shell_next_match(c + 1, buf, len)) {
+        size_t k = len;
+        while (k < common && c->name[k] == first->name[k]) {
+            k++;
+        }
+        common = k;
+        n++;
+    }
+    if (n == 0) {
+        return len;
+    }
+
+    if (common > len) {
+        if (common + 1 >= size) {
+            return len;
+        }
+        memcpy(buf + len, first->name + len, common - len);
+        buf[common] = '\0';
+        uart_puts(buf + len);
+        len = common;
+    } else if (n > 1) {
+        buf[len] = '\0';
+        uart_puts("\r\n");
+        for (const shell_cmd_t *c = first; c; c = shell_next_match(c + 1, buf, len)) {
+            uart_puts(c->name);
+            uart_puts("  ");
+        }
+        uart_puts("\r\n");
+        uart_puts(prompt);
+        uart_puts(buf);
+    }
+
+    if (n == 1 && len + 1 < size) {
+        buf[len++] = ' ';
+        uart_putchar(' ');
+    }
+    return len;
+}
+
+// 等待输入期间执行本 hart 的工作队列：启动 hart 负责定时器软中断，
+// 它投递的工作不能等到有人按下回车
+static char shell_getchar(void)
+{
+#if defined(UART_TYPE_DW)
+    int c;
+
+    while ((c = uart_try_getchar()) < 0) {
+        if (!workqueue_run()) {
+            cpu_relax();
+        }
+    }
+    return (char)c;
+#else
+    // 没有非阻塞读的串口只能在两条命令之间执行工作队列
+    return uart_getchar();
+#endif
+}
+
+int shell_readline(const char *prompt, char *buf, size_t size)
+{
+    size_t len = 0;
+
+    for (;;) {
+        char c = shell_getchar();
+
+        if (c == '\r' || c == '\n') {
+            uart_puts("\r\n");
+            break;
+        }
+        if (c == '\b' || c == 127) {
+            if (len > 0) {
+                len--;
+                uart_puts("\b \b");
+            }
+            continue;
+        }
+        if (c == '\t') {
+            len = shell_complete(prompt, buf, len, size);
+            continue;
+        }
+        // 其他控制字符（方向键的转义序列等）不进入缓冲区
+        if (c >= ' ' && c < 127 && len + 1 < size) {
+            buf[len++] = c;
+            uart_putchar(c);
+        }
+    }
+    buf[len] = '\0';
+    return len;
+}
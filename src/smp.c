@@ -0,0 +1,371 @@
+/*
+ * RISC-V testos 多 hart 支持
+ * SBI HSM 启动从核 + IPI 跨 hart 函数调用
+ */
+
+#include "types.h"
+#include "sysreg.h"
+#include "atomic.h"
+#include "sbi.h"
+#include "smp.h"
+#include "percpu.h"
+#include "mmu.h"
+#include "timer.h"
+#include "exception.h"
+#include "rcu.h"
+#include "idle.h"
+#include "proc.h"
+#include "initcall.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+// boot.S 中的从核入口
+extern char _secondary_start[];
+
+volatile uint64_t smp_online_mask;
+
+// 每个 hart 的调用队列，按缓存行对齐避免不同 hart 之间的伪共享
+typedef struct {
+    volatile uint64_t head;     // csd_t 单链表头（后进先出），接收方整体摘下
+    volatile uint64_t sent;     // 实际发给本 hart 的 IPI 数
+    volatile uint64_t coalesced; // 合并到已挂起 IPI 中的请求数
+    volatile uint64_t received; // 本 hart 处理的软件中断数
+    volatile uint64_t calls;    // 本 hart 执行的请求数
+} __attribute__((aligned(64))) ipi_queue_t;
+
+static ipi_queue_t ipi_queues[MAX_HARTS];
+
+// 不等待的调用使用的请求池，按 [发送方][接收方] 分配，轮流使用，
+// 复用前等待上一次执行完。池中的请求可以同时挂在队列上合并处理
+#define ASYNC_CSD_NR    8
+
+static csd_t   async_csd[MAX_HARTS][MAX_HARTS][ASYNC_CSD_NR];
+static uint8_t async_next[MAX_HARTS][MAX_HARTS];
+
+// 从核等待上线的超时时间（ms）
+#define HART_START_TIMEOUT_MS   100
+
+// ===============================================================================
+// 调用队列
+// ===============================================================================
+
+// 挂入目标队列，返回入队前队列是否为空（为空时需要发送 IPI）
+static bool csd_enqueue(ipi_queue_t *q, csd_t *csd)
+{
+    uint64_t old = READ_ONCE(q->head);
+    uint64_t prev;
+
+    for (;;) {
+        csd->next = (csd_t *)old;
+        prev      = atomic_cmpxchg(&q->head, old, (uint64_t)csd);
+        if (prev == old) {
+            return old == 0;
+        }
+        old = prev;
+    }
+}
+
+// 执行本 hart 队列中的全部请求
+static void ipi_drain(void)
+{
+    ipi_queue_t *q    = &ipi_queues[this_hart_id()];
+    csd_t       *list = (csd_t *)atomic_swap(&q->head, 0);
+    csd_t       *prev = NULL;
+
+    if (!list) {
+        return;
+    }
+
+    // 队列是后进先出的，反转后按提交顺序执行
+    while (list) {
+        csd_t *next = list->next;
+        list->next  = prev;
+        prev        = list;
+        list        = next;
+    }
+
+    for (csd_t *csd = prev; csd;) {
+        // 解锁后发送方可能立即复用 csd，先取出需要的字段
+        csd_t          *next = csd->next;
+        smp_call_func_t func = csd->func;
+        void           *arg  = csd->arg;
+
+        if (csd->flags & CSD_FLAG_SYNC) {
+            func(arg);
+            smp_store_release(&csd->flags, 0);
+        } else {
+            smp_store_release(&csd->flags, 0);
+            func(arg);
+        }
+        atomic_fetch_add(&q->calls, 1);
+        csd = next;
+    }
+}
+
+// 等待请求执行完，期间处理发给自己的请求，避免两个 hart 互相等待时死锁
+static void csd_lock_wait(csd_t *csd)
+{
+    while (smp_load_acquire(&csd->flags) & CSD_FLAG_LOCK) {
+        ipi_drain();
+        cpu_relax();
+    }
+}
+
+// ===============================================================================
+// IPI 发送与处理
+// ===============================================================================
+void smp_send_ipi(uint64_t mask)
+{
+    mask &= READ_ONCE(smp_online_mask);
+    if (!mask) {
+        return;
+    }
+
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        if (mask & HART_MASK(hart)) {
+            atomic_fetch_add(&ipi_queues[hart].sent, 1);
+        }
+    }
+    // 一次 SBI 调用发给所有目标
+    sbi_send_ipi(mask, 0);
+}
+
+static void ipi_handler(trap_frame_t *frame)
+{
+    (void)frame;
+
+    // 先清挂起位再取队列：之后入队的请求会重新置位 SSIP，不会丢失
+    CSR_CLEAR(sip, SIP_SSIP);
+    atomic_fetch_add(&ipi_queues[this_hart_id()].received, 1);
+    ipi_drain();
+}
+
+// ===============================================================================
+// 跨 hart 函数调用
+// ===============================================================================
+int smp_call_function(uint64_t mask, smp_call_func_t fn, void *arg, bool wait)
+{
+    csd_t    sync_csd[MAX_HARTS];
+    uint64_t self = this_hart_id();
+    uint64_t kick = 0;
+    uint64_t flags;
+
+    if (!fn) {
+        return -1;
+    }
+    mask &= READ_ONCE(smp_online_mask);
+
+    // 关中断入队，防止本 hart 的中断处理函数同时使用同一个异步请求
+    flags = local_irq_save();
+
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        if (hart == self || !(mask & HART_MASK(hart))) {
+            continue;
+        }
+
+        csd_t *csd = &sync_csd[hart];
+        if (!wait) {
+            uint8_t idx = async_next[self][hart];
+            async_next[self][hart] = (idx + 1) % ASYNC_CSD_NR;
+            csd = &async_csd[self][hart][idx];
+            csd_lock_wait(csd);
+        }
+        csd->func  = fn;
+        csd->arg   = arg;
+        csd->flags = CSD_FLAG_LOCK | (wait ? CSD_FLAG_SYNC : 0);
+
+        if (csd_enqueue(&ipi_queues[hart], csd)) {
+            kick |= HART_MASK(hart);
+        } else {
+            atomic_fetch_add(&ipi_queues[hart].coalesced, 1);
+        }
+    }
+
+    smp_send_ipi(kick);
+
+    if (mask & HART_MASK(self)) {
+        fn(arg);
+    }
+
+    local_irq_restore(flags);
+
+    if (wait) {
+        for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+            if (hart != self && (mask & HART_MASK(hart))) {
+                csd_lock_wait(&sync_csd[hart]);
+            }
+        }
+    }
+
+    return 0;
+}
+
+// ===============================================================================
+// 远程 TLB 刷新
+// ===============================================================================
+static void flush_tlb_page_local(void *arg)
+{
+    SFENCE_VMA((uintptr_t)arg);
+}
+
+void smp_flush_tlb_page(uintptr_t va)
+{
+    uint64_t others = READ_ONCE(smp_online_mask) & ~HART_MASK(this_hart_id());
+
+    SFENCE_VMA(va);
+    if (others) {
+        smp_call_function(others, flush_tlb_page_local, (void *)va, true);
+    }
+}
+
+// ===============================================================================
+// 从核启动
+// ===============================================================================
+void secondary_main(uint64_t hart_id)
+{
+    percpu_init(hart_id);
+    mmu_enable();
+
+    // 与启动 hart 一样打开浮点单元 (sstatus.FS = Dirty)
+    CSR_SET(sstatus, 0x3ULL << 13);
+
+    CSR_SET(sie, SIE_SSIE);
+    atomic_fetch_or(&smp_online_mask, HART_MASK(hart_id));
+    CSR_SET(sstatus, SSTATUS_SIE);
+
+    // 从核运行进程调度循环，没有可运行的进程时停在 WFI 等 IPI
+    proc_worker();
+}
+
+// ===============================================================================
+// 空闲等待
+// 关中断进入空闲状态（WFI 或 SBI 挂起，由空闲调控器选择）：有中断挂起时照样返回，
+// 但处理函数要等退出空闲状态、重新开中断后才运行，保证 RCU 不会把正在处理中断的
+// hart 当作空闲
+// ===============================================================================
+void cpu_idle(void)
+{
+    local_irq_disable();
+    rcu_idle_enter();
+    idle_enter();
+    rcu_idle_exit();
+    local_irq_enable();
+}
+
+void smp_init(void)
+{
+    uint64_t self = this_hart_id();
+
+    register_interrupt_handler(IRQ_S_SOFT, ipi_handler);
+    atomic_fetch_or(&smp_online_mask, HART_MASK(self));
+    CSR_SET(sie, SIE_SSIE);
+
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        if (hart == self) {
+            continue;
+        }
+
+        // 不存在的 hart 返回错误码，已在运行的 hart 不再启动
+        if (sbi_hart_get_status(hart) != SBI_HSM_STOPPED) {
+            continue;
+        }
+
+        long err = sbi_hart_start(hart, (uintptr_t)_secondary_start, 0);
+        if (err != SBI_SUCCESS) {
+            logger_warn("SMP: failed to start hart %llu (err %d)\n", hart, (int)err);
+            continue;
+        }
+
+        uint64_t deadline = READ_TIME() + timer_get_frequency() * HART_START_TIMEOUT_MS / 1000;
+        while (!(READ_ONCE(smp_online_mask) & HART_MASK(hart)) && READ_TIME() < deadline) {
+            cpu_relax();
+        }
+        if (!(READ_ONCE(smp_online_mask) & HART_MASK(hart))) {
+            logger_warn("SMP: hart %llu did not come online\n", hart);
+        }
+    }
+
+    logger_info("SMP: %d hart(s) online, mask 0x%llx\n", smp_num_online(), smp_online_mask);
+}
+
+// 从核上线后立即运行调度循环，补充预清零页并领取可并行的 initcall
+static int smp_initcall(void)
+{
+    smp_init();
+    return 0;
+}
+INITCALL(smp, INIT_CORE, 0, smp_initcall, "kstack", "proc", "zpool", "idle");
+
+int smp_num_online(void)
+{
+    uint64_t mask = READ_ONCE(smp_online_mask);
+    int      n    = 0;
+
+    while (mask) {
+        mask &= mask - 1;
+        n++;
+    }
+    return n;
+}
+
+// ===============================================================================
+// 统计输出
+// ===============================================================================
+static void ipi_ping(void *arg)
+{
+    (void)arg;
+}
+
+void smp_dump_stats(void)
+{
+    uint64_t self   = this_hart_id();
+    uint64_t others = READ_ONCE(smp_online_mask) & ~HART_MASK(self);
+
+    logger("=== SMP / IPI Statistics ===\n");
+    logger("  Online harts: %d (mask 0x%llx), current hart %llu\n", smp_num_online(),
+           smp_online_mask, self);
+    logger("  %-6s %10s %10s %10s %10s\n", "hart", "sent", "coalesced", "received", "calls");
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        if (!(smp_online_mask & HART_MASK(hart))) {
+            continue;
+        }
+        ipi_queue_t *q = &ipi_queues[hart];
+        logger("  %-6llu %10llu %10llu %10llu %10llu\n", hart, q->sent, q->coalesced, q->received,
+               q->calls);
+    }
+
+    if (!others) {
+        return;
+    }
+
+    // 往返延迟：同步调用所有其他 hart 并等待完成
+    uint64_t start = READ_CYCLE();
+    smp_call_function(others, ipi_ping, NULL, true);
+    uint64_t sync_cycles = READ_CYCLE() - start;
+
+    // 合并效果：连续提交一批异步请求，再同步等待一次
+    uint64_t sent_before = 0;
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        sent_before += ipi_queues[hart].sent;
+    }
+    for (int i = 0; i < ASYNC_CSD_NR; i++) {
+        smp_call_function(others, ipi_ping, NULL, false);
+    }
+    smp_call_function(others, ipi_ping, NULL, true);
+    uint64_t sent_after = 0;
+    for (uint64_t hart = 0; hart < MAX_HARTS; hart++) {
+        sent_after += ipi_queues[hart].sent;
+    }
+
+    logger("  Sync call round trip: %llu cycles\n", sync_cycles);
+    logger("  %d calls x %d harts -> %llu IPIs\n", ASYNC_CSD_NR + 1, smp_num_online() - 1,
+           sent_after - sent_before);
+}
+
+static int cmd_smp(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    smp_dump_stats();
+    return 0;
+}
+SHELL_CMD(smp, NULL, "Show hart status and IPI statistics", cmd_smp);
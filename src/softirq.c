@@ -0,0 +1,204 @@
+/*
+ * RISC-V testos 软中断（中断下半部）
+ *
+ * 挂起位和 tasklet 队列都是每 hart 私有的，只在本 hart 关中断时修改，不需要锁。
+ * 执行耗时按 cycle 统计，每 hart 独立累加，输出时汇总。
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "softirq.h"
+#include "atomic.h"
+#include "initcall.h"
+#include "percpu.h"
+#include "smp.h"
+#include "sysreg.h"
+#include "timer.h"
+#include "workqueue.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t max;
+} softirq_stat_t;
+
+typedef struct {
+    volatile uint32_t pending;
+    bool              running;
+    tasklet_t        *tasklet_head;
+    tasklet_t       **tasklet_tail;
+    uint64_t          restarts;     // 一次中断返回中重新检查挂起位的次数
+    uint64_t          leftover;     // 超过重试上限、留到下一次中断返回的次数
+    softirq_stat_t    stats[SOFTIRQ_NR];
+} __attribute__((aligned(64))) softirq_cpu_t;
+
+static softirq_cpu_t softirq_cpu[MAX_HARTS];
+
+static struct {
+    softirq_handler_t handler;
+    const char       *name;
+} softirq_vec[SOFTIRQ_NR];
+
+void open_softirq(int nr, softirq_handler_t handler, const char *name)
+{
+    softirq_vec[nr].name = name;
+    WRITE_ONCE(softirq_vec[nr].handler, handler);
+}
+
+void raise_softirq(int nr)
+{
+    uint64_t flags = local_irq_save();
+    hart_local_t *hl = this_hart();
+
+    softirq_cpu[hl->hart_id].pending |= 1U << nr;
+    // 线程上下文中挂起的软中断借自发的 IPI 尽快执行
+    if (hl->trap_depth == 0) {
+        smp_send_ipi(HART_MASK(hl->hart_id));
+    }
+    local_irq_restore(flags);
+}
+
+static void softirq_run(softirq_cpu_t *sc, uint32_t pending)
+{
+    for (int nr = 0; pending; nr++, pending >>= 1) {
+        softirq_handler_t handler = READ_ONCE(softirq_vec[nr].handler);
+
+        if (!(pending & 1) || !handler) {
+            continue;
+        }
+
+        softirq_stat_t *st    = &sc->stats[nr];
+        uint64_t        start = READ_CYCLE();
+        handler();
+        uint64_t cycles = READ_CYCLE() - start;
+
+        st->count++;
+        st->cycles += cycles;
+        if (cycles > st->max) {
+            st->max = cycles;
+        }
+    }
+}
+
+void softirq_irq_exit(hart_local_t *hl)
+{
+    softirq_cpu_t *sc = &softirq_cpu[hl->hart_id];
+
+    // 只在回到线程上下文前执行；嵌套在软中断中的硬中断由外层循环处理
+    if (!sc->pending || hl->trap_depth != 1 || sc->running) {
+        return;
+    }
+
+    sc->running = true;
+    for (int round = 0;; round++) {
+        uint32_t pending = sc->pending;
+
+        sc->pending = 0;
+        local_irq_enable();
+        softirq_run(sc, pending);
+        local_irq_disable();
+
+        if (!sc->pending) {
+            break;
+        }
+        if (round + 1 >= SOFTIRQ_MAX_RESTART) {
+            // 不让软中断饿死被打断的线程，剩下的等下一次中断
+            sc->leftover++;
+            smp_send_ipi(HART_MASK(hl->hart_id));
+            break;
+        }
+        sc->restarts++;
+    }
+    sc->running = false;
+}
+
+// ===============================================================================
+// tasklet
+// ===============================================================================
+
+void tasklet_schedule(tasklet_t *t)
+{
+    if (atomic_swap32(&t->scheduled, 1)) {
+        return;
+    }
+
+    uint64_t       flags = local_irq_save();
+    softirq_cpu_t *sc    = &softirq_cpu[this_hart_id()];
+
+    t->next = NULL;
+    if (!sc->tasklet_tail) {
+        sc->tasklet_tail = &sc->tasklet_head;
+    }
+    *sc->tasklet_tail = t;
+    sc->tasklet_tail  = &t->next;
+    raise_softirq(SOFTIRQ_TASKLET);
+    local_irq_restore(flags);
+}
+
+static void tasklet_softirq(void)
+{
+    softirq_cpu_t *sc = &softirq_cpu[this_hart_id()];
+
+    local_irq_disable();
+    tasklet_t *t     = sc->tasklet_head;
+    sc->tasklet_head = NULL;
+    sc->tasklet_tail = &sc->tasklet_head;
+    local_irq_enable();
+
+    while (t) {
+        tasklet_t *next = t->next;
+        // 先清标记：执行期间再次调度会在下一轮执行
+        WRITE_ONCE(t->scheduled, 0);
+        t->func(t->data);
+        t = next;
+    }
+}
+
+static int softirq_initcall(void)
+{
+    open_softirq(SOFTIRQ_TASKLET, tasklet_softirq, "tasklet");
+    return 0;
+}
+INITCALL(softirq, INIT_EARLY, 0, softirq_initcall);
+
+// ===============================================================================
+// 统计
+// ===============================================================================
+
+void softirq_dump_stats(void)
+{
+    logger("=== Softirqs (cycles) ===\n");
+    logger("  %-8s %10s %10s %10s\n", "name", "count", "avg", "max");
+    for (int nr = 0; nr < SOFTIRQ_NR; nr++) {
+        uint64_t count = 0, cycles = 0, max = 0;
+
+        for (int hart = 0; hart < MAX_HARTS; hart++) {
+            softirq_stat_t *st = &softirq_cpu[hart].stats[nr];
+            count  += st->count;
+            cycles += st->cycles;
+            if (st->max > max) {
+                max = st->max;
+            }
+        }
+        logger("  %-8s %10llu %10llu %10llu\n", softirq_vec[nr].name ? softirq_vec[nr].name : "-",
+               count, count ? cycles / count : 0, max);
+    }
+    for (int hart = 0; hart < MAX_HARTS; hart++) {
+        softirq_cpu_t *sc = &softirq_cpu[hart];
+        if (sc->restarts || sc->leftover) {
+            logger("  hart %d: %llu restarts, %llu left for the next interrupt\n", hart,
+                   sc->restarts, sc->leftover);
+        }
+    }
+}
+
+static int cmd_softirq(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    softirq_dump_stats();
+    workqueue_dump();
+    return 0;
+}
+SHELL_CMD(softirq, NULL, "Show softirq run time and workqueue latency", cmd_softirq);
@@ -3,6 +3,14 @@
  */
 
 #include "timer.h"
+#include "sbi.h"
+#include "percpu.h"
+#include "rcu.h"
+#include "bcache.h"
+#include "initcall.h"
+#include "kfence.h"
+#include "softirq.h"
+#include "workqueue.h"
 #include "lib/logger.h"
 
 // 全局变量
@@ -11,8 +19,13 @@ volatile uint64_t g_timer_frequency = TIMER_FREQ_HZ;
 volatile uint64_t g_uptime_seconds  = 0;
 volatile uint32_t g_tick_counter    = 0;
 timer_stats_t     g_timer_stats     = {0};
+volatile bool     g_timer_heartbeat = false;
+
+// 每个 hart 最近一次设置的定时器比较值，供空闲调控器预测空闲时长
+static volatile uint64_t timer_deadline[MAX_HARTS];
 
 // 前向声明
+static void timer_softirq(void);
 
 // ===============================================================================
 // 定时器初始化
@@ -58,6 +71,16 @@ void timer_enable(void)
     logger_info("Machine timer interrupt enabled\n");
 }
 
+// 只有启动 hart 产生时钟节拍，不能并行到从核上
+static int timer_initcall(void)
+{
+    open_softirq(SOFTIRQ_TIMER, timer_softirq, "timer");
+    timer_init();
+    timer_enable();
+    return 0;
+}
+INITCALL(timer, INIT_CORE, 0, timer_initcall);
+
 // ===============================================================================
 // 禁用定时器中断
 // ===============================================================================
@@ -80,21 +103,13 @@ void timer_set_next_interrupt(uint64_t ticks_from_now)
     uint64_t current_time = READ_TIME();
     uint64_t next_time = current_time + ticks_from_now;
     
-    // 使用 SBI 调用设置定时器
-    // SBI call: sbi_set_timer(uint64_t stime_value)
-    // a7 = 0 (EID: Timer Extension)
-    // a6 = 0 (FID: sbi_set_timer)
-    // a0 = stime_value
-    register uint64_t a0 asm("a0") = next_time;
-    register uint64_t a6 asm("a6") = 0;  // FID: sbi_set_timer
-    register uint64_t a7 asm("a7") = 0;  // EID: Timer Extension
-    
-    asm volatile(
-        "ecall"
-        : "+r"(a0)
-        : "r"(a6), "r"(a7)
-        : "memory"
-    );
+    timer_deadline[this_hart_id()] = next_time;
+    sbi_set_timer(next_time);
+}
+
+uint64_t timer_next_event(void)
+{
+    return timer_deadline[this_hart_id()];
 }
 
 // ===============================================================================
@@ -108,6 +123,7 @@ void timer_schedule_next_tick(void)
 
 // ===============================================================================
 // 定时器中断处理函数
+// 硬中断里只推进节拍并设置下一次中断，其余工作放到软中断中
 // ===============================================================================
 void timer_handler(void *frame)
 {
@@ -115,24 +131,47 @@ void timer_handler(void *frame)
 
     // 更新系统tick计数
     g_system_ticks++;
-    g_tick_counter++;
 
     // 更新统计信息
     g_timer_stats.total_interrupts++;
     g_timer_stats.last_interrupt_time = timer_get_uptime_ms();
 
-    // 每100个tick（1秒）更新秒数计数器
-    if (g_tick_counter >= TIMER_FREQUENCY_HZ) {
-        g_uptime_seconds++;
-        g_tick_counter = 0;
-        g_timer_stats.total_seconds = g_uptime_seconds;
-
-        // 每秒输出一句话
-        logger_info("System running - Uptime: %llus\n", g_uptime_seconds);
-    }
-
     // 调度下一个tick
     timer_schedule_next_tick();
+
+    raise_softirq(SOFTIRQ_TIMER);
+
+    // 有待执行的 RCU 回调、块缓存回写时挂起对应的软中断
+    rcu_tick();
+    bcache_tick();
+}
+
+// 每秒输出一句话（线程上下文，不会在中断中占用串口）
+static void timer_heartbeat(work_t *work)
+{
+    (void)work;
+    logger_info("System running - Uptime: %llus\n", g_uptime_seconds);
+}
+
+static work_t heartbeat_work = WORK_INIT(timer_heartbeat);
+
+// 由节拍数推算秒数：软中断合并了多个节拍时也不会少算
+static void timer_softirq(void)
+{
+    uint64_t ticks   = g_system_ticks;
+    uint64_t seconds = ticks / TIMER_FREQUENCY_HZ;
+
+    kfence_tick(ticks);
+
+    g_tick_counter = ticks % TIMER_FREQUENCY_HZ;
+    if (seconds != g_uptime_seconds) {
+        g_uptime_seconds = seconds;
+        g_timer_stats.total_seconds = seconds;
+
+        if (g_timer_heartbeat) {
+            queue_work(&heartbeat_work);
+        }
+    }
 }
 
 // ===============================================================================
@@ -0,0 +1,133 @@
+/*
+ * RISC-V testos 内核工作队列
+ *
+ * 每个 hart 一个队列，入队可能来自任意 hart 的中断上下文，用关中断的自旋锁保护。
+ * 出队时一次取走整条链表，在锁外逐个执行。
+ */
+
+#include "types.h"
+#include "cfg/cfg.h"
+#include "workqueue.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "lib/logger.h"
+
+typedef struct {
+    spinlock_t lock;
+    work_t    *head;
+    work_t    *tail;
+    // 统计（只由本 hart 更新）
+    uint64_t   count;
+    uint64_t   wait_total;      // 排队延迟，time CSR 计数
+    uint64_t   wait_max;
+    uint64_t   run_total;       // 执行时间
+    uint64_t   run_max;
+} __attribute__((aligned(64))) workqueue_t;
+
+static workqueue_t workqueues[MAX_HARTS];
+
+bool queue_work_on(uint64_t hart, work_t *work)
+{
+    if (atomic_swap32(&work->pending, 1)) {
+        return false;
+    }
+
+    uint64_t self = this_hart_id();
+    if (hart >= MAX_HARTS || !(READ_ONCE(smp_online_mask) & HART_MASK(hart))) {
+        hart = self;
+    }
+
+    workqueue_t *wq = &workqueues[hart];
+
+    work->next   = NULL;
+    work->queued = READ_TIME();
+
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    bool     empty = !wq->head;
+    if (empty) {
+        wq->head = work;
+    } else {
+        wq->tail->next = work;
+    }
+    wq->tail = work;
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    // 队列由空变为非空时才需要唤醒；本 hart 回到线程上下文自然会检查
+    if (empty && hart != self) {
+        smp_send_ipi(HART_MASK(hart));
+    }
+    return true;
+}
+
+bool queue_work(work_t *work)
+{
+    return queue_work_on(this_hart_id(), work);
+}
+
+bool workqueue_run(void)
+{
+    workqueue_t *wq = &workqueues[this_hart_id()];
+
+    if (!READ_ONCE(wq->head)) {
+        return false;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    work_t  *work  = wq->head;
+    wq->head       = NULL;
+    wq->tail       = NULL;
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    while (work) {
+        work_t  *next  = work->next;
+        uint64_t start = READ_TIME();
+        uint64_t wait  = start - work->queued;
+
+        // 先清标记：执行期间可以再次投递自己
+        WRITE_ONCE(work->pending, 0);
+        work->func(work);
+
+        uint64_t run = READ_TIME() - start;
+        wq->count++;
+        wq->wait_total += wait;
+        wq->run_total  += run;
+        if (wait > wq->wait_max) {
+            wq->wait_max = wait;
+        }
+        if (run > wq->run_max) {
+            wq->run_max = run;
+        }
+        work = next;
+    }
+    return true;
+}
+
+// ===============================================================================
+// 统计
+// ===============================================================================
+
+static uint64_t ticks_to_us(uint64_t ticks)
+{
+    return ticks * 1000000 / timer_get_frequency();
+}
+
+void workqueue_dump(void)
+{
+    logger("=== Workqueues (us) ===\n");
+    logger("  %4s %10s %10s %10s %10s %10s\n", "hart", "works", "avg wait", "max wait", "avg run",
+           "max run");
+    for (int hart = 0; hart < MAX_HARTS; hart++) {
+        workqueue_t *wq = &workqueues[hart];
+
+        if (!(READ_ONCE(smp_online_mask) & HART_MASK(hart)) && !wq->count) {
+            continue;
+        }
+        logger("  %4d %10llu %10llu %10llu %10llu %10llu%s\n", hart, wq->count,
+               wq->count ? ticks_to_us(wq->wait_total / wq->count) : 0, ticks_to_us(wq->wait_max),
+               wq->count ? ticks_to_us(wq->run_total / wq->count) : 0, ticks_to_us(wq->run_max),
+               READ_ONCE(wq->head) ? "  (queued)" : "");
+    }
+}
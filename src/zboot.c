@@ -0,0 +1,148 @@
+/*
+ * RISC-V testos 压缩映像启动信息
+ *
+ * 解压存根（zboot/）把自己的耗时写进 zboot_info。zboot_info 位于原始映像中的
+ * 固定偏移（见 link.lds），从原始映像启动时它保持全零。
+ *
+ * 加载时间按存储带宽估算：原始映像为 raw / bw；压缩映像为 image / bw 加上
+ * 存根实测的搬移和解压时间。带宽可以手工给出，也可以顺序读取块设备 0 实测。
+ */
+
+#include "types.h"
+#include "zboot.h"
+#include "blkdev.h"
+#include "mem.h"
+#include "string.h"
+#include "timer.h"
+#include "initcall.h"
+#include "shell.h"
+#include "lib/logger.h"
+
+#define ZBOOT_BENCH_BYTES   (4 * 1024 * 1024)   // 实测带宽时读取的总量
+#define ZBOOT_BENCH_CHUNK   (64 * 1024)         // 每次同步读的大小，接近加载器的读法
+
+zboot_info_t zboot_info __attribute__((section(".zboot_info"), used));
+
+static bool zboot_valid(void)
+{
+    return zboot_info.magic == ZBOOT_INFO_MAGIC && zboot_info.end_time >= zboot_info.start_time;
+}
+
+static uint64_t ticks_to_us(uint64_t ticks)
+{
+    return ticks * 1000000 / timer_get_frequency();
+}
+
+void zboot_report(void)
+{
+    if (!zboot_valid()) {
+        return;
+    }
+    logger_info("zboot: inflated %u -> %u bytes in %llu us\n", zboot_info.image_size,
+                zboot_info.raw_size, ticks_to_us(zboot_info.end_time - zboot_info.start_time));
+}
+
+static int zboot_initcall(void)
+{
+    zboot_report();
+    return 0;
+}
+INITCALL(zboot, INIT_LATE, INITCALL_PARALLEL, zboot_initcall);
+
+int zboot_times(uint64_t *start, uint64_t *end)
+{
+    if (!zboot_valid()) {
+        return -1;
+    }
+    *start = zboot_info.start_time;
+    *end   = zboot_info.end_time;
+    return 0;
+}
+
+// 顺序读取块设备 0，返回带宽（字节/秒），失败返回 0
+static uint64_t zboot_measure_bandwidth(void)
+{
+    blkdev_t *dev = blkdev_get(0);
+    uint64_t  sectors = ZBOOT_BENCH_CHUNK / BLK_SECTOR_SIZE;
+    uint64_t  bytes   = 0;
+
+    if (!dev) {
+        logger_error("zboot: no block device to measure, pass the bandwidth: zboot <MB/s>\n");
+        return 0;
+    }
+
+    void *buf = alloc_pages(ZBOOT_BENCH_CHUNK / PAGE_SIZE);
+    if (!buf) {
+        logger_error("zboot: out of memory\n");
+        return 0;
+    }
+
+    uint64_t start = READ_TIME();
+    for (uint64_t sector = 0; bytes < ZBOOT_BENCH_BYTES && sector + sectors <= dev->capacity;
+         sector += sectors) {
+        if (blk_read(dev, sector, buf, sectors) < 0) {
+            logger_error("zboot: read error on %s at sector %llu\n", dev->name, sector);
+            bytes = 0;
+            break;
+        }
+        bytes += ZBOOT_BENCH_CHUNK;
+    }
+    uint64_t ticks = READ_TIME() - start;
+
+    free_pages(buf, ZBOOT_BENCH_CHUNK / PAGE_SIZE);
+    if (!bytes || !ticks) {
+        return 0;
+    }
+    logger("  %s: read %llu KB in %llu us\n", dev->name, bytes / 1024, ticks_to_us(ticks));
+    return bytes * timer_get_frequency() / ticks;
+}
+
+void zboot_dump(const char *arg)
+{
+    if (!zboot_valid()) {
+        logger("zboot: booted from the raw image (use 'make zimage' for a compressed one)\n");
+        return;
+    }
+
+    uint64_t decomp_us = ticks_to_us(zboot_info.end_time - zboot_info.start_time);
+    uint64_t bw;
+
+    logger("=== Compressed Boot ===\n");
+    logger("  raw image     %8u bytes\n", zboot_info.raw_size);
+    logger("  zImage        %8u bytes (%u%%, LZ4 payload %u)\n", zboot_info.image_size,
+           (uint32_t)((uint64_t)zboot_info.image_size * 100 / zboot_info.raw_size),
+           zboot_info.comp_size);
+    logger("  decompression %8llu us (relocation + LZ4)\n", decomp_us);
+
+    if (arg && *arg) {
+        bw = (uint64_t)atoi(arg) * 1024 * 1024;
+        if (!bw) {
+            logger_error("zboot: bad bandwidth '%s'\n", arg);
+            return;
+        }
+        logger("  storage       %8llu MB/s (given)\n", bw >> 20);
+    } else {
+        if (!(bw = zboot_measure_bandwidth())) {
+            return;
+        }
+        logger("  storage       %8llu KB/s (measured)\n", bw >> 10);
+    }
+
+    uint64_t raw_us = (uint64_t)zboot_info.raw_size * 1000000 / bw;
+    uint64_t z_us   = (uint64_t)zboot_info.image_size * 1000000 / bw + decomp_us;
+    logger("  raw load      %8llu us\n", raw_us);
+    logger("  zImage load   %8llu us (%llu load + %llu decompression)\n", z_us, z_us - decomp_us,
+           decomp_us);
+    if (z_us < raw_us) {
+        logger("  compressed image boots %llu us faster\n", raw_us - z_us);
+    } else {
+        logger("  compressed image boots %llu us slower at this bandwidth\n", z_us - raw_us);
+    }
+}
+
+static int cmd_zboot(int argc, char **argv)
+{
+    zboot_dump(argc > 1 ? argv[1] : NULL);
+    return 0;
+}
+SHELL_CMD(zboot, "[MB/s]", "Compare raw and compressed image boot time", cmd_zboot);
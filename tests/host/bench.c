@@ -0,0 +1,284 @@
+/*
+ * RISC-V testos 主机基准测试
+ *
+ * 仿照 Google Benchmark 的做法：每项自动增加迭代次数，直到耗时超过最短时间，
+ * 输出每次迭代的时间、迭代次数和吞吐量。内核实现与 libc 并列，便于对比。
+ *
+ * 用法：host_bench [--filter 子串] [--min-time 秒]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "harness.h"
+
+typedef struct {
+    size_t arg;                 // 数据大小等参数
+    size_t iters;               // 被测项可以调小，表示资源不够、只跑了这么多次
+    size_t bytes;               // 每次迭代处理的字节数，0 表示不输出吞吐量
+} bench_state_t;
+
+typedef void (*bench_fn_t)(bench_state_t *st);
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+    size_t arg;
+} bench_t;
+
+// 防止编译器把被测调用优化掉
+static volatile uintptr_t sink;
+
+static unsigned char src_buf[1 << 20], dst_buf[1 << 20];
+static char          str_buf[1 << 16];
+
+// ===============================================================================
+// 被测项
+// ===============================================================================
+static void bm_memcpy_kern(bench_state_t *st)
+{
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)kern_memcpy(dst_buf, src_buf, st->arg);
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_memcpy_libc(bench_state_t *st)
+{
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)memcpy(dst_buf, src_buf, st->arg);
+        asm volatile("" ::: "memory");
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_memset_kern(bench_state_t *st)
+{
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)kern_memset(dst_buf, (int)i, st->arg);
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_memset_libc(bench_state_t *st)
+{
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)memset(dst_buf, (int)i, st->arg);
+        asm volatile("" ::: "memory");
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_memmove_kern(bench_state_t *st)
+{
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)kern_memmove(dst_buf + 1, dst_buf, st->arg);
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_memcmp_kern(bench_state_t *st)
+{
+    memcpy(dst_buf, src_buf, st->arg);
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)kern_memcmp(dst_buf, src_buf, st->arg);
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_memcmp_libc(bench_state_t *st)
+{
+    memcpy(dst_buf, src_buf, st->arg);
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)memcmp(dst_buf, src_buf, st->arg);
+        asm volatile("" ::: "memory");
+    }
+    st->bytes = st->arg;
+}
+
+static void prepare_string(size_t len)
+{
+    memset(str_buf, 'a', len);
+    str_buf[len] = '\0';
+}
+
+static void bm_strlen_kern(bench_state_t *st)
+{
+    prepare_string(st->arg);
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = kern_strlen(str_buf);
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_strlen_libc(bench_state_t *st)
+{
+    prepare_string(st->arg);
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = strlen(str_buf);
+        asm volatile("" ::: "memory");
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_strcmp_kern(bench_state_t *st)
+{
+    prepare_string(st->arg);
+    memcpy(dst_buf, str_buf, st->arg + 1);
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)kern_strcmp(str_buf, (const char *)dst_buf);
+    }
+    st->bytes = st->arg;
+}
+
+static void bm_snprintf_kern(bench_state_t *st)
+{
+    char buf[128];
+
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)my_snprintf(buf, sizeof(buf), "pid %d: %s at 0x%llx, %08lu\n", (int)i,
+                                      "fault", (unsigned long long)i * 4096, (unsigned long)i);
+    }
+}
+
+static void bm_snprintf_libc(bench_state_t *st)
+{
+    char buf[128];
+
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)snprintf(buf, sizeof(buf), "pid %d: %s at 0x%llx, %08lu\n", (int)i,
+                                   "fault", (unsigned long long)i * 4096, (unsigned long)i);
+    }
+}
+
+static void bm_page_cycle(bench_state_t *st)
+{
+    for (size_t i = 0; i < st->iters; i++) {
+        void *p = alloc_pages(1);
+        sink = (uintptr_t)p;
+        free_pages(p, 1);
+    }
+}
+
+static void bm_malloc_small(bench_state_t *st)
+{
+    // 堆只分配不释放，每轮最多用掉剩余堆的 1/4
+    size_t budget = mem_get_free_size() / 4 / st->arg;
+
+    if (st->iters > budget) {
+        st->iters = budget;
+    }
+    for (size_t i = 0; i < st->iters; i++) {
+        sink = (uintptr_t)kern_malloc(st->arg);
+    }
+}
+
+#define SIZES(name, fn) \
+    { name, fn, 16 }, { name, fn, 256 }, { name, fn, 4096 }, { name, fn, 65536 }
+
+static const bench_t benches[] = {
+    SIZES("memcpy/kernel", bm_memcpy_kern),
+    SIZES("memcpy/libc", bm_memcpy_libc),
+    SIZES("memset/kernel", bm_memset_kern),
+    SIZES("memset/libc", bm_memset_libc),
+    SIZES("memmove/kernel", bm_memmove_kern),
+    SIZES("memcmp/kernel", bm_memcmp_kern),
+    SIZES("memcmp/libc", bm_memcmp_libc),
+    SIZES("strlen/kernel", bm_strlen_kern),
+    SIZES("strlen/libc", bm_strlen_libc),
+    SIZES("strcmp/kernel", bm_strcmp_kern),
+    { "snprintf/kernel", bm_snprintf_kern, 0 },
+    { "snprintf/libc", bm_snprintf_libc, 0 },
+    { "alloc_pages+free_pages", bm_page_cycle, 0 },
+    { "malloc/kernel", bm_malloc_small, 32 },
+};
+
+// ===============================================================================
+// 运行
+// ===============================================================================
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_rate(double bytes_per_sec)
+{
+    static const char *const units[] = { "B/s", "KiB/s", "MiB/s", "GiB/s", "TiB/s" };
+    int u = 0;
+
+    while (bytes_per_sec >= 1024 && u < 4) {
+        bytes_per_sec /= 1024;
+        u++;
+    }
+    printf(" %9.3f%s", bytes_per_sec, units[u]);
+}
+
+static void run_bench(const bench_t *b, double min_time)
+{
+    bench_state_t st = { b->arg, 1, 0 };
+    double        elapsed;
+    char          name[64];
+
+    // 迭代次数按上一轮耗时估算，每轮最多放大 10 倍
+    for (;;) {
+        size_t want = st.iters;
+        double t0   = now_sec();
+        b->fn(&st);
+        elapsed = now_sec() - t0;
+        if (elapsed >= min_time || st.iters < want || st.iters >= (size_t)1 << 40) {
+            break;
+        }
+        double scale = elapsed > 0 ? min_time * 1.4 / elapsed : 10;
+        scale        = scale > 10 ? 10 : scale < 2 ? 2 : scale;
+        st.iters     = (size_t)(st.iters * scale);
+    }
+
+    if (b->arg) {
+        snprintf(name, sizeof(name), "%s/%zu", b->name, b->arg);
+    } else {
+        snprintf(name, sizeof(name), "%s", b->name);
+    }
+    printf("%-30s %12.2f ns %12zu", name, elapsed * 1e9 / st.iters, st.iters);
+    if (st.bytes) {
+        print_rate((double)st.bytes * st.iters / elapsed);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter   = NULL;
+    double      min_time = 0.2;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--filter substring] [--min-time seconds]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (host_heap_init() < 0) {
+        fprintf(stderr, "cannot map the kernel heap at %#lx\n", HOST_HEAP_START);
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(src_buf); i++) {
+        src_buf[i] = (unsigned char)(i * 131);
+    }
+
+    printf("%-30s %15s %12s %12s\n", "Benchmark", "Time", "Iterations", "Throughput");
+    printf("--------------------------------------------------------------------------\n");
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (!filter || strstr(benches[i].name, filter)) {
+            run_bench(&benches[i], min_time);
+        }
+    }
+    return 0;
+}
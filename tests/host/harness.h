@@ -0,0 +1,114 @@
+/*
+ * RISC-V testos 主机测试框架
+ *
+ * 把 src/lib/string.c、src/lib/logger.c 和 src/mem/mem.c 用主机编译器编译，
+ * 与 libc 的参考实现逐项对比。内核中与 libc 同名的函数改名为 kern_*
+ * （见 kern_names.h），这里用主机类型重新声明。
+ */
+
+#ifndef __HARNESS_H__
+#define __HARNESS_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// ===============================================================================
+// 被测的内核函数
+// ===============================================================================
+size_t kern_strlen(const char *str);
+char *kern_strcpy(char *dst, const char *src);
+char *kern_strncpy(char *dst, const char *src, size_t n);
+int kern_strcmp(const char *s1, const char *s2);
+int kern_strncmp(const char *s1, const char *s2, size_t n);
+char *kern_strcat(char *dst, const char *src);
+char *kern_strchr(const char *s, int c);
+char *kern_strrchr(const char *s, int c);
+char *kern_strstr(const char *haystack, const char *needle);
+void *kern_memset(void *s, int c, size_t n);
+void *kern_memcpy(void *dst, const void *src, size_t n);
+void *kern_memmove(void *dst, const void *src, size_t n);
+int kern_memcmp(const void *s1, const void *s2, size_t n);
+void *kern_memchr(const void *s, int c, size_t n);
+long kern_atol(const char *str);
+int kern_atoi(const char *str);
+
+int my_snprintf(char *buf, int size, const char *fmt, ...);
+int my_vsnprintf(char *buf, int size, const char *fmt, va_list va);
+int logger(const char *fmt, ...);
+
+void mem_init(void);
+void *kern_malloc(size_t size);
+void *kern_calloc(size_t count, size_t size);
+void *kern_aligned_alloc(size_t alignment, size_t size);
+void *alloc_pages(size_t npages);
+void free_pages(void *addr, size_t npages);
+int mem_reserve(uintptr_t start, uintptr_t end);
+size_t mem_get_allocated_size(void);
+size_t mem_get_free_size(void);
+int mem_is_heap_addr(void *ptr);
+void mem_get_heap_range(uintptr_t *start, uintptr_t *end);
+
+// ===============================================================================
+// 替身（shim.c）
+// ===============================================================================
+
+// 内核堆所在的物理地址窗口，映射到主机进程的同一地址
+#define HOST_MEM_START      0x80000000UL
+#define HOST_MEM_SIZE       0x10000000UL
+#define HOST_HEAP_START     0x80400000UL
+#define HOST_PAGE_SIZE      4096UL
+
+/**
+ * 在 HOST_HEAP_START 映射内核堆并调用 mem_init，只能调用一次
+ * @return 成功返回 0，地址已被占用返回 -1
+ */
+int host_heap_init(void);
+
+/**
+ * 清空 UART 捕获缓冲区，返回此前捕获的内容（以 '\0' 结尾）
+ */
+const char *uart_capture_take(void);
+
+// 环境变量 HOST_VERBOSE 非空时 UART 输出同时写到 stdout
+extern int host_verbose;
+
+// ===============================================================================
+// 断言与随机数
+// ===============================================================================
+extern unsigned long test_checks;
+extern unsigned long test_failures;
+extern uint64_t      test_seed;
+
+void test_fail(const char *file, int line, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// 失败时打印位置和说明，继续运行；每个文件只打印前几次失败
+#define CHECK(cond, ...)                                        \
+    do {                                                        \
+        test_checks++;                                          \
+        if (!(cond)) {                                          \
+            test_fail(__FILE__, __LINE__, __VA_ARGS__);         \
+        }                                                       \
+    } while (0)
+
+// xorshift64*，固定种子保证失败可以复现
+uint64_t rnd(void);
+
+static inline uint64_t rnd_below(uint64_t n)
+{
+    return n ? rnd() % n : 0;
+}
+
+static inline int sign(int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+// 每个测试组的入口，iters 为随机用例数
+void test_string(unsigned long iters);
+void test_printf(unsigned long iters);
+void test_mem(unsigned long iters);
+
+#endif /* __HARNESS_H__ */
@@ -0,0 +1,32 @@
+/*
+ * RISC-V testos 主机测试：内核符号改名
+ *
+ * 编译内核模块时强制包含（-include），把与 libc 同名的函数改名为 kern_*，
+ * 这样内核实现和 libc 参考实现可以链接进同一个测试程序。
+ */
+
+#ifndef __KERN_NAMES_H__
+#define __KERN_NAMES_H__
+
+#define strlen          kern_strlen
+#define strcpy          kern_strcpy
+#define strncpy         kern_strncpy
+#define strcmp          kern_strcmp
+#define strncmp         kern_strncmp
+#define strcat          kern_strcat
+#define strchr          kern_strchr
+#define strrchr         kern_strrchr
+#define strstr          kern_strstr
+#define memset          kern_memset
+#define memcpy          kern_memcpy
+#define memmove         kern_memmove
+#define memcmp          kern_memcmp
+#define memchr          kern_memchr
+#define atol            kern_atol
+#define atoi            kern_atoi
+#define malloc          kern_malloc
+#define calloc          kern_calloc
+#define aligned_alloc   kern_aligned_alloc
+#define free            kern_free
+
+#endif /* __KERN_NAMES_H__ */
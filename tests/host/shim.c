@@ -0,0 +1,124 @@
+/*
+ * RISC-V testos 主机测试：硬件替身
+ *
+ * UART 输出写入捕获缓冲区；内核堆映射到与板上相同的地址，mem.c 不用改动；
+ * 预清零页池（zpool.c 依赖 FDT 和 cbo.zero）换成直接清零，KFENCE 换成从不抽样。
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "harness.h"
+
+#define CAPTURE_SIZE    65536
+
+static char   capture[CAPTURE_SIZE];
+static size_t capture_len;
+static char   taken[CAPTURE_SIZE];
+
+int host_verbose;
+
+// ===============================================================================
+// UART
+// ===============================================================================
+void uart_putchar(char c)
+{
+    if (capture_len < CAPTURE_SIZE - 1) {
+        capture[capture_len++] = c;
+    }
+    if (host_verbose) {
+        putchar(c);
+    }
+}
+
+void uart_puts(const char *s)
+{
+    while (*s) {
+        uart_putchar(*s++);
+    }
+}
+
+void uart_print_hex(uint64_t value)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%llx", (unsigned long long)value);
+    uart_puts(buf);
+}
+
+void uart_print_dec(int64_t value)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lld", (long long)value);
+    uart_puts(buf);
+}
+
+const char *uart_capture_take(void)
+{
+    memcpy(taken, capture, capture_len);
+    taken[capture_len] = '\0';
+    capture_len        = 0;
+    return taken;
+}
+
+// ===============================================================================
+// 预清零页池
+// ===============================================================================
+void mem_zero(void *dst, size_t n)
+{
+    memset(dst, 0, n);
+}
+
+void *alloc_zeroed_page(void)
+{
+    void *page = alloc_pages(1);
+    if (page) {
+        memset(page, 0, HOST_PAGE_SIZE);
+    }
+    return page;
+}
+
+void zpool_dump_stats(void)
+{
+}
+
+// ===============================================================================
+// KFENCE：主机上从不抽样，分配全部走堆
+// ===============================================================================
+volatile uint32_t kfence_armed;
+
+void *kfence_alloc(size_t size, size_t align, uintptr_t ip)
+{
+    (void)size; (void)align; (void)ip;
+    return NULL;
+}
+
+bool kfence_free(void *ptr, uintptr_t ip)
+{
+    (void)ptr; (void)ip;
+    return false;
+}
+
+// ===============================================================================
+// 内核堆
+// ===============================================================================
+int host_heap_init(void)
+{
+    // mem_init 的堆顶是 MEM_START + MEM_SIZE - 32MB，_heap_start 由链接时 --defsym 给出
+    size_t size = HOST_MEM_START + HOST_MEM_SIZE - 32 * 1024 * 1024 - HOST_HEAP_START;
+    void  *p    = mmap((void *)HOST_HEAP_START, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (p != (void *)HOST_HEAP_START) {
+        if (p != MAP_FAILED) {
+            munmap(p, size);
+        }
+        return -1;
+    }
+    mem_init();
+    uart_capture_take();
+    return 0;
+}
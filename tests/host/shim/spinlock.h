@@ -0,0 +1,56 @@
+/*
+ * RISC-V testos 主机测试：自旋锁替身
+ *
+ * 主机测试是单线程的，锁操作都为空，只保留内核代码用到的类型和接口。
+ */
+
+#ifndef __SPINLOCK_H__
+#define __SPINLOCK_H__
+
+#include "types.h"
+
+typedef struct lock_stat {
+    const char *name;
+} lock_stat_t;
+
+typedef struct {
+    volatile uint32_t locked;
+    lock_stat_t *stat;
+} spinlock_t;
+
+#define SPINLOCK_INIT       { 0, NULL }
+
+static inline void lock_stat_register(lock_stat_t *stat, const char *name)
+{
+    stat->name = name;
+}
+
+static inline void spin_lock_init(spinlock_t *lock, lock_stat_t *stat)
+{
+    lock->locked = 0;
+    lock->stat   = stat;
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+    lock->locked = 1;
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+    lock->locked = 0;
+}
+
+static inline uint64_t spin_lock_irqsave(spinlock_t *lock)
+{
+    spin_lock(lock);
+    return 0;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags)
+{
+    (void)flags;
+    spin_unlock(lock);
+}
+
+#endif /* __SPINLOCK_H__ */
@@ -0,0 +1,18 @@
+/*
+ * RISC-V testos 主机测试：UART 替身
+ *
+ * 替换 include/uart.h，输出写入 shim.c 中的捕获缓冲区，测试可以检查内核打印的内容。
+ */
+
+#ifndef __UART_H__
+#define __UART_H__
+
+#include "types.h"
+#include "cfg/cfg.h"
+
+void uart_putchar(char c);
+void uart_puts(const char *s);
+void uart_print_hex(uint64_t value);
+void uart_print_dec(int64_t value);
+
+#endif /* __UART_H__ */
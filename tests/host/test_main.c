@@ -0,0 +1,86 @@
+/*
+ * RISC-V testos 主机测试入口
+ *
+ * 用法：host_test [--seed N] [--iters N]
+ * 失败信息里带有种子，用同一个种子重跑即可复现。
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "harness.h"
+
+#define MAX_REPORTED    20
+
+unsigned long test_checks;
+unsigned long test_failures;
+uint64_t      test_seed;
+
+static uint64_t rnd_state;
+
+uint64_t rnd(void)
+{
+    rnd_state ^= rnd_state >> 12;
+    rnd_state ^= rnd_state << 25;
+    rnd_state ^= rnd_state >> 27;
+    return rnd_state * 0x2545F4914F6CDD1DULL;
+}
+
+void test_fail(const char *file, int line, const char *fmt, ...)
+{
+    va_list va;
+
+    if (++test_failures > MAX_REPORTED) {
+        return;
+    }
+    printf("FAIL %s:%d: ", file, line);
+    va_start(va, fmt);
+    vprintf(fmt, va);
+    va_end(va);
+    printf("\n");
+}
+
+static void run_group(const char *name, void (*fn)(unsigned long), unsigned long iters)
+{
+    unsigned long checks   = test_checks;
+    unsigned long failures = test_failures;
+
+    rnd_state = test_seed ? test_seed : 1;
+    fn(iters);
+    printf("%-8s %8lu checks, %lu failed\n", name, test_checks - checks, test_failures - failures);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iters = 20000;
+
+    test_seed    = (uint64_t)time(NULL);
+    host_verbose = getenv("HOST_VERBOSE") != NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            test_seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+            iters = strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [--seed N] [--iters N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("host tests: seed %llu, %lu iterations\n", (unsigned long long)test_seed, iters);
+    run_group("string", test_string, iters);
+    run_group("printf", test_printf, iters);
+    run_group("mem", test_mem, iters);
+
+    if (test_failures) {
+        printf("%lu of %lu checks FAILED (rerun with --seed %llu)\n", test_failures, test_checks,
+               (unsigned long long)test_seed);
+        return 1;
+    }
+    printf("all %lu checks passed\n", test_checks);
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * RISC-V testos 主机测试：src/mem/mem.c
+ *
+ * 堆只分配不释放，整个进程只有一个堆，各项检查按顺序共用同一个堆。
+ * 分配前先把堆中尚未分配的部分写脏，calloc 的清零才有意义。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+#define MAX_BLOCKS  4096
+
+typedef struct {
+    unsigned char *p;
+    size_t size;
+} block_t;
+
+static block_t blocks[MAX_BLOCKS];
+static int     nblocks;
+
+static uintptr_t heap_current(void)
+{
+    uintptr_t start, end;
+
+    mem_get_heap_range(&start, &end);
+    return end - mem_get_free_size();
+}
+
+static void dirty_ahead(size_t len)
+{
+    memset((void *)heap_current(), 0xa5, len);
+}
+
+// 新块不能与已有的块重叠；记录下来并填上编号，最后检查没有被覆盖
+static void track(void *p, size_t size)
+{
+    unsigned char *b = p;
+
+    for (int i = 0; i < nblocks; i++) {
+        CHECK(b + size <= blocks[i].p || b >= blocks[i].p + blocks[i].size,
+              "block %p+%zu overlaps %p+%zu", p, size, (void *)blocks[i].p, blocks[i].size);
+    }
+    if (nblocks < MAX_BLOCKS) {
+        blocks[nblocks].p    = b;
+        blocks[nblocks].size = size;
+        memset(b, nblocks & 0xff, size);
+        nblocks++;
+    }
+}
+
+static void check_tracked(void)
+{
+    for (int i = 0; i < nblocks; i++) {
+        for (size_t j = 0; j < blocks[i].size; j++) {
+            if (blocks[i].p[j] != (i & 0xff)) {
+                CHECK(0, "block %d (%p+%zu) clobbered at %zu", i, (void *)blocks[i].p,
+                      blocks[i].size, j);
+                break;
+            }
+        }
+    }
+}
+
+static int all_zero(const unsigned char *p, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (p[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_malloc(unsigned long iters)
+{
+    CHECK(kern_malloc(0) == NULL, "malloc(0)");
+
+    for (unsigned long it = 0; it < iters && nblocks < MAX_BLOCKS / 2; it++) {
+        size_t size = 1 + rnd_below(rnd() & 1 ? 64 : 3000);
+        void  *p    = kern_malloc(size);
+        CHECK(p && ((uintptr_t)p & 7) == 0, "malloc(%zu) = %p", size, p);
+        CHECK(mem_is_heap_addr(p), "malloc(%zu) = %p outside heap", size, p);
+        if (p) {
+            track(p, size);
+        }
+    }
+}
+
+static void test_calloc(unsigned long iters)
+{
+    CHECK(kern_calloc(SIZE_MAX / 2, 4) == NULL, "calloc overflow");
+    CHECK(kern_calloc(0, 16) == NULL, "calloc(0, 16)");
+
+    for (unsigned long it = 0; it < iters / 16 + 1; it++) {
+        size_t count = 1 + rnd_below(64), size = 1 + rnd_below(96);
+        dirty_ahead(2 * HOST_PAGE_SIZE + count * size);
+        unsigned char *p = kern_calloc(count, size);
+        CHECK(p && all_zero(p, count * size), "calloc(%zu, %zu) not zeroed", count, size);
+        if (p) {
+            track(p, count * size);
+        }
+    }
+}
+
+static void test_aligned(unsigned long iters)
+{
+    CHECK(kern_aligned_alloc(24, 64) == NULL, "aligned_alloc bad alignment");
+
+    for (unsigned long it = 0; it < iters / 16 + 1; it++) {
+        size_t align = (size_t)1 << rnd_below(13);
+        size_t size  = 1 + rnd_below(512);
+        void  *p     = kern_aligned_alloc(align, size);
+        CHECK(p && ((uintptr_t)p & (align - 1)) == 0, "aligned_alloc(%zu, %zu) = %p", align, size, p);
+        if (p) {
+            track(p, size);
+        }
+    }
+}
+
+static void test_pages(void)
+{
+    void  *pages[8];
+    size_t before = mem_get_allocated_size();
+
+    for (int i = 0; i < 8; i++) {
+        pages[i] = alloc_pages(1 + (i & 1));
+        CHECK(pages[i] && ((uintptr_t)pages[i] & (HOST_PAGE_SIZE - 1)) == 0, "alloc_pages = %p",
+              pages[i]);
+    }
+
+    // 释放后单页按后进先出复用
+    free_pages(pages[2], 1);
+    free_pages(pages[4], 1);
+    CHECK(alloc_pages(1) == pages[4], "free page reused LIFO");
+    CHECK(alloc_pages(1) == pages[2], "free page reused LIFO");
+    CHECK(mem_get_allocated_size() >= before + 12 * HOST_PAGE_SIZE, "allocated size accounting");
+
+    // 多页块拆成单页回收
+    free_pages(pages[1], 2);
+    void *a = alloc_pages(1), *b = alloc_pages(1);
+    CHECK((a == pages[1] || a == (char *)pages[1] + HOST_PAGE_SIZE) &&
+              (b == pages[1] || b == (char *)pages[1] + HOST_PAGE_SIZE) && a != b,
+          "split multi-page free");
+
+    // 超过半页的 calloc 取整页
+    dirty_ahead(2 * HOST_PAGE_SIZE);
+    unsigned char *big = kern_calloc(1, 3000);
+    CHECK(big && ((uintptr_t)big & (HOST_PAGE_SIZE - 1)) == 0 && all_zero(big, 3000),
+          "calloc(1, 3000) = %p", (void *)big);
+}
+
+static void test_reserve(void)
+{
+    uintptr_t cur = (heap_current() + HOST_PAGE_SIZE - 1) & ~(HOST_PAGE_SIZE - 1);
+    uintptr_t lo  = cur + 16 * HOST_PAGE_SIZE, hi = lo + 8 * HOST_PAGE_SIZE;
+
+    CHECK(mem_reserve(cur - HOST_PAGE_SIZE, cur) == -1, "reserving allocated memory");
+    CHECK(mem_reserve(lo, hi) == 0, "mem_reserve");
+
+    // 之后的分配跨过保留区
+    for (int i = 0; i < 64; i++) {
+        size_t    size = 1 + rnd_below(3 * HOST_PAGE_SIZE);
+        uintptr_t p    = (uintptr_t)(i & 1 ? kern_malloc(size) : alloc_pages(1 + size / HOST_PAGE_SIZE));
+        size_t    len  = i & 1 ? size : (1 + size / HOST_PAGE_SIZE) * HOST_PAGE_SIZE;
+        CHECK(p && (p + len <= lo || p >= hi), "allocation %#lx+%zu inside reserved range", p, len);
+    }
+}
+
+void test_mem(unsigned long iters)
+{
+    if (host_heap_init() < 0) {
+        printf("mem: cannot map the kernel heap at %#lx, skipped\n", HOST_HEAP_START);
+        return;
+    }
+
+    test_malloc(iters);
+    test_calloc(iters);
+    test_aligned(iters);
+    test_pages();
+    test_reserve();
+    check_tracked();
+}
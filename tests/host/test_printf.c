@@ -0,0 +1,177 @@
+/*
+ * RISC-V testos 主机测试：my_vsnprintf 与 libc snprintf 对比
+ *
+ * 随机生成内核支持的转换（%d %u %x %p %s %c %%，标志 - 0 #，宽度，l/ll），
+ * 每个格式串含一个转换和两侧的普通文本，再用随机的缓冲区大小检查截断。
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+#define OUT_SIZE    256
+
+typedef enum { ARG_NONE, ARG_INT, ARG_LONG, ARG_LLONG, ARG_PTR, ARG_STR } arg_kind_t;
+
+typedef struct {
+    char fmt[64];
+    arg_kind_t kind;
+    long long ival;
+    void *pval;
+    const char *sval;
+} spec_t;
+
+static long long random_int(int bits)
+{
+    static const long long edges[] = { 0, 1, -1, INT_MAX, INT_MIN, LLONG_MAX, LLONG_MIN, 255, -255 };
+    long long v;
+
+    if (rnd_below(8) == 0) {
+        v = edges[rnd_below(sizeof(edges) / sizeof(edges[0]))];
+    } else {
+        v = (long long)(rnd() >> rnd_below(64));
+        if (rnd() & 1) {
+            v = -v;
+        }
+    }
+    return bits == 32 ? (int)v : v;
+}
+
+static void random_spec(spec_t *s)
+{
+    static const char conv[] = "duxpsc%";
+    static const char *const strs[] = { "", "x", "hello", "a much longer string argument" };
+    static const char *const text[] = { "", "v=", "[", "abc ", "\xe4\xb8\xad" };
+    char  c     = conv[rnd_below(sizeof(conv) - 1)];
+    char *p     = s->fmt;
+    int   nlong = (int)rnd_below(3);
+
+    p += sprintf(p, "%s%%", text[rnd_below(5)]);
+
+    if (c != '%' && c != 'c') {
+        if (rnd_below(3) == 0) {
+            *p++ = '-';
+        }
+        // libc 对 %p、%s 的 0 标志无定义，只用于整数
+        if (c != 'p' && c != 's' && rnd_below(3) == 0) {
+            *p++ = '0';
+        }
+        if (c == 'x' && rnd_below(3) == 0) {
+            *p++ = '#';
+        }
+        if (rnd() & 1) {
+            p += sprintf(p, "%d", 1 + (int)rnd_below(24));
+        }
+    }
+
+    s->kind = ARG_NONE;
+    switch (c) {
+        case 'd': case 'u': case 'x':
+            for (int i = 0; i < nlong; i++) {
+                *p++ = 'l';
+            }
+            s->kind = nlong == 0 ? ARG_INT : nlong == 1 ? ARG_LONG : ARG_LLONG;
+            s->ival = random_int(nlong ? 64 : 32);
+            break;
+        case 'p':
+            s->kind = ARG_PTR;
+            s->pval = (void *)(uintptr_t)(1 + (rnd() >> rnd_below(64)));
+            break;
+        case 's':
+            s->kind = ARG_STR;
+            s->sval = strs[rnd_below(4)];
+            break;
+        case 'c':
+            s->kind = ARG_INT;
+            s->ival = 1 + (int)rnd_below(126);
+            break;
+    }
+    *p++ = c;
+    strcpy(p, text[rnd_below(5)]);
+}
+
+// 用同一组参数调用 libc 与内核实现
+#define FORMAT_BOTH(s, size, rbuf, rret, kbuf, kret)                                          \
+    do {                                                                                     \
+        switch ((s)->kind) {                                                                 \
+        case ARG_NONE:                                                                       \
+            rret = snprintf(rbuf, size, (s)->fmt);                                           \
+            kret = my_snprintf(kbuf, size, (s)->fmt);                                        \
+            break;                                                                           \
+        case ARG_INT:                                                                        \
+            rret = snprintf(rbuf, size, (s)->fmt, (int)(s)->ival);                           \
+            kret = my_snprintf(kbuf, size, (s)->fmt, (int)(s)->ival);                        \
+            break;                                                                           \
+        case ARG_LONG:                                                                       \
+            rret = snprintf(rbuf, size, (s)->fmt, (long)(s)->ival);                          \
+            kret = my_snprintf(kbuf, size, (s)->fmt, (long)(s)->ival);                       \
+            break;                                                                           \
+        case ARG_LLONG:                                                                      \
+            rret = snprintf(rbuf, size, (s)->fmt, (s)->ival);                                \
+            kret = my_snprintf(kbuf, size, (s)->fmt, (s)->ival);                             \
+            break;                                                                           \
+        case ARG_PTR:                                                                        \
+            rret = snprintf(rbuf, size, (s)->fmt, (s)->pval);                                \
+            kret = my_snprintf(kbuf, size, (s)->fmt, (s)->pval);                             \
+            break;                                                                           \
+        case ARG_STR:                                                                        \
+            rret = snprintf(rbuf, size, (s)->fmt, (s)->sval);                                \
+            kret = my_snprintf(kbuf, size, (s)->fmt, (s)->sval);                             \
+            break;                                                                           \
+        }                                                                                    \
+    } while (0)
+
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+
+static void test_formats(unsigned long iters)
+{
+    char   rbuf[OUT_SIZE], kbuf[OUT_SIZE + 16];
+    spec_t s;
+
+    for (unsigned long it = 0; it < iters; it++) {
+        int rret = 0, kret = 0;
+
+        random_spec(&s);
+        FORMAT_BOTH(&s, OUT_SIZE, rbuf, rret, kbuf, kret);
+        CHECK(rret == kret && strcmp(rbuf, kbuf) == 0, "\"%s\" (%lld): libc \"%s\" (%d), kernel \"%s\" (%d)",
+              s.fmt, s.ival, rbuf, rret, kbuf, kret);
+
+        // 截断：返回值仍是完整长度，输出是完整结果的前缀且以 '\0' 结尾，不越界
+        int size = 1 + (int)rnd_below(rret + 4);
+        memset(kbuf, 'Z', sizeof(kbuf));
+        FORMAT_BOTH(&s, size, rbuf, rret, kbuf, kret);
+        CHECK(rret == kret && strcmp(rbuf, kbuf) == 0, "\"%s\" size %d: libc \"%s\", kernel \"%s\"",
+              s.fmt, size, rbuf, kbuf);
+        CHECK(kbuf[size] == 'Z', "\"%s\" size %d: wrote past the buffer", s.fmt, size);
+    }
+
+    // size 为 0 时只计算长度，不写缓冲区
+    memset(kbuf, 'Z', sizeof(kbuf));
+    CHECK(my_snprintf(kbuf, 0, "%d-%s", 12345, "abc") == 9 && kbuf[0] == 'Z', "size 0");
+}
+
+static void test_logger(void)
+{
+    char long_msg[1024];
+
+    uart_capture_take();
+    logger("pid %d: %s\n", 7, "ok");
+    CHECK(strcmp(uart_capture_take(), "[TESTOS] pid 7: ok\n") == 0, "logger prefix");
+
+    // 超过内部缓冲区（512 字节）的消息被截断，不越界
+    memset(long_msg, 'm', sizeof(long_msg) - 1);
+    long_msg[sizeof(long_msg) - 1] = '\0';
+    int         n   = logger("%s", long_msg);
+    const char *out = uart_capture_take();
+    CHECK(n == (int)sizeof(long_msg) - 1, "logger return %d", n);
+    CHECK(strlen(out) == strlen("[TESTOS] ") + 511, "logger truncation: %zu bytes", strlen(out));
+}
+
+void test_printf(unsigned long iters)
+{
+    test_formats(iters);
+    test_logger();
+}
@@ -0,0 +1,183 @@
+/*
+ * RISC-V testos 主机测试：src/lib/string.c 与 libc 对比
+ *
+ * 随机长度、随机对齐的缓冲区；字符串取自小字母表，让比较和查找经常命中。
+ * 比较函数只要求符号一致。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+// strncpy 不补 '\0' 正是要对比的行为
+#pragma GCC diagnostic ignored "-Wstringop-truncation"
+
+#define ARENA       8192
+#define MAX_LEN     600
+
+static unsigned char a_ref[ARENA], a_kern[ARENA], src[ARENA];
+
+static void fill_random(unsigned char *p, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        p[i] = (unsigned char)rnd();
+    }
+}
+
+// 长度为 len 的随机字符串，字母表大小为 alpha（含高位字节以覆盖有符号 char）
+static void random_string(char *s, size_t len, unsigned alpha)
+{
+    static const char pool[] = "ab\x80\xff cdefghijklmnopqrstuvwxyz0123456789";
+
+    for (size_t i = 0; i < len; i++) {
+        s[i] = pool[rnd_below(alpha < sizeof(pool) - 1 ? alpha : sizeof(pool) - 1)];
+    }
+    s[len] = '\0';
+}
+
+static void test_mem_ops(unsigned long iters)
+{
+    for (unsigned long it = 0; it < iters; it++) {
+        size_t n    = rnd_below(MAX_LEN);
+        size_t doff = rnd_below(64), soff = rnd_below(64);
+        int    c    = (int)rnd_below(512) - 128;
+
+        fill_random(src, ARENA);
+        fill_random(a_ref, ARENA);
+        memcpy(a_kern, a_ref, ARENA);
+
+        switch (it % 4) {
+            case 0:
+                memcpy(a_ref + doff, src + soff, n);
+                CHECK(kern_memcpy(a_kern + doff, src + soff, n) == a_kern + doff, "memcpy return");
+                CHECK(memcmp(a_ref, a_kern, ARENA) == 0, "memcpy n=%zu doff=%zu soff=%zu", n, doff,
+                      soff);
+                break;
+            case 1:
+                memset(a_ref + doff, c, n);
+                CHECK(kern_memset(a_kern + doff, c, n) == a_kern + doff, "memset return");
+                CHECK(memcmp(a_ref, a_kern, ARENA) == 0, "memset n=%zu c=%d", n, c);
+                break;
+            case 2: {
+                // 同一缓冲区内的重叠拷贝，两个方向都覆盖
+                size_t from = rnd_below(1024), to = rnd_below(1024);
+                memmove(a_ref + to, a_ref + from, n);
+                CHECK(kern_memmove(a_kern + to, a_kern + from, n) == a_kern + to, "memmove return");
+                CHECK(memcmp(a_ref, a_kern, ARENA) == 0, "memmove n=%zu from=%zu to=%zu", n, from,
+                      to);
+                break;
+            }
+            default: {
+                // 两份相同数据再随机改一个字节，比较结果与查找位置都应一致
+                memcpy(a_kern, a_ref, ARENA);
+                if (n && rnd() & 1) {
+                    a_kern[doff + rnd_below(n)] ^= (unsigned char)(1 + rnd_below(255));
+                }
+                CHECK(sign(kern_memcmp(a_ref + doff, a_kern + doff, n)) ==
+                          sign(memcmp(a_ref + doff, a_kern + doff, n)),
+                      "memcmp n=%zu", n);
+                const void *r = memchr(a_ref + doff, c, n);
+                const void *k = kern_memchr(a_ref + doff, c, n);
+                CHECK(r == k, "memchr n=%zu c=%d: libc %p kernel %p", n, c, r, k);
+                break;
+            }
+        }
+    }
+}
+
+static void test_str_ops(unsigned long iters)
+{
+    char s1[MAX_LEN + 1], s2[MAX_LEN + 1], dr[2 * MAX_LEN + 2], dk[2 * MAX_LEN + 2];
+
+    for (unsigned long it = 0; it < iters; it++) {
+        unsigned alpha = 1 + (unsigned)rnd_below(8);
+        size_t   l1    = rnd_below(it % 8 == 0 ? MAX_LEN : 16);
+        size_t   l2    = rnd_below(it % 8 == 0 ? MAX_LEN : 16);
+        size_t   n     = rnd_below(24);
+        int      c     = (int)rnd_below(256);
+
+        random_string(s1, l1, alpha);
+        if (rnd() & 1) {
+            // 共同前缀让比较走到更深的位置
+            size_t keep = l1 < l2 ? l1 : l2;
+            memcpy(s2, s1, keep);
+            random_string(s2 + keep, l2 - keep, alpha);
+        } else {
+            random_string(s2, l2, alpha);
+        }
+
+        CHECK(kern_strlen(s1) == strlen(s1), "strlen len=%zu", l1);
+        CHECK(sign(kern_strcmp(s1, s2)) == sign(strcmp(s1, s2)), "strcmp \"%s\" \"%s\"", s1, s2);
+        CHECK(sign(kern_strncmp(s1, s2, n)) == sign(strncmp(s1, s2, n)), "strncmp \"%s\" \"%s\" %zu",
+              s1, s2, n);
+
+        CHECK(kern_strchr(s1, c) == strchr(s1, c), "strchr \"%s\" %d", s1, c);
+        CHECK(kern_strchr(s1, '\0') == strchr(s1, '\0'), "strchr nul");
+        CHECK(kern_strrchr(s1, c) == strrchr(s1, c), "strrchr \"%s\" %d", s1, c);
+        CHECK(kern_strrchr(s1, '\0') == strrchr(s1, '\0'), "strrchr nul");
+
+        // 子串取自 s1 本身或随机串，两种情况都要覆盖
+        char   needle[MAX_LEN + 1];
+        size_t nl = rnd_below(6);
+        if (l1 && rnd() & 1) {
+            size_t at = rnd_below(l1);
+            nl        = nl < l1 - at ? nl : l1 - at;
+            memcpy(needle, s1 + at, nl);
+            needle[nl] = '\0';
+        } else {
+            random_string(needle, nl, alpha);
+        }
+        CHECK(kern_strstr(s1, needle) == strstr(s1, needle), "strstr \"%s\" \"%s\"", s1, needle);
+
+        memset(dr, 'Z', sizeof(dr));
+        memset(dk, 'Z', sizeof(dk));
+        CHECK(kern_strcpy(dk, s1) == dk, "strcpy return");
+        strcpy(dr, s1);
+        CHECK(memcmp(dr, dk, sizeof(dr)) == 0, "strcpy \"%s\"", s1);
+        CHECK(kern_strcat(dk, s2) == dk, "strcat return");
+        strcat(dr, s2);
+        CHECK(memcmp(dr, dk, sizeof(dr)) == 0, "strcat \"%s\" \"%s\"", s1, s2);
+
+        memset(dr, 'Z', sizeof(dr));
+        memset(dk, 'Z', sizeof(dk));
+        CHECK(kern_strncpy(dk, s1, n) == dk, "strncpy return");
+        strncpy(dr, s1, n);
+        CHECK(memcmp(dr, dk, sizeof(dr)) == 0, "strncpy \"%s\" %zu", s1, n);
+    }
+}
+
+static void test_atoi(unsigned long iters)
+{
+    static const char *const fixed[] = {
+        "0", "-0", "+7", "  42", "\t-13x", "\n99", "", "-", "+", "12 34", "007",
+        "2147483647", "-2147483648", "9223372036854775807", "-9223372036854775807",
+    };
+    char buf[40];
+
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) {
+        CHECK(kern_atol(fixed[i]) == atol(fixed[i]), "atol \"%s\"", fixed[i]);
+    }
+
+    for (unsigned long it = 0; it < iters; it++) {
+        // 只覆盖内核 atol 认的空白（空格、制表、换行）和不溢出的取值
+        static const char *const ws[] = { "", " ", "\t", "\n ", "  \t" };
+        long v = (long)(rnd() >> (1 + rnd_below(63)));
+        if (rnd() & 1) {
+            v = -v;
+        }
+        snprintf(buf, sizeof(buf), "%s%s%ld%s", ws[rnd_below(5)], (v >= 0 && rnd() & 1) ? "+" : "",
+                 v, (rnd() & 1) ? "z9" : "");
+        CHECK(kern_atol(buf) == atol(buf), "atol \"%s\": %ld vs %ld", buf, kern_atol(buf), atol(buf));
+        if (v >= INT32_MIN && v <= INT32_MAX) {
+            CHECK(kern_atoi(buf) == atoi(buf), "atoi \"%s\"", buf);
+        }
+    }
+}
+
+void test_string(unsigned long iters)
+{
+    test_mem_ops(iters);
+    test_str_ops(iters);
+    test_atoi(iters);
+}
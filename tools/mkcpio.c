@@ -0,0 +1,129 @@
+/*
+ * RISC-V testos 根文件系统映像生成工具（宿主机运行）
+ *
+ * 用法: mkcpio -o <output> <file>...
+ *
+ * 生成 newc 格式的 cpio 归档，文件以 basename 命名。每个文件的数据起始位置
+ * 按页对齐（在文件名后补 NUL，namesize 包含这些 NUL），内核可以直接映射
+ * 只读段执行；归档总长度补齐到整页，便于直接作为块设备镜像使用。
+ * 生成的归档仍可被标准 cpio 工具解包。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define PAGE_SIZE       4096
+#define CPIO_HDR_SIZE   110
+
+#define ALIGN_UP(x, a)  (((x) + (a) - 1) / (a) * (a))
+
+static unsigned long offset;
+static unsigned long ino = 1;
+
+static void put(FILE *out, const void *buf, size_t len)
+{
+    if (fwrite(buf, 1, len, out) != len) {
+        perror("mkcpio: write");
+        exit(1);
+    }
+    offset += len;
+}
+
+static void pad(FILE *out, unsigned long to)
+{
+    static const char zeros[PAGE_SIZE];
+
+    while (offset < to) {
+        unsigned long n = to - offset;
+        put(out, zeros, n < sizeof(zeros) ? n : sizeof(zeros));
+    }
+}
+
+static void put_entry(FILE *out, const char *name, unsigned mode, const void *data,
+                      unsigned long size)
+{
+    char          hdr[CPIO_HDR_SIZE + 1];
+    unsigned long namesize = strlen(name) + 1;
+
+    // 非空文件的数据按页对齐
+    if (size) {
+        unsigned long data_off = ALIGN_UP(offset + CPIO_HDR_SIZE + namesize, PAGE_SIZE);
+        namesize = data_off - offset - CPIO_HDR_SIZE;
+    }
+
+    snprintf(hdr, sizeof(hdr), "070701%08lX%08X%08X%08X%08X%08X%08lX%08X%08X%08X%08X%08lX%08X",
+             ino++, mode, 0, 0, 1, 0, size, 0, 0, 0, 0, namesize, 0);
+    put(out, hdr, CPIO_HDR_SIZE);
+    put(out, name, strlen(name));
+    pad(out, ALIGN_UP(offset + namesize - strlen(name), 4));
+    put(out, data, size);
+    pad(out, ALIGN_UP(offset, 4));
+}
+
+static void *read_file(const char *path, unsigned long *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    void *buf = malloc(*size ? *size : 1);
+    if (!buf || fread(buf, 1, *size, f) != *size) {
+        fprintf(stderr, "mkcpio: failed to read %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    const char *output = NULL;
+    int         first  = 1;
+
+    if (argc >= 3 && strcmp(argv[1], "-o") == 0) {
+        output = argv[2];
+        first  = 3;
+    }
+    if (!output) {
+        fprintf(stderr, "usage: %s -o <output> <file>...\n", argv[0]);
+        return 1;
+    }
+
+    FILE *out = fopen(output, "wb");
+    if (!out) {
+        perror(output);
+        return 1;
+    }
+
+    for (int i = first; i < argc; i++) {
+        struct stat   st;
+        unsigned long size;
+
+        if (stat(argv[i], &st) < 0 || !S_ISREG(st.st_mode)) {
+            fprintf(stderr, "mkcpio: skipping %s (not a regular file)\n", argv[i]);
+            continue;
+        }
+
+        const char *name = strrchr(argv[i], '/');
+        name = name ? name + 1 : argv[i];
+
+        void *data = read_file(argv[i], &size);
+        put_entry(out, name, 0100000 | (st.st_mode & 0777), data, size);
+        printf("  %-24s %8lu bytes at 0x%lx\n", name, size, offset - ALIGN_UP(size, 4));
+        free(data);
+    }
+
+    put_entry(out, "TRAILER!!!", 0, NULL, 0);
+    pad(out, ALIGN_UP(offset, PAGE_SIZE));
+
+    fclose(out);
+    printf("%s: %lu bytes\n", output, offset);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * RISC-V testos 压缩内核映像生成工具（宿主机运行）
+ *
+ * 用法: mkzimage -s <stub.bin> -o <output> [-b <MB/s>] <kernel.bin>
+ *
+ * 把原始内核映像压缩成一个 LZ4 块，拼在解压存根和 zboot_header_t 之后（布局见
+ * include/zboot.h）。压缩用贪心的单哈希匹配：内核映像只压一次，解压速度才是关键，
+ * LZ4 的解码每个序列只有一次拷贝。给出 -b 时按该存储带宽估算两种映像的加载时间。
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/zboot.h"
+
+#define HASH_LOG        16
+#define MIN_MATCH       4
+#define MAX_OFFSET      65535
+#define LAST_LITERALS   5       // 块的最后 5 字节必须是字面量
+#define MF_LIMIT        12      // 最后一个匹配至少在块尾前 12 字节开始
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE    *f = fopen(path, "rb");
+    uint8_t *buf;
+    long     n;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(n > 0 ? n : 1);
+    if (!buf || fread(buf, 1, n, f) != (size_t)n) {
+        fprintf(stderr, "mkzimage: cannot read %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+    *len = n;
+    return buf;
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint32_t hash4(const uint8_t *p)
+{
+    return (read32(p) * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// 长度字段超过 15 的部分用 255 串接
+static uint8_t *put_ext_len(uint8_t *op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// 输出一个序列；match_len 为 0 表示只有字面量的最后一个序列
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *lit, size_t lit_len, size_t offset,
+                             size_t match_len)
+{
+    uint8_t *token = op++;
+
+    *token = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15) {
+        op = put_ext_len(op, lit_len - 15);
+    }
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len) {
+        size_t ml = match_len - MIN_MATCH;
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)(ml < 15 ? ml : 15);
+        if (ml >= 15) {
+            op = put_ext_len(op, ml - 15);
+        }
+    }
+    return op;
+}
+
+// 输出缓冲区至少 n + n / 255 + 16 字节
+static size_t lz4_compress(const uint8_t *src, size_t n, uint8_t *dst)
+{
+    static uint32_t table[1 << HASH_LOG];       // 位置 + 1，0 表示空
+    const uint8_t  *ip     = src;
+    const uint8_t  *anchor = src;
+    const uint8_t  *iend   = src + n;
+    uint8_t        *op     = dst;
+
+    memset(table, 0, sizeof(table));
+    if (n > MF_LIMIT) {
+        const uint8_t *mflimit    = iend - MF_LIMIT;
+        const uint8_t *matchlimit = iend - LAST_LITERALS;
+
+        while (ip <= mflimit) {
+            uint32_t h    = hash4(ip);
+            uint32_t cand = table[h];
+
+            table[h] = (uint32_t)(ip - src) + 1;
+            if (!cand || ip - (src + cand - 1) > MAX_OFFSET || read32(src + cand - 1) != read32(ip)) {
+                ip++;
+                continue;
+            }
+
+            // 向两侧扩展匹配，结尾不能进入最后 5 个字面量
+            const uint8_t *ref = src + cand - 1;
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            size_t len = MIN_MATCH;
+            while (ip + len < matchlimit && ip[len] == ref[len]) {
+                len++;
+            }
+
+            op     = put_sequence(op, anchor, ip - anchor, ip - ref, len);
+            ip    += len;
+            anchor = ip;
+        }
+    }
+    op = put_sequence(op, anchor, iend - anchor, 0, 0);
+    return op - dst;
+}
+
+static void write_all(FILE *out, const void *buf, size_t len)
+{
+    if (fwrite(buf, 1, len, out) != len) {
+        perror("mkzimage: write");
+        exit(1);
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: mkzimage -s <stub.bin> -o <output> [-b <MB/s>] <kernel.bin>\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *stub_path = NULL, *out_path = NULL;
+    double      mbps      = 0;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "s:o:b:")) != -1) {
+        switch (opt) {
+            case 's': stub_path = optarg; break;
+            case 'o': out_path  = optarg; break;
+            case 'b': mbps      = atof(optarg); break;
+            default: usage();
+        }
+    }
+    if (!stub_path || !out_path || optind != argc - 1) {
+        usage();
+    }
+
+    size_t   stub_len, raw_len;
+    uint8_t *stub = read_file(stub_path, &stub_len);
+    uint8_t *raw  = read_file(argv[optind], &raw_len);
+
+    if (raw_len < ZBOOT_INFO_OFFSET + sizeof(zboot_info_t) || raw_len > UINT32_MAX) {
+        fprintf(stderr, "mkzimage: %s does not look like a testos kernel image\n", argv[optind]);
+        return 1;
+    }
+
+    uint8_t *comp     = malloc(raw_len + raw_len / 255 + 16);
+    size_t   comp_len = lz4_compress(raw, raw_len, comp);
+
+    zboot_header_t hdr = {
+        .magic     = ZBOOT_MAGIC,
+        .raw_size  = (uint32_t)raw_len,
+        .comp_size = (uint32_t)comp_len,
+    };
+
+    // 存根链接脚本已把长度补齐到 16 字节，头紧随其后
+    static const uint8_t zeros[16];
+    size_t stub_pad = (16 - stub_len % 16) % 16;
+
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+    write_all(out, stub, stub_len);
+    write_all(out, zeros, stub_pad);
+    write_all(out, &hdr, sizeof(hdr));
+    write_all(out, comp, comp_len);
+    fclose(out);
+
+    size_t total = stub_len + stub_pad + sizeof(hdr) + comp_len;
+    printf("mkzimage: %zu -> %zu bytes (%.1f%%, stub %zu bytes)\n", raw_len, total,
+           total * 100.0 / raw_len, stub_len);
+    if (mbps > 0) {
+        double bps = mbps * 1024 * 1024;
+        printf("mkzimage: load at %.1f MB/s: raw %.2f ms, compressed %.2f ms + decompression\n",
+               mbps, raw_len * 1e3 / bps, total * 1e3 / bps);
+    }
+
+    free(comp);
+    free(raw);
+    free(stub);
+    return 0;
+}
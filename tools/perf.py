@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""
+RISC-V testos 性能回归检查
+
+在 QEMU（icount 模式，周期数由执行的指令数决定，可重复）中启动内核，
+等到 shell 提示符后逐行发送命令脚本，把串口输出全部写入日志文件，
+再取出其中的 "PERF <名称> <周期/次>" 行与基线比较。
+
+用法：
+    perf.py --qemu "<qemu 命令行>" [--script tools/perf.cmds]
+            [--baseline tools/perf-baseline.txt] [--tolerance 5]
+            [--output bench_output.txt] [--update]
+    perf.py --table <基线文件>...       并排比较几份结果（make profile-report 用）
+
+退出码：0 通过（基线为空时打印警告后跳过检查），1 有项目超出容差，2 启动或运行失败。
+"""
+
+import argparse
+import os
+import re
+import selectors
+import shlex
+import subprocess
+import sys
+import time
+
+PROMPT = b"testos> "
+PERF_LINE = re.compile(r"^PERF (\S+) (\d+)\s*$", re.MULTILINE)
+
+
+class Console:
+    """QEMU 串口（-nographic 时即标准输入输出）"""
+
+    def __init__(self, argv, log):
+        self.proc = subprocess.Popen(argv, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                     stderr=subprocess.STDOUT)
+        self.log = log
+        self.sel = selectors.DefaultSelector()
+        self.sel.register(self.proc.stdout, selectors.EVENT_READ)
+
+    def wait_prompt(self, timeout):
+        """读到下一个提示符为止，返回期间的输出"""
+        buf = b""
+        deadline = time.monotonic() + timeout
+        while not buf.endswith(PROMPT):
+            left = deadline - time.monotonic()
+            if left <= 0:
+                raise TimeoutError("no shell prompt within %d s" % timeout)
+            if not self.sel.select(left):
+                continue
+            data = os.read(self.proc.stdout.fileno(), 4096)
+            if not data:
+                raise EOFError("QEMU exited (status %s)" % self.proc.wait())
+            self.log.write(data)
+            buf += data
+        return buf[:-len(PROMPT)].decode(errors="replace")
+
+    def send(self, line):
+        self.proc.stdin.write(line.encode() + b"\r")
+        self.proc.stdin.flush()
+
+    def close(self):
+        # Ctrl-A x 让 QEMU 正常退出，不行再强杀
+        try:
+            self.proc.stdin.write(b"\x01x")
+            self.proc.stdin.flush()
+            self.proc.wait(timeout=5)
+        except (OSError, subprocess.TimeoutExpired):
+            self.proc.kill()
+            self.proc.wait()
+
+
+def read_commands(path):
+    with open(path) as f:
+        return [l.strip() for l in f if l.strip() and not l.lstrip().startswith("#")]
+
+
+def read_baseline(path):
+    """基线格式：每行 "<名称> <周期/次>"，# 开头为注释"""
+    base = {}
+    if not os.path.exists(path):
+        return base
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].split()
+            if not line:
+                continue
+            if len(line) != 2 or not line[1].isdigit():
+                sys.exit("%s:%d: expected '<name> <cycles>'" % (path, lineno))
+            base[line[0]] = int(line[1])
+    return base
+
+
+def write_baseline(path, results):
+    with open(path, "w") as f:
+        f.write("# make perf 基线：<名称> <周期/次>（QEMU icount 模式）\n")
+        f.write("# 用 make perf-baseline 重新生成；没有基线的项目只报告为 new，基线为空时 make perf 警告并跳过\n")
+        for name, cycles in results.items():
+            f.write("%s %d\n" % (name, cycles))
+
+
+def compare(results, base, tolerance):
+    """打印对比表，返回超出容差的项目数"""
+    regressions = 0
+    print("%-20s %12s %12s %9s" % ("benchmark", "baseline", "current", "change"))
+    for name, cur in results.items():
+        ref = base.get(name)
+        if ref is None:
+            print("%-20s %12s %12d %9s  new" % (name, "-", cur, ""))
+            continue
+        change = (cur - ref) * 100.0 / ref if ref else (0.0 if cur == 0 else float("inf"))
+        verdict = ""
+        if change > tolerance:
+            verdict = "REGRESSION"
+            regressions += 1
+        elif change < -tolerance:
+            verdict = "faster (update the baseline)"
+        print("%-20s %12d %12d %+8.1f%%  %s" % (name, ref, cur, change, verdict))
+    for name in base:
+        if name not in results:
+            print("%-20s %12d %12s %9s  missing" % (name, base[name], "-", ""))
+    return regressions
+
+
+def print_table(paths):
+    """以第一份为参照并排列出各份结果，列名取文件所在目录名（构建配置名）"""
+    tables = [read_baseline(p) for p in paths]
+    labels = [os.path.basename(os.path.dirname(os.path.abspath(p))) for p in paths]
+    names = list(dict.fromkeys(n for t in tables for n in t))
+    print("%-20s" % "cycles/op" + "".join("%18s" % l for l in labels))
+    for name in names:
+        ref = tables[0].get(name)
+        row = "%-20s" % name
+        for t in tables:
+            cur = t.get(name)
+            if cur is None:
+                row += "%18s" % "-"
+            elif t is tables[0] or not ref:
+                row += "%18d" % cur
+            else:
+                row += "%10d (%+4.0f%%)" % (cur, (cur - ref) * 100.0 / ref)
+        print(row)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Boot testos in QEMU and compare PERF results "
+                                             "against a baseline")
+    ap.add_argument("--qemu", help="QEMU command line")
+    ap.add_argument("--script", default="tools/perf.cmds", help="shell commands to send")
+    ap.add_argument("--baseline", default="tools/perf-baseline.txt")
+    ap.add_argument("--tolerance", type=float, default=5.0, help="allowed slowdown in percent")
+    ap.add_argument("--output", default="bench_output.txt", help="raw serial log")
+    ap.add_argument("--timeout", type=int, default=300, help="seconds per command")
+    ap.add_argument("--update", action="store_true", help="rewrite the baseline")
+    ap.add_argument("--table", nargs="+", metavar="FILE", help="print saved results side by side")
+    args = ap.parse_args()
+
+    if args.table:
+        print_table(args.table)
+        return 0
+    if not args.qemu:
+        ap.error("--qemu is required")
+
+    # 空基线下没有可比较的项目：明确说明跳过了检查，不启动 QEMU
+    base = {}
+    if not args.update:
+        base = read_baseline(args.baseline)
+        if not base:
+            print("perf: WARNING: %s has no entries, regression check SKIPPED; run "
+                  "'make PLATFORM=qemu perf-baseline' on a known-good tree and commit it"
+                  % args.baseline, file=sys.stderr)
+            return 0
+
+    commands = read_commands(args.script)
+    output = ""
+    with open(args.output, "wb") as log:
+        con = Console(shlex.split(args.qemu), log)
+        try:
+            con.wait_prompt(args.timeout)
+            for cmd in commands:
+                con.send(cmd)
+                output += con.wait_prompt(args.timeout)
+        except (TimeoutError, EOFError) as e:
+            print("perf: %s, see %s" % (e, args.output), file=sys.stderr)
+            return 2
+        finally:
+            con.close()
+
+    results = {m.group(1): int(m.group(2)) for m in PERF_LINE.finditer(output)}
+    if not results:
+        print("perf: no PERF lines in %s" % args.output, file=sys.stderr)
+        return 2
+
+    if args.update:
+        write_baseline(args.baseline, results)
+        print("perf: wrote %d entries to %s" % (len(results), args.baseline))
+        return 0
+
+    regressions = compare(results, base, args.tolerance)
+    if regressions:
+        print("perf: %d benchmark(s) slower than the baseline by more than %g%%"
+              % (regressions, args.tolerance))
+        return 1
+    print("perf: all benchmarks within %g%% of the baseline" % args.tolerance)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
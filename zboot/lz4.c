@@ -0,0 +1,93 @@
+/*
+ * RISC-V testos 解压存根：LZ4 块格式解码
+ *
+ * 与内核分开编译（-mcmodel=medany -fno-jump-tables），只有 PC 相对寻址，
+ * 存根把自己搬到别处后仍可直接调用。每一步都检查输入输出边界，
+ * 映像损坏时返回错误而不是写坏内存。
+ */
+
+#include "types.h"
+
+// 读取可能以 255 串接的扩展长度，越界返回 -1
+static long lz4_ext_len(const uint8_t **ip, const uint8_t *iend)
+{
+    long    len = 0;
+    uint8_t b;
+
+    do {
+        if (*ip >= iend) {
+            return -1;
+        }
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+/**
+ * 解码一个 LZ4 块
+ * @return 输出字节数，输入损坏或输出空间不足返回 -1
+ */
+long lz4_decompress(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_cap)
+{
+    const uint8_t *ip   = src;
+    const uint8_t *iend = src + src_len;
+    uint8_t       *op   = dst;
+    uint8_t       *oend = dst + dst_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        long    len   = token >> 4;
+
+        // 字面量
+        if (len == 15) {
+            long ext = lz4_ext_len(&ip, iend);
+            if (ext < 0) {
+                return -1;
+            }
+            len += ext;
+        }
+        if (len > iend - ip || len > oend - op) {
+            return -1;
+        }
+        while (len--) {
+            *op++ = *ip++;
+        }
+
+        // 最后一个序列只有字面量
+        if (ip >= iend) {
+            break;
+        }
+
+        // 匹配：2 字节小端偏移，长度至少 4
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) {
+            return -1;
+        }
+
+        len = token & 15;
+        if (len == 15) {
+            long ext = lz4_ext_len(&ip, iend);
+            if (ext < 0) {
+                return -1;
+            }
+            len += ext;
+        }
+        len += 4;
+        if (len > oend - op) {
+            return -1;
+        }
+
+        // 偏移可能小于长度（重复模式），只能逐字节向前复制
+        const uint8_t *match = op - offset;
+        while (len--) {
+            *op++ = *match++;
+        }
+    }
+
+    return op - dst;
+}